@@ -0,0 +1,418 @@
+/** @file  uapcli.c
+ *
+ *  @brief This file contains the client of the uaputl daemon, with a
+ *  query rate benchmark.
+ *
+ * Copyright (C) 2008-2009, Marvell International Ltd.
+ *
+ * This software file (the "File") is distributed by Marvell International
+ * Ltd. under the terms of the GNU General Public License Version 2, June 1991
+ * (the "License").  You may use, redistribute and/or modify this File in
+ * accordance with the terms and conditions of the License, a copy of which
+ * is available along with the File in the gpl.txt file or by writing to
+ * the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307 or on the worldwide web at http://www.gnu.org/licenses/gpl.txt.
+ *
+ * THE FILE IS DISTRIBUTED AS-IS, WITHOUT WARRANTY OF ANY KIND, AND THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE
+ * ARE EXPRESSLY DISCLAIMED.  The License provides additional details about
+ * this warranty disclaimer.
+ *
+ */
+/****************************************************************************
+Change log:
+    10/17/26: Initial creation
+****************************************************************************/
+
+/****************************************************************************
+        Header files
+****************************************************************************/
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "uapd.h"
+
+/****************************************************************************
+        Definitions
+****************************************************************************/
+/** Client version */
+#define UAPCLI_VERSION          "1.0"
+
+/** Daemon connection */
+typedef struct _uapcli_conn
+{
+    /** Socket */
+    int fd;
+    /** Buffered reader on the socket */
+    FILE *in;
+} uapcli_conn;
+
+/** Command line options */
+static struct option cli_options[] = {
+    {"socket", 1, NULL, 's'},
+    {"count", 1, NULL, 'n'},
+    {"clients", 1, NULL, 'c'},
+    {"exec", 1, NULL, 'x'},
+    {"help", 0, NULL, 'h'},
+    {0, 0, 0, 0}
+};
+
+/****************************************************************************
+        Local functions
+****************************************************************************/
+/**
+ *  @brief Prints the client usage
+ *
+ *  @return         N/A
+ */
+static void
+print_usage(void)
+{
+    printf("uapcli - uaputl daemon client ver %s\n"
+           "Usage:\n"
+           "\tuapcli [options] <command> [command parameters]\n"
+           "Options:\n"
+           "\t-s <socket>  Daemon socket, default " UAPD_DEFAULT_SOCKET "\n"
+           "\t-n <count>   Benchmark: send the command count times\n"
+           "\t-c <clients> Benchmark: number of concurrent clients\n"
+           "\t-x <uaputl>  Benchmark: exec uaputl per query instead of\n"
+           "\t             using the daemon\n", UAPCLI_VERSION);
+}
+
+/**
+ *  @brief Returns the monotonic time in seconds
+ *
+ *  @return         Time in seconds
+ */
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ *  @brief Builds the request line for a command
+ *
+ *  @param line     Output buffer, UAPD_MAX_REQUEST bytes
+ *  @param argc     Number of arguments
+ *  @param argv     Command and parameters
+ *  @return         Length of the request, -1 if it is too long
+ */
+static int
+build_request(char *line, int argc, char *argv[])
+{
+    int i, len = 0, n;
+    char *quote;
+
+    for (i = 0; i < argc; i++) {
+        quote = "";
+        if (!*argv[i] || strpbrk(argv[i], " \t#'\""))
+            quote = strchr(argv[i], '"') ? "'" : "\"";
+        n = snprintf(line + len, UAPD_MAX_REQUEST - len, "%s%s%s%s",
+                     i ? " " : "", quote, argv[i], quote);
+        if (n >= UAPD_MAX_REQUEST - len)
+            return -1;
+        len += n;
+    }
+    if (len + 1 >= UAPD_MAX_REQUEST)
+        return -1;
+    line[len++] = '\n';
+    line[len] = '\0';
+    return len;
+}
+
+/**
+ *  @brief Connects to the daemon
+ *
+ *  @param path     Socket path
+ *  @param conn     Connection to fill
+ *  @return         0 on success, -1 on error
+ */
+static int
+conn_open(char *path, uapcli_conn * conn)
+{
+    struct sockaddr_un addr;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        printf("ERR:Socket path too long: %s\n", path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    conn->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (conn->fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    if (connect(conn->fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        printf("ERR:Cannot connect to %s: %s\n", path, strerror(errno));
+        close(conn->fd);
+        return -1;
+    }
+    conn->in = fdopen(conn->fd, "r");
+    if (!conn->in) {
+        close(conn->fd);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ *  @brief Closes a daemon connection
+ *
+ *  @param conn     Connection
+ *  @return         N/A
+ */
+static void
+conn_close(uapcli_conn * conn)
+{
+    fclose(conn->in);
+}
+
+/**
+ *  @brief Sends a request and reads its response
+ *
+ *  @param conn     Connection
+ *  @param req      Request line
+ *  @param req_len  Request length
+ *  @param out      Stream the command output is copied to, or NULL
+ *  @return         Response status, -1 on a connection error
+ */
+static int
+conn_query(uapcli_conn * conn, char *req, int req_len, FILE * out)
+{
+    char hdr[UAPD_MAX_RESP_HDR];
+    char buf[4096];
+    unsigned long len;
+    size_t n;
+    ssize_t sent;
+    int status, off = 0;
+
+    while (off < req_len) {
+        sent = send(conn->fd, req + off, req_len - off, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("send");
+            return -1;
+        }
+        off += sent;
+    }
+    if (!fgets(hdr, sizeof(hdr), conn->in) ||
+        sscanf(hdr, "%d %lu", &status, &len) != 2) {
+        printf("ERR:Bad response from the daemon\n");
+        return -1;
+    }
+    while (len) {
+        n = fread(buf, 1, (len < sizeof(buf)) ? len : sizeof(buf), conn->in);
+        if (!n) {
+            printf("ERR:Truncated response from the daemon\n");
+            return -1;
+        }
+        if (out)
+            fwrite(buf, 1, n, out);
+        len -= n;
+    }
+    return status;
+}
+
+/**
+ *  @brief Runs one query by executing uaputl
+ *
+ *  @param uaputl   Path of the uaputl binary
+ *  @param argc     Number of arguments
+ *  @param argv     uaputl options, command and parameters
+ *  @return         uaputl exit status, -1 on error
+ */
+static int
+exec_query(char *uaputl, int argc, char *argv[])
+{
+    char *args[argc + 2];
+    pid_t pid;
+    int status, fd;
+
+    args[0] = uaputl;
+    memcpy(&args[1], argv, argc * sizeof(char *));
+    args[argc + 1] = NULL;
+    pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (!pid) {
+        fd = open("/dev/null", O_WRONLY);
+        if (fd >= 0)
+            dup2(fd, STDOUT_FILENO);
+        execv(uaputl, args);
+        _exit(127);
+    }
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status))
+        return -1;
+    return WEXITSTATUS(status);
+}
+
+/**
+ *  @brief Runs the benchmark loop of one client
+ *
+ *  @param path     Socket path
+ *  @param uaputl   uaputl binary for the exec model, or NULL
+ *  @param count    Number of queries
+ *  @param argc     Number of arguments
+ *  @param argv     Command and parameters
+ *  @return         Number of failed queries, -1 on error
+ */
+static int
+bench_client(char *path, char *uaputl, int count, int argc, char *argv[])
+{
+    uapcli_conn conn;
+    char req[UAPD_MAX_REQUEST];
+    int req_len = 0, i, failed = 0;
+
+    if (uaputl) {
+        for (i = 0; i < count; i++) {
+            if (exec_query(uaputl, argc, argv) != 0)
+                failed++;
+        }
+        return failed;
+    }
+    req_len = build_request(req, argc, argv);
+    if (req_len < 0 || conn_open(path, &conn) < 0)
+        return -1;
+    for (i = 0; i < count; i++) {
+        switch (conn_query(&conn, req, req_len, NULL)) {
+        case UAPD_STATUS_OK:
+            break;
+        case -1:
+            conn_close(&conn);
+            return -1;
+        default:
+            failed++;
+        }
+    }
+    conn_close(&conn);
+    return failed;
+}
+
+/**
+ *  @brief Runs the benchmark with concurrent clients and prints the rate
+ *
+ *  @param path     Socket path
+ *  @param uaputl   uaputl binary for the exec model, or NULL
+ *  @param count    Number of queries per client
+ *  @param clients  Number of clients
+ *  @param argc     Number of arguments
+ *  @param argv     Command and parameters
+ *  @return         0 if every query succeeded, else 1
+ */
+static int
+bench(char *path, char *uaputl, int count, int clients, int argc,
+      char *argv[])
+{
+    double start, elapsed;
+    int i, status, failed = 0, ret;
+    pid_t pid;
+
+    start = now();
+    for (i = 0; i < clients; i++) {
+        pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            clients = i;
+            break;
+        }
+        if (!pid) {
+            ret = bench_client(path, uaputl, count, argc, argv);
+            _exit(ret < 0 ? 255 : (ret > 254 ? 254 : ret));
+        }
+    }
+    for (i = 0; i < clients; i++) {
+        if (wait(&status) < 0)
+            break;
+        if (!WIFEXITED(status) || WEXITSTATUS(status))
+            failed++;
+    }
+    elapsed = now() - start;
+
+    printf("%s: %d clients x %d queries in %.3f s, %.0f queries/s, "
+           "%.1f us/query per client\n", uaputl ? "exec" : "daemon",
+           clients, count, elapsed, clients * count / elapsed,
+           elapsed * 1e6 / count);
+    if (failed)
+        printf("ERR:%d clients saw failed queries\n", failed);
+    return failed ? 1 : 0;
+}
+
+/****************************************************************************
+        Global functions
+****************************************************************************/
+/**
+ *  @brief Entry function for uapcli
+ *
+ *  @param argc     Number of arguments
+ *  @param argv     A pointer to arguments array
+ *  @return         0 on success, 1 on failure
+ */
+int
+main(int argc, char *argv[])
+{
+    char *path = UAPD_DEFAULT_SOCKET;
+    char *uaputl = NULL;
+    char req[UAPD_MAX_REQUEST];
+    uapcli_conn conn;
+    int opt, count = 0, clients = 1, req_len, status;
+
+    while ((opt = getopt_long(argc, argv, "+s:n:c:x:h", cli_options,
+                              NULL)) != -1) {
+        switch (opt) {
+        case 's':
+            path = optarg;
+            break;
+        case 'n':
+            count = atoi(optarg);
+            break;
+        case 'c':
+            clients = atoi(optarg);
+            break;
+        case 'x':
+            uaputl = optarg;
+            break;
+        case 'h':
+        default:
+            print_usage();
+            exit(0);
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (argc < 1 || count < 0 || clients < 1) {
+        print_usage();
+        exit(1);
+    }
+
+    if (count || uaputl)
+        return bench(path, uaputl, count ? count : 1, clients, argc, argv);
+
+    req_len = build_request(req, argc, argv);
+    if (req_len < 0) {
+        printf("ERR:Request too long\n");
+        exit(1);
+    }
+    if (conn_open(path, &conn) < 0)
+        exit(1);
+    status = conn_query(&conn, req, req_len, stdout);
+    conn_close(&conn);
+    return (status == UAPD_STATUS_OK) ? 0 : 1;
+}
@@ -37,6 +37,7 @@ Change log:
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <linux/if.h>
 #include <sys/ioctl.h>
 #include <errno.h>
 #include "uaputl.h"
@@ -44,6 +45,122 @@ Change log:
 
 extern struct option cmd_options[];
 
+/****************************************************************************
+        Definitions
+****************************************************************************/
+/** sys_cfg_get parameters: TLV and the request the sys_cfg_* GETs send */
+static const struct
+{
+    /** Parameter name, the sys_cfg_ command without its prefix */
+    char *name;
+    /** TLV tag */
+    u16 tag;
+    /** Request value length */
+    u16 len;
+    /** First request value byte, for keyed TLVs */
+    u8 key;
+} sys_cfg_params[] = {
+    {"ap_mac_address", MRVL_AP_MAC_ADDRESS_TLV_ID, ETH_ALEN, 0},
+    {"ssid", MRVL_SSID_TLV_ID, MAX_SSID_LENGTH, 0},
+    {"beacon_period", MRVL_BEACON_PERIOD_TLV_ID, 2, 0},
+    {"dtim_period", MRVL_DTIM_PERIOD_TLV_ID, 1, 0},
+    {"channel", MRVL_CHANNELCONFIG_TLV_ID, 2, 0},
+    {"scan_channels", MRVL_CHANNELLIST_TLV_ID,
+     sizeof(CHANNEL_LIST) * MAX_CHANNELS, 0},
+    {"rates", MRVL_RATES_TLV_ID, MAX_RATES, 0},
+    {"tx_power", MRVL_TX_POWER_TLV_ID, 1, 0},
+    {"bcast_ssid_ctl", MRVL_BCAST_SSID_CTL_TLV_ID, 1, 0},
+    {"preamble_ctl", MRVL_PREAMBLE_CTL_TLV_ID, 1, 0},
+    {"rx_antenna", MRVL_ANTENNA_CTL_TLV_ID, 2, 0},
+    {"tx_antenna", MRVL_ANTENNA_CTL_TLV_ID, 2, 1},
+    {"rts_threshold", MRVL_RTS_THRESHOLD_TLV_ID, 2, 0},
+    {"frag_threshold", MRVL_FRAG_THRESHOLD_TLV_ID, 2, 0},
+    {"radio_ctl", MRVL_RADIO_CTL_TLV_ID, 1, 0},
+    {"rsn_replay_prot", MRVL_RSN_REPLAY_PROT_TLV_ID, 1, 0},
+    {"mcbc_data_rate", MRVL_MCBC_DATA_RATE_TLV_ID, 2, 0},
+    {"tx_data_rate", MRVL_TX_DATA_RATE_TLV_ID, 2, 0},
+    {"pkt_fwd_ctl", MRVL_PKT_FWD_CTL_TLV_ID, 1, 0},
+    {"sta_ageout_timer", MRVL_STA_AGEOUT_TIMER_TLV_ID, 4, 0},
+    {"auth", MRVL_AUTH_TLV_ID, 1, 0},
+    {"protocol", MRVL_PROTOCOL_TLV_ID, 2, 0},
+    {"akmp", MRVL_AKMP_TLV_ID, 2, 0},
+    {"cipher", MRVL_CIPHER_TLV_ID, 2, 0},
+    {"group_rekey_timer", MRVL_GRP_REKEY_TIME_TLV_ID, 4, 0},
+    {"wpa_passphrase", MRVL_WPA_PASSPHRASE_TLV_ID, MAX_WPA_PASSPHRASE_LENGTH,
+     0},
+    {"max_sta_num", MRVL_MAX_STA_CNT_TLV_ID, 2, 0},
+    {"retry_limit", MRVL_RETRY_LIMIT_TLV_ID, 1, 0},
+};
+
+/** Number of sys_cfg_get parameters */
+#define SYS_CFG_PARAMS  (sizeof(sys_cfg_params) / sizeof(sys_cfg_params[0]))
+
+/** SNMP MIB OID name and value size */
+typedef struct _snmp_oid_def
+{
+    /** OID name */
+    char name[48];
+    /** OID */
+    u16 oid;
+    /** Value size: 1, 2 or 4 */
+    int size;
+} snmp_oid_def;
+
+/** OIDs known without a MIB file */
+static const snmp_oid_def snmp_oid_defs[] = {
+    {"dot11MultiDomainCapabilityEnabled", OID_80211D_ENABLE, 1},
+    {"dot11LocalTKIPMICFailures", 0x0b, 4},
+    {"dot11CCMPDecryptErrors", 0x0c, 4},
+    {"dot11WEPUndecryptableCount", 0x0d, 4},
+    {"dot11WEPICVErrorCount", 0x0e, 4},
+    {"dot11DecryptFailureCount", 0x0f, 4},
+    {"dot11FailedCount", 0x12, 4},
+    {"dot11RetryCount", 0x13, 4},
+    {"dot11MultipleRetryCount", 0x14, 4},
+    {"dot11FrameDuplicateCount", 0x15, 4},
+    {"dot11RTSSuccessCount", 0x16, 4},
+    {"dot11RTSFailureCount", 0x17, 4},
+    {"dot11ACKFailureCount", 0x18, 4},
+    {"dot11ReceivedFragmentCount", 0x19, 4},
+    {"dot11MulticastReceivedFrameCount", 0x1a, 4},
+    {"dot11FCSErrorCount", 0x1b, 4},
+    {"dot11TransmittedFrameCount", 0x1c, 4},
+    {"dot11RSNATKIPCounterMeasuresInvoked", 0x1d, 4},
+    {"dot11RSNA4WayHandshakeFailures", 0x1e, 4},
+    {"dot11MulticastTransmittedFrameCount", 0x1f, 4},
+};
+
+/** Number of built-in OIDs */
+#define SNMP_OID_DEFS   (sizeof(snmp_oid_defs) / sizeof(snmp_oid_defs[0]))
+
+/** Maximum number of OIDs in a MIB file */
+#define MAX_SNMP_OID_DEFS       256
+/** Maximum number of OIDs of one snmp_get or snmp_set */
+#define MAX_SNMP_OIDS           512
+
+/** MIB file loaded by snmp_get/snmp_set -m */
+typedef struct _snmp_mib
+{
+    /** OIDs of the file, looked up before the built-in ones */
+    snmp_oid_def *defs;
+    /** Number of OIDs of the file */
+    int num;
+} snmp_mib;
+
+/** Options of the snmp_get and snmp_set commands */
+static struct option snmp_options[] = {
+    {"help", 0, NULL, 'h'},
+    {"mib", 1, NULL, 'm'},
+    {NULL, 0, NULL, '\0'}
+};
+
+/** Options of the sta_filter_table command */
+static struct option sta_filter_options[] = {
+    {"help", 0, NULL, 'h'},
+    {"file", 1, NULL, 'f'},
+    {NULL, 0, NULL, '\0'}
+};
+
 /****************************************************************************
         Local functions
 ****************************************************************************/
@@ -515,14 +632,21 @@ print_sys_cfg_wpa_passphrase_usage(void)
 void
 print_sta_filter_table_usage(void)
 {
-    printf("\nUsage : sta_filter_table <FILTERMODE> <MACADDRESS_LIST>\n"
+    printf("\nUsage : sta_filter_table [--file <path>] <FILTERMODE> "
+           "<MACADDRESS_LIST>\n"
            "\nOptions: FILTERMODE : 0 - Disable filter table"
            "\n                      1 - allow MAC addresses specified in the allowed list"
            "\n                      2 - block MAC addresses specified in the banned list"
            "\n         MACADDRESS_LIST is the list of MAC addresses to be acted upon. Each"
            "\n                      MAC address must be separated with a space. Maximum of"
-           "\n                      16 MAC addresses are supported."
-           "\n         empty - Get current mac filter settings\n");
+           "\n                      %d distinct MAC addresses are supported."
+           "\n         --file       adds the MAC addresses of <path>, one per"
+           "\n                      line ('-' for stdin, '#' starts a comment)."
+           "\n         empty - Get current mac filter settings\n"
+           "\nRepeated MAC addresses are dropped and the list is compared"
+           "\nwith the table in the firmware: only the changes are printed,"
+           "\nand nothing is sent when there is none.\n",
+           MAX_MAC_ONESHOT_FILTER);
     return;
 }
 
@@ -569,51 +693,124 @@ print_cfg_data_usage(void)
     return;
 }
 
+/**
+ *  @brief Show usage information for the sys_cfg batch commands
+ *
+ *  $return         N/A
+ */
+void
+print_sys_cfg_batch_usage(void)
+{
+    printf("\nUsage : sys_cfg_begin | sys_cfg_commit | sys_cfg_abort\n"
+           "\nsys_cfg_* settings made between sys_cfg_begin and sys_cfg_commit"
+           "\nare sent to the firmware together at sys_cfg_commit, in as few"
+           "\ncommands as fit. Use in a script (-f); the daemon, shared by all"
+           "\nits clients, refuses them.\n");
+    return;
+}
+
+/**
+ *  @brief Prints the built-in OIDs
+ *
+ *  @return         N/A
+ */
+static void
+print_snmp_oid_defs(void)
+{
+    int i;
+
+    for (i = 0; i < SNMP_OID_DEFS; i++)
+        printf("\n    %-36s 0x%02x %d", snmp_oid_defs[i].name,
+               snmp_oid_defs[i].oid, snmp_oid_defs[i].size);
+    printf("\n");
+}
+
+/**
+ *  @brief Show usage information for the snmp_get command
+ *
+ *  $return         N/A
+ */
+void
+print_snmp_get_usage(void)
+{
+    printf("\nUsage : snmp_get [-m <mib file>] <OID>[,OID...] [OID ...]\n"
+           "\nGets all the OIDs with as few commands as possible.  OID is a"
+           "\nname from the MIB file or the built-in table, or a number with"
+           "\nan optional value size, as 0x13:4 (default size 4).\n"
+           "\nMIB file lines are \"<name> <oid> <size>\", # starts a"
+           "\ncomment.  Built-in OIDs:");
+    print_snmp_oid_defs();
+    return;
+}
+
+/**
+ *  @brief Show usage information for the snmp_set command
+ *
+ *  $return         N/A
+ */
+void
+print_snmp_set_usage(void)
+{
+    printf("\nUsage : snmp_set [-m <mib file>] <OID>=<value> [OID=value ...]"
+           "\n\nSets all the OIDs with as few commands as possible.  See"
+           "\nsnmp_get --help for OID and the MIB file.\n");
+    return;
+}
+
+/**
+ *  @brief Show usage information for the sys_cfg_get command
+ *
+ *  $return         N/A
+ */
+void
+print_sys_cfg_get_usage(void)
+{
+    int i;
+
+    printf("\nUsage : sys_cfg_get <PARAMETER> [PARAMETER ...]\n"
+           "\nReads all the PARAMETERs with a single command. PARAMETER is"
+           "\none of:");
+    for (i = 0; i < SYS_CFG_PARAMS; i++)
+        printf("%s%s", (i % 4) ? " " : "\n    ", sys_cfg_params[i].name);
+    printf("\n");
+    return;
+}
+
 /** 
  *  @brief  get configured operational rates.
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param  rates   Operational rates allowed are
  *                  stored at this pointer
  *  @return         number of basic rates allowed.
  *                  -1 if a failure 
  */
 int
-get_sys_cfg_rates(u8 * rates)
+get_sys_cfg_rates(uap_dev * dev, u8 * rates)
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     TLVBUF_RATES *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
+    tlv_builder b;
     int ret = UAP_FAILURE;
     int i = 0;
     int rate_cnt = 0;
-    /* Initialize the command length */
-    cmd_len =
-        sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_RATES) + MAX_DATA_RATES;
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
+        return -1;
+    tlv = tlv_build_add(&b, MRVL_RATES_TLV_ID,
+                        sizeof(TLVBUF_RATES) + MAX_DATA_RATES);
+    if (!tlv) {
+        tlv_build_free(dev, &b);
         return -1;
     }
-    bzero((char *) buffer, cmd_len);
-
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv = (TLVBUF_RATES *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
 
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_RATES_TLV_ID;
     cmd_buf->Action = ACTION_GET;
     tlv->Length = MAX_DATA_RATES;
 
-    endian_convert_tlv_header_out(tlv);
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = tlv_build_send(dev, &b);
     endian_convert_tlv_header_in(tlv);
     /* Process response */
     if (ret == UAP_SUCCESS) {
@@ -622,7 +819,7 @@ get_sys_cfg_rates(u8 * rates)
             (tlv->Tag != MRVL_RATES_TLV_ID)) {
             printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
                    cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
+            tlv_build_free(dev, &b);
             return -1;
         }
 
@@ -639,26 +836,26 @@ get_sys_cfg_rates(u8 * rates)
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return rate_cnt;
 }
 
 /** 
  *  @brief check rate is valid or not.
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param  rate   rate for check
  *
  *  @return         UAP_SUCCESS or UAP_FAILURE
  */
 int
-is_tx_rate_valid(u8 rate)
+is_tx_rate_valid(uap_dev * dev, u8 rate)
 {
     int rate_cnt = 0;
     int i;
     u8 rates[MAX_DATA_RATES];
 
-    rate_cnt = get_sys_cfg_rates((u8 *) & rates);
+    rate_cnt = get_sys_cfg_rates(dev, (u8 *) & rates);
     if (rate_cnt > 0) {
         for (i = 0; i < rate_cnt; i++) {
             if (rate == (rates[i] & ~BASIC_RATE_SET_BIT)) {
@@ -672,18 +869,19 @@ is_tx_rate_valid(u8 rate)
 /** 
  *  @brief check mcbc rate is valid or not.
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param  rate   rate for check
  *
  *  @return         UAP_SUCCESS or UAP_FAILURE
  */
 int
-is_mcbc_rate_valid(u8 rate)
+is_mcbc_rate_valid(uap_dev * dev, u8 rate)
 {
     int rate_cnt = 0;
     int i;
     u8 rates[MAX_DATA_RATES];
 
-    rate_cnt = get_sys_cfg_rates((u8 *) & rates);
+    rate_cnt = get_sys_cfg_rates(dev, (u8 *) & rates);
     if (rate_cnt > 0) {
         for (i = 0; i < rate_cnt; i++) {
             if (rates[i] & BASIC_RATE_SET_BIT) {
@@ -707,17 +905,17 @@ is_mcbc_rate_valid(u8 rate)
  *          if AP_MAC_ADDRESS is provided, a 'set' is performed,
  *          else a 'get' is performed.
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_ap_mac_address(int argc, char *argv[])
+apcmd_sys_cfg_ap_mac_address(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     TLVBUF_AP_MAC_ADDRESS *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
+    tlv_builder b;
     int ret = UAP_FAILURE;
     int opt;
 
@@ -738,28 +936,18 @@ apcmd_sys_cfg_ap_mac_address(int argc, char *argv[])
         return;
     }
 
-    /* Initialize the command length */
-    cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_AP_MAC_ADDRESS);
-
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
+        return;
+    tlv = tlv_build_add(&b, MRVL_AP_MAC_ADDRESS_TLV_ID,
+                        sizeof(TLVBUF_AP_MAC_ADDRESS));
+    if (!tlv) {
+        tlv_build_free(dev, &b);
         return;
     }
-    bzero((char *) buffer, cmd_len);
-
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv = (TLVBUF_AP_MAC_ADDRESS *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
 
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_AP_MAC_ADDRESS_TLV_ID;
     tlv->Length = ETH_ALEN;
     if (argc == 0) {
         cmd_buf->Action = ACTION_GET;
@@ -768,14 +956,12 @@ apcmd_sys_cfg_ap_mac_address(int argc, char *argv[])
         if ((ret = mac2raw(argv[0], tlv->ApMacAddr)) != UAP_SUCCESS) {
             printf("ERR: %s Address \n", ret == UAP_FAILURE ? "Invalid MAC" :
                    ret == UAP_RET_MAC_BROADCAST ? "Broadcast" : "Multicast");
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
     }
-    endian_convert_tlv_header_out(tlv);
-
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = tlv_build_send(dev, &b);
     endian_convert_tlv_header_in(tlv);
     /* Process response */
     if (ret == UAP_SUCCESS) {
@@ -784,7 +970,7 @@ apcmd_sys_cfg_ap_mac_address(int argc, char *argv[])
             (tlv->Tag != MRVL_AP_MAC_ADDRESS_TLV_ID)) {
             printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
                    cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
 
@@ -808,8 +994,7 @@ apcmd_sys_cfg_ap_mac_address(int argc, char *argv[])
         printf("ERR:Command sending failed!\n");
     }
 
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
@@ -821,20 +1006,17 @@ apcmd_sys_cfg_ap_mac_address(int argc, char *argv[])
  *          if SSID is provided, a 'set' is performed
  *          else a 'get' is performed 
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_ssid(int argc, char *argv[])
+apcmd_sys_cfg_ssid(uap_dev * dev, int argc, char *argv[])
 {
-    APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
-    TLVBUF_SSID *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
-    int ret = UAP_FAILURE;
+    int ret;
     int opt;
-    u8 ssid[33];
+    char ssid[33];
 
     while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
         switch (opt) {
@@ -854,99 +1036,33 @@ apcmd_sys_cfg_ssid(int argc, char *argv[])
     }
 
     if (argc == 0) {
-        /* Initialize the command length */
-        cmd_len =
-            sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_SSID) +
-            MAX_SSID_LENGTH;
-    } else {
-        if (strlen(argv[0]) > MAX_SSID_LENGTH) {
-            printf("ERR:SSID too long.\n");
-            return;
-        }
-        /* Initialize the command length */
-        if (argv[0][1] == '"') {
-            argv[0]++;
-        }
-        if (argv[0][strlen(argv[0])] == '"') {
-            argv[0][strlen(argv[0])] = '\0';
-        }
-        if (!strlen(argv[0])) {
-            printf("ERR:NULL SSID not allowed.\n");
-            return;
-        }
-        cmd_len =
-            sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_SSID) +
-            strlen(argv[0]);
+        ret = uap_get_ssid(dev, ssid, sizeof(ssid));
+        if (ret == UAP_OK)
+            printf("SSID = %s\n", ssid);
+        else
+            print_lib_error(ret, "Could not get SSID!");
+        return;
     }
 
-    /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (strlen(argv[0]) > MAX_SSID_LENGTH) {
+        printf("ERR:SSID too long.\n");
         return;
     }
-    bzero((char *) buffer, cmd_len);
-
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv = (TLVBUF_SSID *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
-
-    /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_SSID_TLV_ID;
-    if (argc == 0) {
-        cmd_buf->Action = ACTION_GET;
-        tlv->Length = MAX_SSID_LENGTH;
-    } else {
-        cmd_buf->Action = ACTION_SET;
-        tlv->Length = strlen(argv[0]);
-        memcpy(tlv->Ssid, argv[0], tlv->Length);
+    if (argv[0][1] == '"') {
+        argv[0]++;
     }
-
-    endian_convert_tlv_header_out(tlv);
-
-    /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
-
-    endian_convert_tlv_header_in(tlv);
-
-    /* Process response */
-    if (ret == UAP_SUCCESS) {
-        /* Verify response */
-        if ((cmd_buf->CmdCode != (APCMD_SYS_CONFIGURE | APCMD_RESP_CHECK)) ||
-            (tlv->Tag != MRVL_SSID_TLV_ID)) {
-            printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
-                   cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
-            return;
-        }
-
-        /* Print response */
-        if (cmd_buf->Result == CMD_SUCCESS) {
-            if (argc == 0) {
-                memset(ssid, 0, sizeof(ssid));
-                memcpy(ssid, tlv->Ssid, tlv->Length);
-                printf("SSID = %s\n", ssid);
-            } else {
-                printf("SSID setting successful\n");
-            }
-        } else {
-            if (argc == 0) {
-                printf("ERR:Could not get SSID!\n");
-            } else {
-                printf("ERR:Could not set SSID!\n");
-            }
-        }
-    } else {
-        printf("ERR:Command sending failed!\n");
+    if (argv[0][strlen(argv[0])] == '"') {
+        argv[0][strlen(argv[0])] = '\0';
     }
-
-    if (buffer)
-        free(buffer);
+    if (!strlen(argv[0])) {
+        printf("ERR:NULL SSID not allowed.\n");
+        return;
+    }
+    ret = uap_set_ssid(dev, argv[0]);
+    if (ret == UAP_OK)
+        printf("SSID setting successful\n");
+    else
+        print_lib_error(ret, "Could not set SSID!");
     return;
 }
 
@@ -960,17 +1076,17 @@ apcmd_sys_cfg_ssid(int argc, char *argv[])
  *
  *           BEACON_PERIOD is represented in ms
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_beacon_period(int argc, char *argv[])
+apcmd_sys_cfg_beacon_period(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     TLVBUF_BEACON_PERIOD *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
+    tlv_builder b;
     int ret = UAP_FAILURE;
     int opt;
 
@@ -989,28 +1105,18 @@ apcmd_sys_cfg_beacon_period(int argc, char *argv[])
         print_sys_cfg_beacon_period_usage();
         return;
     }
-    /* Initialize the command length */
-    cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_BEACON_PERIOD);
-
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
+        return;
+    tlv = tlv_build_add(&b, MRVL_BEACON_PERIOD_TLV_ID,
+                        sizeof(TLVBUF_BEACON_PERIOD));
+    if (!tlv) {
+        tlv_build_free(dev, &b);
         return;
     }
-    bzero((char *) buffer, cmd_len);
-
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv = (TLVBUF_BEACON_PERIOD *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
 
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_BEACON_PERIOD_TLV_ID;
     tlv->Length = 2;
     if (argc == 0) {
         cmd_buf->Action = ACTION_GET;
@@ -1018,11 +1124,10 @@ apcmd_sys_cfg_beacon_period(int argc, char *argv[])
         cmd_buf->Action = ACTION_SET;
         tlv->BeaconPeriod_ms = (u16) atoi(argv[0]);
     }
-    endian_convert_tlv_header_out(tlv);
     tlv->BeaconPeriod_ms = uap_cpu_to_le16(tlv->BeaconPeriod_ms);
 
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = tlv_build_send(dev, &b);
     endian_convert_tlv_header_in(tlv);
     tlv->BeaconPeriod_ms = uap_le16_to_cpu(tlv->BeaconPeriod_ms);
     /* Process response */
@@ -1032,7 +1137,7 @@ apcmd_sys_cfg_beacon_period(int argc, char *argv[])
             (tlv->Tag != MRVL_BEACON_PERIOD_TLV_ID)) {
             printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
                    cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
         /* Print response */
@@ -1052,8 +1157,7 @@ apcmd_sys_cfg_beacon_period(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
@@ -1065,17 +1169,17 @@ apcmd_sys_cfg_beacon_period(int argc, char *argv[])
  *           if DTIM_PERIOD is provided, a 'set' is performed
  *           else a 'get' is performed
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_dtim_period(int argc, char *argv[])
+apcmd_sys_cfg_dtim_period(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     TLVBUF_DTIM_PERIOD *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
+    tlv_builder b;
     int ret = UAP_FAILURE;
     int opt;
     while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
@@ -1093,28 +1197,18 @@ apcmd_sys_cfg_dtim_period(int argc, char *argv[])
         return;
     }
 
-    /* Initialize the command length */
-    cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_DTIM_PERIOD);
-
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
+        return;
+    tlv = tlv_build_add(&b, MRVL_DTIM_PERIOD_TLV_ID,
+                        sizeof(TLVBUF_DTIM_PERIOD));
+    if (!tlv) {
+        tlv_build_free(dev, &b);
         return;
     }
-    bzero((char *) buffer, cmd_len);
-
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv = (TLVBUF_DTIM_PERIOD *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
 
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_DTIM_PERIOD_TLV_ID;
     tlv->Length = 1;
     if (argc == 0) {
         cmd_buf->Action = ACTION_GET;
@@ -1122,9 +1216,8 @@ apcmd_sys_cfg_dtim_period(int argc, char *argv[])
         cmd_buf->Action = ACTION_SET;
         tlv->DtimPeriod = (u8) atoi(argv[0]);
     }
-    endian_convert_tlv_header_out(tlv);
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = tlv_build_send(dev, &b);
     endian_convert_tlv_header_in(tlv);
 
     /* Process response */
@@ -1134,7 +1227,7 @@ apcmd_sys_cfg_dtim_period(int argc, char *argv[])
             (tlv->Tag != MRVL_DTIM_PERIOD_TLV_ID)) {
             printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
                    cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
         /* Print response */
@@ -1154,8 +1247,7 @@ apcmd_sys_cfg_dtim_period(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
@@ -1170,18 +1262,16 @@ apcmd_sys_cfg_dtim_period(int argc, char *argv[])
  *           0 as manual channel selection
  *           1 as automatic channel selection.
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_channel(int argc, char *argv[])
+apcmd_sys_cfg_channel(uap_dev * dev, int argc, char *argv[])
 {
-    APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
-    TLVBUF_CHANNEL_CONFIG *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
-    int ret = UAP_FAILURE;
+    int channel, acs;
+    int ret;
     int opt;
     while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
         switch (opt) {
@@ -1199,76 +1289,22 @@ apcmd_sys_cfg_channel(int argc, char *argv[])
         return;
     }
 
-    /* Initialize the command length */
-    cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_CHANNEL_CONFIG);
-
-    /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
-        return;
-    }
-    bzero((char *) buffer, cmd_len);
-
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv = (TLVBUF_CHANNEL_CONFIG *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
-
-    /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_CHANNELCONFIG_TLV_ID;
-    tlv->Length = 2;
     if (argc == 0) {
-        cmd_buf->Action = ACTION_GET;
-    } else {
-        cmd_buf->Action = ACTION_SET;
-        if (argc == 1) {
-            tlv->ChanNumber = (u8) atoi(argv[0]);
-            tlv->BandConfigType = 0;
-        } else {
-            tlv->BandConfigType = atoi(argv[1]) ? BAND_CONFIG_ACS_MODE : 0;
-            tlv->ChanNumber = (u8) atoi(argv[0]);
-        }
-    }
-    endian_convert_tlv_header_out(tlv);
-    /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
-    endian_convert_tlv_header_in(tlv);
-    /* Process response */
-    if (ret == UAP_SUCCESS) {
-        /* Verify response */
-        if ((cmd_buf->CmdCode != (APCMD_SYS_CONFIGURE | APCMD_RESP_CHECK)) ||
-            (tlv->Tag != MRVL_CHANNELCONFIG_TLV_ID)) {
-            printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
-                   cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
-            return;
-        }
-        /* Print response */
-        if (cmd_buf->Result == CMD_SUCCESS) {
-            if (argc == 0) {
-                printf("Mode    = %s\n",
-                       (tlv->BandConfigType == 0) ? "Manual" : "ACS");
-                printf("Channel = %d\n", tlv->ChanNumber);
-            } else {
-                printf("Channel setting successful\n");
-            }
+        ret = uap_get_channel(dev, &channel, &acs);
+        if (ret == UAP_OK) {
+            printf("Mode    = %s\n", acs ? "ACS" : "Manual");
+            printf("Channel = %d\n", channel);
         } else {
-            if (argc == 0) {
-                printf("ERR:Could not get channel!\n");
-            } else {
-                printf("ERR:Could not set channel!\n");
-            }
+            print_lib_error(ret, "Could not get channel!");
         }
-    } else {
-        printf("ERR:Command sending failed!\n");
+        return;
     }
-    if (buffer)
-        free(buffer);
+    ret = uap_set_channel(dev, (u8) atoi(argv[0]),
+                          (argc == 2) ? atoi(argv[1]) : 0);
+    if (ret == UAP_OK)
+        printf("Channel setting successful\n");
+    else
+        print_lib_error(ret, "Could not set channel!");
     return;
 }
 
@@ -1280,18 +1316,18 @@ apcmd_sys_cfg_channel(int argc, char *argv[])
  *           if CHANNELS are provided, a 'set' is performed
  *           else a 'get' is performed
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_scan_channels(int argc, char *argv[])
+apcmd_sys_cfg_scan_channels(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     TLVBUF_CHANNEL_LIST *tlv = NULL;
     CHANNEL_LIST *pChanList = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
+    tlv_builder b;
     int ret = UAP_FAILURE;
     int opt;
     int i;
@@ -1311,35 +1347,19 @@ apcmd_sys_cfg_scan_channels(int argc, char *argv[])
         return;
     }
 
-    /* Initialize the command length */
-    if (argc == 0)
-        cmd_len =
-            sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_CHANNEL_LIST) +
-            sizeof(CHANNEL_LIST) * MAX_CHANNELS;
-    else
-        cmd_len =
-            sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_CHANNEL_LIST) +
-            sizeof(CHANNEL_LIST) * argc;
-
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-
-    if (!buffer) {
-        printf("ERR:Can not allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
+        return;
+    tlv = tlv_build_add(&b, MRVL_CHANNELLIST_TLV_ID,
+                        sizeof(TLVBUF_CHANNEL_LIST) +
+                        sizeof(CHANNEL_LIST) * (argc ? argc : MAX_CHANNELS));
+    if (!tlv) {
+        tlv_build_free(dev, &b);
         return;
     }
-    bzero((char *) buffer, cmd_len);
-
-    /* LOCATE HEADERS */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv = (TLVBUF_CHANNEL_LIST *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
 
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_CHANNELLIST_TLV_ID;
     if (argc == 0) {
         cmd_buf->Action = ACTION_GET;
         tlv->Length = sizeof(CHANNEL_LIST) * MAX_CHANNELS;
@@ -1353,9 +1373,8 @@ apcmd_sys_cfg_scan_channels(int argc, char *argv[])
             pChanList++;
         }
     }
-    endian_convert_tlv_header_out(tlv);
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = tlv_build_send(dev, &b);
     endian_convert_tlv_header_in(tlv);
     /* Process response */
     if (ret == UAP_SUCCESS) {
@@ -1364,7 +1383,7 @@ apcmd_sys_cfg_scan_channels(int argc, char *argv[])
             (tlv->Tag != MRVL_CHANNELLIST_TLV_ID)) {
             printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
                    cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
         /* Print response */
@@ -1373,7 +1392,7 @@ apcmd_sys_cfg_scan_channels(int argc, char *argv[])
                 printf("Channels List = ");
                 if (tlv->Length % sizeof(CHANNEL_LIST)) {
                     printf("Error: Length mismatch\n");
-                    free(buffer);
+                    tlv_build_free(dev, &b);
                     return;
                 }
                 pChanList = tlv->ChanList;
@@ -1392,8 +1411,7 @@ apcmd_sys_cfg_scan_channels(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
@@ -1446,12 +1464,13 @@ parse_input(int argc, char **argv, int output[3][2])
  *
  *   Usage: "sys_cfg_rates_ext  [RATES]" 
  *  
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_rates_ext(int argc, char *argv[])
+apcmd_sys_cfg_rates_ext(uap_dev * dev, int argc, char *argv[])
 {
     int i, j = 0;
     int opt;
@@ -1466,12 +1485,12 @@ apcmd_sys_cfg_rates_ext(int argc, char *argv[])
     TLVBUF_TX_DATA_RATE *tlv_urate = NULL;
     TLVBUF_MCBC_DATA_RATE *tlv_mrate = NULL;
     TLVBUF_RATES *tlv_rate = NULL;
-    u8 *buffer = NULL;
+    tlv_builder b;
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     int ret = UAP_FAILURE;
-    u16 cmd_len;
     int output[3][2];
 
+    b.buf = NULL;
     while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
         switch (opt) {
         default:
@@ -1562,14 +1581,15 @@ apcmd_sys_cfg_rates_ext(int argc, char *argv[])
              * Check mrate and urate wrt old Rates
              */
             if (mflag && A2HEXDECIMAL(argv_mrate[0]) &&
-                is_mcbc_rate_valid(A2HEXDECIMAL(argv_mrate[0])) !=
+                is_mcbc_rate_valid(dev, A2HEXDECIMAL(argv_mrate[0])) !=
                 UAP_SUCCESS) {
                 printf("ERR: invalid MCBC data rate.");
                 print_sys_cfg_rates_ext_usage();
                 goto done;
             }
             if (uflag && A2HEXDECIMAL(argv_urate[0]) &&
-                is_tx_rate_valid(A2HEXDECIMAL(argv_urate[0])) != UAP_SUCCESS) {
+                is_tx_rate_valid(dev, A2HEXDECIMAL(argv_urate[0])) !=
+                UAP_SUCCESS) {
                 printf("ERR: invalid tx data rate.");
                 print_sys_cfg_rates_ext_usage();
                 goto done;
@@ -1608,81 +1628,51 @@ apcmd_sys_cfg_rates_ext(int argc, char *argv[])
                 goto done;
             }
         }
-        /* post-parsing */
-        cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE);
-        if (rflag) {
-            cmd_len += sizeof(TLVBUF_RATES) + argc_rate;
-            cmd_len += sizeof(TLVBUF_MCBC_DATA_RATE);
-            cmd_len += sizeof(TLVBUF_TX_DATA_RATE);
-        } else {
-            if (mflag)
-                cmd_len += sizeof(TLVBUF_MCBC_DATA_RATE);
-            if (uflag)
-                cmd_len += sizeof(TLVBUF_TX_DATA_RATE);
-        }
-    } else {
-        /* GET */
-        cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE)
-            + sizeof(TLVBUF_RATES) + MAX_RATES + sizeof(TLVBUF_MCBC_DATA_RATE)
-            + sizeof(TLVBUF_TX_DATA_RATE);
     }
 
-    buffer = (u8 *) malloc(cmd_len);
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    /* Initialize the command buffer */
+    if (tlv_build_start(dev, &b, argc ? ACTION_SET : ACTION_GET) !=
+        UAP_SUCCESS)
         goto done;
-    }
-    bzero((char *) buffer, cmd_len);
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
 
     /* Fill the command buffer */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    cmd_buf->Action = argc ? ACTION_SET : ACTION_GET;
-    tlv_buf = buffer + sizeof(APCMDBUF_SYS_CONFIGURE);
-    /* Locate headers */
     if (rflag || (!argc)) {
-        tlv_rate = (TLVBUF_RATES *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
-        tlv_rate->Tag = MRVL_RATES_TLV_ID;
-        tlv_rate->Length = argc ? argc_rate : MAX_RATES;
+        tlv_rate = tlv_build_add(&b, MRVL_RATES_TLV_ID, sizeof(TLVBUF_RATES) +
+                                 (argc ? argc_rate : MAX_RATES));
+        if (!tlv_rate)
+            goto done;
         for (i = 0; i < argc_rate; i++) {
             tlv_rate->OperationalRates[i] = (u8) A2HEXDECIMAL(argv_rate[i]);
         }
-        tlv_buf += tlv_rate->Length + sizeof(TLVBUF_RATES);
-        endian_convert_tlv_header_out(tlv_rate);
     }
     if (rflag || mflag || (!argc)) {
-        tlv_mrate = (TLVBUF_MCBC_DATA_RATE *) tlv_buf;
-        tlv_mrate->Tag = MRVL_MCBC_DATA_RATE_TLV_ID;
-        tlv_mrate->Length = 2;
-        tlv_mrate->MCBCdatarate = 0;
+        tlv_mrate = tlv_build_add(&b, MRVL_MCBC_DATA_RATE_TLV_ID,
+                                  sizeof(TLVBUF_MCBC_DATA_RATE));
+        if (!tlv_mrate)
+            goto done;
         if (mflag) {
             tlv_mrate->MCBCdatarate = (u16) A2HEXDECIMAL(argv_mrate[0])
                 & ~BASIC_RATE_SET_BIT;
             tlv_mrate->MCBCdatarate = uap_cpu_to_le16(tlv_mrate->MCBCdatarate);
         }
-        tlv_buf += sizeof(TLVBUF_MCBC_DATA_RATE);
-        endian_convert_tlv_header_out(tlv_mrate);
     }
     if (rflag || uflag || (!argc)) {
-        tlv_urate = (TLVBUF_TX_DATA_RATE *) tlv_buf;
-        tlv_urate->Tag = MRVL_TX_DATA_RATE_TLV_ID;
-        tlv_urate->Length = 2;
-        tlv_urate->TxDataRate = 0;
+        tlv_urate = tlv_build_add(&b, MRVL_TX_DATA_RATE_TLV_ID,
+                                  sizeof(TLVBUF_TX_DATA_RATE));
+        if (!tlv_urate)
+            goto done;
         if (uflag) {
             tlv_urate->TxDataRate = (u16) A2HEXDECIMAL(argv_urate[0])
                 & ~BASIC_RATE_SET_BIT;
             tlv_urate->TxDataRate = uap_cpu_to_le16(tlv_urate->TxDataRate);
         }
-        endian_convert_tlv_header_out(tlv_urate);
     }
 
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = tlv_build_send(dev, &b);
 
-    tlv_buf = buffer + sizeof(APCMDBUF_SYS_CONFIGURE);
+    tlv_buf = b.buf + sizeof(APCMDBUF_SYS_CONFIGURE);
 
     if (ret == UAP_SUCCESS) {
         /* Verify response */
@@ -1719,8 +1709,7 @@ apcmd_sys_cfg_rates_ext(int argc, char *argv[])
         free(argv_mrate[0]);
     if (uflag)
         free(argv_urate[0]);
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
@@ -1738,17 +1727,17 @@ apcmd_sys_cfg_rates_ext(int argc, char *argv[])
  *
  *           Each rate must be separated by a space
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_rates(int argc, char *argv[])
+apcmd_sys_cfg_rates(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     TLVBUF_RATES *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
+    tlv_builder b;
     int ret = UAP_FAILURE;
     int i = 0;
     int opt;
@@ -1767,32 +1756,18 @@ apcmd_sys_cfg_rates(int argc, char *argv[])
         print_sys_cfg_rates_usage();
         return;
     }
-    if (argc == 0) {
-        /* Initialize the command length */
-        cmd_len =
-            sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_RATES) + MAX_RATES;
-    } else {
-        /* Initialize the command length */
-        cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_RATES) + argc;
-    }
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
+        return;
+    tlv = tlv_build_add(&b, MRVL_RATES_TLV_ID,
+                        sizeof(TLVBUF_RATES) + (argc ? argc : MAX_RATES));
+    if (!tlv) {
+        tlv_build_free(dev, &b);
         return;
     }
-    bzero((char *) buffer, cmd_len);
-
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv = (TLVBUF_RATES *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
 
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_RATES_TLV_ID;
     if (argc == 0) {
         cmd_buf->Action = ACTION_GET;
         tlv->Length = MAX_RATES;
@@ -1804,9 +1779,8 @@ apcmd_sys_cfg_rates(int argc, char *argv[])
         }
     }
 
-    endian_convert_tlv_header_out(tlv);
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = tlv_build_send(dev, &b);
     endian_convert_tlv_header_in(tlv);
     /* Process response */
     if (ret == UAP_SUCCESS) {
@@ -1815,7 +1789,7 @@ apcmd_sys_cfg_rates(int argc, char *argv[])
             (tlv->Tag != MRVL_RATES_TLV_ID)) {
             printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
                    cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
 
@@ -1836,8 +1810,7 @@ apcmd_sys_cfg_rates(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
@@ -1851,17 +1824,17 @@ apcmd_sys_cfg_rates(int argc, char *argv[])
  *
  *           TX_POWER is represented in dBm
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_tx_power(int argc, char *argv[])
+apcmd_sys_cfg_tx_power(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     TLVBUF_TX_POWER *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
+    tlv_builder b;
     int ret = UAP_FAILURE;
     int opt;
     while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
@@ -1879,28 +1852,17 @@ apcmd_sys_cfg_tx_power(int argc, char *argv[])
         return;
     }
 
-    /* Initialize the command length */
-    cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_TX_POWER);
-
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
+        return;
+    tlv = tlv_build_add(&b, MRVL_TX_POWER_TLV_ID, sizeof(TLVBUF_TX_POWER));
+    if (!tlv) {
+        tlv_build_free(dev, &b);
         return;
     }
-    bzero((char *) buffer, cmd_len);
-
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv = (TLVBUF_TX_POWER *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
 
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_TX_POWER_TLV_ID;
     tlv->Length = 1;
     if (argc == 0) {
         cmd_buf->Action = ACTION_GET;
@@ -1912,9 +1874,8 @@ apcmd_sys_cfg_tx_power(int argc, char *argv[])
         cmd_buf->Action = ACTION_SET;
         tlv->TxPower_dBm = (u8) atoi(argv[0]);
     }
-    endian_convert_tlv_header_out(tlv);
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = tlv_build_send(dev, &b);
     endian_convert_tlv_header_in(tlv);
     /* Process response */
     if (ret == UAP_SUCCESS) {
@@ -1923,7 +1884,7 @@ apcmd_sys_cfg_tx_power(int argc, char *argv[])
             (tlv->Tag != MRVL_TX_POWER_TLV_ID)) {
             printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
                    cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
         /* Print response */
@@ -1943,8 +1904,7 @@ apcmd_sys_cfg_tx_power(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
@@ -1958,17 +1918,17 @@ apcmd_sys_cfg_tx_power(int argc, char *argv[])
  *            1     - Enable SSID broadcast
  *            empty - Get current SSID broadcast setting
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_bcast_ssid_ctl(int argc, char *argv[])
+apcmd_sys_cfg_bcast_ssid_ctl(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     TLVBUF_BCAST_SSID_CTL *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
+    tlv_builder b;
     int ret = UAP_FAILURE;
     int opt;
 
@@ -1986,27 +1946,18 @@ apcmd_sys_cfg_bcast_ssid_ctl(int argc, char *argv[])
         print_sys_cfg_bcast_ssid_ctl_usage();
         return;
     }
-    /* Initialize the command length */
-    cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_BCAST_SSID_CTL);
-
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
+        return;
+    tlv = tlv_build_add(&b, MRVL_BCAST_SSID_CTL_TLV_ID,
+                        sizeof(TLVBUF_BCAST_SSID_CTL));
+    if (!tlv) {
+        tlv_build_free(dev, &b);
         return;
     }
-    bzero((char *) buffer, cmd_len);
-
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv = (TLVBUF_BCAST_SSID_CTL *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
 
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_BCAST_SSID_CTL_TLV_ID;
     tlv->Length = 1;
     if (argc == 0) {
         cmd_buf->Action = ACTION_GET;
@@ -2014,9 +1965,8 @@ apcmd_sys_cfg_bcast_ssid_ctl(int argc, char *argv[])
         cmd_buf->Action = ACTION_SET;
         tlv->BcastSsidCtl = (u8) atoi(argv[0]);
     }
-    endian_convert_tlv_header_out(tlv);
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = tlv_build_send(dev, &b);
     endian_convert_tlv_header_in(tlv);
     /* Process response */
     if (ret == UAP_SUCCESS) {
@@ -2025,7 +1975,7 @@ apcmd_sys_cfg_bcast_ssid_ctl(int argc, char *argv[])
             (tlv->Tag != MRVL_BCAST_SSID_CTL_TLV_ID)) {
             printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
                    cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
         /* Print response */
@@ -2046,8 +1996,7 @@ apcmd_sys_cfg_bcast_ssid_ctl(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
@@ -2057,17 +2006,17 @@ apcmd_sys_cfg_bcast_ssid_ctl(int argc, char *argv[])
  *
  *   Usage: "sys_cfg_preamble_ctl"
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_preamble_ctl(int argc, char *argv[])
+apcmd_sys_cfg_preamble_ctl(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     TLVBUF_PREAMBLE_CTL *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
+    tlv_builder b;
     int ret = UAP_FAILURE;
     int opt;
     while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
@@ -2086,33 +2035,22 @@ apcmd_sys_cfg_preamble_ctl(int argc, char *argv[])
         print_sys_cfg_preamble_ctl_usage();
         return;
     }
-    /* Initialize the command length */
-    cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_PREAMBLE_CTL);
-
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
+        return;
+    tlv = tlv_build_add(&b, MRVL_PREAMBLE_CTL_TLV_ID,
+                        sizeof(TLVBUF_PREAMBLE_CTL));
+    if (!tlv) {
+        tlv_build_free(dev, &b);
         return;
     }
-    bzero((char *) buffer, cmd_len);
-
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv = (TLVBUF_PREAMBLE_CTL *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
 
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_PREAMBLE_CTL_TLV_ID;
     tlv->Length = 1;
     cmd_buf->Action = ACTION_GET;
-    endian_convert_tlv_header_out(tlv);
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = tlv_build_send(dev, &b);
     endian_convert_tlv_header_in(tlv);
     /* Process response */
     if (ret == UAP_SUCCESS) {
@@ -2121,7 +2059,7 @@ apcmd_sys_cfg_preamble_ctl(int argc, char *argv[])
             (tlv->Tag != MRVL_PREAMBLE_CTL_TLV_ID)) {
             printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
                    cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
         /* Print response */
@@ -2134,8 +2072,7 @@ apcmd_sys_cfg_preamble_ctl(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
@@ -2151,17 +2088,17 @@ apcmd_sys_cfg_preamble_ctl(int argc, char *argv[])
  *                      1       - Antenna B
  *                      empty   - Get current antenna settings
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_antenna_ctl(int argc, char *argv[])
+apcmd_sys_cfg_antenna_ctl(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     TLVBUF_ANTENNA_CTL *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
+    tlv_builder b;
     int ret = UAP_FAILURE;
     int opt;
     while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
@@ -2206,27 +2143,18 @@ apcmd_sys_cfg_antenna_ctl(int argc, char *argv[])
         }
     }
 
-    /* Initialize the command length */
-    cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_ANTENNA_CTL);
-
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
+        return;
+    tlv = tlv_build_add(&b, MRVL_ANTENNA_CTL_TLV_ID,
+                        sizeof(TLVBUF_ANTENNA_CTL));
+    if (!tlv) {
+        tlv_build_free(dev, &b);
         return;
     }
-    bzero((char *) buffer, cmd_len);
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv = (TLVBUF_ANTENNA_CTL *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
 
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_ANTENNA_CTL_TLV_ID;
     tlv->Length = 2;
     tlv->WhichAntenna = (u8) atoi(argv[0]);
     if (argc == 1) {
@@ -2235,9 +2163,8 @@ apcmd_sys_cfg_antenna_ctl(int argc, char *argv[])
         cmd_buf->Action = ACTION_SET;
         tlv->AntennaMode = (u8) atoi(argv[1]);
     }
-    endian_convert_tlv_header_out(tlv);
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = tlv_build_send(dev, &b);
     endian_convert_tlv_header_in(tlv);
     /* Process response */
     if (ret == UAP_SUCCESS) {
@@ -2246,7 +2173,7 @@ apcmd_sys_cfg_antenna_ctl(int argc, char *argv[])
             (tlv->Tag != MRVL_ANTENNA_CTL_TLV_ID)) {
             printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
                    cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
         /* Print response */
@@ -2267,8 +2194,7 @@ apcmd_sys_cfg_antenna_ctl(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
@@ -2280,17 +2206,17 @@ apcmd_sys_cfg_antenna_ctl(int argc, char *argv[])
  *           if RTS_THRESHOLD is provided, a 'set' is performed
  *           else a 'get' is performed
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_rts_threshold(int argc, char *argv[])
+apcmd_sys_cfg_rts_threshold(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     TLVBUF_RTS_THRESHOLD *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
+    tlv_builder b;
     int ret = UAP_FAILURE;
     int opt;
     while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
@@ -2307,28 +2233,18 @@ apcmd_sys_cfg_rts_threshold(int argc, char *argv[])
         print_sys_cfg_rts_threshold_usage();
         return;
     }
-    /* Initialize the command length */
-    cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_RTS_THRESHOLD);
-
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
+        return;
+    tlv = tlv_build_add(&b, MRVL_RTS_THRESHOLD_TLV_ID,
+                        sizeof(TLVBUF_RTS_THRESHOLD));
+    if (!tlv) {
+        tlv_build_free(dev, &b);
         return;
     }
-    bzero((char *) buffer, cmd_len);
-
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv = (TLVBUF_RTS_THRESHOLD *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
 
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_RTS_THRESHOLD_TLV_ID;
     tlv->Length = 2;
     if (argc == 0) {
         cmd_buf->Action = ACTION_GET;
@@ -2336,10 +2252,9 @@ apcmd_sys_cfg_rts_threshold(int argc, char *argv[])
         cmd_buf->Action = ACTION_SET;
         tlv->RtsThreshold = (u16) atoi(argv[0]);
     }
-    endian_convert_tlv_header_out(tlv);
     tlv->RtsThreshold = uap_cpu_to_le16(tlv->RtsThreshold);
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = tlv_build_send(dev, &b);
     endian_convert_tlv_header_in(tlv);
     tlv->RtsThreshold = uap_le16_to_cpu(tlv->RtsThreshold);
     /* Process response */
@@ -2349,7 +2264,7 @@ apcmd_sys_cfg_rts_threshold(int argc, char *argv[])
             (tlv->Tag != MRVL_RTS_THRESHOLD_TLV_ID)) {
             printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
                    cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
         /* Print response */
@@ -2369,8 +2284,7 @@ apcmd_sys_cfg_rts_threshold(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
@@ -2382,17 +2296,17 @@ apcmd_sys_cfg_rts_threshold(int argc, char *argv[])
  *           if FRAG_THRESHOLD is provided, a 'set' is performed
  *           else a 'get' is performed
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_frag_threshold(int argc, char *argv[])
+apcmd_sys_cfg_frag_threshold(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     TLVBUF_FRAG_THRESHOLD *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
+    tlv_builder b;
     int ret = UAP_FAILURE;
     int opt;
     while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
@@ -2409,28 +2323,18 @@ apcmd_sys_cfg_frag_threshold(int argc, char *argv[])
         print_sys_cfg_frag_threshold_usage();
         return;
     }
-    /* Initialize the command length */
-    cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_FRAG_THRESHOLD);
-
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
+        return;
+    tlv = tlv_build_add(&b, MRVL_FRAG_THRESHOLD_TLV_ID,
+                        sizeof(TLVBUF_FRAG_THRESHOLD));
+    if (!tlv) {
+        tlv_build_free(dev, &b);
         return;
     }
-    bzero((char *) buffer, cmd_len);
-
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv = (TLVBUF_FRAG_THRESHOLD *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
 
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_FRAG_THRESHOLD_TLV_ID;
     tlv->Length = 2;
     if (argc == 0) {
         cmd_buf->Action = ACTION_GET;
@@ -2438,10 +2342,9 @@ apcmd_sys_cfg_frag_threshold(int argc, char *argv[])
         cmd_buf->Action = ACTION_SET;
         tlv->FragThreshold = (u16) atoi(argv[0]);
     }
-    endian_convert_tlv_header_out(tlv);
     tlv->FragThreshold = uap_cpu_to_le16(tlv->FragThreshold);
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = tlv_build_send(dev, &b);
     endian_convert_tlv_header_in(tlv);
     tlv->FragThreshold = uap_le16_to_cpu(tlv->FragThreshold);
 
@@ -2452,7 +2355,7 @@ apcmd_sys_cfg_frag_threshold(int argc, char *argv[])
             (tlv->Tag != MRVL_FRAG_THRESHOLD_TLV_ID)) {
             printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
                    cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
         /* Print response */
@@ -2472,8 +2375,7 @@ apcmd_sys_cfg_frag_threshold(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
@@ -2487,17 +2389,17 @@ apcmd_sys_cfg_frag_threshold(int argc, char *argv[])
  *            1     - Turn radio off
  *            empty - Get current radio setting
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_radio_ctl(int argc, char *argv[])
+apcmd_sys_cfg_radio_ctl(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     TLVBUF_RADIO_CTL *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
+    tlv_builder b;
     int ret = UAP_FAILURE;
     int opt;
     while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
@@ -2514,27 +2416,17 @@ apcmd_sys_cfg_radio_ctl(int argc, char *argv[])
         print_sys_cfg_radio_ctl_usage();
         return;
     }
-    /* Initialize the command length */
-    cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_RADIO_CTL);
-
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
+        return;
+    tlv = tlv_build_add(&b, MRVL_RADIO_CTL_TLV_ID, sizeof(TLVBUF_RADIO_CTL));
+    if (!tlv) {
+        tlv_build_free(dev, &b);
         return;
     }
-    bzero((char *) buffer, cmd_len);
-
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv = (TLVBUF_RADIO_CTL *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
 
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_RADIO_CTL_TLV_ID;
     tlv->Length = 1;
     if (argc == 0) {
         cmd_buf->Action = ACTION_GET;
@@ -2542,9 +2434,8 @@ apcmd_sys_cfg_radio_ctl(int argc, char *argv[])
         cmd_buf->Action = ACTION_SET;
         tlv->RadioCtl = (u8) atoi(argv[0]);
     }
-    endian_convert_tlv_header_out(tlv);
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = tlv_build_send(dev, &b);
     endian_convert_tlv_header_in(tlv);
     /* Process response */
     if (ret == UAP_SUCCESS) {
@@ -2553,7 +2444,7 @@ apcmd_sys_cfg_radio_ctl(int argc, char *argv[])
             (tlv->Tag != MRVL_RADIO_CTL_TLV_ID)) {
             printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
                    cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
         /* Print response */
@@ -2573,8 +2464,7 @@ apcmd_sys_cfg_radio_ctl(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
@@ -2588,17 +2478,17 @@ apcmd_sys_cfg_radio_ctl(int argc, char *argv[])
  *            1     - Enable  RSN replay protection
  *            empty - Get current RSN replay protection setting
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_rsn_replay_prot(int argc, char *argv[])
+apcmd_sys_cfg_rsn_replay_prot(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     tlvbuf_rsn_replay_prot *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
+    tlv_builder b;
     int ret = UAP_FAILURE;
     int opt;
 
@@ -2616,27 +2506,18 @@ apcmd_sys_cfg_rsn_replay_prot(int argc, char *argv[])
         print_sys_cfg_rsn_replay_prot_usage();
         return;
     }
-    /* Initialize the command length */
-    cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(tlvbuf_rsn_replay_prot);
-
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
+        return;
+    tlv = tlv_build_add(&b, MRVL_RSN_REPLAY_PROT_TLV_ID,
+                        sizeof(tlvbuf_rsn_replay_prot));
+    if (!tlv) {
+        tlv_build_free(dev, &b);
         return;
     }
-    bzero((char *) buffer, cmd_len);
-
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv = (tlvbuf_rsn_replay_prot *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
 
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_RSN_REPLAY_PROT_TLV_ID;
     tlv->Length = 1;
     if (argc == 0) {
         cmd_buf->Action = ACTION_GET;
@@ -2644,9 +2525,8 @@ apcmd_sys_cfg_rsn_replay_prot(int argc, char *argv[])
         cmd_buf->Action = ACTION_SET;
         tlv->rsn_replay_prot = (u8) atoi(argv[0]);
     }
-    endian_convert_tlv_header_out(tlv);
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = tlv_build_send(dev, &b);
     endian_convert_tlv_header_in(tlv);
     /* Process response */
     if (ret == UAP_SUCCESS) {
@@ -2655,7 +2535,7 @@ apcmd_sys_cfg_rsn_replay_prot(int argc, char *argv[])
             (tlv->Tag != MRVL_RSN_REPLAY_PROT_TLV_ID)) {
             printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
                    cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
         /* Print response */
@@ -2676,8 +2556,7 @@ apcmd_sys_cfg_rsn_replay_prot(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
@@ -2693,17 +2572,17 @@ apcmd_sys_cfg_rsn_replay_prot(int argc, char *argv[])
  *
  *           MCBC_DATA_RATE is represented in units of 500 kbps
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_mcbc_data_rate(int argc, char *argv[])
+apcmd_sys_cfg_mcbc_data_rate(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     TLVBUF_MCBC_DATA_RATE *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
+    tlv_builder b;
     int ret = UAP_FAILURE;
     int opt;
     while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
@@ -2724,35 +2603,25 @@ apcmd_sys_cfg_mcbc_data_rate(int argc, char *argv[])
             return;
         }
         if ((A2HEXDECIMAL(argv[0]) != 0) &&
-            (is_mcbc_rate_valid(A2HEXDECIMAL(argv[0])) != UAP_SUCCESS)) {
+            (is_mcbc_rate_valid(dev, A2HEXDECIMAL(argv[0])) != UAP_SUCCESS)) {
             printf("ERR: invalid MCBC data rate.");
             print_sys_cfg_mcbc_data_rates_usage();
             return;
         }
     }
 
-    /* Initialize the command length */
-    cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_MCBC_DATA_RATE);
-
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
+        return;
+    tlv = tlv_build_add(&b, MRVL_MCBC_DATA_RATE_TLV_ID,
+                        sizeof(TLVBUF_MCBC_DATA_RATE));
+    if (!tlv) {
+        tlv_build_free(dev, &b);
         return;
     }
-    bzero((char *) buffer, cmd_len);
-
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv = (TLVBUF_MCBC_DATA_RATE *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
 
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_MCBC_DATA_RATE_TLV_ID;
     tlv->Length = 2;
     if (argc == 0) {
         cmd_buf->Action = ACTION_GET;
@@ -2760,11 +2629,10 @@ apcmd_sys_cfg_mcbc_data_rate(int argc, char *argv[])
         cmd_buf->Action = ACTION_SET;
         tlv->MCBCdatarate = (u16) A2HEXDECIMAL(argv[0]);
     }
-    endian_convert_tlv_header_out(tlv);
     tlv->MCBCdatarate = uap_cpu_to_le16(tlv->MCBCdatarate);
 
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = tlv_build_send(dev, &b);
     endian_convert_tlv_header_in(tlv);
     tlv->MCBCdatarate = uap_le16_to_cpu(tlv->MCBCdatarate);
 
@@ -2775,7 +2643,7 @@ apcmd_sys_cfg_mcbc_data_rate(int argc, char *argv[])
             (tlv->Tag != MRVL_MCBC_DATA_RATE_TLV_ID)) {
             printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
                    cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
         /* Print response */
@@ -2799,8 +2667,7 @@ apcmd_sys_cfg_mcbc_data_rate(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
@@ -2816,17 +2683,17 @@ apcmd_sys_cfg_mcbc_data_rate(int argc, char *argv[])
  *
  *           TX_DATA_RATE is represented in units of 500 kbps
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_tx_data_rate(int argc, char *argv[])
+apcmd_sys_cfg_tx_data_rate(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     TLVBUF_TX_DATA_RATE *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
+    tlv_builder b;
     int ret = UAP_FAILURE;
     int opt;
     while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
@@ -2846,35 +2713,26 @@ apcmd_sys_cfg_tx_data_rate(int argc, char *argv[])
             print_sys_cfg_tx_data_rates_usage();
             return;
         } else if ((A2HEXDECIMAL(argv[0]) != 0) &&
-                   (is_tx_rate_valid(A2HEXDECIMAL(argv[0])) != UAP_SUCCESS)) {
+                   (is_tx_rate_valid(dev, A2HEXDECIMAL(argv[0])) !=
+                    UAP_SUCCESS)) {
             printf("ERR: invalid tx data rate.");
             print_sys_cfg_tx_data_rates_usage();
             return;
         }
     }
 
-    /* Initialize the command length */
-    cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_TX_DATA_RATE);
-
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
+        return;
+    tlv = tlv_build_add(&b, MRVL_TX_DATA_RATE_TLV_ID,
+                        sizeof(TLVBUF_TX_DATA_RATE));
+    if (!tlv) {
+        tlv_build_free(dev, &b);
         return;
     }
-    bzero((char *) buffer, cmd_len);
-
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv = (TLVBUF_TX_DATA_RATE *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
 
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_TX_DATA_RATE_TLV_ID;
     tlv->Length = 2;
     if (argc == 0) {
         cmd_buf->Action = ACTION_GET;
@@ -2882,11 +2740,10 @@ apcmd_sys_cfg_tx_data_rate(int argc, char *argv[])
         cmd_buf->Action = ACTION_SET;
         tlv->TxDataRate = (u16) A2HEXDECIMAL(argv[0]);
     }
-    endian_convert_tlv_header_out(tlv);
     tlv->TxDataRate = uap_cpu_to_le16(tlv->TxDataRate);
 
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = tlv_build_send(dev, &b);
     endian_convert_tlv_header_in(tlv);
     tlv->TxDataRate = uap_le16_to_cpu(tlv->TxDataRate);
 
@@ -2897,7 +2754,7 @@ apcmd_sys_cfg_tx_data_rate(int argc, char *argv[])
             (tlv->Tag != MRVL_TX_DATA_RATE_TLV_ID)) {
             printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
                    cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
         /* Print response */
@@ -2921,8 +2778,7 @@ apcmd_sys_cfg_tx_data_rate(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
@@ -2936,17 +2792,17 @@ apcmd_sys_cfg_tx_data_rate(int argc, char *argv[])
  *            1     - Firmware handles intra-BSS packets
  *            empty - Get current packet forwarding setting
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_pkt_fwd_ctl(int argc, char *argv[])
+apcmd_sys_cfg_pkt_fwd_ctl(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     TLVBUF_PKT_FWD_CTL *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
+    tlv_builder b;
     int ret = UAP_FAILURE;
     int opt;
     while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
@@ -2963,27 +2819,18 @@ apcmd_sys_cfg_pkt_fwd_ctl(int argc, char *argv[])
         print_sys_cfg_pkt_fwd_ctl_usage();
         return;
     }
-    /* Initialize the command length */
-    cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_PKT_FWD_CTL);
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
+        return;
+    tlv = tlv_build_add(&b, MRVL_PKT_FWD_CTL_TLV_ID,
+                        sizeof(TLVBUF_PKT_FWD_CTL));
+    if (!tlv) {
+        tlv_build_free(dev, &b);
         return;
     }
-    bzero((char *) buffer, cmd_len);
-
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv = (TLVBUF_PKT_FWD_CTL *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
 
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_PKT_FWD_CTL_TLV_ID;
     tlv->Length = 1;
     if (argc == 0) {
         cmd_buf->Action = ACTION_GET;
@@ -2991,9 +2838,8 @@ apcmd_sys_cfg_pkt_fwd_ctl(int argc, char *argv[])
         cmd_buf->Action = ACTION_SET;
         tlv->PktFwdCtl = (u8) atoi(argv[0]);
     }
-    endian_convert_tlv_header_out(tlv);
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = tlv_build_send(dev, &b);
     endian_convert_tlv_header_in(tlv);
     /* Process response */
     if (ret == UAP_SUCCESS) {
@@ -3002,7 +2848,7 @@ apcmd_sys_cfg_pkt_fwd_ctl(int argc, char *argv[])
             (tlv->Tag != MRVL_PKT_FWD_CTL_TLV_ID)) {
             printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
                    cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
         /* Print response */
@@ -3024,8 +2870,7 @@ apcmd_sys_cfg_pkt_fwd_ctl(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
@@ -3040,17 +2885,17 @@ apcmd_sys_cfg_pkt_fwd_ctl(int argc, char *argv[])
  *
  *           STA_AGEOUT_TIMER is represented in units of 100 ms
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_sta_ageout_timer(int argc, char *argv[])
+apcmd_sys_cfg_sta_ageout_timer(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     TLVBUF_STA_AGEOUT_TIMER *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
+    tlv_builder b;
     int ret = UAP_FAILURE;
     int opt;
     while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
@@ -3067,28 +2912,18 @@ apcmd_sys_cfg_sta_ageout_timer(int argc, char *argv[])
         print_sys_cfg_sta_ageout_timer_usage();
         return;
     }
-    /* Initialize the command length */
-    cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_STA_AGEOUT_TIMER);
-
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
+        return;
+    tlv = tlv_build_add(&b, MRVL_STA_AGEOUT_TIMER_TLV_ID,
+                        sizeof(TLVBUF_STA_AGEOUT_TIMER));
+    if (!tlv) {
+        tlv_build_free(dev, &b);
         return;
     }
-    bzero((char *) buffer, cmd_len);
-
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv = (TLVBUF_STA_AGEOUT_TIMER *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
 
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_STA_AGEOUT_TIMER_TLV_ID;
     tlv->Length = 4;
     if (argc == 0) {
         cmd_buf->Action = ACTION_GET;
@@ -3096,10 +2931,9 @@ apcmd_sys_cfg_sta_ageout_timer(int argc, char *argv[])
         cmd_buf->Action = ACTION_SET;
         tlv->StaAgeoutTimer_ms = (u32) atoi(argv[0]);
     }
-    endian_convert_tlv_header_out(tlv);
     tlv->StaAgeoutTimer_ms = uap_cpu_to_le32(tlv->StaAgeoutTimer_ms);
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = tlv_build_send(dev, &b);
     endian_convert_tlv_header_in(tlv);
     tlv->StaAgeoutTimer_ms = uap_le32_to_cpu(tlv->StaAgeoutTimer_ms);
     /* Process response */
@@ -3109,7 +2943,7 @@ apcmd_sys_cfg_sta_ageout_timer(int argc, char *argv[])
             (tlv->Tag != MRVL_STA_AGEOUT_TIMER_TLV_ID)) {
             printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
                    cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
         /* Print response */
@@ -3130,8 +2964,7 @@ apcmd_sys_cfg_sta_ageout_timer(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
@@ -3145,17 +2978,17 @@ apcmd_sys_cfg_sta_ageout_timer(int argc, char *argv[])
  *                           1 - Shared key authentication
  *            empty - Get current authentication mode                         
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_auth(int argc, char *argv[])
+apcmd_sys_cfg_auth(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     TLVBUF_AUTH_MODE *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
+    tlv_builder b;
     int ret = UAP_FAILURE;
     int opt;
     while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
@@ -3172,28 +3005,17 @@ apcmd_sys_cfg_auth(int argc, char *argv[])
         print_sys_cfg_auth_usage();
         return;
     }
-    /* Initialize the command length */
-    cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_AUTH_MODE);
-
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
+        return;
+    tlv = tlv_build_add(&b, MRVL_AUTH_TLV_ID, sizeof(TLVBUF_AUTH_MODE));
+    if (!tlv) {
+        tlv_build_free(dev, &b);
         return;
     }
-    bzero((char *) buffer, cmd_len);
-
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv = (TLVBUF_AUTH_MODE *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
 
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_AUTH_TLV_ID;
     tlv->Length = 1;
     if (argc == 0) {
         cmd_buf->Action = ACTION_GET;
@@ -3201,9 +3023,8 @@ apcmd_sys_cfg_auth(int argc, char *argv[])
         cmd_buf->Action = ACTION_SET;
         tlv->AuthMode = (u8) atoi(argv[0]);
     }
-    endian_convert_tlv_header_out(tlv);
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = tlv_build_send(dev, &b);
     endian_convert_tlv_header_in(tlv);
 
     /* Process response */
@@ -3213,7 +3034,7 @@ apcmd_sys_cfg_auth(int argc, char *argv[])
             (tlv->Tag != MRVL_AUTH_TLV_ID)) {
             printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
                    cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
         /* Print response */
@@ -3233,8 +3054,7 @@ apcmd_sys_cfg_auth(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
@@ -3250,18 +3070,18 @@ apcmd_sys_cfg_auth(int argc, char *argv[])
  *	                             Bit 3 - WPA2
  *            empty - Get current protocol                         
  *           
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_protocol(int argc, char *argv[])
+apcmd_sys_cfg_protocol(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     TLVBUF_PROTOCOL *tlv = NULL;
     TLVBUF_AKMP *akmp_tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
+    tlv_builder b;
     int ret = UAP_FAILURE;
     int opt;
     while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
@@ -3278,61 +3098,42 @@ apcmd_sys_cfg_protocol(int argc, char *argv[])
         print_sys_cfg_protocol_usage();
         return;
     }
-    /* Initialize the command length */
-    if ((argc == 1) &&
-        ((atoi(argv[0]) == PROTOCOL_NO_SECURITY) ||
-         (atoi(argv[0]) == PROTOCOL_STATIC_WEP))) {
-        cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_PROTOCOL);
-    } else
-        cmd_len =
-            sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_PROTOCOL) +
-            sizeof(TLVBUF_AKMP);
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
+        return;
+    tlv = tlv_build_add(&b, MRVL_PROTOCOL_TLV_ID, sizeof(TLVBUF_PROTOCOL));
+    if (!tlv) {
+        tlv_build_free(dev, &b);
         return;
     }
-    bzero((char *) buffer, cmd_len);
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv = (TLVBUF_PROTOCOL *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
-    akmp_tlv =
-        (TLVBUF_AKMP *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE) +
-                         sizeof(TLVBUF_PROTOCOL));
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
+    /* The AKMP TLV is left out with no security or static WEP */
+    if ((argc == 0) ||
+        ((atoi(argv[0]) != PROTOCOL_NO_SECURITY) &&
+         (atoi(argv[0]) != PROTOCOL_STATIC_WEP))) {
+        akmp_tlv = tlv_build_add(&b, MRVL_AKMP_TLV_ID, sizeof(TLVBUF_AKMP));
+        if (!akmp_tlv) {
+            tlv_build_free(dev, &b);
+            return;
+        }
+    }
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_PROTOCOL_TLV_ID;
     tlv->Length = 2;
     if (argc == 0) {
         cmd_buf->Action = ACTION_GET;
-        akmp_tlv->Tag = MRVL_AKMP_TLV_ID;
-        akmp_tlv->Length = 2;
     } else {
         cmd_buf->Action = ACTION_SET;
         tlv->Protocol = (u16) atoi(argv[0]);
         if (tlv->Protocol & (PROTOCOL_WPA | PROTOCOL_WPA2)) {
-            akmp_tlv->Tag = MRVL_AKMP_TLV_ID;
-            akmp_tlv->Length = 2;
             akmp_tlv->KeyMgmt = KEY_MGMT_PSK;
             akmp_tlv->KeyMgmt = uap_cpu_to_le16(akmp_tlv->KeyMgmt);
         }
     }
-    endian_convert_tlv_header_out(tlv);
-    if (cmd_len ==
-        (sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_PROTOCOL) +
-         sizeof(TLVBUF_AKMP)))
-        endian_convert_tlv_header_out(akmp_tlv);
     tlv->Protocol = uap_cpu_to_le16(tlv->Protocol);
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = tlv_build_send(dev, &b);
     endian_convert_tlv_header_in(tlv);
-    if (cmd_len ==
-        (sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_PROTOCOL) +
-         sizeof(TLVBUF_AKMP)))
+    if (akmp_tlv)
         endian_convert_tlv_header_in(akmp_tlv);
 
     /* Process response */
@@ -3341,7 +3142,7 @@ apcmd_sys_cfg_protocol(int argc, char *argv[])
         if (cmd_buf->CmdCode != (APCMD_SYS_CONFIGURE | APCMD_RESP_CHECK)) {
             printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
                    cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
         /* Print response */
@@ -3363,8 +3164,7 @@ apcmd_sys_cfg_protocol(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
@@ -3383,18 +3183,17 @@ apcmd_sys_cfg_protocol(int argc, char *argv[])
  *            KEY_* :        Key value
  *            empty - Get current WEP key settings
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_wep_key(int argc, char *argv[])
+apcmd_sys_cfg_wep_key(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     TLVBUF_WEP_KEY *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
-    u16 buf_len;
+    tlv_builder b;
     int ret = UAP_FAILURE;
     int key_len = -1;
     int length = 0;
@@ -3474,42 +3273,23 @@ apcmd_sys_cfg_wep_key(int argc, char *argv[])
         }
     }
 
-    /* Initialize the command length */
-    if (argc == 0 || argc == 1) {
-        if (argc == 0)
-            cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_HEADER);
-        else
-            cmd_len =
-                sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_WEP_KEY) - 1;
-        buf_len = MRVDRV_SIZE_OF_CMD_BUFFER;
-    } else {
-        buf_len = cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE);
-    }
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(buf_len);
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
         return;
-    }
-    bzero((char *) buffer, buf_len);
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
 
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
     if (argc == 0 || argc == 1) {
         cmd_buf->Action = ACTION_GET;
-        tlv = (TLVBUF_WEP_KEY *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
-        tlv->Tag = MRVL_WEP_KEY_TLV_ID;
-        if (argc == 0)
-            tlv->Length = 0;
-        else {
-            tlv->Length = 1;
-            tlv->KeyIndex = atoi(argv[0]);
+        tlv = tlv_build_add(&b, MRVL_WEP_KEY_TLV_ID,
+                            argc ? sizeof(TLVBUF_WEP_KEY) - 1 :
+                            sizeof(TLVBUF_HEADER));
+        if (!tlv) {
+            tlv_build_free(dev, &b);
+            return;
         }
-        endian_convert_tlv_header_out(tlv);
+        if (argc == 1)
+            tlv->KeyIndex = atoi(argv[0]);
     } else {
         cmd_buf->Action = ACTION_SET;
     }
@@ -3532,20 +3312,13 @@ apcmd_sys_cfg_wep_key(int argc, char *argv[])
             key_len = 0;
             break;
         }
-        /* Adjust command buffer */
-        buffer = realloc(buffer, (cmd_len + sizeof(TLVBUF_WEP_KEY) + key_len));
-        if (!buffer) {
-            printf("ERR:Cannot append WEP key configurations TLV!\n");
+        tlv = tlv_build_add(&b, MRVL_WEP_KEY_TLV_ID,
+                            sizeof(TLVBUF_WEP_KEY) + key_len);
+        if (!tlv) {
+            tlv_build_free(dev, &b);
             return;
         }
-        /* Locate headers */
-        cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-        tlv = (TLVBUF_WEP_KEY *) (buffer + cmd_len);
-        /* Adjust command length */
-        cmd_len += (sizeof(TLVBUF_WEP_KEY) + key_len);
         /* Set TLV fields */
-        tlv->Tag = MRVL_WEP_KEY_TLV_ID;
-        tlv->Length = 2 + key_len;
         tlv->KeyIndex = (u8) keyindex;
         tlv->IsDefault = (u8) is_default;
         /* Check if string or raw */
@@ -3561,22 +3334,16 @@ apcmd_sys_cfg_wep_key(int argc, char *argv[])
         default:
             break;
         }
-        endian_convert_tlv_header_out(tlv);
     }
 
-    /* Update command length */
-    cmd_buf->Size = cmd_len;
-    if ((argc != 0) && (argc != 1))
-        buf_len = cmd_len;
-
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, buf_len);
+    ret = tlv_build_send(dev, &b);
     /* Process response */
     if (ret == UAP_SUCCESS) {
         /* Verify response */
         if (cmd_buf->CmdCode != (APCMD_SYS_CONFIGURE | APCMD_RESP_CHECK)) {
             printf("ERR:Corrupted response!\n");
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
         /* Print response */
@@ -3586,7 +3353,7 @@ apcmd_sys_cfg_wep_key(int argc, char *argv[])
             } else {
                 printf("query WEP key setting successful\n");
                 tlv =
-                    (TLVBUF_WEP_KEY *) (buffer +
+                    (TLVBUF_WEP_KEY *) (b.buf +
                                         sizeof(APCMDBUF_SYS_CONFIGURE));
                 print_tlv((u8 *) tlv,
                           cmd_buf->Size - sizeof(APCMDBUF_SYS_CONFIGURE) +
@@ -3601,8 +3368,7 @@ apcmd_sys_cfg_wep_key(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
@@ -3620,19 +3386,19 @@ apcmd_sys_cfg_wep_key(int argc, char *argv[])
  *            IEBuffer:      IE Buffer in hex
  *            empty - Get all IE settings
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_custom_ie(int argc, char *argv[])
+apcmd_sys_cfg_custom_ie(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     tlvbuf_custom_ie *tlv = NULL;
     custom_ie *ie_ptr = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
-    u16 buf_len;
+    tlv_builder b;
+    u16 tlv_len = 0;
     u16 mgmt_subtype_mask = 0;
     int ret = UAP_FAILURE;
     int ie_buf_len = 0, ie_len = 0;
@@ -3654,7 +3420,7 @@ apcmd_sys_cfg_custom_ie(int argc, char *argv[])
         return;
     }
 
-    /* Error checks and initialize the command length */
+    /* Error checks and initialize the TLV length */
     if (argc >= 1) {
         if ((ISDIGIT(argv[0]) == 0) || (atoi(argv[0]) < 0) ||
             (atoi(argv[0]) > 3)) {
@@ -3667,14 +3433,11 @@ apcmd_sys_cfg_custom_ie(int argc, char *argv[])
     }
     switch (argc) {
     case 0:
-        cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(tlvbuf_custom_ie);
-        buf_len = MRVDRV_SIZE_OF_CMD_BUFFER;
+        tlv_len = sizeof(tlvbuf_custom_ie);
         break;
     case 1:
         /* TLV header + ie_index */
-        cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(tlvbuf_custom_ie) +
-            sizeof(u16);
-        buf_len = MRVDRV_SIZE_OF_CMD_BUFFER;
+        tlv_len = sizeof(tlvbuf_custom_ie) + sizeof(u16);
         break;
     case 2:
         if (UAP_FAILURE == ishexstring(argv[1]) || A2HEXDECIMAL(argv[1]) != 0) {
@@ -3682,8 +3445,7 @@ apcmd_sys_cfg_custom_ie(int argc, char *argv[])
             print_sys_cfg_custom_ie_usage();
             return;
         }
-        buf_len = cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) +
-            sizeof(tlvbuf_custom_ie) + sizeof(custom_ie);
+        tlv_len = sizeof(tlvbuf_custom_ie) + sizeof(custom_ie);
         break;
     case 3:
         if (UAP_FAILURE == ishexstring(argv[1]) || A2HEXDECIMAL(argv[1]) == 0) {
@@ -3708,63 +3470,41 @@ apcmd_sys_cfg_custom_ie(int argc, char *argv[])
             return;
         }
         mgmt_subtype_mask = (u16) A2HEXDECIMAL(argv[1]);
-        buf_len = cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) +
-            sizeof(tlvbuf_custom_ie) + sizeof(custom_ie) + ie_len;
+        tlv_len = sizeof(tlvbuf_custom_ie) + sizeof(custom_ie) + ie_len;
         break;
     }
 
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(buf_len);
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, argc > 1 ? ACTION_SET : ACTION_GET) !=
+        UAP_SUCCESS)
+        return;
+    tlv = tlv_build_add(&b, MRVL_MGMT_IE_LIST_TLV_ID, tlv_len);
+    if (!tlv) {
+        tlv_build_free(dev, &b);
         return;
     }
-    memset(buffer, 0, buf_len);
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
+    ie_ptr = (custom_ie *) (tlv->ie_data);
 
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    cmd_buf->Size = cmd_len;
-
-    if (argc == 0 || argc == 1) {
-        cmd_buf->Action = ACTION_GET;
-        tlv = (tlvbuf_custom_ie *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
-        tlv->Tag = MRVL_MGMT_IE_LIST_TLV_ID;
-        if (argc == 0)
-            tlv->Length = 0;
-        else {
-            tlv->Length = sizeof(u16);
-            ie_ptr = (custom_ie *) (tlv->ie_data);
-            ie_ptr->ie_index = (u16) uap_cpu_to_le16(atoi(argv[0]));
-        }
-        endian_convert_tlv_header_out(tlv);
-    } else {
-        cmd_buf->Action = ACTION_SET;
-        /* Locate headers */
-        tlv = (tlvbuf_custom_ie *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
-        ie_ptr = (custom_ie *) (tlv->ie_data);
-        /* Set TLV fields */
-        tlv->Tag = MRVL_MGMT_IE_LIST_TLV_ID;
-        tlv->Length = sizeof(custom_ie) + ie_len;
+    if (argc == 1) {
+        ie_ptr->ie_index = (u16) uap_cpu_to_le16(atoi(argv[0]));
+    } else if (argc > 1) {
         ie_ptr->ie_index = uap_cpu_to_le16(atoi(argv[0]));
         ie_ptr->mgmt_subtype_mask = uap_cpu_to_le16(mgmt_subtype_mask);
         ie_ptr->ie_length = uap_cpu_to_le16(ie_len);
         if (argc == 3)
             string2raw(argv[2], ie_ptr->ie_buffer);
-        endian_convert_tlv_header_out(tlv);
     }
 
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, buf_len);
+    ret = tlv_build_send(dev, &b);
     /* Process response */
     if (ret == UAP_SUCCESS) {
         /* Verify response */
         if (cmd_buf->CmdCode != (APCMD_SYS_CONFIGURE | APCMD_RESP_CHECK)) {
             printf("ERR:Corrupted response!\n");
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
         /* Print response */
@@ -3774,7 +3514,7 @@ apcmd_sys_cfg_custom_ie(int argc, char *argv[])
             } else {
                 printf("Querying custom IE successful\n");
                 tlv =
-                    (tlvbuf_custom_ie *) (buffer +
+                    (tlvbuf_custom_ie *) (b.buf +
                                           sizeof(APCMDBUF_SYS_CONFIGURE));
                 print_tlv((u8 *) tlv,
                           cmd_buf->Size - sizeof(APCMDBUF_SYS_CONFIGURE) +
@@ -3789,8 +3529,7 @@ apcmd_sys_cfg_custom_ie(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
@@ -3806,17 +3545,17 @@ apcmd_sys_cfg_custom_ie(int argc, char *argv[])
  *                              Bit 3 - AES CCMP
  *            empty - Get current cipher settings
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_cipher(int argc, char *argv[])
+apcmd_sys_cfg_cipher(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     TLVBUF_CIPHER *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
+    tlv_builder b;
     int ret = UAP_FAILURE;
     int opt;
     while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
@@ -3856,27 +3595,17 @@ apcmd_sys_cfg_cipher(int argc, char *argv[])
             return;
         }
     }
-    /* Initialize the command length */
-    cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_CIPHER);
-
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
+        return;
+    tlv = tlv_build_add(&b, MRVL_CIPHER_TLV_ID, sizeof(TLVBUF_CIPHER));
+    if (!tlv) {
+        tlv_build_free(dev, &b);
         return;
     }
-    bzero((char *) buffer, cmd_len);
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
 
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv = (TLVBUF_CIPHER *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_CIPHER_TLV_ID;
     tlv->Length = 2;
     if (argc == 0) {
         cmd_buf->Action = ACTION_GET;
@@ -3885,9 +3614,8 @@ apcmd_sys_cfg_cipher(int argc, char *argv[])
         tlv->PairwiseCipher = (u8) atoi(argv[0]);
         tlv->GroupCipher = (u8) atoi(argv[1]);
     }
-    endian_convert_tlv_header_out(tlv);
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = tlv_build_send(dev, &b);
     endian_convert_tlv_header_in(tlv);
     /* Process response */
     if (ret == UAP_SUCCESS) {
@@ -3896,7 +3624,7 @@ apcmd_sys_cfg_cipher(int argc, char *argv[])
             (tlv->Tag != MRVL_CIPHER_TLV_ID)) {
             printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
                    cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
         /* Print response */
@@ -3916,8 +3644,7 @@ apcmd_sys_cfg_cipher(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
@@ -3930,17 +3657,17 @@ apcmd_sys_cfg_cipher(int argc, char *argv[])
  *   Options: GROUP_REKEY_TIME is represented in seconds
  *            Get current group re-key timer                         
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_group_rekey_timer(int argc, char *argv[])
+apcmd_sys_cfg_group_rekey_timer(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     TLVBUF_GROUP_REKEY_TIMER *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
+    tlv_builder b;
     int ret = UAP_FAILURE;
     int opt;
     while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
@@ -3957,26 +3684,18 @@ apcmd_sys_cfg_group_rekey_timer(int argc, char *argv[])
         print_sys_cfg_group_rekey_timer_usage();
     }
 
-    /* Initialize the command length */
-    cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_GROUP_REKEY_TIMER);
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
+        return;
+    tlv = tlv_build_add(&b, MRVL_GRP_REKEY_TIME_TLV_ID,
+                        sizeof(TLVBUF_GROUP_REKEY_TIMER));
+    if (!tlv) {
+        tlv_build_free(dev, &b);
         return;
     }
-    bzero((char *) buffer, cmd_len);
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv =
-        (TLVBUF_GROUP_REKEY_TIMER *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
 
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_GRP_REKEY_TIME_TLV_ID;
     tlv->Length = 4;
     if (argc == 0) {
         cmd_buf->Action = ACTION_GET;
@@ -3984,10 +3703,9 @@ apcmd_sys_cfg_group_rekey_timer(int argc, char *argv[])
         cmd_buf->Action = ACTION_SET;
         tlv->GroupRekeyTime_sec = (u32) atoi(argv[0]);
     }
-    endian_convert_tlv_header_out(tlv);
     tlv->GroupRekeyTime_sec = uap_cpu_to_le32(tlv->GroupRekeyTime_sec);
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = tlv_build_send(dev, &b);
     endian_convert_tlv_header_in(tlv);
     tlv->GroupRekeyTime_sec = uap_le32_to_cpu(tlv->GroupRekeyTime_sec);
     /* Process response */
@@ -3997,7 +3715,7 @@ apcmd_sys_cfg_group_rekey_timer(int argc, char *argv[])
             (tlv->Tag != MRVL_GRP_REKEY_TIME_TLV_ID)) {
             printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
                    cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
         /* Print response */
@@ -4021,8 +3739,7 @@ apcmd_sys_cfg_group_rekey_timer(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
@@ -4034,17 +3751,17 @@ apcmd_sys_cfg_group_rekey_timer(int argc, char *argv[])
  *           if PASSPHRASE is provided, a 'set' is performed
  *           else a 'get' is performed
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_wpa_passphrase(int argc, char *argv[])
+apcmd_sys_cfg_wpa_passphrase(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     TLVBUF_WPA_PASSPHRASE *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
+    tlv_builder b;
     int ret = UAP_FAILURE;
     int opt;
     while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
@@ -4077,31 +3794,18 @@ apcmd_sys_cfg_wpa_passphrase(int argc, char *argv[])
             return;
         }
     }
-    /* Initialize the command length */
-    if (argc == 0)
-        cmd_len =
-            sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_WPA_PASSPHRASE) +
-            MAX_WPA_PASSPHRASE_LENGTH;
-    else
-        cmd_len =
-            sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_WPA_PASSPHRASE) +
-            strlen(argv[0]);
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
+        return;
+    tlv = tlv_build_add(&b, MRVL_WPA_PASSPHRASE_TLV_ID,
+                        sizeof(TLVBUF_WPA_PASSPHRASE) +
+                        (argc ? strlen(argv[0]) : MAX_WPA_PASSPHRASE_LENGTH));
+    if (!tlv) {
+        tlv_build_free(dev, &b);
         return;
     }
-    bzero((char *) buffer, cmd_len);
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv = (TLVBUF_WPA_PASSPHRASE *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_WPA_PASSPHRASE_TLV_ID;
     if (argc == 0) {
         cmd_buf->Action = ACTION_GET;
         tlv->Length = MAX_WPA_PASSPHRASE_LENGTH;
@@ -4110,9 +3814,8 @@ apcmd_sys_cfg_wpa_passphrase(int argc, char *argv[])
         tlv->Length = strlen(argv[0]);
         memcpy(tlv->Passphrase, argv[0], tlv->Length);
     }
-    endian_convert_tlv_header_out(tlv);
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = tlv_build_send(dev, &b);
     endian_convert_tlv_header_in(tlv);
     /* Process response */
     if (ret == UAP_SUCCESS) {
@@ -4121,7 +3824,7 @@ apcmd_sys_cfg_wpa_passphrase(int argc, char *argv[])
             (tlv->Tag != MRVL_WPA_PASSPHRASE_TLV_ID)) {
             printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
                    cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
         /* Print response */
@@ -4144,39 +3847,114 @@ apcmd_sys_cfg_wpa_passphrase(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
+/**
+ *  @brief Gets or sets the MAC filter table
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param action   ACTION_GET or ACTION_SET
+ *  @param filter   Table to set, or returns the table, with room for
+ *                  MAX_MAC_ONESHOT_FILTER addresses
+ *  @return         UAP_SUCCESS or UAP_FAILURE, printed
+ */
+static int
+sta_filter_table_cmd(uap_dev * dev, u16 action,
+                     TLVBUF_STA_MAC_ADDR_FILTER * filter)
+{
+    APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
+    TLVBUF_STA_MAC_ADDR_FILTER *tlv = NULL;
+    tlv_builder b;
+    int count;
+    int ret = UAP_FAILURE;
+
+    count = action == ACTION_GET ? MAX_MAC_ONESHOT_FILTER : filter->Count;
+
+    /* Initialize the command buffer */
+    if (tlv_build_start(dev, &b, action) != UAP_SUCCESS)
+        return UAP_FAILURE;
+    tlv = tlv_build_add(&b, MRVL_STA_MAC_ADDR_FILTER_TLV_ID,
+                        sizeof(TLVBUF_STA_MAC_ADDR_FILTER) + count * ETH_ALEN);
+    if (!tlv) {
+        tlv_build_free(dev, &b);
+        return UAP_FAILURE;
+    }
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
+
+    /* Fill the command buffer */
+    tlv->Count = count;
+    if (action == ACTION_SET) {
+        tlv->FilterMode = filter->FilterMode;
+        memcpy(tlv->MacAddress, filter->MacAddress, count * ETH_ALEN);
+    }
+    /* Send the command */
+    ret = tlv_build_send(dev, &b);
+    endian_convert_tlv_header_in(tlv);
+    /* Process response */
+    if (ret == UAP_SUCCESS) {
+        /* Verify response */
+        if ((cmd_buf->CmdCode != (APCMD_SYS_CONFIGURE | APCMD_RESP_CHECK)) ||
+            (tlv->Tag != MRVL_STA_MAC_ADDR_FILTER_TLV_ID) ||
+            (action == ACTION_GET && cmd_buf->Result == CMD_SUCCESS &&
+             tlv->Count > MAX_MAC_ONESHOT_FILTER)) {
+            printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
+                   cmd_buf->CmdCode, tlv->Tag);
+            ret = UAP_FAILURE;
+        } else if (cmd_buf->Result != CMD_SUCCESS) {
+            printf("ERR:Could not %s MAC address filter table settings!\n",
+                   action == ACTION_GET ? "get" : "set");
+            ret = UAP_FAILURE;
+        } else if (action == ACTION_GET) {
+            filter->FilterMode = tlv->FilterMode;
+            filter->Count = tlv->Count;
+            memcpy(filter->MacAddress, tlv->MacAddress,
+                   tlv->Count * ETH_ALEN);
+        }
+    } else {
+        printf("ERR:Command sending failed!\n");
+    }
+    tlv_build_free(dev, &b);
+    return ret;
+}
+
 /** 
  *  @brief Creates a STA filter request and sends to the driver
  *
- *   Usage: "sta_filter_table <FILTERMODE> <MACADDRESS_LIST>"
+ *   Usage: "sta_filter_table [--file <path>] <FILTERMODE> <MACADDRESS_LIST>"
  *
  *   Options: FILTERMODE : 0 - Disable filter table
  *                         1 - Allow mac address specified in the allwed list
  *		           2 - Block MAC addresses specified in the  banned list
  *            MACADDRESS_LIST is the list of MAC addresses to be acted upon. Each
  *                         MAC address must be separated with a space. Maximum of
- *                         16 MAC addresses are supported.
+ *                         16 distinct MAC addresses are supported.
+ *
+ *   The table is read first and only set when it differs.
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sta_filter_table(int argc, char *argv[])
+apcmd_sta_filter_table(uap_dev * dev, int argc, char *argv[])
 {
-    APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
-    TLVBUF_STA_MAC_ADDR_FILTER *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
-    int ret = UAP_FAILURE;
+    u8 buf[sizeof(TLVBUF_STA_MAC_ADDR_FILTER) +
+           MAX_MAC_ONESHOT_FILTER * ETH_ALEN];
+    TLVBUF_STA_MAC_ADDR_FILTER *filter = (TLVBUF_STA_MAC_ADDR_FILTER *) buf;
+    mac_list macs;
+    char *file = NULL;
+    int mode, changes;
     int i = 0;
     int opt;
-    while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "+hf:", sta_filter_options,
+                              NULL)) != -1) {
         switch (opt) {
+        case 'f':
+            file = optarg;
+            break;
         default:
             print_sta_filter_table_usage();
             return;
@@ -4184,115 +3962,72 @@ apcmd_sta_filter_table(int argc, char *argv[])
     }
     argc -= optind;
     argv += optind;
+    memset(buf, 0, sizeof(buf));
     /* Check arguments */
-    if (argc > (MAX_MAC_ONESHOT_FILTER + 1)) {
-        printf("ERR:Too many arguments.\n");
+    if (argc == 0 && !file) {
+        if (sta_filter_table_cmd(dev, ACTION_GET, filter) == UAP_SUCCESS)
+            print_mac_filter(filter);
+        return;
+    }
+    if ((argc == 0) || (ISDIGIT(argv[0]) == 0) ||
+        ((atoi(argv[0]) < 0) || (atoi(argv[0]) > 2))) {
+        printf
+            ("ERR:Illegal FILTERMODE parameter %s. Must be either '0', '1', or '2'.\n",
+             argc ? argv[0] : "");
         print_sta_filter_table_usage();
         return;
     }
-    if (argc > 0) {
-        if ((ISDIGIT(argv[0]) == 0) ||
-            ((atoi(argv[0]) < 0) || (atoi(argv[0]) > 2))) {
-            printf
-                ("ERR:Illegal FILTERMODE parameter %s. Must be either '0', '1', or '2'.\n",
-                 argv[1]);
-            print_sta_filter_table_usage();
-            return;
-        }
-        if ((atoi(argv[0]) != 0) && (argc == 1)) {
-            printf("ERR:At least one mac is required.\n");
+    mode = atoi(argv[0]);
+
+    memset(&macs, 0, sizeof(macs));
+    for (i = 1; i < argc; i++) {
+        if (mac_list_add(&macs, argv[i]) != UAP_SUCCESS) {
             print_sta_filter_table_usage();
-            return;
+            goto done;
         }
     }
-    /* Initialize the command length */
-    if (argc == 0) {
-        cmd_len =
-            sizeof(APCMDBUF_SYS_CONFIGURE) +
-            sizeof(TLVBUF_STA_MAC_ADDR_FILTER) +
-            (MAX_MAC_ONESHOT_FILTER * ETH_ALEN);
-    } else {
-        cmd_len =
-            sizeof(APCMDBUF_SYS_CONFIGURE) +
-            sizeof(TLVBUF_STA_MAC_ADDR_FILTER) + (argc - 1) * ETH_ALEN;
+    if (file && mac_list_read(&macs, file) != UAP_SUCCESS)
+        goto done;
+    if (sta_mac_dedup(&macs) != UAP_SUCCESS) {
+        printf("ERR:Cannot allocate memory!\n");
+        goto done;
     }
-
-    /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
-        return;
+    if ((mode != 0) && (macs.n == 0)) {
+        printf("ERR:At least one mac is required.\n");
+        print_sta_filter_table_usage();
+        goto done;
+    }
+    if (macs.n > MAX_MAC_ONESHOT_FILTER) {
+        printf("ERR:%d distinct MAC addresses, the firmware filter table "
+               "holds at most %d.\n", macs.n, MAX_MAC_ONESHOT_FILTER);
+        goto done;
     }
-    bzero((char *) buffer, cmd_len);
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv =
-        (TLVBUF_STA_MAC_ADDR_FILTER *) (buffer +
-                                        sizeof(APCMDBUF_SYS_CONFIGURE));
 
-    /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_STA_MAC_ADDR_FILTER_TLV_ID;
-    if (argc == 0) {
-        cmd_buf->Action = ACTION_GET;
-        tlv->Count = MAX_MAC_ONESHOT_FILTER;
-    } else {
-        cmd_buf->Action = ACTION_SET;
-        tlv->FilterMode = atoi(argv[0]);
-        tlv->Count = argc - 1;
-        for (i = 0; i < tlv->Count; i++) {
-            if ((ret =
-                 mac2raw(argv[i + 1],
-                         &tlv->MacAddress[i * ETH_ALEN])) != UAP_SUCCESS) {
-                printf("ERR: %s Address\n",
-                       ret == UAP_FAILURE ? "Invalid MAC" : ret ==
-                       UAP_RET_MAC_BROADCAST ? "Broadcast" : "Multicast");
-                print_sta_filter_table_usage();
-                free(buffer);
-                return;
-            }
-        }
+    /* Compare with the table in the firmware */
+    if (sta_filter_table_cmd(dev, ACTION_GET, filter) != UAP_SUCCESS)
+        goto done;
+    changes = sta_mac_diff(&macs, filter->MacAddress, filter->Count);
+    if (changes < 0) {
+        printf("ERR:Cannot allocate memory!\n");
+        goto done;
     }
-    tlv->Length = tlv->Count * ETH_ALEN + 2;
-    endian_convert_tlv_header_out(tlv);
-    /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
-    endian_convert_tlv_header_in(tlv);
-    /* Process response */
-    if (ret == UAP_SUCCESS) {
-        /* Verify response */
-        if ((cmd_buf->CmdCode != (APCMD_SYS_CONFIGURE | APCMD_RESP_CHECK)) ||
-            (tlv->Tag != MRVL_STA_MAC_ADDR_FILTER_TLV_ID)) {
-            printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
-                   cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
-            return;
-        }
-        /* Print response */
-        if (cmd_buf->Result == CMD_SUCCESS) {
-            if (argc == 0) {
-                print_mac_filter(tlv);
-            } else {
-                printf("MAC address filter table setting successful!\n");
-            }
-        } else {
-            if (argc == 0) {
-                printf
-                    ("ERR:Could not get MAC address filter table settings!\n");
-            } else {
-                printf
-                    ("ERR:Could not set MAC address filter table settings!\n");
-            }
-        }
-    } else {
-        printf("ERR:Command sending failed!\n");
+    if (filter->FilterMode != mode) {
+        printf("Filter mode %d -> %d\n", filter->FilterMode, mode);
+        changes++;
     }
-    if (buffer)
-        free(buffer);
+    if (!changes) {
+        printf("MAC address filter table is up to date.\n");
+        goto done;
+    }
+
+    filter->FilterMode = mode;
+    filter->Count = macs.n;
+    if (macs.n)
+        memcpy(filter->MacAddress, macs.mac, macs.n * ETH_ALEN);
+    if (sta_filter_table_cmd(dev, ACTION_SET, filter) == UAP_SUCCESS)
+        printf("MAC address filter table setting successful!\n");
+  done:
+    free(macs.mac);
     return;
 }
 
@@ -4306,17 +4041,17 @@ apcmd_sta_filter_table(int argc, char *argv[])
  *
  *           STA_NUM should not bigger than 8
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_max_sta_num(int argc, char *argv[])
+apcmd_sys_cfg_max_sta_num(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     TLVBUF_MAX_STA_NUM *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
+    tlv_builder b;
     int ret = UAP_FAILURE;
     int opt;
 
@@ -4336,28 +4071,18 @@ apcmd_sys_cfg_max_sta_num(int argc, char *argv[])
         return;
     }
 
-    /* Initialize the command length */
-    cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_MAX_STA_NUM);
-
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
+        return;
+    tlv = tlv_build_add(&b, MRVL_MAX_STA_CNT_TLV_ID,
+                        sizeof(TLVBUF_MAX_STA_NUM));
+    if (!tlv) {
+        tlv_build_free(dev, &b);
         return;
     }
-    bzero((char *) buffer, cmd_len);
-
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv = (TLVBUF_MAX_STA_NUM *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
 
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_MAX_STA_CNT_TLV_ID;
     tlv->Length = 2;
     if (argc == 0) {
         cmd_buf->Action = ACTION_GET;
@@ -4365,11 +4090,10 @@ apcmd_sys_cfg_max_sta_num(int argc, char *argv[])
         cmd_buf->Action = ACTION_SET;
         tlv->Max_sta_num = (u16) atoi(argv[0]);
     }
-    endian_convert_tlv_header_out(tlv);
     tlv->Max_sta_num = uap_cpu_to_le16(tlv->Max_sta_num);
 
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = tlv_build_send(dev, &b);
     endian_convert_tlv_header_in(tlv);
     tlv->Max_sta_num = uap_le16_to_cpu(tlv->Max_sta_num);
     /* Process response */
@@ -4379,7 +4103,7 @@ apcmd_sys_cfg_max_sta_num(int argc, char *argv[])
             (tlv->Tag != MRVL_MAX_STA_CNT_TLV_ID)) {
             printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
                    cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
         /* Print response */
@@ -4399,8 +4123,7 @@ apcmd_sys_cfg_max_sta_num(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
@@ -4414,17 +4137,17 @@ apcmd_sys_cfg_max_sta_num(int argc, char *argv[])
  *
  *           RETRY_LIMIT should not bigger than 14
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_cfg_retry_limit(int argc, char *argv[])
+apcmd_sys_cfg_retry_limit(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     TLVBUF_RETRY_LIMIT *tlv = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
+    tlv_builder b;
     int ret = UAP_FAILURE;
     int opt;
 
@@ -4444,28 +4167,18 @@ apcmd_sys_cfg_retry_limit(int argc, char *argv[])
         return;
     }
 
-    /* Initialize the command length */
-    cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(TLVBUF_RETRY_LIMIT);
-
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
+        return;
+    tlv = tlv_build_add(&b, MRVL_RETRY_LIMIT_TLV_ID,
+                        sizeof(TLVBUF_RETRY_LIMIT));
+    if (!tlv) {
+        tlv_build_free(dev, &b);
         return;
     }
-    bzero((char *) buffer, cmd_len);
-
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-    tlv = (TLVBUF_RETRY_LIMIT *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b.buf;
 
     /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    tlv->Tag = MRVL_RETRY_LIMIT_TLV_ID;
     tlv->Length = 1;
     if (argc == 0) {
         cmd_buf->Action = ACTION_GET;
@@ -4473,10 +4186,8 @@ apcmd_sys_cfg_retry_limit(int argc, char *argv[])
         cmd_buf->Action = ACTION_SET;
         tlv->retry_limit = (u8) atoi(argv[0]);
     }
-    endian_convert_tlv_header_out(tlv);
-
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = tlv_build_send(dev, &b);
     endian_convert_tlv_header_in(tlv);
 
     /* Process response */
@@ -4486,7 +4197,7 @@ apcmd_sys_cfg_retry_limit(int argc, char *argv[])
             (tlv->Tag != MRVL_RETRY_LIMIT_TLV_ID)) {
             printf("ERR:Corrupted response! CmdCode=%x, Tlv->Tag=%x\n",
                    cmd_buf->CmdCode, tlv->Tag);
-            free(buffer);
+            tlv_build_free(dev, &b);
             return;
         }
         /* Print response */
@@ -4506,8 +4217,7 @@ apcmd_sys_cfg_retry_limit(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     return;
 }
 
@@ -4576,12 +4286,13 @@ fparse_for_hex(FILE * fp, u8 * dst)
  *
  *   Usage: "cfg_data <cfg_data.conf>"
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_cfg_data(int argc, char *argv[])
+apcmd_cfg_data(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_CFG_DATA *cmd_buf = NULL;
     u8 *buf = NULL;
@@ -4613,8 +4324,7 @@ apcmd_cfg_data(int argc, char *argv[])
         }
     }
     buf_len = MRVDRV_SIZE_OF_CMD_BUFFER;
-    buf = (u8 *) malloc(buf_len);
-    memset(buf, 0, buf_len);
+    buf = uap_cmd_buf_alloc(dev, sizeof(APCMDBUF_CFG_DATA));
     cmd_buf = (APCMDBUF_CFG_DATA *) buf;
     if (buf == NULL) {
         printf("Error: allocate memory for hostcmd failed\n");
@@ -4625,7 +4335,7 @@ apcmd_cfg_data(int argc, char *argv[])
         fp = fopen(argv[1], "r");
         if (fp == NULL) {
             printf("\nERR:Config file can not open %s.\n", argv[1]);
-            free(buf);
+            uap_cmd_buf_free(dev, buf);
             return;
         }
         cmd_buf->action = ACTION_SET;
@@ -4633,7 +4343,7 @@ apcmd_cfg_data(int argc, char *argv[])
         fclose(fp);
         if (cmd_buf->data_len > MAX_CFG_DATA_SIZE) {
             printf("ERR: Config file is too big %d\n", cmd_buf->data_len);
-            free(buf);
+            uap_cmd_buf_free(dev, buf);
             return;
         }
     } else {
@@ -4654,7 +4364,7 @@ apcmd_cfg_data(int argc, char *argv[])
     cmd_buf->Result = 0;
 
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, buf_len);
+    ret = uap_ioctl(dev, (u8 *) cmd_buf, &cmd_len, buf_len);
     /* Process response */
     if (ret == UAP_SUCCESS) {
         cmd_buf->action = uap_le16_to_cpu(cmd_buf->action);
@@ -4665,6 +4375,469 @@ apcmd_cfg_data(int argc, char *argv[])
             printf("download cfg data successful\n");
     }
     if (buf)
-        free(buf);
+        uap_cmd_buf_free(dev, buf);
+    return;
+}
+
+/**
+ *  @brief Parses the arguments of the sys_cfg batch commands
+ *
+ *  @param argc     Number of arguments
+ *  @param argv     Pointer to the arguments
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+sys_cfg_batch_args(int argc, char *argv[])
+{
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
+        switch (opt) {
+        default:
+            print_sys_cfg_batch_usage();
+            return UAP_FAILURE;
+        }
+    }
+    if (argc - optind) {
+        printf("ERR:Too many arguments.\n");
+        print_sys_cfg_batch_usage();
+        return UAP_FAILURE;
+    }
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Opens a sys_cfg batch
+ *
+ *   Usage: "sys_cfg_begin"
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param argc     Number of arguments
+ *  @param argv     Pointer to the arguments
+ *  @return         N/A
+ */
+void
+apcmd_sys_cfg_begin(uap_dev * dev, int argc, char *argv[])
+{
+    if (sys_cfg_batch_args(argc, argv) != UAP_SUCCESS)
+        return;
+    if (uapd_allowed("sys_cfg_begin") != UAP_SUCCESS)
+        return;
+    if (uap_cfg_begin(dev) == UAP_OK)
+        printf("sys_cfg batch started\n");
+    return;
+}
+
+/**
+ *  @brief Sends the settings of the open sys_cfg batch
+ *
+ *   Usage: "sys_cfg_commit"
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param argc     Number of arguments
+ *  @param argv     Pointer to the arguments
+ *  @return         N/A
+ */
+void
+apcmd_sys_cfg_commit(uap_dev * dev, int argc, char *argv[])
+{
+    int sets = 0, cmds = 0;
+
+    if (sys_cfg_batch_args(argc, argv) != UAP_SUCCESS)
+        return;
+    if (uapd_allowed("sys_cfg_commit") != UAP_SUCCESS)
+        return;
+    if (uap_cfg_commit(dev, &sets, &cmds) == UAP_OK)
+        printf("sys_cfg batch committed: %d settings in %d commands\n", sets,
+               cmds);
+    else
+        printf("ERR:sys_cfg batch of %d settings failed\n", sets);
+    return;
+}
+
+/**
+ *  @brief Discards the settings of the open sys_cfg batch
+ *
+ *   Usage: "sys_cfg_abort"
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param argc     Number of arguments
+ *  @param argv     Pointer to the arguments
+ *  @return         N/A
+ */
+void
+apcmd_sys_cfg_abort(uap_dev * dev, int argc, char *argv[])
+{
+    int sets;
+
+    if (sys_cfg_batch_args(argc, argv) != UAP_SUCCESS)
+        return;
+    if (uapd_allowed("sys_cfg_abort") != UAP_SUCCESS)
+        return;
+    sets = uap_cfg_abort(dev);
+    if (sets < 0)
+        printf("ERR:No sys_cfg batch is open\n");
+    else
+        printf("sys_cfg batch discarded: %d settings\n", sets);
     return;
 }
+
+/**
+ *  @brief Reads several sys_cfg parameters with one command
+ *
+ *   Usage: "sys_cfg_get <PARAMETER> [PARAMETER ...]"
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param argc     Number of arguments
+ *  @param argv     Pointer to the arguments
+ *  @return         N/A
+ */
+void
+apcmd_sys_cfg_get(uap_dev * dev, int argc, char *argv[])
+{
+    uap_tlv tlvs[SYS_CFG_PARAMS];
+    u8 keys[SYS_CFG_PARAMS][2];
+    u8 buf[MRVDRV_SIZE_OF_CMD_BUFFER];
+    int opt, i, j, len = sizeof(buf), ret;
+
+    while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
+        switch (opt) {
+        default:
+            print_sys_cfg_get_usage();
+            return;
+        }
+    }
+    argc -= optind;
+    argv += optind;
+
+    /* Check arguments */
+    if (!argc) {
+        print_sys_cfg_get_usage();
+        return;
+    }
+    if (argc > SYS_CFG_PARAMS) {
+        printf("ERR:Too many arguments.\n");
+        print_sys_cfg_get_usage();
+        return;
+    }
+    for (i = 0; i < argc; i++) {
+        for (j = 0; j < SYS_CFG_PARAMS; j++) {
+            if (!strcmp(argv[i], sys_cfg_params[j].name))
+                break;
+        }
+        if (j == SYS_CFG_PARAMS) {
+            printf("ERR:Unknown parameter %s\n", argv[i]);
+            print_sys_cfg_get_usage();
+            return;
+        }
+        tlvs[i].tag = sys_cfg_params[j].tag;
+        tlvs[i].len = sys_cfg_params[j].len;
+        tlvs[i].value = NULL;
+        if (sys_cfg_params[j].key) {
+            keys[i][0] = sys_cfg_params[j].key;
+            keys[i][1] = 0;
+            tlvs[i].value = keys[i];
+        }
+    }
+
+    ret = uap_get_tlvs(dev, tlvs, argc, buf, &len);
+    if (ret != UAP_OK) {
+        print_lib_error(ret, "Could not get sys_cfg parameters");
+        return;
+    }
+    print_tlv(buf, len);
+    for (i = 0; i < argc; i++) {
+        if (!tlvs[i].value)
+            printf("ERR:%s not returned\n", argv[i]);
+    }
+    return;
+}
+
+/**
+ *  @brief Loads a MIB file
+ *
+ *  @param file     MIB file, lines of "<name> <oid> <size>"
+ *  @param mib      MIB to fill, free mib->defs when done
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+snmp_mib_load(char *file, snmp_mib * mib)
+{
+    char line[256], name[sizeof(mib->defs->name)], *p;
+    unsigned int oid;
+    int size, n, lineno = 0;
+    FILE *fp;
+
+    fp = fopen(file, "r");
+    if (!fp) {
+        printf("ERR:Cannot open MIB file %s: %s\n", file, strerror(errno));
+        return UAP_FAILURE;
+    }
+    mib->defs = (snmp_oid_def *) malloc(MAX_SNMP_OID_DEFS *
+                                        sizeof(snmp_oid_def));
+    mib->num = 0;
+    if (!mib->defs) {
+        printf("ERR:Cannot allocate MIB table!\n");
+        fclose(fp);
+        return UAP_FAILURE;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        lineno++;
+        p = strchr(line, '#');
+        if (p)
+            *p = '\0';
+        n = sscanf(line, "%47s %i %d", name, (int *) &oid, &size);
+        if (n <= 0)
+            continue;
+        if (n != 3 || !oid || oid > 0xffff ||
+            (size != 1 && size != 2 && size != 4)) {
+            printf("ERR:%s:%d: expected \"<name> <oid> <size 1|2|4>\"\n",
+                   file, lineno);
+            goto fail;
+        }
+        if (mib->num == MAX_SNMP_OID_DEFS) {
+            printf("ERR:%s: more than %d OIDs\n", file, MAX_SNMP_OID_DEFS);
+            goto fail;
+        }
+        strcpy(mib->defs[mib->num].name, name);
+        mib->defs[mib->num].oid = (u16) oid;
+        mib->defs[mib->num].size = size;
+        mib->num++;
+    }
+    fclose(fp);
+    return UAP_SUCCESS;
+
+  fail:
+    fclose(fp);
+    free(mib->defs);
+    mib->defs = NULL;
+    return UAP_FAILURE;
+}
+
+/**
+ *  @brief Resolves an OID argument
+ *
+ *  @param mib      Loaded MIB file
+ *  @param arg      OID name, or number with an optional ":<size>"
+ *  @param oid      OID to fill
+ *  @return         Name of the OID, NULL if it is invalid
+ */
+static const char *
+snmp_oid_lookup(snmp_mib * mib, char *arg, uap_oid * oid)
+{
+    unsigned long num;
+    char *end;
+    int i;
+
+    for (i = 0; i < mib->num; i++) {
+        if (!strcmp(mib->defs[i].name, arg)) {
+            oid->oid = mib->defs[i].oid;
+            oid->size = mib->defs[i].size;
+            return mib->defs[i].name;
+        }
+    }
+    for (i = 0; i < SNMP_OID_DEFS; i++) {
+        if (!strcmp(snmp_oid_defs[i].name, arg)) {
+            oid->oid = snmp_oid_defs[i].oid;
+            oid->size = snmp_oid_defs[i].size;
+            return snmp_oid_defs[i].name;
+        }
+    }
+    num = strtoul(arg, &end, 0);
+    if (end == arg || !num || num > 0xffff)
+        return NULL;
+    oid->oid = (u16) num;
+    oid->size = 4;
+    if (*end == ':') {
+        oid->size = strtol(end + 1, &end, 10);
+        if (oid->size != 1 && oid->size != 2 && oid->size != 4)
+            return NULL;
+    }
+    return *end ? NULL : arg;
+}
+
+/**
+ *  @brief Parses the -m option of snmp_get and snmp_set
+ *
+ *  @param argc     Number of arguments
+ *  @param argv     Pointer to the arguments
+ *  @param mib      MIB to fill
+ *  @param usage    Usage function of the command
+ *  @return         Index of the first OID argument, -1 on error
+ */
+static int
+snmp_args(int argc, char *argv[], snmp_mib * mib, void (*usage) (void))
+{
+    int opt;
+
+    mib->defs = NULL;
+    mib->num = 0;
+    while ((opt = getopt_long(argc, argv, "+hm:", snmp_options, NULL)) !=
+           -1) {
+        switch (opt) {
+        case 'm':
+            free(mib->defs);
+            if (snmp_mib_load(optarg, mib) != UAP_SUCCESS)
+                return -1;
+            break;
+        default:
+            free(mib->defs);
+            usage();
+            return -1;
+        }
+    }
+    if (optind == argc) {
+        free(mib->defs);
+        usage();
+        return -1;
+    }
+    return optind;
+}
+
+/**
+ *  @brief Gets any number of SNMP MIB OIDs in a batch
+ *
+ *   Usage: "snmp_get [-m <mib file>] <OID>[,OID...] [OID ...]"
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param argc     Number of arguments
+ *  @param argv     Pointer to the arguments
+ *  @return         N/A
+ */
+void
+apcmd_snmp_get(uap_dev * dev, int argc, char *argv[])
+{
+    uap_oid oids[MAX_SNMP_OIDS];
+    const char *names[MAX_SNMP_OIDS];
+    snmp_mib mib;
+    char *arg, *save;
+    int i, n = 0, cmds, ret;
+
+    i = snmp_args(argc, argv, &mib, print_snmp_get_usage);
+    if (i < 0)
+        return;
+    for (; i < argc; i++) {
+        for (arg = strtok_r(argv[i], ",", &save); arg;
+             arg = strtok_r(NULL, ",", &save)) {
+            if (n == MAX_SNMP_OIDS) {
+                printf("ERR:More than %d OIDs\n", MAX_SNMP_OIDS);
+                goto done;
+            }
+            names[n] = snmp_oid_lookup(&mib, arg, &oids[n]);
+            if (!names[n]) {
+                printf("ERR:Unknown OID %s\n", arg);
+                goto done;
+            }
+            n++;
+        }
+    }
+
+    ret = uap_snmp_get_oids(dev, oids, n, &cmds);
+    if (ret != UAP_OK) {
+        print_lib_error(ret, "Could not get SNMP MIB values");
+        goto done;
+    }
+    for (i = 0; i < n; i++)
+        printf("%s: %u\n", names[i], oids[i].value);
+    uap_printf(MSG_DEBUG, "DBG:%d OIDs in %d commands\n", n, cmds);
+  done:
+    free(mib.defs);
+    return;
+}
+
+/**
+ *  @brief Sets any number of SNMP MIB OIDs in a batch
+ *
+ *   Usage: "snmp_set [-m <mib file>] <OID>=<value> [OID=value ...]"
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param argc     Number of arguments
+ *  @param argv     Pointer to the arguments
+ *  @return         N/A
+ */
+void
+apcmd_snmp_set(uap_dev * dev, int argc, char *argv[])
+{
+    uap_oid oids[MAX_SNMP_OIDS];
+    snmp_mib mib;
+    unsigned long value;
+    char *eq, *end;
+    int i, n = 0, cmds, ret;
+
+    i = snmp_args(argc, argv, &mib, print_snmp_set_usage);
+    if (i < 0)
+        return;
+    for (; i < argc; i++) {
+        if (n == MAX_SNMP_OIDS) {
+            printf("ERR:More than %d OIDs\n", MAX_SNMP_OIDS);
+            goto done;
+        }
+        eq = strchr(argv[i], '=');
+        if (!eq) {
+            printf("ERR:Expected <OID>=<value>, got %s\n", argv[i]);
+            goto done;
+        }
+        *eq = '\0';
+        if (!snmp_oid_lookup(&mib, argv[i], &oids[n])) {
+            printf("ERR:Unknown OID %s\n", argv[i]);
+            goto done;
+        }
+        value = strtoul(eq + 1, &end, 0);
+        if (end == eq + 1 || *end || (oids[n].size < 4 &&
+                                      value >> (8 * oids[n].size))) {
+            printf("ERR:Invalid value %s for %s\n", eq + 1, argv[i]);
+            goto done;
+        }
+        oids[n++].value = (unsigned int) value;
+    }
+
+    ret = uap_snmp_set_oids(dev, oids, n, &cmds);
+    if (ret != UAP_OK) {
+        print_lib_error(ret, "Could not set SNMP MIB values");
+        goto done;
+    }
+    printf("SNMP MIB set: %d OIDs in %d commands\n", n, cmds);
+  done:
+    free(mib.defs);
+    return;
+}
+
+/**
+ *  @brief Returns the name of a built-in OID
+ *
+ *  @param oid      OID
+ *  @return         Name of the OID, NULL if it is not built in
+ */
+const char *
+snmp_oid_name(u16 oid)
+{
+    int i;
+
+    for (i = 0; i < SNMP_OID_DEFS; i++) {
+        if (snmp_oid_defs[i].oid == oid)
+            return snmp_oid_defs[i].name;
+    }
+    return NULL;
+}
+
+/**
+ *  @brief Lists the built-in 802.11 counter OIDs
+ *
+ *  @param oids     OIDs to fill
+ *  @param max      Size of oids
+ *  @return         Number of OIDs filled
+ */
+int
+snmp_counter_oids(uap_oid * oids, int max)
+{
+    int i, n = 0;
+
+    for (i = 0; i < SNMP_OID_DEFS && n < max; i++) {
+        if (snmp_oid_defs[i].size != 4)
+            continue;
+        oids[n].oid = snmp_oid_defs[i].oid;
+        oids[n].size = 4;
+        oids[n++].value = 0;
+    }
+    return n;
+}
@@ -28,36 +28,44 @@ Change log:
 #define _UAPCMD_H
 
 /** Function Prototype Declaration */
-void apcmd_sys_cfg_ap_mac_address(int argc, char *argv[]);
-void apcmd_sys_cfg_ssid(int argc, char *argv[]);
-void apcmd_sys_cfg_beacon_period(int argc, char *argv[]);
-void apcmd_sys_cfg_dtim_period(int argc, char *argv[]);
-void apcmd_sys_cfg_channel(int argc, char *argv[]);
-void apcmd_sys_cfg_scan_channels(int argc, char *argv[]);
-void apcmd_sys_cfg_rates(int argc, char *argv[]);
-void apcmd_sys_cfg_rates_ext(int argc, char *argv[]);
-void apcmd_sys_cfg_tx_power(int argc, char *argv[]);
-void apcmd_sys_cfg_bcast_ssid_ctl(int argc, char *argv[]);
-void apcmd_sys_cfg_preamble_ctl(int argc, char *argv[]);
-void apcmd_sys_cfg_antenna_ctl(int argc, char *argv[]);
-void apcmd_sys_cfg_rts_threshold(int argc, char *argv[]);
-void apcmd_sys_cfg_frag_threshold(int argc, char *argv[]);
-void apcmd_sys_cfg_radio_ctl(int argc, char *argv[]);
-void apcmd_sys_cfg_rsn_replay_prot(int argc, char *argv[]);
-void apcmd_sys_cfg_tx_data_rate(int argc, char *argv[]);
-void apcmd_sys_cfg_mcbc_data_rate(int argc, char *argv[]);
-void apcmd_sys_cfg_pkt_fwd_ctl(int argc, char *argv[]);
-void apcmd_sys_cfg_sta_ageout_timer(int argc, char *argv[]);
-void apcmd_sys_cfg_auth(int argc, char *argv[]);
-void apcmd_sys_cfg_protocol(int argc, char *argv[]);
-void apcmd_sys_cfg_wep_key(int argc, char *argv[]);
-void apcmd_sys_cfg_custom_ie(int argc, char *argv[]);
-void apcmd_sys_cfg_cipher(int argc, char *argv[]);
-void apcmd_sys_cfg_wpa_passphrase(int argc, char *argv[]);
-void apcmd_sys_cfg_group_rekey_timer(int argc, char *argv[]);
-void apcmd_coex_config_profile(int argc, char *argv[]);
-void apcmd_sta_filter_table(int argc, char *argv[]);
-void apcmd_sys_cfg_max_sta_num(int argc, char *argv[]);
-void apcmd_sys_cfg_retry_limit(int argc, char *argv[]);
-void apcmd_cfg_data(int argc, char *argv[]);
+void apcmd_sys_cfg_ap_mac_address(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_ssid(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_beacon_period(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_dtim_period(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_channel(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_scan_channels(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_rates(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_rates_ext(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_tx_power(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_bcast_ssid_ctl(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_preamble_ctl(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_antenna_ctl(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_rts_threshold(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_frag_threshold(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_radio_ctl(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_rsn_replay_prot(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_tx_data_rate(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_mcbc_data_rate(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_pkt_fwd_ctl(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_sta_ageout_timer(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_auth(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_protocol(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_wep_key(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_custom_ie(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_cipher(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_wpa_passphrase(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_group_rekey_timer(uap_dev * dev, int argc, char *argv[]);
+void apcmd_coex_config_profile(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sta_filter_table(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_max_sta_num(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_retry_limit(uap_dev * dev, int argc, char *argv[]);
+void apcmd_cfg_data(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_begin(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_commit(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_abort(uap_dev * dev, int argc, char *argv[]);
+void apcmd_sys_cfg_get(uap_dev * dev, int argc, char *argv[]);
+void apcmd_snmp_get(uap_dev * dev, int argc, char *argv[]);
+void apcmd_snmp_set(uap_dev * dev, int argc, char *argv[]);
+const char *snmp_oid_name(u16 oid);
+int snmp_counter_oids(uap_oid * oids, int max);
 #endif /* _UAP_H */
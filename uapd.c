@@ -0,0 +1,540 @@
+/** @file  uapd.c
+ *
+ *  @brief This file contains the uaputl daemon: the ap_command table
+ *  served to local clients over a UNIX domain socket.
+ *
+ * Copyright (C) 2008-2009, Marvell International Ltd.
+ *
+ * This software file (the "File") is distributed by Marvell International
+ * Ltd. under the terms of the GNU General Public License Version 2, June 1991
+ * (the "License").  You may use, redistribute and/or modify this File in
+ * accordance with the terms and conditions of the License, a copy of which
+ * is available along with the File in the gpl.txt file or by writing to
+ * the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307 or on the worldwide web at http://www.gnu.org/licenses/gpl.txt.
+ *
+ * THE FILE IS DISTRIBUTED AS-IS, WITHOUT WARRANTY OF ANY KIND, AND THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE
+ * ARE EXPRESSLY DISCLAIMED.  The License provides additional details about
+ * this warranty disclaimer.
+ *
+ */
+/****************************************************************************
+Change log:
+    10/17/26: Initial creation
+****************************************************************************/
+
+/****************************************************************************
+        Header files
+****************************************************************************/
+/** accept4() */
+#define _GNU_SOURCE
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/if.h>
+#include "uaputl.h"
+#include "uapd.h"
+
+/****************************************************************************
+        Definitions
+****************************************************************************/
+/** Maximum number of arguments in a request */
+#define UAPD_MAX_ARGS           64
+/** Number of epoll events handled per wakeup */
+#define UAPD_MAX_EVENTS         32
+/** Pending output above which a client's requests are no longer read */
+#define UAPD_MAX_PENDING        (64 * 1024)
+
+/** Client connection */
+typedef struct _uapd_client
+{
+    /** Socket */
+    int fd;
+    /** Events registered with epoll */
+    u32 events;
+    /** Close once the pending output is sent */
+    int closing;
+    /** Received, not yet processed request bytes */
+    char in[UAPD_MAX_REQUEST];
+    /** Length of in */
+    int in_len;
+    /** Responses not yet sent */
+    char *out;
+    /** Length of out */
+    size_t out_len;
+    /** Bytes of out already sent */
+    size_t out_off;
+    /** Allocated size of out */
+    size_t out_size;
+} uapd_client;
+
+/** Set by SIGINT and SIGTERM */
+static volatile sig_atomic_t uapd_stop;
+
+/** Set while the daemon loop serves clients */
+static int uapd_serving;
+
+/** Daemon counters, printed on exit */
+static u32 uapd_clients, uapd_requests, uapd_failures;
+
+/****************************************************************************
+        Local functions
+****************************************************************************/
+/**
+ *  @brief Signal handler, stops the daemon loop
+ *
+ *  @param sig      Signal number
+ *  @return         N/A
+ */
+static void
+uapd_signal(int sig)
+{
+    uapd_stop = 1;
+}
+
+/**
+ *  @brief Appends bytes to the client output
+ *
+ *  @param c        Client
+ *  @param data     Bytes to append
+ *  @param len      Number of bytes
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+uapd_append(uapd_client * c, char *data, size_t len)
+{
+    char *out;
+    size_t size;
+
+    if (c->out_off && c->out_off == c->out_len)
+        c->out_off = c->out_len = 0;
+    if (c->out_len + len > c->out_size) {
+        size = c->out_size ? c->out_size : 4096;
+        while (size < c->out_len + len)
+            size *= 2;
+        out = realloc(c->out, size);
+        if (!out)
+            return UAP_FAILURE;
+        c->out = out;
+        c->out_size = size;
+    }
+    memcpy(c->out + c->out_len, data, len);
+    c->out_len += len;
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Queues a response
+ *
+ *  @param c        Client
+ *  @param status   UAPD_STATUS_OK or UAPD_STATUS_FAIL
+ *  @param data     Command output
+ *  @param len      Length of the command output
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+uapd_respond(uapd_client * c, int status, char *data, size_t len)
+{
+    char hdr[UAPD_MAX_RESP_HDR];
+    int hdr_len;
+
+    hdr_len = snprintf(hdr, sizeof(hdr), "%d %lu\n", status,
+                       (unsigned long) len);
+    if (uapd_append(c, hdr, hdr_len) != UAP_SUCCESS)
+        return UAP_FAILURE;
+    return uapd_append(c, data, len);
+}
+
+/**
+ *  @brief Runs one request, capturing the command output
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param c        Client
+ *  @param line     Request line, without '\n'
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+uapd_request(uap_dev * dev, uapd_client * c, char *line)
+{
+    char *args[UAPD_MAX_ARGS];
+    char *text = NULL;
+    size_t text_len = 0;
+    FILE *out, *mem;
+    int argc, status, ret;
+
+    uapd_requests++;
+    argc = split_command_line(line, args, UAPD_MAX_ARGS);
+    if (argc < 0) {
+        uapd_failures++;
+        return uapd_respond(c, UAPD_STATUS_FAIL, "ERR:Too many arguments\n",
+                            strlen("ERR:Too many arguments\n"));
+    }
+    if (!argc)
+        return uapd_respond(c, UAPD_STATUS_OK, NULL, 0);
+
+    mem = open_memstream(&text, &text_len);
+    if (!mem)
+        return UAP_FAILURE;
+    fflush(stdout);
+    out = stdout;
+    stdout = mem;
+    status = (uap_run_command(dev, argc, args) == UAP_SUCCESS) ?
+        UAPD_STATUS_OK : UAPD_STATUS_FAIL;
+    stdout = out;
+    fclose(mem);
+
+    if (status != UAPD_STATUS_OK)
+        uapd_failures++;
+    ret = uapd_respond(c, status, text, text_len);
+    free(text);
+    return ret;
+}
+
+/**
+ *  @brief Runs the complete requests received from a client
+ *
+ *  Stops when the pending output is too large, the remaining requests
+ *  are run once the client has read its responses.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param c        Client
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+uapd_process(uap_dev * dev, uapd_client * c)
+{
+    char *nl;
+    int len;
+
+    while (c->out_len - c->out_off < UAPD_MAX_PENDING) {
+        nl = memchr(c->in, '\n', c->in_len);
+        if (!nl)
+            break;
+        *nl = '\0';
+        if (uapd_request(dev, c, c->in) != UAP_SUCCESS)
+            return UAP_FAILURE;
+        len = nl + 1 - c->in;
+        c->in_len -= len;
+        memmove(c->in, nl + 1, c->in_len);
+    }
+    if (c->in_len == sizeof(c->in) && !memchr(c->in, '\n', c->in_len)) {
+        /* No room left for the end of the line */
+        uapd_respond(c, UAPD_STATUS_FAIL, "ERR:Request too long\n",
+                     strlen("ERR:Request too long\n"));
+        c->in_len = 0;
+        c->closing = 1;
+    }
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Sends as much of the pending output as the socket takes
+ *
+ *  @param c        Client
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+uapd_flush(uapd_client * c)
+{
+    ssize_t n;
+
+    while (c->out_off < c->out_len) {
+        n = send(c->fd, c->out + c->out_off, c->out_len - c->out_off,
+                 MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return UAP_FAILURE;
+        }
+        c->out_off += n;
+    }
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Closes a client connection
+ *
+ *  @param epfd     epoll descriptor
+ *  @param c        Client
+ *  @return         N/A
+ */
+static void
+uapd_client_close(int epfd, uapd_client * c)
+{
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    free(c->out);
+    free(c);
+}
+
+/**
+ *  @brief Handles the events of a client connection
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param epfd     epoll descriptor
+ *  @param c        Client
+ *  @param events   Events reported by epoll
+ *  @return         UAP_SUCCESS, or UAP_FAILURE if the client was closed
+ */
+static int
+uapd_client_event(uap_dev * dev, int epfd, uapd_client * c, u32 events)
+{
+    struct epoll_event ev;
+    ssize_t n;
+    u32 want;
+
+    if (events & (EPOLLERR | EPOLLHUP))
+        c->closing = 1;
+    if ((events & EPOLLIN) && !c->closing) {
+        for (;;) {
+            n = recv(c->fd, c->in + c->in_len, sizeof(c->in) - c->in_len, 0);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                break;
+            if (n <= 0) {
+                c->closing = 1;
+                break;
+            }
+            c->in_len += n;
+            if (uapd_process(dev, c) != UAP_SUCCESS) {
+                c->closing = 1;
+                break;
+            }
+            if (c->in_len == sizeof(c->in) ||
+                c->out_len - c->out_off >= UAPD_MAX_PENDING)
+                break;
+        }
+    }
+    if (uapd_flush(c) != UAP_SUCCESS) {
+        uapd_client_close(epfd, c);
+        return UAP_FAILURE;
+    }
+    /* Requests held back while the output was pending */
+    if (!c->closing && c->out_off == c->out_len && c->in_len) {
+        if (uapd_process(dev, c) != UAP_SUCCESS ||
+            uapd_flush(c) != UAP_SUCCESS) {
+            uapd_client_close(epfd, c);
+            return UAP_FAILURE;
+        }
+    }
+    if (c->closing && c->out_off == c->out_len) {
+        uapd_client_close(epfd, c);
+        return UAP_FAILURE;
+    }
+
+    want = 0;
+    if (c->out_off < c->out_len)
+        want |= EPOLLOUT;
+    if (!c->closing && c->out_len - c->out_off < UAPD_MAX_PENDING &&
+        c->in_len < sizeof(c->in))
+        want |= EPOLLIN;
+    if (want != c->events) {
+        memset(&ev, 0, sizeof(ev));
+        ev.events = want;
+        ev.data.ptr = c;
+        epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+        c->events = want;
+    }
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Accepts the pending client connections
+ *
+ *  @param epfd     epoll descriptor
+ *  @param lfd      Listening socket
+ *  @return         N/A
+ */
+static void
+uapd_accept(int epfd, int lfd)
+{
+    struct epoll_event ev;
+    uapd_client *c;
+    int fd;
+
+    for (;;) {
+        fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                perror("accept");
+            return;
+        }
+        c = calloc(1, sizeof(uapd_client));
+        if (!c) {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->events = EPOLLIN;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = c->events;
+        ev.data.ptr = c;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            free(c);
+            continue;
+        }
+        uapd_clients++;
+    }
+}
+
+/****************************************************************************
+        Global functions
+****************************************************************************/
+/**
+ *  @brief Checks whether a command or mode may run
+ *
+ *  The daemon runs the requests of all clients one at a time, so a
+ *  watch, recorder or publisher loop would hold every other client off
+ *  and replace the daemon's SIGINT handler. A sys_cfg batch belongs to
+ *  the handle all clients share and would swallow their SETs, and stdin
+ *  is the daemon's own. These are refused while the daemon is serving.
+ *
+ *  @param what     Command or option, for the error message
+ *  @return         UAP_SUCCESS if the mode may start, else UAP_FAILURE
+ */
+int
+uapd_allowed(char *what)
+{
+    if (!uapd_serving)
+        return UAP_SUCCESS;
+    printf("ERR:%s is not available through the daemon\n", what);
+    return UAP_FAILURE;
+}
+
+/**
+ *  @brief Creates a listening UNIX domain socket
+ *
+ *  A path left by a daemon that is no longer running is replaced.
+ *
+ *  @param path     Socket path
+ *  @return         Socket descriptor, or -1 on error
+ */
+int
+uapd_listen(char *path)
+{
+    struct sockaddr_un addr;
+    mode_t mask;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        printf("ERR:Socket path too long: %s\n", path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    /* A daemon still answering owns the path, otherwise it is stale */
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0) {
+        printf("ERR:A daemon is already listening on %s\n", path);
+        close(fd);
+        return -1;
+    }
+    unlink(path);
+    mask = umask(007);
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        perror("bind");
+        umask(mask);
+        close(fd);
+        return -1;
+    }
+    umask(mask);
+    if (listen(fd, SOMAXCONN) < 0) {
+        perror("listen");
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ *  @brief Serves the ap_command table on a UNIX domain socket
+ *
+ *  Runs in the foreground until SIGINT or SIGTERM. All clients share
+ *  the device handle; their requests are run one at a time, in the
+ *  order they arrive. Modes that do not return on their own and sys_cfg
+ *  batches are refused (see uapd_allowed).
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param path     Socket path
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+int
+uapd_run(uap_dev * dev, char *path)
+{
+    struct epoll_event ev, events[UAPD_MAX_EVENTS];
+    struct sigaction sa;
+    int lfd, epfd, n, i;
+
+    lfd = uapd_listen(path);
+    if (lfd < 0)
+        return UAP_FAILURE;
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        perror("epoll_create1");
+        close(lfd);
+        unlink(path);
+        return UAP_FAILURE;
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, lfd, &ev);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = uapd_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("uaputl daemon on %s, interface %s\n", path, dev->name);
+    fflush(stdout);
+    uapd_serving = 1;
+    while (!uapd_stop) {
+        n = epoll_wait(epfd, events, UAPD_MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait");
+            break;
+        }
+        for (i = 0; i < n; i++) {
+            if (!events[i].data.ptr)
+                uapd_accept(epfd, lfd);
+            else
+                uapd_client_event(dev, epfd, events[i].data.ptr,
+                                  events[i].events);
+        }
+    }
+
+    uapd_serving = 0;
+    /* Open client connections are dropped with the process */
+    close(epfd);
+    close(lfd);
+    unlink(path);
+    printf("uaputl daemon: %lu clients, %lu requests, %lu failed\n",
+           uapd_clients, uapd_requests, uapd_failures);
+    return UAP_SUCCESS;
+}
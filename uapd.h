@@ -0,0 +1,52 @@
+/** @file  uapd.h
+ *
+ *  @brief Request protocol of the uaputl daemon, shared by the daemon
+ *  and its clients
+ *
+ * Copyright (C) 2008-2009, Marvell International Ltd.
+ *
+ * This software file (the "File") is distributed by Marvell International
+ * Ltd. under the terms of the GNU General Public License Version 2, June 1991
+ * (the "License").  You may use, redistribute and/or modify this File in
+ * accordance with the terms and conditions of the License, a copy of which
+ * is available along with the File in the gpl.txt file or by writing to
+ * the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307 or on the worldwide web at http://www.gnu.org/licenses/gpl.txt.
+ *
+ * THE FILE IS DISTRIBUTED AS-IS, WITHOUT WARRANTY OF ANY KIND, AND THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE
+ * ARE EXPRESSLY DISCLAIMED.  The License provides additional details about
+ * this warranty disclaimer.
+ *
+ */
+/************************************************************************
+Change log:
+    10/17/26: Initial creation
+************************************************************************/
+
+#ifndef _UAPD_H
+#define _UAPD_H
+
+/*
+ * A request is one line, terminated by '\n', holding a command and its
+ * parameters exactly as given on the uaputl command line.  Parameters
+ * may be quoted with ' or ".  An empty line is a no-op request.
+ *
+ * A response is a header line "<status> <length>\n", status 0 for
+ * success and 1 for failure, followed by <length> bytes of the command
+ * output.  Responses are sent in request order, so a client may
+ * pipeline requests.
+ */
+
+/** Default daemon socket */
+#define UAPD_DEFAULT_SOCKET     "/var/run/uaputl.sock"
+/** Maximum request line length, including '\n' */
+#define UAPD_MAX_REQUEST        1024
+/** Maximum response header length */
+#define UAPD_MAX_RESP_HDR       32
+/** Response status: success */
+#define UAPD_STATUS_OK          0
+/** Response status: failure */
+#define UAPD_STATUS_FAIL        1
+
+#endif /* _UAPD_H */
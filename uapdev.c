@@ -0,0 +1,1520 @@
+/** @file  uapdev.c
+ *
+ *  @brief This file contains the uAP device handle and the transport
+ *  backends used to send commands to the driver.
+ *
+ * Copyright (C) 2008-2009, Marvell International Ltd.
+ *
+ * This software file (the "File") is distributed by Marvell International
+ * Ltd. under the terms of the GNU General Public License Version 2, June 1991
+ * (the "License").  You may use, redistribute and/or modify this File in
+ * accordance with the terms and conditions of the License, a copy of which
+ * is available along with the File in the gpl.txt file or by writing to
+ * the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307 or on the worldwide web at http://www.gnu.org/licenses/gpl.txt.
+ *
+ * THE FILE IS DISTRIBUTED AS-IS, WITHOUT WARRANTY OF ANY KIND, AND THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE
+ * ARE EXPRESSLY DISCLAIMED.  The License provides additional details about
+ * this warranty disclaimer.
+ *
+ */
+/****************************************************************************
+Change log:
+    10/17/26: Initial creation, uap_ioctl moved here from uaputl.c
+****************************************************************************/
+
+/****************************************************************************
+        Header files
+****************************************************************************/
+#include <sys/types.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <linux/if.h>
+#include <sys/ioctl.h>
+#include "uaputl.h"
+
+/****************************************************************************
+        Local functions
+****************************************************************************/
+/**
+ *  @brief Opens the control socket of the ioctl backend
+ *
+ *  The control socket and the ifreq are set up here once, so that
+ *  every command sent through the handle costs a single ioctl.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param arg      Unused
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+ioctl_open(uap_dev * dev, char *arg)
+{
+    /* Open socket */
+    if ((dev->sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+        uap_dev_error(dev, UAP_ERR_NODEV, "Cannot open socket");
+        return UAP_FAILURE;
+    }
+    /* Initialize the ifr structure */
+    strncpy(dev->ifr.ifr_ifrn.ifrn_name, dev->name, IFNAMSIZ);
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Sends a host command through the UAPHOSTCMD ioctl
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param buf      Command buffer, overwritten with the response
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+ioctl_cmd(uap_dev * dev, u8 * buf)
+{
+    struct ifreq ifr = dev->ifr;
+    int err;
+
+    ifr.ifr_ifru.ifru_data = (void *) buf;
+    /* Perform ioctl */
+    errno = 0;
+    if (ioctl(dev->sockfd, UAPHOSTCMD, &ifr)) {
+        err = errno;
+        uap_dev_error(dev, UAP_ERR_IO, "UAPHOSTCMD %s %s: %s",
+                      (err == ENOTTY || err == EOPNOTSUPP) ?
+                      "is not supported by" : "failed on", dev->name,
+                      strerror(err));
+        errno = err;
+        return UAP_FAILURE;
+    }
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Performs the UAP_POWER_MODE ioctl
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param pm       A pointer to ps_mgmt structure
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+ioctl_power_mode(uap_dev * dev, ps_mgmt * pm)
+{
+    struct ifreq ifr = dev->ifr;
+    int err;
+
+    ifr.ifr_ifru.ifru_data = (void *) pm;
+    /* Perform ioctl */
+    errno = 0;
+    if (ioctl(dev->sockfd, UAP_POWER_MODE, &ifr)) {
+        err = errno;
+        uap_dev_error(dev, UAP_ERR_IO, "UAP_POWER_MODE %s %s: %s",
+                      (err == ENOTTY || err == EOPNOTSUPP) ?
+                      "is not supported by" : "failed on", dev->name,
+                      strerror(err));
+        errno = err;
+        return UAP_FAILURE;
+    }
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Closes the control socket of the ioctl backend
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @return         N/A
+ */
+static void
+ioctl_close(uap_dev * dev)
+{
+    /* Close socket */
+    close(dev->sockfd);
+}
+
+/** Driver ioctl backend */
+static uap_transport ioctl_transport = {
+    "ioctl",
+    ioctl_open,
+    ioctl_cmd,
+    ioctl_power_mode,
+    ioctl_close,
+    1
+};
+
+/** Known transport backends, the first one is the default */
+static uap_transport *transports[] = {
+    &ioctl_transport,
+    &uap_sim_transport,
+    &uap_replay_transport,
+    NULL
+};
+
+/** Host command names */
+static struct
+{
+    /** Command code */
+    u16 cmd_code;
+    /** Name */
+    char *name;
+} cmd_names[] = {
+    {APCMD_SYS_INFO, "SYS_INFO"},
+    {APCMD_SYS_RESET, "SYS_RESET"},
+    {APCMD_SYS_CONFIGURE, "SYS_CONFIGURE"},
+    {APCMD_BSS_START, "BSS_START"},
+    {APCMD_BSS_STOP, "BSS_STOP"},
+    {APCMD_STA_LIST, "STA_LIST"},
+    {APCMD_STA_DEAUTH, "STA_DEAUTH"},
+    {HostCmd_SNMP_MIB, "SNMP_MIB"},
+    {HostCmd_CMD_MAC_REG_ACCESS, "MAC_REG_ACCESS"},
+    {HostCmd_CMD_BBP_REG_ACCESS, "BBP_REG_ACCESS"},
+    {HostCmd_CMD_RF_REG_ACCESS, "RF_REG_ACCESS"},
+    {HostCmd_EEPROM_ACCESS, "EEPROM_ACCESS"},
+    {HostCmd_CMD_MEM_ACCESS, "MEM_ACCESS"},
+    {HostCmd_CMD_802_11D_DOMAIN_INFO, "802_11D_DOMAIN_INFO"},
+    {HostCmd_CMD_CFG_DATA, "CFG_DATA"},
+    {APCMD_SYS_DEBUG, "SYS_DEBUG"},
+    {HostCmd_ROBUST_COEX, "ROBUST_COEX"},
+    {0, NULL}
+};
+
+/**
+ *  @brief Returns the histogram bucket of a latency
+ *
+ *  Latencies below 8 ns have a bucket each, longer ones are split in 8
+ *  buckets per power of two, so a bucket is within 12.5% of its values.
+ *
+ *  @param ns       Latency in ns
+ *  @return         Bucket index
+ */
+static int
+timing_bucket(u64 ns)
+{
+    int msb;
+
+    if (ns < (1 << UAP_TIMING_SUB_BITS))
+        return ns;
+    if (ns >= (1ULL << UAP_TIMING_MAX_BITS))
+        ns = (1ULL << UAP_TIMING_MAX_BITS) - 1;
+    msb = 63 - __builtin_clzll(ns);
+    return ((msb - UAP_TIMING_SUB_BITS + 1) << UAP_TIMING_SUB_BITS) +
+        ((ns >> (msb - UAP_TIMING_SUB_BITS)) &
+         ((1 << UAP_TIMING_SUB_BITS) - 1));
+}
+
+/**
+ *  @brief Returns the middle of a histogram bucket
+ *
+ *  @param bucket   Bucket index
+ *  @return         Latency in ns
+ */
+static u64
+timing_bucket_ns(int bucket)
+{
+    int shift;
+    u64 low;
+
+    if (bucket < (1 << UAP_TIMING_SUB_BITS))
+        return bucket;
+    shift = (bucket >> UAP_TIMING_SUB_BITS) - 1;
+    low = (u64) ((1 << UAP_TIMING_SUB_BITS) +
+                 (bucket & ((1 << UAP_TIMING_SUB_BITS) - 1))) << shift;
+    return low + ((1ULL << shift) >> 1);
+}
+
+/**
+ *  @brief Records the latency of a request, with dev->lock held
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param type     UAP_TRACE_HOSTCMD or UAP_TRACE_POWER_MODE
+ *  @param cmd_code Command code
+ *  @param status   Transport status
+ *  @param ns       Round trip latency in ns, retries included
+ *  @param retries  Number of attempts retried
+ *  @param timeouts Number of attempts past their deadline
+ *  @return         N/A
+ */
+static void
+timing_record(uap_dev * dev, u8 type, u16 cmd_code, int status, u64 ns,
+              u32 retries, u32 timeouts)
+{
+    uap_timing *t;
+    int i;
+
+    if (!dev->timing) {
+        dev->timing = (uap_timing *) calloc(UAP_TIMING_CMDS,
+                                            sizeof(uap_timing));
+        if (!dev->timing)
+            return;
+    }
+    for (i = 0; i < dev->timing_cmds; i++) {
+        if (dev->timing[i].type == type && dev->timing[i].cmd_code == cmd_code)
+            break;
+    }
+    if (i == dev->timing_cmds) {
+        if (i == UAP_TIMING_CMDS)
+            return;
+        dev->timing_cmds++;
+        dev->timing[i].type = type;
+        dev->timing[i].cmd_code = cmd_code;
+    }
+    t = &dev->timing[i];
+    t->retries += retries;
+    t->timeouts += timeouts;
+    if (status != UAP_SUCCESS) {
+        t->errors++;
+        return;
+    }
+    if (!t->count || ns < t->min_ns)
+        t->min_ns = ns;
+    if (ns > t->max_ns)
+        t->max_ns = ns;
+    t->count++;
+    t->total_ns += ns;
+    t->hist[timing_bucket(ns)]++;
+}
+
+/**
+ *  @brief Returns a nearest rank latency percentile from a histogram
+ *
+ *  @param t        A pointer to uap_timing structure
+ *  @param pct      Percentile, 0 to 100
+ *  @return         Latency in ns
+ */
+static u64
+timing_percentile(uap_timing * t, int pct)
+{
+    /* ceil(count * pct / 100), counted from 0 */
+    u32 rank = (u32) (((u64) t->count * pct + 99) / 100), seen = 0;
+    u64 ns;
+    int i;
+
+    if (rank)
+        rank--;
+
+    for (i = 0; i < UAP_TIMING_BUCKETS; i++) {
+        seen += t->hist[i];
+        if (seen > rank)
+            break;
+    }
+    ns = timing_bucket_ns(i);
+    if (ns < t->min_ns)
+        ns = t->min_ns;
+    return MIN(ns, t->max_ns);
+}
+
+/**
+ *  @brief Gives a host command its sequence number and puts it in flight,
+ *  with dev->lock held
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param req      Completion object of the request
+ *  @param cmd_code Command code
+ *  @return         N/A
+ */
+static void
+req_submit(uap_dev * dev, uap_req * req, u16 cmd_code)
+{
+    /* SeqNum 0 is what a firmware that does not echo it returns, it is
+       never sent so that such responses are not taken for a mismatch */
+    if (!++dev->seq_num)
+        dev->seq_num++;
+    req->seq_num = dev->seq_num;
+    req->cmd_code = cmd_code;
+    req->next = dev->inflight;
+    dev->inflight = req;
+    if (++dev->inflight_num > dev->inflight_peak)
+        dev->inflight_peak = dev->inflight_num;
+}
+
+/**
+ *  @brief Takes a completed host command out of flight, with dev->lock
+ *  held
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param req      Completion object of the request
+ *  @return         N/A
+ */
+static void
+req_complete(uap_dev * dev, uap_req * req)
+{
+    uap_req **p;
+
+    for (p = &dev->inflight; *p; p = &(*p)->next) {
+        if (*p == req) {
+            *p = req->next;
+            dev->inflight_num--;
+            break;
+        }
+    }
+}
+
+/**
+ *  @brief Handler of UAP_DEADLINE_SIGNAL, its delivery interrupts the
+ *  blocked request
+ *
+ *  @param sig      Signal number
+ *  @return         N/A
+ */
+static void
+deadline_handler(int sig)
+{
+}
+
+/** Installs deadline_handler once per process */
+static pthread_once_t deadline_once = PTHREAD_ONCE_INIT;
+
+/**
+ *  @brief Installs the handler of UAP_DEADLINE_SIGNAL
+ *
+ *  @return         N/A
+ */
+static void
+deadline_init(void)
+{
+    struct sigaction sa;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = deadline_handler;
+    sigemptyset(&sa.sa_mask);
+    /* No SA_RESTART, the blocked ioctl must return EINTR */
+    sigaction(UAP_DEADLINE_SIGNAL, &sa, NULL);
+}
+
+/**
+ *  @brief Arms a timer signalling the calling thread at a deadline
+ *
+ *  @param timer      Returns the timer, to be deleted by the caller
+ *  @param timeout_ms Deadline in ms
+ *  @return           UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+deadline_arm(timer_t * timer, u32 timeout_ms)
+{
+    struct sigevent sev;
+    struct itimerspec its;
+
+    pthread_once(&deadline_once, deadline_init);
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_signo = UAP_DEADLINE_SIGNAL;
+    sev._sigev_un._tid = syscall(SYS_gettid);
+    if (timer_create(CLOCK_MONOTONIC, &sev, timer) < 0)
+        return UAP_FAILURE;
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = timeout_ms / 1000;
+    its.it_value.tv_nsec = (timeout_ms % 1000) * 1000000;
+    if (timer_settime(*timer, 0, &its, NULL) < 0) {
+        timer_delete(*timer);
+        return UAP_FAILURE;
+    }
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Returns the deadline of a request
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param type     UAP_TRACE_HOSTCMD or UAP_TRACE_POWER_MODE
+ *  @param cmd_code Command code
+ *  @return         Deadline of one attempt in ms, 0 for none
+ */
+static u32
+request_timeout(uap_dev * dev, u8 type, u16 cmd_code)
+{
+    int i;
+
+    if (type == UAP_TRACE_HOSTCMD) {
+        for (i = 0; i < dev->timeout_cmds; i++) {
+            if (dev->cmd_timeouts[i].cmd_code == cmd_code)
+                return dev->cmd_timeouts[i].timeout_ms;
+        }
+    }
+    return dev->timeout_ms;
+}
+
+/**
+ *  @brief Passes one attempt of a request to the transport
+ *
+ *  An attempt still blocked at its deadline is interrupted by
+ *  UAP_DEADLINE_SIGNAL and fails with errno set to ETIMEDOUT.
+ *
+ *  @param dev        A pointer to uap_dev structure
+ *  @param type       UAP_TRACE_HOSTCMD or UAP_TRACE_POWER_MODE
+ *  @param data       Command buffer or ps_mgmt structure
+ *  @param timeout_ms Deadline in ms, 0 for none
+ *  @return           UAP_SUCCESS or UAP_FAILURE, errno set on failure
+ */
+static int
+request_attempt(uap_dev * dev, u8 type, void *data, u32 timeout_ms)
+{
+    timer_t timer;
+    u64 start_ns = 0;
+    int armed = 0, ret, err;
+
+    if (!dev->ops->concurrent)
+        pthread_mutex_lock(&dev->xfer_lock);
+    if (timeout_ms) {
+        start_ns = uap_time_ns();
+        armed = (deadline_arm(&timer, timeout_ms) == UAP_SUCCESS);
+    }
+    errno = 0;
+    if (type == UAP_TRACE_HOSTCMD)
+        ret = dev->ops->cmd(dev, (u8 *) data);
+    else
+        ret = dev->ops->power_mode(dev, (ps_mgmt *) data);
+    err = errno;
+    if (armed) {
+        timer_delete(timer);
+        if (ret != UAP_SUCCESS && err == EINTR &&
+            uap_time_ns() - start_ns >= timeout_ms * 1000000ULL)
+            err = ETIMEDOUT;
+    }
+    if (!dev->ops->concurrent)
+        pthread_mutex_unlock(&dev->xfer_lock);
+    errno = err;
+    return ret;
+}
+
+/**
+ *  @brief Runs a request under its deadline, retrying transient failures
+ *
+ *  EBUSY and EAGAIN are retried up to dev->retries times, after waiting
+ *  dev->backoff_ms, doubled for each next retry up to UAP_BACKOFF_MAX_MS.
+ *  ETIMEDOUT is only retried with dev->retry_timeouts set: the driver
+ *  may have queued the interrupted command, which then runs twice.
+ *  The request is restored from its copy before a retry, as a failed
+ *  attempt may have overwritten it.  Only the final failure is reported.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param type     UAP_TRACE_HOSTCMD or UAP_TRACE_POWER_MODE
+ *  @param cmd_code Command code
+ *  @param data     Command buffer or ps_mgmt structure
+ *  @param copy     Copy of the request, NULL to make a single attempt
+ *  @param len      Length of the copy
+ *  @param retries  Returns the number of attempts retried
+ *  @param timeouts Returns the number of attempts past their deadline
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+request_run(uap_dev * dev, u8 type, u16 cmd_code, void *data, u8 * copy,
+            u16 len, u32 * retries, u32 * timeouts)
+{
+    uap_err_state *st = uap_dev_err_state(dev);
+    u32 timeout_ms = request_timeout(dev, type, cmd_code);
+    u32 backoff_ms = dev->backoff_ms;
+    char msg[UAP_ERRMSG_LEN];
+    char code[8];
+    char *name;
+    int ret, err, attempt;
+
+    *retries = *timeouts = 0;
+    for (attempt = 0;; attempt++) {
+        st->last_err = UAP_OK;
+        st->errmsg[0] = '\0';
+        st->quiet = 1;
+        ret = request_attempt(dev, type, data, timeout_ms);
+        err = errno;
+        st->quiet = 0;
+        if (ret == UAP_SUCCESS)
+            return UAP_SUCCESS;
+        if (err == ETIMEDOUT)
+            (*timeouts)++;
+        if ((err != EBUSY && err != EAGAIN &&
+             (err != ETIMEDOUT || !dev->retry_timeouts)) || !copy ||
+            attempt >= dev->retries)
+            break;
+        (*retries)++;
+        usleep(backoff_ms * 1000);
+        backoff_ms *= 2;
+        if (backoff_ms > UAP_BACKOFF_MAX_MS)
+            backoff_ms = UAP_BACKOFF_MAX_MS;
+        memcpy(data, copy, len);
+    }
+
+    name = (type == UAP_TRACE_POWER_MODE) ? "POWER_MODE" :
+        uap_cmd_name(cmd_code);
+    if (!name) {
+        snprintf(code, sizeof(code), "0x%04x", cmd_code);
+        name = code;
+    }
+    if (err == ETIMEDOUT && timeout_ms)
+        snprintf(msg, sizeof(msg), "%s timed out after %lu ms", name,
+                 timeout_ms);
+    else if (st->errmsg[0])
+        snprintf(msg, sizeof(msg), "%s", st->errmsg);
+    else
+        snprintf(msg, sizeof(msg), "%s failed: %s", name,
+                 err ? strerror(err) : uap_strerror(UAP_ERR_IO));
+    if (err == ETIMEDOUT)
+        st->last_err = UAP_ERR_TIMEOUT;
+    else if (!st->last_err)
+        st->last_err = UAP_ERR_IO;
+    if (attempt)
+        uap_dev_error(dev, st->last_err, "%s, %d attempts", msg, attempt + 1);
+    else
+        uap_dev_error(dev, st->last_err, "%s", msg);
+    return UAP_FAILURE;
+}
+
+/**
+ *  @brief Sends a host command through the transport
+ *
+ *  @param dev           A pointer to uap_dev structure
+ *  @param cmd        	 Pointer to the command buffer
+ *  @param size          Pointer to the command size. This value is
+ *                       overwritten by the function with the size of the
+ *                       received response.
+ *  @param buf_size 	 Size of the allocated command buffer
+ *  @return              UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+ioctl_send(uap_dev * dev, u8 * cmd, u16 * size, u16 buf_size)
+{
+    APCMDBUF *header = NULL;
+    u8 req[MRVDRV_SIZE_OF_CMD_BUFFER];
+    u16 req_len = 0, resp_len = 0, cmd_code, resp_code, resp_seq;
+    u64 start_ns, end_ns;
+    uap_req pending;
+    u32 retries, timeouts;
+    int ret;
+
+    *(u32 *) cmd = buf_size - BUF_HEADER_SIZE;
+
+    header = (APCMDBUF *) cmd;
+    cmd_code = header->CmdCode;
+    header->Size = *size - BUF_HEADER_SIZE;
+    if (header->CmdCode == APCMD_SYS_CONFIGURE) {
+        APCMDBUF_SYS_CONFIGURE *sys_cfg;
+        sys_cfg = (APCMDBUF_SYS_CONFIGURE *) cmd;
+        sys_cfg->Action = uap_cpu_to_le16(sys_cfg->Action);
+    }
+    pthread_mutex_lock(&dev->lock);
+    dev->cmd_count++;
+    req_submit(dev, &pending, cmd_code);
+    pthread_mutex_unlock(&dev->lock);
+    header->SeqNum = pending.seq_num;
+    endian_convert_request_header(header);
+    /* Dump request buffer */
+    if (dev->debug >= MSG_ALL)
+        hexdump_data("Request buffer", (void *) cmd, *size, ' ');
+    if (dev->trace || dev->retries) {
+        req_len = MIN(*size, sizeof(req));
+        memcpy(req, cmd, req_len);
+    }
+
+    start_ns = uap_time_ns();
+    ret = request_run(dev, UAP_TRACE_HOSTCMD, cmd_code, cmd,
+                      dev->retries ? req : NULL, req_len, &retries,
+                      &timeouts);
+    end_ns = uap_time_ns();
+
+    pthread_mutex_lock(&dev->lock);
+    req_complete(dev, &pending);
+    dev->retry_count += retries;
+    dev->timeout_count += timeouts;
+    timing_record(dev, UAP_TRACE_HOSTCMD, cmd_code, ret, end_ns - start_ns,
+                  retries, timeouts);
+    if (dev->trace) {
+        if (ret == UAP_SUCCESS)
+            resp_len = MIN(uap_le16_to_cpu(header->Size) + BUF_HEADER_SIZE,
+                           buf_size);
+        uap_trace_record(dev, UAP_TRACE_HOSTCMD, ret, req, req_len, cmd,
+                         resp_len, buf_size, start_ns, end_ns);
+    }
+    if (ret != UAP_SUCCESS) {
+        dev->err_count++;
+        pthread_mutex_unlock(&dev->lock);
+        return UAP_FAILURE;
+    }
+    resp_code = uap_le16_to_cpu(header->CmdCode);
+    resp_seq = uap_le16_to_cpu(header->SeqNum);
+    /* SeqNum 0: not echoed, the command code and response bit still are */
+    if ((resp_seq && resp_seq != pending.seq_num) ||
+        (resp_code & HostCmd_CMD_ID_MASK) != (cmd_code & HostCmd_CMD_ID_MASK)
+        || !(resp_code & APCMD_RESP_CHECK)) {
+        dev->err_count++;
+        pthread_mutex_unlock(&dev->lock);
+        uap_dev_error(dev, UAP_ERR_PROTO,
+                      "Response 0x%04x seq %d does not match command 0x%04x "
+                      "seq %d", resp_code, resp_seq, cmd_code,
+                      pending.seq_num);
+        return UAP_FAILURE;
+    }
+    if (uap_le16_to_cpu(header->Result) != CMD_SUCCESS)
+        dev->fw_err_count++;
+    pthread_mutex_unlock(&dev->lock);
+
+    endian_convert_response_header(header);
+    header->CmdCode &= HostCmd_CMD_ID_MASK;
+    header->CmdCode |= APCMD_RESP_CHECK;
+    *size = header->Size;
+    uap_dev_err_state(dev)->fw_result = header->Result;
+
+    /* Validate response size */
+    if (*size > (buf_size - BUF_HEADER_SIZE)) {
+        uap_dev_error(dev, UAP_ERR_PROTO,
+                      "Response size (%d) greater than buffer size (%d)! "
+                      "Aborting!", *size, buf_size);
+        return UAP_FAILURE;
+    }
+    /* Dump respond buffer */
+    if (dev->debug >= MSG_ALL)
+        hexdump_data("Respond buffer", (void *) header,
+                     header->Size + BUF_HEADER_SIZE, ' ');
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Moves the held back sys_cfg TLVs into one SET command
+ *
+ *  Called with dev->lock held, the command is sent by cfg_batch_send()
+ *  once the lock is released.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param buf      Command buffer of MRVDRV_SIZE_OF_CMD_BUFFER bytes
+ *  @param len      Returns the command length
+ *  @return         1 if there was anything held back, else 0
+ */
+static int
+cfg_batch_take(uap_dev * dev, u8 * buf, u16 * len)
+{
+    APCMDBUF_SYS_CONFIGURE *cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buf;
+
+    if (!dev->cfg_len)
+        return 0;
+    memset(cmd_buf, 0, sizeof(APCMDBUF_SYS_CONFIGURE));
+    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
+    cmd_buf->Action = ACTION_SET;
+    memcpy(buf + sizeof(APCMDBUF_SYS_CONFIGURE), dev->cfg_batch,
+           dev->cfg_len);
+    *len = sizeof(APCMDBUF_SYS_CONFIGURE) + dev->cfg_len;
+    dev->cfg_len = 0;
+    dev->cfg_cmds++;
+    return 1;
+}
+
+/**
+ *  @brief Sends a SET command built by cfg_batch_take()
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param buf      Command buffer of MRVDRV_SIZE_OF_CMD_BUFFER bytes
+ *  @param len      Command length
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+cfg_batch_send(uap_dev * dev, u8 * buf, u16 len)
+{
+    APCMDBUF_SYS_CONFIGURE *cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buf;
+
+    if (ioctl_send(dev, buf, &len, MRVDRV_SIZE_OF_CMD_BUFFER) != UAP_SUCCESS)
+        return UAP_FAILURE;
+    if (cmd_buf->Result != CMD_SUCCESS) {
+        uap_dev_error(dev, UAP_ERR_FW, "sys_cfg batch rejected, result %d",
+                      cmd_buf->Result);
+        return UAP_FAILURE;
+    }
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Sends the held back sys_cfg TLVs as one SET command
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+cfg_batch_flush(uap_dev * dev)
+{
+    u8 buf[MRVDRV_SIZE_OF_CMD_BUFFER];
+    u16 len;
+    int taken;
+
+    pthread_mutex_lock(&dev->lock);
+    taken = cfg_batch_take(dev, buf, &len);
+    pthread_mutex_unlock(&dev->lock);
+    if (!taken)
+        return UAP_SUCCESS;
+    return cfg_batch_send(dev, buf, len);
+}
+
+/**
+ *  @brief Checks whether a command must see the held back TLVs
+ *
+ *  Any command other than a sys_cfg GET is ordered after the batch.
+ *  A GET only waits for it when it asks for a tag held back, or for
+ *  the whole configuration. Called with dev->lock held.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param cmd      Command buffer, header in CPU order, TLVs little endian
+ *  @param size     Command length
+ *  @return         1 if the batch has to be sent first, else 0
+ */
+static int
+cfg_batch_conflicts(uap_dev * dev, u8 * cmd, u16 size)
+{
+    APCMDBUF_SYS_CONFIGURE *cmd_buf = (APCMDBUF_SYS_CONFIGURE *) cmd;
+    TLVBUF_HEADER *tlv, *held;
+    int off, held_off;
+
+    if (!dev->cfg_len)
+        return 0;
+    if (cmd_buf->CmdCode != APCMD_SYS_CONFIGURE)
+        return 1;
+    off = sizeof(APCMDBUF_SYS_CONFIGURE);
+    if (off + sizeof(TLVBUF_HEADER) > size)
+        return 1;
+    for (; off + sizeof(TLVBUF_HEADER) <= size;
+         off += sizeof(TLVBUF_HEADER) + uap_le16_to_cpu(tlv->Len)) {
+        tlv = (TLVBUF_HEADER *) (cmd + off);
+        for (held_off = 0; held_off < dev->cfg_len;
+             held_off += sizeof(TLVBUF_HEADER) + uap_le16_to_cpu(held->Len)) {
+            held = (TLVBUF_HEADER *) (dev->cfg_batch + held_off);
+            if (held->Type == tlv->Type)
+                return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ *  @brief Holds back the TLVs of a sys_cfg SET in the open batch
+ *
+ *  The request is answered at once with a success response echoing it,
+ *  the firmware sees the TLVs when the batch is sent. Without an open
+ *  batch the request is sent as is.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param cmd      Command buffer, header in CPU order, TLVs little endian
+ *  @param size     Pointer to the command size, set to the response size
+ *  @param buf_size Size of the allocated command buffer
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+cfg_batch_add(uap_dev * dev, u8 * cmd, u16 * size, u16 buf_size)
+{
+    APCMDBUF *header = (APCMDBUF *) cmd;
+    u16 len = *size - sizeof(APCMDBUF_SYS_CONFIGURE);
+    u8 buf[MRVDRV_SIZE_OF_CMD_BUFFER];
+    u16 buf_len;
+
+    pthread_mutex_lock(&dev->lock);
+    /* Make room, the lock is not held while the full batch is sent */
+    while (dev->cfg_batch && dev->cfg_len + len > UAP_CFG_BATCH_ROOM &&
+           cfg_batch_take(dev, buf, &buf_len)) {
+        pthread_mutex_unlock(&dev->lock);
+        if (cfg_batch_send(dev, buf, buf_len) != UAP_SUCCESS)
+            return UAP_FAILURE;
+        pthread_mutex_lock(&dev->lock);
+    }
+    if (!dev->cfg_batch) {
+        pthread_mutex_unlock(&dev->lock);
+        return ioctl_send(dev, cmd, size, buf_size);
+    }
+    if (len > UAP_CFG_BATCH_ROOM) {
+        /* Too large to share a command, send it on its own */
+        dev->cfg_cmds++;
+        pthread_mutex_unlock(&dev->lock);
+        return ioctl_send(dev, cmd, size, buf_size);
+    }
+    memcpy(dev->cfg_batch + dev->cfg_len, cmd + sizeof(APCMDBUF_SYS_CONFIGURE),
+           len);
+    dev->cfg_len += len;
+    dev->cfg_sets++;
+    pthread_mutex_unlock(&dev->lock);
+
+    header->CmdCode |= APCMD_RESP_CHECK;
+    header->Result = CMD_SUCCESS;
+    header->Size = *size - BUF_HEADER_SIZE;
+    *size = header->Size;
+    return UAP_SUCCESS;
+}
+
+/** Messages of the UAP_ERR_ codes, by negated code */
+static const char *err_names[] = {
+    "Success",
+    "Invalid argument",
+    "Out of memory",
+    "Cannot open interface",
+    "Request failed",
+    "Firmware returned a failure",
+    "Malformed response",
+    "Request timed out",
+    "In use by a running process",
+};
+
+/****************************************************************************
+        Global functions
+****************************************************************************/
+/**
+ *  @brief Records the failure of a request on a handle
+ *
+ *  The message is printed as "ERR:<message>" on handles opened with
+ *  UAP_OPEN_VERBOSE.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param err      UAP_ERR_ code
+ *  @param fmt      printf format string, followed by optional arguments
+ *  @return         err
+ */
+int
+uap_dev_error(uap_dev * dev, int err, char *fmt, ...)
+{
+    uap_err_state *st = uap_dev_err_state(dev);
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(st->errmsg, sizeof(st->errmsg), fmt, ap);
+    va_end(ap);
+    st->last_err = err;
+    if ((dev->flags & UAP_OPEN_VERBOSE) && !st->quiet)
+        printf("ERR:%s\n", st->errmsg);
+    return err;
+}
+
+/**
+ *  @brief Returns the error state of the calling thread on a handle
+ *
+ *  Threads sharing a handle each see the outcome of their own requests.
+ *  The thread that opened the handle uses the state in the handle.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @return         Error state
+ */
+uap_err_state *
+uap_dev_err_state(uap_dev * dev)
+{
+    uap_err_state *st;
+
+    if (pthread_equal(pthread_self(), dev->owner))
+        return &dev->err;
+    st = (uap_err_state *) pthread_getspecific(dev->err_key);
+    if (st)
+        return st;
+    st = (uap_err_state *) calloc(1, sizeof(uap_err_state));
+    if (!st || pthread_setspecific(dev->err_key, st)) {
+        free(st);
+        return &dev->err;
+    }
+    return st;
+}
+
+/**
+ *  @brief Opens the control context of a uAP interface
+ *
+ *  @param devp       Returns a pointer to uap_dev structure, NULL on error
+ *  @param name       Interface name
+ *  @param transport  Backend as "name[:arg]", NULL for the driver ioctl
+ *  @param flags      UAP_OPEN_ flags
+ *  @return           UAP_OK or a UAP_ERR_ code
+ */
+int
+uap_open(uap_dev ** devp, const char *name, const char *transport, int flags)
+{
+    uap_dev *dev = NULL;
+    char *arg = NULL;
+    int i, len, ret;
+
+    *devp = NULL;
+    if (!name || strlen(name) >= IFNAMSIZ) {
+        if (flags & UAP_OPEN_VERBOSE)
+            printf("ERR:Interface name %s is too long\n", name);
+        return UAP_ERR_INVAL;
+    }
+    dev = (uap_dev *) malloc(sizeof(uap_dev));
+    if (!dev) {
+        if (flags & UAP_OPEN_VERBOSE)
+            printf("ERR:Cannot allocate device handle!\n");
+        return UAP_ERR_NOMEM;
+    }
+    memset(dev, 0, sizeof(uap_dev));
+    strncpy(dev->name, name, IFNAMSIZ);
+    dev->flags = flags;
+    dev->sockfd = -1;
+    dev->owner = pthread_self();
+    if (pthread_key_create(&dev->err_key, free)) {
+        if (flags & UAP_OPEN_VERBOSE)
+            printf("ERR:Cannot allocate device handle!\n");
+        free(dev);
+        return UAP_ERR_NOMEM;
+    }
+
+    /* Look up the backend */
+    if (!transport)
+        transport = transports[0]->name;
+    arg = strchr(transport, ':');
+    len = arg ? (arg++ - transport) : strlen(transport);
+    for (i = 0; transports[i]; i++) {
+        if ((strlen(transports[i]->name) == len) &&
+            !strncmp(transports[i]->name, transport, len))
+            break;
+    }
+    if (!transports[i]) {
+        ret = uap_dev_error(dev, UAP_ERR_INVAL, "Unknown transport %s",
+                            transport);
+        goto fail;
+    }
+    if (posix_memalign((void **) &dev->cmd_pool, UAP_CMD_POOL_ALIGN,
+                       UAP_CMD_POOL_SIZE * MRVDRV_SIZE_OF_CMD_BUFFER)) {
+        dev->cmd_pool = NULL;
+        ret = uap_dev_error(dev, UAP_ERR_NOMEM,
+                            "Cannot allocate command buffers!");
+        goto fail;
+    }
+    dev->cmd_pool_free = (1 << UAP_CMD_POOL_SIZE) - 1;
+    dev->retries = UAP_DEFAULT_RETRIES;
+    dev->backoff_ms = UAP_DEFAULT_BACKOFF_MS;
+    dev->ops = transports[i];
+    if (dev->ops->open(dev, arg) != UAP_SUCCESS) {
+        ret = dev->err.last_err ? dev->err.last_err : UAP_ERR_NODEV;
+        goto fail;
+    }
+    pthread_mutex_init(&dev->lock, NULL);
+    pthread_mutex_init(&dev->xfer_lock, NULL);
+    *devp = dev;
+    return UAP_OK;
+
+  fail:
+    free(dev->cmd_pool);
+    pthread_key_delete(dev->err_key);
+    free(dev);
+    return ret;
+}
+
+/**
+ *  @brief Closes the control context of a uAP interface
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @return         N/A
+ */
+void
+uap_close(uap_dev * dev)
+{
+    if (!dev)
+        return;
+    uap_cfg_abort(dev);
+    uap_trace_close(dev);
+    dev->ops->close(dev);
+    pthread_mutex_destroy(&dev->lock);
+    pthread_mutex_destroy(&dev->xfer_lock);
+    pthread_key_delete(dev->err_key);
+    free(dev->timing);
+    free(dev->cmd_pool);
+    free(dev);
+}
+
+/**
+ *  @brief Returns the message of an error code
+ *
+ *  @param err      UAP_ERR_ code
+ *  @return         Message
+ */
+const char *
+uap_strerror(int err)
+{
+    if (err > 0 || -err >= sizeof(err_names) / sizeof(err_names[0]))
+        return "Unknown error";
+    return err_names[-err];
+}
+
+/**
+ *  @brief Returns the message of the last failure on a handle
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @return         Message
+ */
+const char *
+uap_last_error(uap_dev * dev)
+{
+    uap_err_state *st = uap_dev_err_state(dev);
+
+    return st->errmsg[0] ? st->errmsg : uap_strerror(st->last_err);
+}
+
+/**
+ *  @brief Returns the firmware result of the last host command
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @return         Result field of the last response
+ */
+int
+uap_last_result(uap_dev * dev)
+{
+    return uap_dev_err_state(dev)->fw_result;
+}
+
+/**
+ *  @brief Returns the monotonic time
+ *
+ *  @return         Time in nanoseconds
+ */
+u64
+uap_time_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ *  @brief Returns the name of a host command
+ *
+ *  @param cmd_code Command code, with or without APCMD_RESP_CHECK
+ *  @return         Command name, or NULL if unknown
+ */
+char *
+uap_cmd_name(u16 cmd_code)
+{
+    int i;
+
+    cmd_code &= HostCmd_CMD_ID_MASK;
+    for (i = 0; cmd_names[i].name; i++) {
+        if (cmd_names[i].cmd_code == cmd_code)
+            return cmd_names[i].name;
+    }
+    return NULL;
+}
+
+/**
+ *  @brief Returns the code of a host command
+ *
+ *  @param name     Command name as printed by uap_cmd_name(), or a code
+ *                  in hex
+ *  @return         Command code, -1 if unknown
+ */
+int
+uap_cmd_code(char *name)
+{
+    char *end;
+    long code;
+    int i;
+
+    for (i = 0; cmd_names[i].name; i++) {
+        if (!strcasecmp(cmd_names[i].name, name))
+            return cmd_names[i].cmd_code;
+    }
+    code = strtol(name, &end, 16);
+    if (end == name || *end || code <= 0 || code > HostCmd_CMD_ID_MASK)
+        return -1;
+    return code;
+}
+
+/**
+ *  @brief Takes a command buffer from the pool of the handle
+ *
+ *  The buffer is MRVDRV_SIZE_OF_CMD_BUFFER bytes and only its first
+ *  clear_len bytes are zeroed.  When every pooled buffer is in use a
+ *  buffer is allocated instead.
+ *
+ *  @param dev       A pointer to uap_dev structure
+ *  @param clear_len Number of bytes to zero, at most the buffer size
+ *  @return          Buffer, or NULL on error
+ */
+u8 *
+uap_cmd_buf_alloc(uap_dev * dev, int clear_len)
+{
+    u8 *buf = NULL;
+    int i;
+
+    if (clear_len < 0 || clear_len > MRVDRV_SIZE_OF_CMD_BUFFER) {
+        uap_dev_error(dev, UAP_ERR_INVAL, "Command of %d bytes too long!",
+                      clear_len);
+        return NULL;
+    }
+    pthread_mutex_lock(&dev->lock);
+    if (dev->cmd_pool_free) {
+        i = __builtin_ctz(dev->cmd_pool_free);
+        dev->cmd_pool_free &= ~(1 << i);
+        buf = dev->cmd_pool + i * MRVDRV_SIZE_OF_CMD_BUFFER;
+    } else {
+        dev->cmd_pool_misses++;
+    }
+    pthread_mutex_unlock(&dev->lock);
+    if (!buf && posix_memalign((void **) &buf, UAP_CMD_POOL_ALIGN,
+                               MRVDRV_SIZE_OF_CMD_BUFFER)) {
+        uap_dev_error(dev, UAP_ERR_NOMEM, "Cannot allocate command buffer!");
+        return NULL;
+    }
+    memset(buf, 0, clear_len);
+    return buf;
+}
+
+/**
+ *  @brief Returns a command buffer to the pool of the handle
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param buf      Buffer from uap_cmd_buf_alloc(), or NULL
+ *  @return         N/A
+ */
+void
+uap_cmd_buf_free(uap_dev * dev, u8 * buf)
+{
+    long off;
+
+    if (!buf)
+        return;
+    off = dev->cmd_pool ? buf - dev->cmd_pool : -1;
+    if (off < 0 || off >= UAP_CMD_POOL_SIZE * MRVDRV_SIZE_OF_CMD_BUFFER) {
+        free(buf);
+        return;
+    }
+    pthread_mutex_lock(&dev->lock);
+    dev->cmd_pool_free |= 1 << (off / MRVDRV_SIZE_OF_CMD_BUFFER);
+    pthread_mutex_unlock(&dev->lock);
+}
+
+/**
+ *  @brief Prints the round trip latencies timed on a handle
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @return         N/A
+ */
+void
+uap_timing_print(uap_dev * dev)
+{
+    uap_timing *t;
+    char code[8];
+    char *name;
+    int i;
+
+    pthread_mutex_lock(&dev->lock);
+    printf("%s: round trip latency of %lu host commands, %lu power mode\n",
+           dev->name, dev->cmd_count, dev->pm_count);
+    printf("%-20s %7s %6s %7s %8s %9s %9s %9s %9s %9s\n", "Command",
+           "Count", "Errors", "Retries", "Timeouts", "Min(us)", "Avg(us)",
+           "P50(us)", "P99(us)", "Max(us)");
+    for (i = 0; i < dev->timing_cmds; i++) {
+        t = &dev->timing[i];
+        name = (t->type == UAP_TRACE_POWER_MODE) ? "POWER_MODE" :
+            uap_cmd_name(t->cmd_code);
+        if (!name) {
+            snprintf(code, sizeof(code), "0x%04x", t->cmd_code);
+            name = code;
+        }
+        printf("%-20s %7lu %6lu %7lu %8lu", name, t->count, t->errors,
+               t->retries, t->timeouts);
+        if (t->count)
+            printf(" %9.1f %9.1f %9.1f %9.1f %9.1f", t->min_ns / 1e3,
+                   t->total_ns / 1e3 / t->count,
+                   timing_percentile(t, 50) / 1e3,
+                   timing_percentile(t, 99) / 1e3, t->max_ns / 1e3);
+        printf("\n");
+    }
+    pthread_mutex_unlock(&dev->lock);
+}
+
+/**
+ *  @brief Clears the round trip latencies timed on a handle
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @return         N/A
+ */
+void
+uap_timing_reset(uap_dev * dev)
+{
+    pthread_mutex_lock(&dev->lock);
+    dev->timing_cmds = 0;
+    if (dev->timing)
+        memset(dev->timing, 0, UAP_TIMING_CMDS * sizeof(uap_timing));
+    pthread_mutex_unlock(&dev->lock);
+}
+
+/**
+ *  @brief Sets the deadline of the attempts of a host command
+ *
+ *  @param dev        A pointer to uap_dev structure
+ *  @param cmd_code   Command code, 0 for every command without its own
+ *                    deadline and for power mode requests
+ *  @param timeout_ms Deadline in ms, 0 for none
+ *  @return           UAP_OK or a UAP_ERR_ code
+ */
+int
+uap_set_timeout(uap_dev * dev, unsigned short cmd_code, int timeout_ms)
+{
+    int i, ret = UAP_OK;
+
+    if (timeout_ms < 0)
+        return uap_dev_error(dev, UAP_ERR_INVAL, "Invalid timeout %d ms",
+                             timeout_ms);
+    pthread_mutex_lock(&dev->lock);
+    if (!cmd_code) {
+        dev->timeout_ms = timeout_ms;
+    } else {
+        cmd_code &= HostCmd_CMD_ID_MASK;
+        for (i = 0; i < dev->timeout_cmds; i++) {
+            if (dev->cmd_timeouts[i].cmd_code == cmd_code)
+                break;
+        }
+        if (i < UAP_TIMEOUT_CMDS) {
+            dev->cmd_timeouts[i].cmd_code = cmd_code;
+            dev->cmd_timeouts[i].timeout_ms = timeout_ms;
+            if (i == dev->timeout_cmds)
+                dev->timeout_cmds++;
+        } else {
+            ret = UAP_ERR_INVAL;
+        }
+    }
+    pthread_mutex_unlock(&dev->lock);
+    if (ret != UAP_OK)
+        return uap_dev_error(dev, ret, "No more than %d command timeouts",
+                             UAP_TIMEOUT_CMDS);
+    return UAP_OK;
+}
+
+/**
+ *  @brief Sets how transient failures of requests are retried
+ *
+ *  @param dev        A pointer to uap_dev structure
+ *  @param retries    Number of retries, 0 to fail at once
+ *  @param backoff_ms Wait before the first retry in ms, doubled for each
+ *                    next one up to UAP_BACKOFF_MAX_MS
+ *  @return           UAP_OK or a UAP_ERR_ code
+ */
+int
+uap_set_retry(uap_dev * dev, int retries, int backoff_ms)
+{
+    if (retries < 0 || backoff_ms < 0 || backoff_ms > UAP_BACKOFF_MAX_MS)
+        return uap_dev_error(dev, UAP_ERR_INVAL,
+                             "Invalid retry policy %d/%d ms", retries,
+                             backoff_ms);
+    pthread_mutex_lock(&dev->lock);
+    dev->retries = retries;
+    dev->backoff_ms = backoff_ms;
+    pthread_mutex_unlock(&dev->lock);
+    return UAP_OK;
+}
+
+/**
+ *  @brief Sets whether requests past their deadline are retried
+ *
+ *  Off by default: an interrupted host command may already be queued
+ *  to the firmware, so retrying it can run a SET, bss_start or
+ *  sta_deauth twice.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param enable   1 to retry ETIMEDOUT like EBUSY and EAGAIN, 0 not to
+ *  @return         UAP_OK
+ */
+int
+uap_set_retry_timeouts(uap_dev * dev, int enable)
+{
+    pthread_mutex_lock(&dev->lock);
+    dev->retry_timeouts = enable ? 1 : 0;
+    pthread_mutex_unlock(&dev->lock);
+    return UAP_OK;
+}
+
+/** 
+ *  @brief Dump hex data
+ *
+ *  @param prompt	A pointer prompt buffer
+ *  @param p		A pointer to data buffer
+ *  @param len		the len of data buffer
+ *  @param delim	delim char
+ *  @return            	None
+ */
+void
+hexdump_data(char *prompt, void *p, int len, char delim)
+{
+    int i;
+    unsigned char *s = p;
+
+    if (prompt) {
+        printf("%s: len=%d\n", prompt, (int) len);
+    }
+    for (i = 0; i < len; i++) {
+        if (i != len - 1)
+            printf("%02x%c", *s++, delim);
+        else
+            printf("%02x\n", *s);
+        if ((i + 1) % 16 == 0)
+            printf("\n");
+    }
+    printf("\n");
+}
+
+/**
+ *  @brief Performs the ioctl operation to send the command to
+ *  the driver.
+ *
+ *  While a sys_cfg batch is open, SET requests are held back and other
+ *  requests are ordered after them.
+ *
+ *  @param dev           A pointer to uap_dev structure
+ *  @param cmd        	 Pointer to the command buffer
+ *  @param size          Pointer to the command size. This value is
+ *                       overwritten by the function with the size of the
+ *                       received response.
+ *  @param buf_size 	 Size of the allocated command buffer
+ *  @return              UAP_SUCCESS or UAP_FAILURE
+ */
+int
+uap_ioctl(uap_dev * dev, u8 * cmd, u16 * size, u16 buf_size)
+{
+    APCMDBUF_SYS_CONFIGURE *cmd_buf = (APCMDBUF_SYS_CONFIGURE *) cmd;
+    uap_err_state *st = uap_dev_err_state(dev);
+    int conflict;
+
+    st->last_err = UAP_OK;
+    st->errmsg[0] = '\0';
+    if (buf_size < *size) {
+        uap_dev_error(dev, UAP_ERR_INVAL,
+                      "buf_size should not less than cmd buffer size");
+        return UAP_FAILURE;
+    }
+    if (cmd_buf->CmdCode == APCMD_SYS_CONFIGURE &&
+        cmd_buf->Action == ACTION_SET &&
+        *size >= sizeof(APCMDBUF_SYS_CONFIGURE))
+        return cfg_batch_add(dev, cmd, size, buf_size);
+    pthread_mutex_lock(&dev->lock);
+    conflict = cfg_batch_conflicts(dev, cmd, *size);
+    pthread_mutex_unlock(&dev->lock);
+    if (conflict && cfg_batch_flush(dev) != UAP_SUCCESS)
+        return UAP_FAILURE;
+    return ioctl_send(dev, cmd, size, buf_size);
+}
+
+/**
+ *  @brief Opens a sys_cfg batch
+ *
+ *  Until uap_cfg_commit(), sys_cfg SET requests are collected and sent
+ *  together in as few APCMD_SYS_CONFIGURE commands as fit.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+int
+uap_cfg_begin(uap_dev * dev)
+{
+    u8 *batch;
+
+    batch = (u8 *) malloc(UAP_CFG_BATCH_ROOM);
+    if (!batch)
+        return uap_dev_error(dev, UAP_ERR_NOMEM,
+                             "Cannot allocate sys_cfg batch!");
+    pthread_mutex_lock(&dev->lock);
+    if (dev->cfg_batch) {
+        pthread_mutex_unlock(&dev->lock);
+        free(batch);
+        return uap_dev_error(dev, UAP_ERR_INVAL,
+                             "A sys_cfg batch is already open");
+    }
+    dev->cfg_batch = batch;
+    dev->cfg_len = 0;
+    dev->cfg_sets = 0;
+    dev->cfg_cmds = 0;
+    pthread_mutex_unlock(&dev->lock);
+    return UAP_OK;
+}
+
+/**
+ *  @brief Sends the open sys_cfg batch and closes it
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param sets     Returns the number of SET requests in the batch, or NULL
+ *  @param cmds     Returns the number of commands sent, or NULL
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+int
+uap_cfg_commit(uap_dev * dev, int *sets, int *cmds)
+{
+    uap_err_state *st = uap_dev_err_state(dev);
+    u8 buf[MRVDRV_SIZE_OF_CMD_BUFFER];
+    u8 *batch;
+    u16 len;
+    int taken, ret = UAP_OK;
+
+    /* Closed before the last command is sent, later SETs go out alone */
+    pthread_mutex_lock(&dev->lock);
+    batch = dev->cfg_batch;
+    if (!batch) {
+        pthread_mutex_unlock(&dev->lock);
+        return uap_dev_error(dev, UAP_ERR_INVAL, "No sys_cfg batch is open");
+    }
+    taken = cfg_batch_take(dev, buf, &len);
+    if (sets)
+        *sets = dev->cfg_sets;
+    if (cmds)
+        *cmds = dev->cfg_cmds;
+    dev->cfg_batch = NULL;
+    pthread_mutex_unlock(&dev->lock);
+    free(batch);
+
+    st->last_err = UAP_OK;
+    if (taken && cfg_batch_send(dev, buf, len) != UAP_SUCCESS)
+        ret = st->last_err ? st->last_err : UAP_ERR_IO;
+    return ret;
+}
+
+/**
+ *  @brief Discards the open sys_cfg batch
+ *
+ *  SET requests already sent because the batch overflowed or a later
+ *  request depended on them are not undone.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @return         Number of SET requests in the batch, or -1 if no
+ *                  batch was open
+ */
+int
+uap_cfg_abort(uap_dev * dev)
+{
+    u8 *batch;
+    int sets;
+
+    pthread_mutex_lock(&dev->lock);
+    batch = dev->cfg_batch;
+    sets = batch ? dev->cfg_sets : -1;
+    dev->cfg_batch = NULL;
+    dev->cfg_len = 0;
+    pthread_mutex_unlock(&dev->lock);
+    free(batch);
+    return sets;
+}
+
+/**
+ *  @brief Sets/gets the power mode through the transport
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param pm       A pointer to ps_mgmt structure
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+int
+uap_power_mode_ioctl(uap_dev * dev, ps_mgmt * pm)
+{
+    uap_err_state *st = uap_dev_err_state(dev);
+    ps_mgmt req = *pm;
+    u64 start_ns, end_ns;
+    u32 retries, timeouts;
+    int ret;
+
+    st->last_err = UAP_OK;
+    st->errmsg[0] = '\0';
+    if (cfg_batch_flush(dev) != UAP_SUCCESS)
+        return UAP_FAILURE;
+    start_ns = uap_time_ns();
+    ret = request_run(dev, UAP_TRACE_POWER_MODE, 0, pm, (u8 *) & req,
+                      sizeof(ps_mgmt), &retries, &timeouts);
+    end_ns = uap_time_ns();
+    pthread_mutex_lock(&dev->lock);
+    dev->pm_count++;
+    dev->retry_count += retries;
+    dev->timeout_count += timeouts;
+    timing_record(dev, UAP_TRACE_POWER_MODE, 0, ret, end_ns - start_ns,
+                  retries, timeouts);
+    if (dev->trace)
+        uap_trace_record(dev, UAP_TRACE_POWER_MODE, ret, (u8 *) & req,
+                         sizeof(ps_mgmt), (u8 *) pm,
+                         ret == UAP_SUCCESS ? sizeof(ps_mgmt) : 0,
+                         sizeof(ps_mgmt), start_ns, end_ns);
+    if (ret != UAP_SUCCESS)
+        dev->err_count++;
+    pthread_mutex_unlock(&dev->lock);
+    return (ret == UAP_SUCCESS) ? UAP_SUCCESS : UAP_FAILURE;
+}
@@ -0,0 +1,571 @@
+/** @file  uapexp.c
+ *
+ *  @brief This file contains the metrics exporter: the uAP statistics
+ *  served in OpenMetrics text format over HTTP.
+ *
+ * Copyright (C) 2008-2009, Marvell International Ltd.
+ *
+ * This software file (the "File") is distributed by Marvell International
+ * Ltd. under the terms of the GNU General Public License Version 2, June 1991
+ * (the "License").  You may use, redistribute and/or modify this File in
+ * accordance with the terms and conditions of the License, a copy of which
+ * is available along with the File in the gpl.txt file or by writing to
+ * the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307 or on the worldwide web at http://www.gnu.org/licenses/gpl.txt.
+ *
+ * THE FILE IS DISTRIBUTED AS-IS, WITHOUT WARRANTY OF ANY KIND, AND THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE
+ * ARE EXPRESSLY DISCLAIMED.  The License provides additional details about
+ * this warranty disclaimer.
+ *
+ */
+/****************************************************************************
+Change log:
+    10/17/26: Initial creation
+****************************************************************************/
+
+/****************************************************************************
+        Header files
+****************************************************************************/
+/** accept4() */
+#define _GNU_SOURCE
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/if.h>
+#include "uaputl.h"
+
+/****************************************************************************
+        Definitions
+****************************************************************************/
+/*
+ * Every scrape is answered from one cached snapshot of the firmware
+ * state.  The snapshot is taken again only when it is older than the
+ * cache time, so any number of scrapers cost one set of host commands
+ * per cache time.
+ */
+
+/** Maximum request header length */
+#define UAPEXP_MAX_REQUEST      2048
+/** Number of epoll events handled per wakeup */
+#define UAPEXP_MAX_EVENTS       32
+
+/** OpenMetrics content type */
+#define UAPEXP_CONTENT_TYPE \
+    "application/openmetrics-text; version=1.0.0; charset=utf-8"
+
+/** Client connection */
+typedef struct _uapexp_client
+{
+    /** Socket */
+    int fd;
+    /** Received request header bytes */
+    char in[UAPEXP_MAX_REQUEST];
+    /** Length of in */
+    int in_len;
+    /** Response, NULL until the request is complete */
+    char *out;
+    /** Length of out */
+    size_t out_len;
+    /** Bytes of out already sent */
+    size_t out_off;
+} uapexp_client;
+
+/** Cached snapshot */
+typedef struct _uapexp_cache
+{
+    /** Metrics text without the trailer, NULL before the first one */
+    char *text;
+    /** Length of text */
+    size_t len;
+    /** Time the snapshot was taken */
+    u64 taken_ns;
+    /** Cache time in ns */
+    u64 max_age_ns;
+    /** Number of snapshots taken */
+    u32 snapshots;
+    /** Number of scrapes answered */
+    u32 scrapes;
+} uapexp_cache;
+
+/** Set by SIGINT and SIGTERM */
+static volatile sig_atomic_t uapexp_stop;
+
+/****************************************************************************
+        Local functions
+****************************************************************************/
+/**
+ *  @brief Signal handler, stops the exporter loop
+ *
+ *  @param sig      Signal number
+ *  @return         N/A
+ */
+static void
+uapexp_signal(int sig)
+{
+    uapexp_stop = 1;
+}
+
+/**
+ *  @brief Prints the metrics of one snapshot
+ *
+ *  Reuses the decoding of uap_stats, sta_list, powermode and
+ *  coex_config.  A source that cannot be read is left out and flagged
+ *  by uap_scrape_error.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param out      Output stream
+ *  @return         N/A
+ */
+static void
+uapexp_print_snapshot(uap_dev * dev, FILE * out)
+{
+    uap_stats_info stats;
+    uap_sta_info sta[UAP_MAX_STA];
+    unsigned int coex[COEX_STATS], value;
+    const char *name;
+    char *ifname = dev->name;
+    ps_mgmt pm;
+    int i, count, err_stats, err_sta, err_pm, err_coex;
+
+    err_stats = uap_get_stats(dev, &stats) != UAP_OK;
+    if (!err_stats) {
+        fprintf(out, "# TYPE uap_dot11 counter\n"
+                "# HELP uap_dot11 802.11 MIB counters, as of uap_stats.\n");
+        for (i = 0; (name = stats_field(&stats, i, &value)); i++)
+            fprintf(out, "uap_dot11_total{interface=\"%s\",counter=\"%s\"} "
+                    "%u\n", ifname, name, value);
+    }
+
+    err_sta = uap_get_sta_list(dev, sta, UAP_MAX_STA, &count) != UAP_OK;
+    if (!err_sta) {
+        if (count > UAP_MAX_STA)
+            count = UAP_MAX_STA;
+        fprintf(out, "# TYPE uap_stations gauge\n"
+                "# HELP uap_stations Associated stations.\n"
+                "uap_stations{interface=\"%s\"} %d\n", ifname, count);
+        fprintf(out, "# TYPE uap_station_rssi_dbm gauge\n"
+                "# UNIT uap_station_rssi_dbm dbm\n"
+                "# HELP uap_station_rssi_dbm RSSI of each station.\n");
+        for (i = 0; i < count; i++)
+            fprintf(out, "uap_station_rssi_dbm{interface=\"%s\","
+                    "mac=\"%02x:%02x:%02x:%02x:%02x:%02x\"} %d\n", ifname,
+                    sta[i].mac[0], sta[i].mac[1], sta[i].mac[2],
+                    sta[i].mac[3], sta[i].mac[4], sta[i].mac[5],
+                    sta[i].rssi);
+        fprintf(out, "# TYPE uap_station_power_save gauge\n"
+                "# HELP uap_station_power_save 1 for a station in power "
+                "save.\n");
+        for (i = 0; i < count; i++)
+            fprintf(out, "uap_station_power_save{interface=\"%s\","
+                    "mac=\"%02x:%02x:%02x:%02x:%02x:%02x\"} %d\n", ifname,
+                    sta[i].mac[0], sta[i].mac[1], sta[i].mac[2],
+                    sta[i].mac[3], sta[i].mac[4], sta[i].mac[5],
+                    sta[i].power_save ? 1 : 0);
+    }
+
+    /* A request without flags gets the current power mode */
+    memset(&pm, 0, sizeof(ps_mgmt));
+    err_pm = uap_power_mode_ioctl(dev, &pm) != UAP_SUCCESS;
+    if (!err_pm) {
+        fprintf(out, "# TYPE uap_power_mode stateset\n"
+                "# HELP uap_power_mode Power save mode, as of powermode.\n");
+        for (i = 0; i < POWER_MODES; i++)
+            fprintf(out, "uap_power_mode{interface=\"%s\","
+                    "uap_power_mode=\"%s\"} %d\n", ifname,
+                    power_mode_name(i), pm.ps_mode == i);
+    }
+
+    err_coex = coex_stats_get(dev, coex) != UAP_SUCCESS;
+    if (!err_coex) {
+        fprintf(out, "# TYPE uap_coex counter\n"
+                "# HELP uap_coex BT coex statistics, as of coex_config.\n");
+        for (i = 0; i < COEX_STATS; i++)
+            fprintf(out, "uap_coex_total{interface=\"%s\",counter=\"%s\"} "
+                    "%u\n", ifname, coex_stats_name(i), coex[i]);
+    }
+
+    fprintf(out, "# TYPE uap_scrape_error gauge\n"
+            "# HELP uap_scrape_error 1 when a source could not be read.\n");
+    fprintf(out, "uap_scrape_error{interface=\"%s\",source=\"stats\"} %d\n",
+            ifname, err_stats);
+    fprintf(out, "uap_scrape_error{interface=\"%s\",source=\"sta_list\"} "
+            "%d\n", ifname, err_sta);
+    fprintf(out, "uap_scrape_error{interface=\"%s\",source=\"powermode\"} "
+            "%d\n", ifname, err_pm);
+    fprintf(out, "uap_scrape_error{interface=\"%s\",source=\"coex\"} %d\n",
+            ifname, err_coex);
+}
+
+/**
+ *  @brief Builds the response to a scrape, taking a new snapshot if
+ *  the cached one is too old
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param cache    Snapshot cache
+ *  @param c        Client
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+uapexp_scrape(uap_dev * dev, uapexp_cache * cache, uapexp_client * c)
+{
+    char hdr[256];
+    char *text = NULL, *body = NULL, *resp;
+    size_t text_len = 0, body_len = 0;
+    int hdr_len;
+    FILE *mem;
+    u64 now_ns = uap_time_ns();
+
+    if (!cache->text || now_ns - cache->taken_ns >= cache->max_age_ns) {
+        mem = open_memstream(&text, &text_len);
+        if (!mem)
+            return UAP_FAILURE;
+        uapexp_print_snapshot(dev, mem);
+        fclose(mem);
+        free(cache->text);
+        cache->text = text;
+        cache->len = text_len;
+        now_ns = uap_time_ns();
+        cache->taken_ns = now_ns;
+        cache->snapshots++;
+    }
+    cache->scrapes++;
+
+    mem = open_memstream(&body, &body_len);
+    if (!mem)
+        return UAP_FAILURE;
+    fwrite(cache->text, 1, cache->len, mem);
+    fprintf(mem, "# TYPE uap_exporter_snapshots counter\n"
+            "uap_exporter_snapshots_total %lu\n"
+            "# TYPE uap_exporter_scrapes counter\n"
+            "uap_exporter_scrapes_total %lu\n"
+            "# TYPE uap_exporter_snapshot_age_seconds gauge\n"
+            "uap_exporter_snapshot_age_seconds %.3f\n# EOF\n",
+            cache->snapshots, cache->scrapes,
+            (now_ns - cache->taken_ns) / 1e9);
+    fclose(mem);
+    if (!body)
+        return UAP_FAILURE;
+    hdr_len = snprintf(hdr, sizeof(hdr), "HTTP/1.1 200 OK\r\n"
+                       "Content-Type: " UAPEXP_CONTENT_TYPE "\r\n"
+                       "Content-Length: %lu\r\nConnection: close\r\n\r\n",
+                       (unsigned long) body_len);
+    resp = (char *) malloc(hdr_len + body_len);
+    if (!resp) {
+        free(body);
+        return UAP_FAILURE;
+    }
+    memcpy(resp, hdr, hdr_len);
+    memcpy(resp + hdr_len, body, body_len);
+    free(body);
+    c->out = resp;
+    c->out_len = hdr_len + body_len;
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Queues an error response
+ *
+ *  @param c        Client
+ *  @param status   HTTP status line, without "HTTP/1.1 "
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+uapexp_error(uapexp_client * c, char *status)
+{
+    char *resp;
+    size_t len = strlen(status) + 128;
+
+    resp = (char *) malloc(len);
+    if (!resp)
+        return UAP_FAILURE;
+    c->out_len = snprintf(resp, len, "HTTP/1.1 %s\r\nContent-Length: %d\r\n"
+                          "Connection: close\r\n\r\n%s\n", status,
+                          (int) strlen(status) + 1, status);
+    c->out = resp;
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Answers a complete request header
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param cache    Snapshot cache
+ *  @param c        Client
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+uapexp_request(uap_dev * dev, uapexp_cache * cache, uapexp_client * c)
+{
+    char *path, *end;
+
+    c->in[c->in_len] = '\0';
+    if (strncmp(c->in, "GET ", 4))
+        return uapexp_error(c, "405 Method Not Allowed");
+    path = c->in + 4;
+    end = path + strcspn(path, " ?\r\n");
+    if ((end - path == 1 && path[0] == '/') ||
+        (end - path == 8 && !strncmp(path, "/metrics", 8)))
+        return uapexp_scrape(dev, cache, c);
+    return uapexp_error(c, "404 Not Found");
+}
+
+/**
+ *  @brief Closes a client connection
+ *
+ *  @param epfd     epoll descriptor
+ *  @param c        Client
+ *  @return         N/A
+ */
+static void
+uapexp_client_close(int epfd, uapexp_client * c)
+{
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    free(c->out);
+    free(c);
+}
+
+/**
+ *  @brief Handles the events of a client connection
+ *
+ *  Reads the request header, then sends the response and closes.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param cache    Snapshot cache
+ *  @param epfd     epoll descriptor
+ *  @param c        Client
+ *  @param events   Events reported by epoll
+ *  @return         N/A
+ */
+static void
+uapexp_client_event(uap_dev * dev, uapexp_cache * cache, int epfd,
+                    uapexp_client * c, u32 events)
+{
+    struct epoll_event ev;
+    ssize_t n;
+
+    if (events & (EPOLLERR | EPOLLHUP) && !c->out) {
+        uapexp_client_close(epfd, c);
+        return;
+    }
+    while (!c->out) {
+        n = recv(c->fd, c->in + c->in_len, sizeof(c->in) - 1 - c->in_len, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        if (n <= 0) {
+            uapexp_client_close(epfd, c);
+            return;
+        }
+        c->in_len += n;
+        c->in[c->in_len] = '\0';
+        if (strstr(c->in, "\r\n\r\n") || strstr(c->in, "\n\n")) {
+            if (uapexp_request(dev, cache, c) != UAP_SUCCESS) {
+                uapexp_client_close(epfd, c);
+                return;
+            }
+        } else if (c->in_len == sizeof(c->in) - 1) {
+            if (uapexp_error(c, "431 Request Header Fields Too Large") !=
+                UAP_SUCCESS) {
+                uapexp_client_close(epfd, c);
+                return;
+            }
+        }
+    }
+    while (c->out_off < c->out_len) {
+        n = send(c->fd, c->out + c->out_off, c->out_len - c->out_off,
+                 MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLOUT;
+            ev.data.ptr = c;
+            epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+            return;
+        }
+        if (n < 0)
+            break;
+        c->out_off += n;
+    }
+    uapexp_client_close(epfd, c);
+}
+
+/**
+ *  @brief Accepts the pending client connections
+ *
+ *  @param epfd     epoll descriptor
+ *  @param lfd      Listening socket
+ *  @return         N/A
+ */
+static void
+uapexp_accept(int epfd, int lfd)
+{
+    struct epoll_event ev;
+    uapexp_client *c;
+    int fd;
+
+    for (;;) {
+        fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                perror("accept");
+            return;
+        }
+        c = calloc(1, sizeof(uapexp_client));
+        if (!c) {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.ptr = c;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            free(c);
+        }
+    }
+}
+
+/**
+ *  @brief Creates the listening TCP socket
+ *
+ *  @param addr     "[host:]port", host defaults to the loopback address
+ *  @return         Socket descriptor, or -1 on error
+ */
+static int
+uapexp_listen_tcp(char *addr)
+{
+    struct addrinfo hints, *res;
+    char host[256], *port;
+    int fd, one = 1, err;
+
+    port = strrchr(addr, ':');
+    if (port) {
+        snprintf(host, sizeof(host), "%.*s", (int) (port - addr), addr);
+        port++;
+    } else {
+        strcpy(host, UAPEXP_DEFAULT_HOST);
+        port = addr;
+    }
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    err = getaddrinfo(host[0] ? host : NULL, port, &hints, &res);
+    if (err) {
+        printf("ERR:Invalid listen address %s: %s\n", addr,
+               gai_strerror(err));
+        return -1;
+    }
+    fd = socket(res->ai_family, res->ai_socktype | SOCK_NONBLOCK |
+                SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        freeaddrinfo(res);
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, res->ai_addr, res->ai_addrlen) < 0 ||
+        listen(fd, SOMAXCONN) < 0) {
+        perror("bind");
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+/****************************************************************************
+        Global functions
+****************************************************************************/
+/**
+ *  @brief Serves the uAP statistics in OpenMetrics text format
+ *
+ *  Runs in the foreground until SIGINT or SIGTERM.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param addr     "[host:]port" for TCP, or "unix:<path>"
+ *  @param cache_ms Time a snapshot is served for, in ms
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+int
+uapexp_run(uap_dev * dev, char *addr, long cache_ms)
+{
+    struct epoll_event ev, events[UAPEXP_MAX_EVENTS];
+    struct sigaction sa;
+    uapexp_cache cache;
+    char *path = NULL;
+    int lfd, epfd, n, i;
+
+    if (!strncmp(addr, "unix:", 5)) {
+        path = addr + 5;
+        lfd = uapd_listen(path);
+    } else {
+        lfd = uapexp_listen_tcp(addr);
+    }
+    if (lfd < 0)
+        return UAP_FAILURE;
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        perror("epoll_create1");
+        close(lfd);
+        if (path)
+            unlink(path);
+        return UAP_FAILURE;
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, lfd, &ev);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = uapexp_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    memset(&cache, 0, sizeof(cache));
+    cache.max_age_ns = (u64) cache_ms * 1000000;
+    printf("uaputl metrics on %s, interface %s, snapshot cache %ld ms\n",
+           addr, dev->name, cache_ms);
+    fflush(stdout);
+    while (!uapexp_stop) {
+        n = epoll_wait(epfd, events, UAPEXP_MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait");
+            break;
+        }
+        for (i = 0; i < n; i++) {
+            if (!events[i].data.ptr)
+                uapexp_accept(epfd, lfd);
+            else
+                uapexp_client_event(dev, &cache, epfd, events[i].data.ptr,
+                                    events[i].events);
+        }
+    }
+
+    /* Open client connections are dropped with the process */
+    close(epfd);
+    close(lfd);
+    if (path)
+        unlink(path);
+    free(cache.text);
+    printf("uaputl metrics: %lu scrapes, %lu snapshots\n", cache.scrapes,
+           cache.snapshots);
+    return UAP_SUCCESS;
+}
@@ -0,0 +1,1022 @@
+/** @file  uaplib.c
+ *
+ *  @brief This file contains the typed command API of libuaputl.
+ *
+ *  Each call builds one host command in a stack buffer, sends it
+ *  through the handle and decodes the response into caller provided
+ *  storage.  Nothing is printed here; failures are returned as
+ *  UAP_ERR_ codes and described by uap_last_error().
+ *
+ * Copyright (C) 2008-2009, Marvell International Ltd.
+ *
+ * This software file (the "File") is distributed by Marvell International
+ * Ltd. under the terms of the GNU General Public License Version 2, June 1991
+ * (the "License").  You may use, redistribute and/or modify this File in
+ * accordance with the terms and conditions of the License, a copy of which
+ * is available along with the File in the gpl.txt file or by writing to
+ * the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307 or on the worldwide web at http://www.gnu.org/licenses/gpl.txt.
+ *
+ * THE FILE IS DISTRIBUTED AS-IS, WITHOUT WARRANTY OF ANY KIND, AND THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE
+ * ARE EXPRESSLY DISCLAIMED.  The License provides additional details about
+ * this warranty disclaimer.
+ *
+ */
+/****************************************************************************
+Change log:
+    10/17/26: Initial creation
+****************************************************************************/
+
+/****************************************************************************
+        Header files
+****************************************************************************/
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/if.h>
+#include "uaputl.h"
+
+/****************************************************************************
+        Definitions
+****************************************************************************/
+/** SNMP MIB OIDs of uap_stats_info, in request order */
+static const struct
+{
+    /** OID */
+    u16 oid;
+    /** Offset of the counter in uap_stats_info */
+    u16 offset;
+} stats_oids[] = {
+    {0x0b, offsetof(uap_stats_info, tkip_mic_failures)},
+    {0x0c, offsetof(uap_stats_info, ccmp_decrypt_errors)},
+    {0x0d, offsetof(uap_stats_info, wep_undecryptable)},
+    {0x0e, offsetof(uap_stats_info, wep_icv_errors)},
+    {0x0f, offsetof(uap_stats_info, decrypt_failures)},
+    {0x12, offsetof(uap_stats_info, failed)},
+    {0x13, offsetof(uap_stats_info, retry)},
+    {0x14, offsetof(uap_stats_info, multiple_retry)},
+    {0x15, offsetof(uap_stats_info, frame_duplicate)},
+    {0x16, offsetof(uap_stats_info, rts_success)},
+    {0x17, offsetof(uap_stats_info, rts_failure)},
+    {0x18, offsetof(uap_stats_info, ack_failure)},
+    {0x19, offsetof(uap_stats_info, rx_fragments)},
+    {0x1a, offsetof(uap_stats_info, rx_multicast_frames)},
+    {0x1b, offsetof(uap_stats_info, fcs_errors)},
+    {0x1c, offsetof(uap_stats_info, tx_frames)},
+    {0x1d, offsetof(uap_stats_info, tkip_countermeasures)},
+    {0x1e, offsetof(uap_stats_info, rsna_4way_failures)},
+    {0x1f, offsetof(uap_stats_info, tx_multicast_frames)},
+};
+
+/** Number of stats OIDs */
+#define STATS_OIDS      (sizeof(stats_oids) / sizeof(stats_oids[0]))
+
+/** Output array of uap_get_sta_list() */
+typedef struct _lib_sta_array
+{
+    /** Stations */
+    uap_sta_info *sta;
+    /** Size of sta */
+    int max;
+    /** Stations stored */
+    int n;
+} lib_sta_array;
+
+/** Names of the UAP_KPI_ ratios */
+static const char *kpi_names[UAP_KPIS] = {
+    "retry",
+    "failure",
+    "fcs_error",
+    "rts_failure",
+    "decrypt_error",
+};
+
+/** Default alert thresholds of the UAP_KPI_ ratios */
+static const double kpi_thresholds[UAP_KPIS] = {
+    0.25,                       /* retries per transmitted frame */
+    0.05,                       /* failed per attempted frame */
+    0.10,                       /* FCS errors per received frame */
+    0.20,                       /* RTS failures per RTS */
+    0.01,                       /* decrypt errors per received frame */
+};
+
+/****************************************************************************
+        Local functions
+****************************************************************************/
+/**
+ *  @brief Records a failure on a handle without printing it
+ *
+ *  Commands report their own messages, so only the code and the text
+ *  for uap_last_error() are kept.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param err      UAP_ERR_ code
+ *  @param fmt      printf format string, followed by optional arguments
+ *  @return         err
+ */
+static int
+lib_error(uap_dev * dev, int err, char *fmt, ...)
+{
+    uap_err_state *st = uap_dev_err_state(dev);
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(st->errmsg, sizeof(st->errmsg), fmt, ap);
+    va_end(ap);
+    st->last_err = err;
+    return err;
+}
+
+/**
+ *  @brief Loads a little endian value of 1, 2 or 4 bytes
+ *
+ *  @param p        Source
+ *  @param size     Size of the value
+ *  @return         Value
+ */
+static unsigned int
+get_le(u8 * p, int size)
+{
+    unsigned int v = 0;
+
+    while (size--)
+        v = (v << 8) | p[size];
+    return v;
+}
+
+/**
+ *  @brief Checks the response of a host command
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param buf      Response buffer
+ *  @param cmd_code Command code sent
+ *  @param sent     UAP_SUCCESS or UAP_FAILURE, as returned by uap_ioctl()
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+static int
+lib_result(uap_dev * dev, u8 * buf, u16 cmd_code, int sent)
+{
+    APCMDBUF *header = (APCMDBUF *) buf;
+    int err;
+
+    if (sent != UAP_SUCCESS) {
+        err = uap_dev_err_state(dev)->last_err;
+        return err ? err : UAP_ERR_IO;
+    }
+    if (header->CmdCode != (cmd_code | APCMD_RESP_CHECK))
+        return lib_error(dev, UAP_ERR_PROTO, "Corrupted response! CmdCode=%x",
+                         header->CmdCode);
+    if (header->Result != CMD_SUCCESS)
+        return lib_error(dev, UAP_ERR_FW, "Command 0x%04x failed, result %d",
+                         cmd_code, header->Result);
+    return UAP_OK;
+}
+
+/**
+ *  @brief Sends a host command and checks its response
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param buf      Command buffer, header filled except sizes
+ *  @param cmd_len  Command length
+ *  @param buf_len  Buffer size
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+static int
+lib_send(uap_dev * dev, u8 * buf, u16 cmd_len, u16 buf_len)
+{
+    APCMDBUF *header = (APCMDBUF *) buf;
+
+    header->Size = cmd_len;
+    header->SeqNum = 0;
+    header->Result = 0;
+    return lib_result(dev, buf, header->CmdCode,
+                      uap_ioctl(dev, buf, &cmd_len, buf_len));
+}
+
+/**
+ *  @brief Sends a sys_configure request carrying one TLV
+ *
+ *  The request is built with the TLV builder, the caller releases
+ *  b->buf with tlv_build_free() whatever the outcome.  On success the
+ *  response TLV is the first one of b->buf, its header in CPU order.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param b        Builder, started here
+ *  @param action   ACTION_GET or ACTION_SET
+ *  @param tag      TLV tag
+ *  @param value    TLV value, NULL for a zeroed one
+ *  @param len      TLV value length
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+static int
+lib_sys_cfg(uap_dev * dev, tlv_builder * b, u16 action, u16 tag,
+            const void *value, u16 len)
+{
+    TLVBUF_HEADER *tlv;
+    int ret;
+
+    if (tlv_build_start(dev, b, action) != UAP_SUCCESS)
+        return UAP_ERR_NOMEM;
+    if (len > MRVDRV_SIZE_OF_CMD_BUFFER ||
+        !(tlv = tlv_build_add(b, tag, sizeof(TLVBUF_HEADER) + len)))
+        return lib_error(dev, UAP_ERR_INVAL, "TLV 0x%04x too long", tag);
+    if (value)
+        memcpy(tlv->Data, value, len);
+    ret = lib_result(dev, b->buf, APCMD_SYS_CONFIGURE,
+                     tlv_build_send(dev, b));
+    if (ret != UAP_OK)
+        return ret;
+    tlv->Type = uap_le16_to_cpu(tlv->Type);
+    tlv->Len = uap_le16_to_cpu(tlv->Len);
+    if (tlv->Type != tag)
+        return lib_error(dev, UAP_ERR_PROTO, "Corrupted response! Tlv->Tag=%x",
+                         tlv->Type);
+    return UAP_OK;
+}
+
+/**
+ *  @brief Sends a command made of the header alone
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param cmd_code Command code
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+static int
+lib_simple_cmd(uap_dev * dev, u16 cmd_code)
+{
+    APCMDBUF cmd_buf;
+
+    memset(&cmd_buf, 0, sizeof(cmd_buf));
+    cmd_buf.CmdCode = cmd_code;
+    return lib_send(dev, (u8 *) & cmd_buf, sizeof(cmd_buf), sizeof(cmd_buf));
+}
+
+/**
+ *  @brief Exchanges a batch of OIDs, as many per command as fit
+ *
+ *  Each command carries the OIDs in order and the firmware answers a
+ *  GET in the same order, so response TLVs are matched by position and
+ *  their OID checked.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param action   ACTION_GET or ACTION_SET
+ *  @param oids     OIDs, values filled in on a GET
+ *  @param count    Number of OIDs
+ *  @param cmds     Returns the number of commands sent, or NULL
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+static int
+lib_snmp_oids(uap_dev * dev, u16 action, uap_oid * oids, int count,
+              int *cmds)
+{
+    u8 buf[MRVDRV_SIZE_OF_CMD_BUFFER];
+    APCMDBUF_SNMP_MIB *cmd_buf = (APCMDBUF_SNMP_MIB *) buf;
+    TLVBUF_HEADER *tlv;
+    int first, i, j, len, ret;
+
+    if (cmds)
+        *cmds = 0;
+    if (!oids || count < 0)
+        return lib_error(dev, UAP_ERR_INVAL, "Invalid argument");
+    for (i = 0; i < count; i++) {
+        if (oids[i].size != 1 && oids[i].size != 2 && oids[i].size != 4)
+            return lib_error(dev, UAP_ERR_INVAL, "Invalid size %d of OID %x",
+                             oids[i].size, oids[i].oid);
+    }
+    for (first = 0; first < count; first = i) {
+        memset(buf, 0, sizeof(APCMDBUF_SNMP_MIB));
+        cmd_buf->CmdCode = HostCmd_SNMP_MIB;
+        cmd_buf->Action = uap_cpu_to_le16(action);
+        len = sizeof(APCMDBUF_SNMP_MIB);
+        for (i = first; i < count; i++) {
+            if (len + sizeof(TLVBUF_HEADER) + oids[i].size > sizeof(buf))
+                break;
+            tlv = (TLVBUF_HEADER *) (buf + len);
+            tlv->Type = uap_cpu_to_le16(oids[i].oid);
+            tlv->Len = uap_cpu_to_le16(oids[i].size);
+            for (j = 0; j < oids[i].size; j++)
+                tlv->Data[j] = (action == ACTION_SET) ?
+                    (u8) (oids[i].value >> (8 * j)) : 0;
+            len += sizeof(TLVBUF_HEADER) + oids[i].size;
+        }
+        ret = lib_send(dev, buf, len, sizeof(buf));
+        if (ret != UAP_OK)
+            return ret;
+        if (cmds)
+            (*cmds)++;
+        if (action == ACTION_SET)
+            continue;
+        len = cmd_buf->Size - (sizeof(APCMDBUF_SNMP_MIB) - BUF_HEADER_SIZE);
+        tlv = (TLVBUF_HEADER *) (buf + sizeof(APCMDBUF_SNMP_MIB));
+        for (j = first; j < i; j++) {
+            if (len < (int) sizeof(TLVBUF_HEADER) ||
+                uap_le16_to_cpu(tlv->Type) != oids[j].oid ||
+                len < sizeof(TLVBUF_HEADER) + uap_le16_to_cpu(tlv->Len))
+                return lib_error(dev, UAP_ERR_PROTO,
+                                 "Corrupted response! OID=%x", oids[j].oid);
+            oids[j].value = get_le(tlv->Data,
+                                   MIN(uap_le16_to_cpu(tlv->Len),
+                                       oids[j].size));
+            len -= sizeof(TLVBUF_HEADER) + uap_le16_to_cpu(tlv->Len);
+            tlv = (TLVBUF_HEADER *) & tlv->Data[uap_le16_to_cpu(tlv->Len)];
+        }
+    }
+    return UAP_OK;
+}
+
+/**
+ *  @brief Returns part / (part + rest), or -1 without frames
+ *
+ *  @param part     Counted events
+ *  @param rest     Frames without the event
+ *  @return         Ratio
+ */
+static double
+kpi_ratio(unsigned int part, unsigned int rest)
+{
+    if (!part && !rest)
+        return -1;
+    return (double) part / ((double) part + rest);
+}
+
+/****************************************************************************
+        Global functions
+****************************************************************************/
+/**
+ *  @brief Gets the firmware system information string
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param info     Output string
+ *  @param len      Size of info, UAP_SYS_INFO_LEN is enough
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+int
+uap_get_sys_info(uap_dev * dev, char *info, int len)
+{
+    APCMDBUF_SYS_INFO_RESPONSE resp;
+    int ret;
+
+    if (!info || len <= 0)
+        return lib_error(dev, UAP_ERR_INVAL, "Invalid argument");
+    memset(&resp, 0, sizeof(resp));
+    resp.CmdCode = APCMD_SYS_INFO;
+    ret = lib_send(dev, (u8 *) & resp, sizeof(APCMDBUF_SYS_INFO_REQUEST),
+                   sizeof(resp));
+    if (ret != UAP_OK)
+        return ret;
+    snprintf(info, len, "%.*s", (int) sizeof(resp.SysInfo), resp.SysInfo);
+    return UAP_OK;
+}
+
+/**
+ *  @brief Starts the BSS
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+int
+uap_bss_start(uap_dev * dev)
+{
+    return lib_simple_cmd(dev, APCMD_BSS_START);
+}
+
+/**
+ *  @brief Stops the BSS
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+int
+uap_bss_stop(uap_dev * dev)
+{
+    return lib_simple_cmd(dev, APCMD_BSS_STOP);
+}
+
+/**
+ *  @brief Stores one station of uap_get_sta_list()
+ *
+ *  @param arg      lib_sta_array
+ *  @param sta      Station
+ *  @return         0 to go on
+ */
+static int
+lib_sta_store(void *arg, const uap_sta_info * sta)
+{
+    lib_sta_array *a = (lib_sta_array *) arg;
+
+    if (a->n < a->max)
+        a->sta[a->n++] = *sta;
+    return 0;
+}
+
+/**
+ *  @brief Gets the associated stations, one callback per station as the
+ *  response is decoded
+ *
+ *  The response is walked TLV by TLV, by tag and length, so TLVs other
+ *  than station information are skipped.  A response carrying fewer
+ *  stations than its count, as when they do not all fit in one host
+ *  command, fails with UAP_ERR_PROTO after the stations it carries.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param cb       Called for each station, non zero stops the walk
+ *  @param arg      Argument of cb
+ *  @param count    Returns the number of stations reported by the
+ *                  firmware
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+int
+uap_sta_list_walk(uap_dev * dev, uap_sta_cb cb, void *arg, int *count)
+{
+    u8 buf[MRVDRV_SIZE_OF_CMD_BUFFER];
+    APCMDBUF_STA_LIST_RESPONSE *resp = (APCMDBUF_STA_LIST_RESPONSE *) buf;
+    TLVBUF_STA_INFO *tlv;
+    uap_sta_info sta;
+    u8 *p, *end;
+    int ret, n = 0, len;
+
+    if (!cb || !count)
+        return lib_error(dev, UAP_ERR_INVAL, "Invalid argument");
+    memset(buf, 0, sizeof(APCMDBUF_STA_LIST_RESPONSE));
+    resp->CmdCode = APCMD_STA_LIST;
+    ret = lib_send(dev, buf, sizeof(APCMDBUF_STA_LIST_REQUEST), sizeof(buf));
+    if (ret != UAP_OK)
+        return ret;
+
+    *count = uap_le16_to_cpu(resp->StaCount);
+    p = (u8 *) resp->StaList;
+    end = buf + MIN(resp->Size + BUF_HEADER_SIZE, sizeof(buf));
+    while (p + sizeof(TLVBUF_HEADER) <= end) {
+        tlv = (TLVBUF_STA_INFO *) p;
+        len = sizeof(TLVBUF_HEADER) + uap_le16_to_cpu(tlv->Length);
+        if (p + len > end)
+            return lib_error(dev, UAP_ERR_PROTO, "TLV %d bytes past the "
+                             "response", (int) (p + len - end));
+        p += len;
+        if (uap_le16_to_cpu(tlv->Tag) != MRVL_STA_INFO_TLV_ID)
+            continue;
+        if (len < sizeof(TLVBUF_STA_INFO))
+            return lib_error(dev, UAP_ERR_PROTO,
+                             "STA %d information corrupted", n + 1);
+        memcpy(sta.mac, tlv->MacAddress, ETH_ALEN);
+        sta.power_save = tlv->PowerMfgStatus != 0;
+        /* On some platform, s8 is same as unsigned char */
+        sta.rssi = (int) tlv->Rssi;
+        if (sta.rssi > 0x7f)
+            sta.rssi -= 256;
+        n++;
+        if (cb(arg, &sta))
+            return UAP_OK;
+    }
+    if (n < *count)
+        return lib_error(dev, UAP_ERR_PROTO, "Response carries %d of %d "
+                         "stations", n, *count);
+    return UAP_OK;
+}
+
+/**
+ *  @brief Gets the associated stations
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param sta      Output array
+ *  @param max      Size of sta
+ *  @param count    Returns the number of stations reported by the
+ *                  firmware; at most max of them are stored
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+int
+uap_get_sta_list(uap_dev * dev, uap_sta_info * sta, int max, int *count)
+{
+    lib_sta_array a;
+
+    if (!count || max < 0 || (max && !sta))
+        return lib_error(dev, UAP_ERR_INVAL, "Invalid argument");
+    a.sta = sta;
+    a.max = max;
+    a.n = 0;
+    return uap_sta_list_walk(dev, lib_sta_store, &a, count);
+}
+
+/**
+ *  @brief Deauthenticates a station
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param mac      Station MAC address
+ *  @param reason   IEEE 802.11 reason code
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+int
+uap_sta_deauth(uap_dev * dev, const unsigned char *mac, unsigned short reason)
+{
+    APCMDBUF_STA_DEAUTH cmd_buf;
+
+    if (!mac)
+        return lib_error(dev, UAP_ERR_INVAL, "Invalid argument");
+    memset(&cmd_buf, 0, sizeof(cmd_buf));
+    cmd_buf.CmdCode = APCMD_STA_DEAUTH;
+    memcpy(cmd_buf.StaMacAddress, mac, ETH_ALEN);
+    cmd_buf.ReasonCode = uap_cpu_to_le16(reason);
+    return lib_send(dev, (u8 *) & cmd_buf, sizeof(cmd_buf), sizeof(cmd_buf));
+}
+
+/**
+ *  @brief Gets the 802.11 counters in one SNMP MIB request
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param stats    Output counters, counters not returned are left zero
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+int
+uap_get_stats(uap_dev * dev, uap_stats_info * stats)
+{
+    u8 buf[sizeof(APCMDBUF_SNMP_MIB) +
+           STATS_OIDS * (sizeof(TLVBUF_HEADER) + 4)];
+    APCMDBUF_SNMP_MIB *cmd_buf = (APCMDBUF_SNMP_MIB *) buf;
+    TLVBUF_HEADER *tlv;
+    int ret, i, size;
+    u16 type, len;
+
+    if (!stats)
+        return lib_error(dev, UAP_ERR_INVAL, "Invalid argument");
+    memset(buf, 0, sizeof(buf));
+    cmd_buf->CmdCode = HostCmd_SNMP_MIB;
+    cmd_buf->Action = uap_cpu_to_le16(ACTION_GET);
+    tlv = (TLVBUF_HEADER *) (buf + sizeof(APCMDBUF_SNMP_MIB));
+    for (i = 0; i < STATS_OIDS; i++) {
+        tlv->Type = uap_cpu_to_le16(stats_oids[i].oid);
+        tlv->Len = uap_cpu_to_le16(4);
+        tlv = (TLVBUF_HEADER *) & tlv->Data[4];
+    }
+    ret = lib_send(dev, buf, sizeof(buf), sizeof(buf));
+    if (ret != UAP_OK)
+        return ret;
+
+    memset(stats, 0, sizeof(uap_stats_info));
+    tlv = (TLVBUF_HEADER *) (buf + sizeof(APCMDBUF_SNMP_MIB));
+    size = cmd_buf->Size - (sizeof(APCMDBUF_SNMP_MIB) - BUF_HEADER_SIZE);
+    while (size >= (int) sizeof(TLVBUF_HEADER)) {
+        type = uap_le16_to_cpu(tlv->Type);
+        len = uap_le16_to_cpu(tlv->Len);
+        if (sizeof(TLVBUF_HEADER) + len > size)
+            break;
+        for (i = 0; i < STATS_OIDS; i++) {
+            if (stats_oids[i].oid == type && len <= 4) {
+                *(unsigned int *) ((u8 *) stats + stats_oids[i].offset) =
+                    get_le(tlv->Data, len);
+                break;
+            }
+        }
+        size -= sizeof(TLVBUF_HEADER) + len;
+        tlv = (TLVBUF_HEADER *) & tlv->Data[len];
+    }
+    return UAP_OK;
+}
+
+/**
+ *  @brief Gets one SNMP MIB value
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param oid      OID
+ *  @param size     Value size: 1, 2 or 4
+ *  @param value    Output value
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+int
+uap_snmp_get(uap_dev * dev, unsigned short oid, int size,
+             unsigned int *value)
+{
+    u8 buf[sizeof(APCMDBUF_SNMP_MIB) + sizeof(TLVBUF_HEADER) + 4];
+    APCMDBUF_SNMP_MIB *cmd_buf = (APCMDBUF_SNMP_MIB *) buf;
+    TLVBUF_HEADER *tlv = (TLVBUF_HEADER *) (buf + sizeof(APCMDBUF_SNMP_MIB));
+    int ret;
+
+    if ((size != 1 && size != 2 && size != 4) || !value)
+        return lib_error(dev, UAP_ERR_INVAL, "Invalid argument");
+    memset(buf, 0, sizeof(buf));
+    cmd_buf->CmdCode = HostCmd_SNMP_MIB;
+    cmd_buf->Action = uap_cpu_to_le16(ACTION_GET);
+    tlv->Type = uap_cpu_to_le16(oid);
+    tlv->Len = uap_cpu_to_le16(size);
+    ret = lib_send(dev, buf, sizeof(APCMDBUF_SNMP_MIB) +
+                   sizeof(TLVBUF_HEADER) + size, sizeof(buf));
+    if (ret != UAP_OK)
+        return ret;
+    if (uap_le16_to_cpu(tlv->Type) != oid)
+        return lib_error(dev, UAP_ERR_PROTO, "Corrupted response! OID=%x",
+                         uap_le16_to_cpu(tlv->Type));
+    *value = get_le(tlv->Data, MIN(uap_le16_to_cpu(tlv->Len), size));
+    return UAP_OK;
+}
+
+/**
+ *  @brief Sets one SNMP MIB value
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param oid      OID
+ *  @param size     Value size: 1, 2 or 4
+ *  @param value    Value
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+int
+uap_snmp_set(uap_dev * dev, unsigned short oid, int size, unsigned int value)
+{
+    u8 buf[sizeof(APCMDBUF_SNMP_MIB) + sizeof(TLVBUF_HEADER) + 4];
+    APCMDBUF_SNMP_MIB *cmd_buf = (APCMDBUF_SNMP_MIB *) buf;
+    TLVBUF_HEADER *tlv = (TLVBUF_HEADER *) (buf + sizeof(APCMDBUF_SNMP_MIB));
+    int i;
+
+    if (size != 1 && size != 2 && size != 4)
+        return lib_error(dev, UAP_ERR_INVAL, "Invalid argument");
+    memset(buf, 0, sizeof(buf));
+    cmd_buf->CmdCode = HostCmd_SNMP_MIB;
+    cmd_buf->Action = uap_cpu_to_le16(ACTION_SET);
+    tlv->Type = uap_cpu_to_le16(oid);
+    tlv->Len = uap_cpu_to_le16(size);
+    for (i = 0; i < size; i++)
+        tlv->Data[i] = (u8) (value >> (8 * i));
+    return lib_send(dev, buf, sizeof(APCMDBUF_SNMP_MIB) +
+                    sizeof(TLVBUF_HEADER) + size, sizeof(buf));
+}
+
+/**
+ *  @brief Gets a batch of SNMP MIB values
+ *
+ *  The OIDs are packed into as few HostCmd_SNMP_MIB commands as the
+ *  command buffer allows, in practice one for up to 250 OIDs.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param oids     OIDs and their sizes, values filled in
+ *  @param count    Number of OIDs
+ *  @param cmds     Returns the number of commands sent, or NULL
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+int
+uap_snmp_get_oids(uap_dev * dev, uap_oid * oids, int count, int *cmds)
+{
+    return lib_snmp_oids(dev, ACTION_GET, oids, count, cmds);
+}
+
+/**
+ *  @brief Sets a batch of SNMP MIB values
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param oids     OIDs, sizes and values
+ *  @param count    Number of OIDs
+ *  @param cmds     Returns the number of commands sent, or NULL
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+int
+uap_snmp_set_oids(uap_dev * dev, const uap_oid * oids, int count, int *cmds)
+{
+    return lib_snmp_oids(dev, ACTION_SET, (uap_oid *) oids, count, cmds);
+}
+
+/**
+ *  @brief Gets the SSID
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param ssid     Output string
+ *  @param len      Size of ssid, UAP_SSID_MAX_LEN + 1 is enough
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+int
+uap_get_ssid(uap_dev * dev, char *ssid, int len)
+{
+    tlv_builder b;
+    TLVBUF_SSID *tlv;
+    int ret;
+
+    if (!ssid || len <= 0)
+        return lib_error(dev, UAP_ERR_INVAL, "Invalid argument");
+    ret = lib_sys_cfg(dev, &b, ACTION_GET, MRVL_SSID_TLV_ID, NULL,
+                      MAX_SSID_LENGTH);
+    if (ret == UAP_OK) {
+        tlv = (TLVBUF_SSID *) (b.buf + sizeof(APCMDBUF_SYS_CONFIGURE));
+        snprintf(ssid, len, "%.*s", MIN(tlv->Length, MAX_SSID_LENGTH),
+                 (char *) tlv->Ssid);
+    }
+    tlv_build_free(dev, &b);
+    return ret;
+}
+
+/**
+ *  @brief Sets the SSID
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param ssid     SSID, 1 to UAP_SSID_MAX_LEN characters
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+int
+uap_set_ssid(uap_dev * dev, const char *ssid)
+{
+    tlv_builder b;
+    int len, ret;
+
+    if (!ssid || !(len = strlen(ssid)) || len > MAX_SSID_LENGTH)
+        return lib_error(dev, UAP_ERR_INVAL, "Invalid SSID");
+    ret = lib_sys_cfg(dev, &b, ACTION_SET, MRVL_SSID_TLV_ID, ssid, len);
+    tlv_build_free(dev, &b);
+    return ret;
+}
+
+/**
+ *  @brief Gets the channel
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param channel  Output channel number
+ *  @param acs      Output, non zero with automatic channel selection
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+int
+uap_get_channel(uap_dev * dev, int *channel, int *acs)
+{
+    tlv_builder b;
+    TLVBUF_CHANNEL_CONFIG *tlv;
+    int ret;
+
+    if (!channel || !acs)
+        return lib_error(dev, UAP_ERR_INVAL, "Invalid argument");
+    ret = lib_sys_cfg(dev, &b, ACTION_GET, MRVL_CHANNELCONFIG_TLV_ID, NULL, 2);
+    if (ret == UAP_OK) {
+        tlv = (TLVBUF_CHANNEL_CONFIG *) (b.buf +
+                                         sizeof(APCMDBUF_SYS_CONFIGURE));
+        *channel = tlv->ChanNumber;
+        *acs = tlv->BandConfigType != 0;
+    }
+    tlv_build_free(dev, &b);
+    return ret;
+}
+
+/**
+ *  @brief Sets the channel
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param channel  Channel number
+ *  @param acs      Non zero for automatic channel selection
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+int
+uap_set_channel(uap_dev * dev, int channel, int acs)
+{
+    tlv_builder b;
+    TLVBUF_CHANNEL_CONFIG cfg;
+    int ret;
+
+    if (channel < 0 || channel > 0xff)
+        return lib_error(dev, UAP_ERR_INVAL, "Invalid channel %d", channel);
+    cfg.BandConfigType = acs ? BAND_CONFIG_ACS_MODE : 0;
+    cfg.ChanNumber = (u8) channel;
+    ret = lib_sys_cfg(dev, &b, ACTION_SET, MRVL_CHANNELCONFIG_TLV_ID,
+                      &cfg.BandConfigType, 2);
+    tlv_build_free(dev, &b);
+    return ret;
+}
+
+/**
+ *  @brief Gets the raw value of a sys_configure TLV
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param tag      TLV tag
+ *  @param value    Output value, as the firmware returns it
+ *  @param len      Size of value on input, value length on output
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+int
+uap_get_tlv(uap_dev * dev, unsigned short tag, unsigned char *value,
+            int *len)
+{
+    tlv_builder b;
+    TLVBUF_HEADER *tlv;
+    int room = MRVDRV_SIZE_OF_CMD_BUFFER - sizeof(APCMDBUF_SYS_CONFIGURE) -
+        sizeof(TLVBUF_HEADER);
+    int ret;
+
+    if (!value || !len || *len < 0 || *len > room)
+        return lib_error(dev, UAP_ERR_INVAL, "Invalid argument");
+    ret = lib_sys_cfg(dev, &b, ACTION_GET, tag, NULL, *len);
+    if (ret == UAP_OK) {
+        tlv = (TLVBUF_HEADER *) (b.buf + sizeof(APCMDBUF_SYS_CONFIGURE));
+        if (tlv->Len > room) {
+            ret = lib_error(dev, UAP_ERR_PROTO, "TLV length %d", tlv->Len);
+        } else {
+            *len = MIN(tlv->Len, *len);
+            memcpy(value, tlv->Data, *len);
+        }
+    }
+    tlv_build_free(dev, &b);
+    return ret;
+}
+
+/**
+ *  @brief Sets the raw value of a sys_configure TLV
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param tag      TLV tag
+ *  @param value    Value, in firmware (little endian) format
+ *  @param len      Value length
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+int
+uap_set_tlv(uap_dev * dev, unsigned short tag, const unsigned char *value,
+            int len)
+{
+    tlv_builder b;
+    int ret;
+
+    if ((!value && len) || len < 0 ||
+        len > MRVDRV_SIZE_OF_CMD_BUFFER - sizeof(APCMDBUF_SYS_CONFIGURE) -
+        sizeof(TLVBUF_HEADER))
+        return lib_error(dev, UAP_ERR_INVAL, "Invalid argument");
+    ret = lib_sys_cfg(dev, &b, ACTION_SET, tag, value, len);
+    tlv_build_free(dev, &b);
+    return ret;
+}
+
+/**
+ *  @brief Gets several sys_configure TLVs with one command
+ *
+ *  The response TLVs are copied to buf, in firmware format, as a stream
+ *  print_tlv() can decode.  Each tlvs[] entry is then pointed at the
+ *  value of the first response TLV with its tag that no earlier entry
+ *  took, so keyed tags such as the antenna may be asked for twice.
+ *  Entries the firmware did not answer get a NULL value.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param tlvs     Tags, request lengths and optional request values in,
+ *                  response values out
+ *  @param count    Number of entries in tlvs
+ *  @param buf      Response buffer
+ *  @param len      Size of buf in, length of the response TLVs out
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+int
+uap_get_tlvs(uap_dev * dev, uap_tlv * tlvs, int count, unsigned char *buf,
+             int *len)
+{
+    tlv_builder b;
+    TLVBUF_HEADER *tlv;
+    int i, off, resp_len, tlv_len, ret;
+
+    if (!tlvs || count <= 0 || !buf || !len || *len < 0)
+        return lib_error(dev, UAP_ERR_INVAL, "Invalid argument");
+    if (tlv_build_start(dev, &b, ACTION_GET) != UAP_SUCCESS)
+        return UAP_ERR_NOMEM;
+    for (i = 0; i < count; i++) {
+        if (tlvs[i].len < 0 || tlvs[i].len > MRVDRV_SIZE_OF_CMD_BUFFER ||
+            !(tlv = tlv_build_add(&b, tlvs[i].tag,
+                                  sizeof(TLVBUF_HEADER) + tlvs[i].len))) {
+            tlv_build_free(dev, &b);
+            return lib_error(dev, UAP_ERR_INVAL, "Too many TLVs requested");
+        }
+        if (tlvs[i].value)
+            memcpy(tlv->Data, tlvs[i].value, tlvs[i].len);
+    }
+    ret = lib_result(dev, b.buf, APCMD_SYS_CONFIGURE,
+                     tlv_build_send(dev, &b));
+    if (ret != UAP_OK) {
+        tlv_build_free(dev, &b);
+        return ret;
+    }
+
+    resp_len = ((APCMDBUF_SYS_CONFIGURE *) b.buf)->Size + BUF_HEADER_SIZE -
+        sizeof(APCMDBUF_SYS_CONFIGURE);
+    if (resp_len < 0 || resp_len > MRVDRV_SIZE_OF_CMD_BUFFER -
+        sizeof(APCMDBUF_SYS_CONFIGURE))
+        ret = lib_error(dev, UAP_ERR_PROTO, "Response size %d", resp_len);
+    else if (resp_len > *len)
+        ret = lib_error(dev, UAP_ERR_INVAL, "Response buffer too small");
+    else
+        memcpy(buf, b.buf + sizeof(APCMDBUF_SYS_CONFIGURE), resp_len);
+    tlv_build_free(dev, &b);
+    if (ret != UAP_OK)
+        return ret;
+    *len = resp_len;
+
+    for (i = 0; i < count; i++) {
+        tlvs[i].value = NULL;
+        tlvs[i].len = 0;
+    }
+    for (off = 0; off + sizeof(TLVBUF_HEADER) <= resp_len; off += tlv_len) {
+        tlv = (TLVBUF_HEADER *) (buf + off);
+        tlv_len = sizeof(TLVBUF_HEADER) + uap_le16_to_cpu(tlv->Len);
+        if (off + tlv_len > resp_len)
+            return lib_error(dev, UAP_ERR_PROTO, "Truncated TLV 0x%04x",
+                             uap_le16_to_cpu(tlv->Type));
+        for (i = 0; i < count; i++) {
+            if (!tlvs[i].value && tlvs[i].tag == uap_le16_to_cpu(tlv->Type)) {
+                tlvs[i].value = tlv->Data;
+                tlvs[i].len = uap_le16_to_cpu(tlv->Len);
+                break;
+            }
+        }
+    }
+    return UAP_OK;
+}
+
+/**
+ *  @brief Computes the counter increments between two samples
+ *
+ *  The firmware counters are 32 bits wide and the increments are taken
+ *  modulo 2^32, so a counter that wrapped between the samples is right.
+ *
+ *  @param delta    Output increments
+ *  @param prev     Older sample
+ *  @param cur      Newer sample
+ *  @return         N/A
+ */
+void
+uap_stats_delta(uap_stats_info * delta, const uap_stats_info * prev,
+                const uap_stats_info * cur)
+{
+    int i;
+
+    for (i = 0; i < STATS_OIDS; i++)
+        *(unsigned int *) ((u8 *) delta + stats_oids[i].offset) =
+            *(unsigned int *) ((u8 *) cur + stats_oids[i].offset) -
+            *(unsigned int *) ((u8 *) prev + stats_oids[i].offset);
+}
+
+/**
+ *  @brief Initializes KPI state with the default alert thresholds
+ *
+ *  @param kpi      KPI state
+ *  @param alpha    EWMA weight of the newest window, 0 < alpha <= 1
+ *  @return         N/A
+ */
+void
+uap_kpi_init(uap_kpi * kpi, double alpha)
+{
+    int i;
+
+    memset(kpi, 0, sizeof(uap_kpi));
+    kpi->alpha = (alpha > 0 && alpha <= 1) ? alpha : 1;
+    for (i = 0; i < UAP_KPIS; i++) {
+        kpi->value[i] = kpi->ewma[i] = -1;
+        kpi->threshold[i] = kpi_thresholds[i];
+    }
+}
+
+/**
+ *  @brief Adds a window of counter increments to the KPIs
+ *
+ *  A ratio is only updated by windows with frames to divide by, so an
+ *  idle interval does not pull the average to zero.  An alert is
+ *  raised when the smoothed ratio goes above its threshold and cleared
+ *  when it drops to or below it.
+ *
+ *  @param kpi      KPI state
+ *  @param delta    Counter increments of the window
+ *  @return         Bit (1 << UAP_KPI_) set for each alert raised or
+ *                  cleared by this window
+ */
+int
+uap_kpi_update(uap_kpi * kpi, const uap_stats_info * delta)
+{
+    unsigned int decrypt;
+    int i, alert, changed = 0;
+
+    decrypt = delta->tkip_mic_failures + delta->ccmp_decrypt_errors +
+        delta->wep_undecryptable + delta->wep_icv_errors +
+        delta->decrypt_failures;
+    kpi->value[UAP_KPI_RETRY] = delta->tx_frames ?
+        (double) delta->retry / delta->tx_frames : -1;
+    kpi->value[UAP_KPI_FAILURE] = kpi_ratio(delta->failed, delta->tx_frames);
+    kpi->value[UAP_KPI_FCS_ERROR] = kpi_ratio(delta->fcs_errors,
+                                              delta->rx_fragments);
+    kpi->value[UAP_KPI_RTS_FAILURE] = kpi_ratio(delta->rts_failure,
+                                                delta->rts_success);
+    kpi->value[UAP_KPI_DECRYPT_ERROR] = kpi_ratio(decrypt,
+                                                  delta->rx_fragments);
+    for (i = 0; i < UAP_KPIS; i++) {
+        if (kpi->value[i] < 0)
+            continue;
+        if (kpi->ewma[i] < 0)
+            kpi->ewma[i] = kpi->value[i];
+        else
+            kpi->ewma[i] += kpi->alpha * (kpi->value[i] - kpi->ewma[i]);
+        alert = kpi->threshold[i] > 0 && kpi->ewma[i] > kpi->threshold[i];
+        if (alert != kpi->alert[i]) {
+            kpi->alert[i] = alert;
+            if (alert)
+                kpi->alerts[i]++;
+            changed |= 1 << i;
+        }
+    }
+    return changed;
+}
+
+/**
+ *  @brief Returns the name of a KPI
+ *
+ *  @param kpi      UAP_KPI_ index
+ *  @return         Name, NULL if unknown
+ */
+const char *
+uap_kpi_name(int kpi)
+{
+    return (kpi >= 0 && kpi < UAP_KPIS) ? kpi_names[kpi] : NULL;
+}
@@ -0,0 +1,254 @@
+/** @file  uaplib.h
+ *
+ *  @brief Public interface of libuaputl, the uAP control library
+ *
+ *  Every call works on a handle returned by uap_open().  The library
+ *  keeps no global state and prints nothing unless the handle was
+ *  opened with UAP_OPEN_VERBOSE.  Several threads may issue requests
+ *  on one handle at the same time: each request carries its own
+ *  sequence number and its response is matched against it.
+ *  uap_last_error() and uap_last_result() report the calling thread's
+ *  last request.  A sys_cfg batch collects the SETs of every thread
+ *  using the handle; the uaputl daemon, whose clients share one handle,
+ *  does not open one.
+ *
+ * Copyright (C) 2008-2009, Marvell International Ltd.
+ *
+ * This software file (the "File") is distributed by Marvell International
+ * Ltd. under the terms of the GNU General Public License Version 2, June 1991
+ * (the "License").  You may use, redistribute and/or modify this File in
+ * accordance with the terms and conditions of the License, a copy of which
+ * is available along with the File in the gpl.txt file or by writing to
+ * the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307 or on the worldwide web at http://www.gnu.org/licenses/gpl.txt.
+ *
+ * THE FILE IS DISTRIBUTED AS-IS, WITHOUT WARRANTY OF ANY KIND, AND THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE
+ * ARE EXPRESSLY DISCLAIMED.  The License provides additional details about
+ * this warranty disclaimer.
+ *
+ */
+/************************************************************************
+Change log:
+    10/17/26: Initial creation
+************************************************************************/
+
+#ifndef _UAPLIB_H
+#define _UAPLIB_H
+
+/** Success */
+#define UAP_OK                  0
+/** Invalid argument */
+#define UAP_ERR_INVAL           -1
+/** Out of memory */
+#define UAP_ERR_NOMEM           -2
+/** Interface or transport cannot be opened */
+#define UAP_ERR_NODEV           -3
+/** Request could not be exchanged with the firmware */
+#define UAP_ERR_IO              -4
+/** Firmware returned a failure result, see uap_last_result() */
+#define UAP_ERR_FW              -5
+/** Malformed or unexpected response */
+#define UAP_ERR_PROTO           -6
+/** Request did not complete before its deadline */
+#define UAP_ERR_TIMEOUT         -7
+/** In use by another running process */
+#define UAP_ERR_BUSY            -8
+
+/** uap_open() flag: print errors to stdout, as the uaputl tool does */
+#define UAP_OPEN_VERBOSE        0x1
+
+/** Maximum SSID length */
+#define UAP_SSID_MAX_LEN        32
+/** System information string size */
+#define UAP_SYS_INFO_LEN        64
+
+/** Most stations one station list response carries, all of a 2 KB
+ *  host command buffer */
+#define UAP_MAX_STA             169
+
+/** Opaque control handle of one uAP interface */
+typedef struct _uap_dev uap_dev;
+
+/** Associated station */
+typedef struct _uap_sta_info
+{
+    /** MAC address */
+    unsigned char mac[6];
+    /** Non zero when the station is in power save */
+    int power_save;
+    /** RSSI in dBm */
+    int rssi;
+} uap_sta_info;
+
+/** Called for each station of uap_sta_list_walk(), non zero stops it */
+typedef int (*uap_sta_cb) (void *arg, const uap_sta_info * sta);
+
+/** 802.11 counters, see the uap_stats command */
+typedef struct _uap_stats_info
+{
+    unsigned int tkip_mic_failures;
+    unsigned int ccmp_decrypt_errors;
+    unsigned int wep_undecryptable;
+    unsigned int wep_icv_errors;
+    unsigned int decrypt_failures;
+    unsigned int failed;
+    unsigned int retry;
+    unsigned int multiple_retry;
+    unsigned int frame_duplicate;
+    unsigned int rts_success;
+    unsigned int rts_failure;
+    unsigned int ack_failure;
+    unsigned int rx_fragments;
+    unsigned int rx_multicast_frames;
+    unsigned int fcs_errors;
+    unsigned int tx_frames;
+    unsigned int tkip_countermeasures;
+    unsigned int rsna_4way_failures;
+    unsigned int tx_multicast_frames;
+} uap_stats_info;
+
+/** KPIs derived from the 802.11 counters, see uap_kpi_update() */
+#define UAP_KPI_RETRY           0
+#define UAP_KPI_FAILURE         1
+#define UAP_KPI_FCS_ERROR       2
+#define UAP_KPI_RTS_FAILURE     3
+#define UAP_KPI_DECRYPT_ERROR   4
+#define UAP_KPIS                5
+
+/** KPI state over a series of counter windows */
+typedef struct _uap_kpi
+{
+    /** EWMA weight of the newest window, 0 < alpha <= 1 */
+    double alpha;
+    /** Ratio of the last window, negative when it had no frames */
+    double value[UAP_KPIS];
+    /** Smoothed ratio, negative until a window had frames */
+    double ewma[UAP_KPIS];
+    /** Alert threshold of the smoothed ratio, 0 for none */
+    double threshold[UAP_KPIS];
+    /** Non zero while the smoothed ratio is above its threshold */
+    int alert[UAP_KPIS];
+    /** Number of times each alert was raised */
+    unsigned int alerts[UAP_KPIS];
+} uap_kpi;
+
+/** One TLV of a uap_get_tlvs() query */
+typedef struct _uap_tlv
+{
+    /** TLV tag */
+    unsigned short tag;
+    /** Value length */
+    unsigned short len;
+    /** Value in firmware (little endian) format, NULL for zeros */
+    unsigned char *value;
+} uap_tlv;
+
+/** One OID of a uap_snmp_get_oids() or uap_snmp_set_oids() batch */
+typedef struct _uap_oid
+{
+    /** OID */
+    unsigned short oid;
+    /** Value size: 1, 2 or 4 */
+    int size;
+    /** Value */
+    unsigned int value;
+} uap_oid;
+
+/** Stations kept per uap_shm_rec */
+#define UAP_SHM_MAX_STA         UAP_MAX_STA
+
+/** One record of a shared-memory ring, see uap_shm_create() */
+typedef struct _uap_shm_rec
+{
+    /** Seqlock: 2n once record n is complete, odd while it is written */
+    unsigned long long seq;
+    /** CLOCK_REALTIME of the poll in ns */
+    unsigned long long time_ns;
+    /** 802.11 counters */
+    uap_stats_info stats;
+    /** Stations associated */
+    int sta_total;
+    /** Stations in sta[], at most UAP_SHM_MAX_STA */
+    int sta_count;
+    /** Stations */
+    uap_sta_info sta[UAP_SHM_MAX_STA];
+} uap_shm_rec;
+
+/** Opaque handle of a mapped shared-memory ring */
+typedef struct _uap_shm uap_shm;
+
+/* Handles */
+int uap_open(uap_dev ** dev, const char *ifname, const char *transport,
+             int flags);
+void uap_close(uap_dev * dev);
+const char *uap_strerror(int err);
+const char *uap_last_error(uap_dev * dev);
+int uap_last_result(uap_dev * dev);
+
+/* Commands, each returns UAP_OK or a UAP_ERR_ code */
+int uap_get_sys_info(uap_dev * dev, char *info, int len);
+int uap_bss_start(uap_dev * dev);
+int uap_bss_stop(uap_dev * dev);
+int uap_get_sta_list(uap_dev * dev, uap_sta_info * sta, int max,
+                     int *count);
+int uap_sta_list_walk(uap_dev * dev, uap_sta_cb cb, void *arg, int *count);
+int uap_sta_deauth(uap_dev * dev, const unsigned char *mac,
+                   unsigned short reason);
+int uap_get_stats(uap_dev * dev, uap_stats_info * stats);
+int uap_snmp_get(uap_dev * dev, unsigned short oid, int size,
+                 unsigned int *value);
+int uap_snmp_set(uap_dev * dev, unsigned short oid, int size,
+                 unsigned int value);
+int uap_snmp_get_oids(uap_dev * dev, uap_oid * oids, int count, int *cmds);
+int uap_snmp_set_oids(uap_dev * dev, const uap_oid * oids, int count,
+                      int *cmds);
+int uap_get_ssid(uap_dev * dev, char *ssid, int len);
+int uap_set_ssid(uap_dev * dev, const char *ssid);
+int uap_get_channel(uap_dev * dev, int *channel, int *acs);
+int uap_set_channel(uap_dev * dev, int channel, int acs);
+int uap_get_tlv(uap_dev * dev, unsigned short tag, unsigned char *value,
+                int *len);
+int uap_set_tlv(uap_dev * dev, unsigned short tag,
+                const unsigned char *value, int len);
+int uap_get_tlvs(uap_dev * dev, uap_tlv * tlvs, int count,
+                 unsigned char *buf, int *len);
+
+/* Counter deltas and KPIs, no request is sent */
+void uap_stats_delta(uap_stats_info * delta, const uap_stats_info * prev,
+                     const uap_stats_info * cur);
+void uap_kpi_init(uap_kpi * kpi, double alpha);
+int uap_kpi_update(uap_kpi * kpi, const uap_stats_info * delta);
+const char *uap_kpi_name(int kpi);
+
+/* Request policy: a deadline per attempt (0 for none, the default) and
+ * retries with exponential backoff of EBUSY and EAGAIN.  Deadlines
+ * interrupt the request with signal SIGRTMIN + 1.  An interrupted
+ * command may already be queued to the firmware, so ETIMEDOUT is only
+ * retried once uap_set_retry_timeouts() enabled it. */
+int uap_set_timeout(uap_dev * dev, unsigned short cmd_code, int timeout_ms);
+int uap_set_retry(uap_dev * dev, int retries, int backoff_ms);
+int uap_set_retry_timeouts(uap_dev * dev, int enable);
+
+/* sys_cfg batches: SETs between begin and commit go out together */
+int uap_cfg_begin(uap_dev * dev);
+int uap_cfg_commit(uap_dev * dev, int *sets, int *cmds);
+int uap_cfg_abort(uap_dev * dev);
+
+/* Shared-memory ring in /dev/shm: one publisher, any number of readers.
+ * Reading sends no request and makes no system call. */
+int uap_shm_create(uap_shm ** shm, const char *name, int slots,
+                   int interval_ms);
+int uap_shm_publish(uap_shm * shm, const uap_stats_info * stats,
+                    const uap_sta_info * sta, int count);
+int uap_shm_open(uap_shm ** shm, const char *name);
+void uap_shm_close(uap_shm * shm);
+unsigned long long uap_shm_head(uap_shm * shm);
+int uap_shm_slots(uap_shm * shm);
+int uap_shm_publisher(uap_shm * shm, int *interval_ms);
+const uap_shm_rec *uap_shm_peek(uap_shm * shm, unsigned long long n);
+int uap_shm_valid(uap_shm * shm, const uap_shm_rec * rec,
+                  unsigned long long n);
+int uap_shm_read(uap_shm * shm, unsigned long long n, uap_shm_rec * rec);
+
+#endif /* _UAPLIB_H */
@@ -0,0 +1,1219 @@
+/** @file  uaplog.c
+ *
+ *  @brief This file contains the counter log: sampling of the AP
+ *  counters into a compact append-only file, and its offline query.
+ *
+ * Copyright (C) 2008-2009, Marvell International Ltd.
+ *
+ * This software file (the "File") is distributed by Marvell International
+ * Ltd. under the terms of the GNU General Public License Version 2, June 1991
+ * (the "License").  You may use, redistribute and/or modify this File in
+ * accordance with the terms and conditions of the License, a copy of which
+ * is available along with the File in the gpl.txt file or by writing to
+ * the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307 or on the worldwide web at http://www.gnu.org/licenses/gpl.txt.
+ *
+ * THE FILE IS DISTRIBUTED AS-IS, WITHOUT WARRANTY OF ANY KIND, AND THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE
+ * ARE EXPRESSLY DISCLAIMED.  The License provides additional details about
+ * this warranty disclaimer.
+ *
+ */
+/****************************************************************************
+Change log:
+    10/17/26: Initial creation
+****************************************************************************/
+
+/****************************************************************************
+        Header files
+****************************************************************************/
+/** strptime() */
+#define _GNU_SOURCE
+#include <sys/types.h>
+#include <stdio.h>
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <linux/if.h>
+#include "uaputl.h"
+#include "uapcmd.h"
+
+/****************************************************************************
+        Definitions
+****************************************************************************/
+/*
+ * Log file layout, all integers little endian:
+ *
+ *   header  "UAPTSLOG", u8 version, 7 reserved bytes
+ *   record  u8 type, varint payload length, payload
+ *
+ *   DEF     varint id, u8 kind, 6 byte key: names series id
+ *   KEY     u64 time in ms, varint n, n x (varint id, zigzag value)
+ *   DELTA   varint ms since the previous sample,
+ *           varint n, n x (varint id, zigzag change),
+ *           varint g, g x (varint id)
+ *
+ * A KEY lists every series of its sample.  A DELTA lists the series that
+ * changed, with their change modulo 2^32, or appeared, with their value,
+ * then the g series that disappeared; the other series keep their value.
+ * Records are length prefixed, so a query skips to the KEY before its
+ * start without decoding values, and a torn record at the end of the
+ * file is ignored.
+ */
+
+/** Log file magic */
+#define TSLOG_MAGIC             "UAPTSLOG"
+/** Log file magic length */
+#define TSLOG_MAGIC_LEN         8
+/** Log file format version */
+#define TSLOG_VERSION           1
+/** Log file header length */
+#define TSLOG_HDR_LEN           16
+
+/** Record types */
+#define TSLOG_REC_DEF           1
+#define TSLOG_REC_KEY           2
+#define TSLOG_REC_DELTA         3
+
+/** Series kinds */
+#define TSLOG_KIND_SNMP         1
+#define TSLOG_KIND_STA_COUNT    2
+#define TSLOG_KIND_RSSI         3
+#define TSLOG_KIND_COEX         4
+
+/** Counters are queried as rates, the other kinds as values */
+#define TSLOG_KIND_COUNTER(kind) \
+    ((kind) == TSLOG_KIND_SNMP || (kind) == TSLOG_KIND_COEX)
+
+/** Series key length */
+#define TSLOG_KEY_LEN           6
+/** Maximum number of series in one log file */
+#define TSLOG_MAX_SERIES        1024
+/** Maximum record payload */
+#define TSLOG_MAX_REC           (16 + TSLOG_MAX_SERIES * 2 * 10)
+/** Maximum number of SNMP counters sampled */
+#define TSLOG_MAX_OIDS          64
+/** Maximum number of --series prefixes */
+#define TSLOG_MAX_PREFIXES      16
+/** Series name length */
+#define TSLOG_NAME_LEN          48
+
+/** Default sampling interval in ms */
+#define TSLOG_DEFAULT_INTERVAL  10000
+/** Default number of samples from one KEY to the next */
+#define TSLOG_DEFAULT_KEYFRAME  60
+
+/** Sources of tslog_record */
+#define TSLOG_SRC_STATS         0x1
+#define TSLOG_SRC_STA           0x2
+#define TSLOG_SRC_COEX          0x4
+
+/** One series of a log */
+typedef struct _tslog_series
+{
+    /** TSLOG_KIND_ */
+    u8 kind;
+    /** OID, MAC address or coex statistic index */
+    u8 key[TSLOG_KEY_LEN];
+    /** Non zero when the series has a value in the last sample */
+    int present;
+    /** Value in the last sample */
+    unsigned int value;
+} tslog_series;
+
+/** Log state, of the writer or of the reader */
+typedef struct _tslog
+{
+    /** Series, by id */
+    tslog_series series[TSLOG_MAX_SERIES];
+    /** Number of series */
+    int num;
+    /** Time of the last sample in ms */
+    u64 last_ms;
+} tslog;
+
+/** One sample being written */
+typedef struct _tslog_sample
+{
+    /** Series ids */
+    int id[TSLOG_MAX_SERIES];
+    /** Values */
+    unsigned int value[TSLOG_MAX_SERIES];
+    /** Number of values */
+    int num;
+    /** Number of values dropped for lack of series */
+    int dropped;
+} tslog_sample;
+
+/** Values of one series in a query window */
+typedef struct _tslog_agg
+{
+    /** Values */
+    double *v;
+    /** Number of values */
+    int num;
+    /** Allocated values */
+    int cap;
+    /** Non zero when the series is selected */
+    int selected;
+    /** Previous counter value, for rates */
+    unsigned int prev;
+    /** Time of the previous counter value in ms, 0 for none */
+    u64 prev_ms;
+} tslog_agg;
+
+/** Options of the tslog commands */
+static struct option tslog_options[] = {
+    {"help", 0, NULL, 'h'},
+    {"interval", 1, NULL, 'i'},
+    {"count", 1, NULL, 'c'},
+    {"keyframe", 1, NULL, 'k'},
+    {"max-size", 1, NULL, 'm'},
+    {"sources", 1, NULL, 's'},
+    {"from", 1, NULL, 'F'},
+    {"to", 1, NULL, 'T'},
+    {"window", 1, NULL, 'w'},
+    {"series", 1, NULL, 'S'},
+    {NULL, 0, NULL, '\0'}
+};
+
+/** Set by SIGINT to end tslog_record */
+static volatile sig_atomic_t tslog_stop;
+
+/****************************************************************************
+        Local functions
+****************************************************************************/
+/**
+ *  @brief Stores a varint
+ *
+ *  @param p        Destination, at least 10 bytes
+ *  @param v        Value
+ *  @return         Number of bytes stored
+ */
+static int
+put_varint(u8 * p, u64 v)
+{
+    int n = 0;
+
+    while (v >= 0x80) {
+        p[n++] = (u8) (v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (u8) v;
+    return n;
+}
+
+/**
+ *  @brief Reads a varint
+ *
+ *  @param p        Source
+ *  @param end      End of the source
+ *  @param v        Output value
+ *  @return         Number of bytes read, 0 if truncated
+ */
+static int
+get_varint(u8 * p, u8 * end, u64 * v)
+{
+    int n = 0, shift = 0;
+
+    *v = 0;
+    while (p + n < end && shift < 64) {
+        *v |= (u64) (p[n] & 0x7f) << shift;
+        if (!(p[n++] & 0x80))
+            return n;
+        shift += 7;
+    }
+    return 0;
+}
+
+/**
+ *  @brief Maps a 32 bit value, read as signed, to a small unsigned one
+ *
+ *  @param d        Value
+ *  @return         Zigzag value: 0, -1, 1, -2, ... map to 0, 1, 2, 3, ...
+ */
+static unsigned int
+zigzag(unsigned int d)
+{
+    return (d << 1) ^ (0U - (d >> 31));
+}
+
+/**
+ *  @brief Reverses zigzag()
+ *
+ *  @param z        Zigzag value
+ *  @return         Value
+ */
+static unsigned int
+unzigzag(unsigned int z)
+{
+    return (z >> 1) ^ (0U - (z & 1));
+}
+
+/**
+ *  @brief Returns the wall clock time in ms
+ *
+ *  @return         Milliseconds since the epoch
+ */
+static u64
+tslog_now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (u64) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ *  @brief SIGINT handler of tslog_record
+ *
+ *  @param sig      Signal number
+ *  @return         N/A
+ */
+static void
+tslog_sigint(int sig)
+{
+    tslog_stop = 1;
+}
+
+/**
+ *  @brief Formats the name of a series
+ *
+ *  @param s        Series
+ *  @param name     Output buffer of TSLOG_NAME_LEN bytes
+ *  @return         name
+ */
+static char *
+tslog_series_name(tslog_series * s, char *name)
+{
+    const char *oid_name;
+    u16 oid;
+
+    switch (s->kind) {
+    case TSLOG_KIND_SNMP:
+        oid = s->key[0] | (s->key[1] << 8);
+        oid_name = snmp_oid_name(oid);
+        if (oid_name)
+            snprintf(name, TSLOG_NAME_LEN, "%s", oid_name);
+        else
+            snprintf(name, TSLOG_NAME_LEN, "oid:0x%02x", oid);
+        break;
+    case TSLOG_KIND_STA_COUNT:
+        snprintf(name, TSLOG_NAME_LEN, "sta_count");
+        break;
+    case TSLOG_KIND_RSSI:
+        snprintf(name, TSLOG_NAME_LEN, "rssi:%02x:%02x:%02x:%02x:%02x:%02x",
+                 s->key[0], s->key[1], s->key[2], s->key[3], s->key[4],
+                 s->key[5]);
+        break;
+    case TSLOG_KIND_COEX:
+        snprintf(name, TSLOG_NAME_LEN, "coex:%s", coex_stats_name(s->key[0]) ?
+                 coex_stats_name(s->key[0]) : "unknown");
+        break;
+    default:
+        snprintf(name, TSLOG_NAME_LEN, "unknown:%d", s->kind);
+        break;
+    }
+    return name;
+}
+
+/**
+ *  @brief Writes a record
+ *
+ *  @param fp       Log file
+ *  @param type     TSLOG_REC_ type
+ *  @param payload  Payload
+ *  @param len      Payload length
+ *  @return         Number of bytes written, -1 on error
+ */
+static long
+tslog_write_rec(FILE * fp, u8 type, u8 * payload, int len)
+{
+    u8 hdr[11];
+    int n;
+
+    hdr[0] = type;
+    n = 1 + put_varint(hdr + 1, len);
+    if (fwrite(hdr, 1, n, fp) != n || fwrite(payload, 1, len, fp) != len)
+        return -1;
+    return n + len;
+}
+
+/**
+ *  @brief Adds a value to a sample, defining its series if it is new
+ *
+ *  @param log      Log state
+ *  @param fp       Log file, for the DEF record
+ *  @param sample   Sample
+ *  @param kind     TSLOG_KIND_
+ *  @param key      Series key, TSLOG_KEY_LEN bytes
+ *  @param value    Value
+ *  @return         Number of bytes written, -1 on error
+ */
+static long
+tslog_add(tslog * log, FILE * fp, tslog_sample * sample, u8 kind, u8 * key,
+          unsigned int value)
+{
+    u8 def[10 + 1 + TSLOG_KEY_LEN];
+    long written = 0;
+    int id, n;
+
+    for (id = 0; id < log->num; id++) {
+        if (log->series[id].kind == kind &&
+            !memcmp(log->series[id].key, key, TSLOG_KEY_LEN))
+            break;
+    }
+    if (id == log->num) {
+        if (id == TSLOG_MAX_SERIES) {
+            sample->dropped++;
+            return 0;
+        }
+        memset(&log->series[id], 0, sizeof(tslog_series));
+        log->series[id].kind = kind;
+        memcpy(log->series[id].key, key, TSLOG_KEY_LEN);
+        log->num++;
+        n = put_varint(def, id);
+        def[n++] = kind;
+        memcpy(def + n, key, TSLOG_KEY_LEN);
+        written = tslog_write_rec(fp, TSLOG_REC_DEF, def, n + TSLOG_KEY_LEN);
+    }
+    sample->id[sample->num] = id;
+    sample->value[sample->num++] = value;
+    return written;
+}
+
+/**
+ *  @brief Takes one sample of the AP counters and appends it to the log
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param log      Log state
+ *  @param fp       Log file
+ *  @param sources  TSLOG_SRC_ flags
+ *  @param key      Non zero to write a KEY record
+ *  @param sample   Scratch sample
+ *  @return         Number of bytes written, -1 on error
+ */
+static long
+tslog_sample_write(uap_dev * dev, tslog * log, FILE * fp, int sources,
+                   int key, tslog_sample * sample)
+{
+    static u8 rec[TSLOG_MAX_REC];
+    static u8 gone[TSLOG_MAX_SERIES];
+    uap_oid oids[TSLOG_MAX_OIDS];
+    uap_sta_info sta[UAP_MAX_STA];
+    unsigned int coex[COEX_STATS];
+    u8 k[TSLOG_KEY_LEN];
+    tslog_series *s;
+    u64 now_ms;
+    long written = 0, w = 0;
+    int i, id, num_oids, count, changed, num_gone, len;
+
+    sample->num = 0;
+    now_ms = tslog_now_ms();
+    memset(k, 0, sizeof(k));
+    num_oids = snmp_counter_oids(oids, TSLOG_MAX_OIDS);
+    if ((sources & TSLOG_SRC_STATS) &&
+        uap_snmp_get_oids(dev, oids, num_oids, NULL) == UAP_OK) {
+        for (i = 0; i < num_oids && w >= 0; i++) {
+            k[0] = oids[i].oid & 0xff;
+            k[1] = oids[i].oid >> 8;
+            w = tslog_add(log, fp, sample, TSLOG_KIND_SNMP, k,
+                          oids[i].value);
+            written += w;
+        }
+    }
+    memset(k, 0, sizeof(k));
+    if ((sources & TSLOG_SRC_STA) && w >= 0 &&
+        uap_get_sta_list(dev, sta, UAP_MAX_STA, &count) == UAP_OK) {
+        w = tslog_add(log, fp, sample, TSLOG_KIND_STA_COUNT, k, count);
+        written += w;
+        for (i = 0; i < count && i < UAP_MAX_STA && w >= 0; i++) {
+            w = tslog_add(log, fp, sample, TSLOG_KIND_RSSI, sta[i].mac,
+                          (unsigned int) sta[i].rssi);
+            written += w;
+        }
+    }
+    if ((sources & TSLOG_SRC_COEX) && w >= 0 &&
+        coex_stats_get(dev, coex) == UAP_SUCCESS) {
+        for (i = 0; i < COEX_STATS && w >= 0; i++) {
+            k[0] = (u8) i;
+            w = tslog_add(log, fp, sample, TSLOG_KIND_COEX, k, coex[i]);
+            written += w;
+        }
+    }
+    if (w < 0)
+        return -1;
+    if (!sample->num)
+        return written;
+
+    memset(gone, 1, log->num);
+    for (i = 0; i < sample->num; i++)
+        gone[sample->id[i]] = 0;
+    len = 0;
+    if (key) {
+        for (i = 0; i < 8; i++)
+            rec[len++] = (u8) (now_ms >> (8 * i));
+        len += put_varint(rec + len, sample->num);
+        for (i = 0; i < sample->num; i++) {
+            len += put_varint(rec + len, sample->id[i]);
+            len += put_varint(rec + len, zigzag(sample->value[i]));
+        }
+    } else {
+        /* Both counts come before their entries */
+        for (i = 0, changed = 0; i < sample->num; i++) {
+            s = &log->series[sample->id[i]];
+            if (!s->present || s->value != sample->value[i])
+                changed++;
+        }
+        for (id = 0, num_gone = 0; id < log->num; id++) {
+            if (gone[id] && log->series[id].present)
+                num_gone++;
+        }
+        len += put_varint(rec + len, now_ms - log->last_ms);
+        len += put_varint(rec + len, changed);
+        for (i = 0; i < sample->num; i++) {
+            s = &log->series[sample->id[i]];
+            if (!s->present) {
+                len += put_varint(rec + len, sample->id[i]);
+                len += put_varint(rec + len, zigzag(sample->value[i]));
+            } else if (s->value != sample->value[i]) {
+                len += put_varint(rec + len, sample->id[i]);
+                len += put_varint(rec + len,
+                                  zigzag(sample->value[i] - s->value));
+            }
+        }
+        len += put_varint(rec + len, num_gone);
+        for (id = 0; id < log->num; id++) {
+            if (gone[id] && log->series[id].present)
+                len += put_varint(rec + len, id);
+        }
+    }
+    for (id = 0; id < log->num; id++) {
+        if (gone[id])
+            log->series[id].present = 0;
+    }
+    for (i = 0; i < sample->num; i++) {
+        log->series[sample->id[i]].present = 1;
+        log->series[sample->id[i]].value = sample->value[i];
+    }
+    log->last_ms = now_ms;
+    w = tslog_write_rec(fp, key ? TSLOG_REC_KEY : TSLOG_REC_DELTA, rec, len);
+    if (w < 0 || fflush(fp))
+        return -1;
+    return written + w;
+}
+
+/**
+ *  @brief Loads a log file
+ *
+ *  @param file     Log file name
+ *  @param len      Returns the file length
+ *  @return         File contents to free, NULL on error
+ */
+static u8 *
+tslog_load(char *file, long *len)
+{
+    FILE *fp;
+    u8 *data = NULL;
+
+    fp = fopen(file, "r");
+    if (!fp) {
+        printf("ERR:Cannot open %s: %s\n", file, strerror(errno));
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    *len = ftell(fp);
+    rewind(fp);
+    if (*len >= TSLOG_HDR_LEN)
+        data = (u8 *) malloc(*len);
+    if (!data || fread(data, 1, *len, fp) != *len ||
+        memcmp(data, TSLOG_MAGIC, TSLOG_MAGIC_LEN) ||
+        data[TSLOG_MAGIC_LEN] != TSLOG_VERSION) {
+        printf("ERR:%s is not a counter log\n", file);
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+    return data;
+}
+
+/**
+ *  @brief Reads a record header
+ *
+ *  @param p        Record
+ *  @param end      End of the log
+ *  @param payload  Returns the payload
+ *  @return         Payload length, -1 for a truncated record
+ */
+static long
+tslog_next_rec(u8 * p, u8 * end, u8 ** payload)
+{
+    u64 len;
+    int n;
+
+    n = get_varint(p + 1, end, &len);
+    if (!n || len > end - (p + 1 + n))
+        return -1;
+    *payload = p + 1 + n;
+    return (long) len;
+}
+
+/**
+ *  @brief Reads the time of a KEY record
+ *
+ *  @param p        Payload, at least 8 bytes
+ *  @return         Time in ms
+ */
+static u64
+tslog_key_ms(u8 * p)
+{
+    u64 ms = 0;
+    int i;
+
+    for (i = 0; i < 8; i++)
+        ms |= (u64) p[i] << (8 * i);
+    return ms;
+}
+
+/**
+ *  @brief Decodes a DEF record into the log state
+ *
+ *  @param log      Log state
+ *  @param p        Payload
+ *  @param len      Payload length
+ *  @return         N/A
+ */
+static void
+tslog_read_def(tslog * log, u8 * p, long len)
+{
+    u64 id;
+    int n;
+
+    n = get_varint(p, p + len, &id);
+    if (!n || n + 1 + TSLOG_KEY_LEN > len || id != log->num ||
+        log->num == TSLOG_MAX_SERIES)
+        return;
+    memset(&log->series[id], 0, sizeof(tslog_series));
+    log->series[id].kind = p[n];
+    memcpy(log->series[id].key, p + n + 1, TSLOG_KEY_LEN);
+    log->num++;
+}
+
+/**
+ *  @brief Decodes a KEY or DELTA record into the log state
+ *
+ *  @param log      Log state, last_ms is the time of the sample
+ *  @param type     TSLOG_REC_KEY or TSLOG_REC_DELTA
+ *  @param p        Payload
+ *  @param len      Payload length
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+tslog_read_sample(tslog * log, u8 type, u8 * p, long len)
+{
+    u8 *end = p + len;
+    tslog_series *s;
+    u64 num, id, v;
+    int i, n;
+
+    if (type == TSLOG_REC_KEY) {
+        if (len < 8)
+            return UAP_FAILURE;
+        log->last_ms = tslog_key_ms(p);
+        p += 8;
+        for (i = 0; i < log->num; i++)
+            log->series[i].present = 0;
+    } else {
+        n = get_varint(p, end, &v);
+        if (!n)
+            return UAP_FAILURE;
+        p += n;
+        log->last_ms += v;
+    }
+    n = get_varint(p, end, &num);
+    if (!n)
+        return UAP_FAILURE;
+    for (p += n; num; num--) {
+        n = get_varint(p, end, &id);
+        if (!n || id >= log->num)
+            return UAP_FAILURE;
+        p += n;
+        n = get_varint(p, end, &v);
+        if (!n)
+            return UAP_FAILURE;
+        p += n;
+        s = &log->series[id];
+        if (s->present)
+            s->value += unzigzag((unsigned int) v);
+        else
+            s->value = unzigzag((unsigned int) v);
+        s->present = 1;
+    }
+    if (type == TSLOG_REC_KEY)
+        return UAP_SUCCESS;
+    n = get_varint(p, end, &num);
+    if (!n)
+        return UAP_FAILURE;
+    for (p += n; num; num--) {
+        n = get_varint(p, end, &id);
+        if (!n || id >= log->num)
+            return UAP_FAILURE;
+        p += n;
+        log->series[id].present = 0;
+    }
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Opens a log for appending, reading the series it defines
+ *
+ *  @param file     Log file name
+ *  @param log      Log state to fill
+ *  @param size     Returns the file size
+ *  @return         Log file, NULL on error
+ */
+static FILE *
+tslog_open_append(char *file, tslog * log, long *size)
+{
+    u8 hdr[TSLOG_HDR_LEN];
+    u8 *data, *p, *payload;
+    FILE *fp;
+    long len;
+
+    memset(log, 0, sizeof(tslog));
+    fp = fopen(file, "a");
+    if (!fp) {
+        printf("ERR:Cannot open %s: %s\n", file, strerror(errno));
+        return NULL;
+    }
+    *size = ftell(fp);
+    if (!*size) {
+        memset(hdr, 0, sizeof(hdr));
+        memcpy(hdr, TSLOG_MAGIC, TSLOG_MAGIC_LEN);
+        hdr[TSLOG_MAGIC_LEN] = TSLOG_VERSION;
+        if (fwrite(hdr, 1, sizeof(hdr), fp) != sizeof(hdr) || fflush(fp)) {
+            printf("ERR:Cannot write %s: %s\n", file, strerror(errno));
+            fclose(fp);
+            return NULL;
+        }
+        *size = sizeof(hdr);
+        return fp;
+    }
+    data = tslog_load(file, size);
+    if (!data) {
+        fclose(fp);
+        return NULL;
+    }
+    /* Series ids continue from the DEFs already in the file */
+    for (p = data + TSLOG_HDR_LEN; p < data + *size; p = payload + len) {
+        len = tslog_next_rec(p, data + *size, &payload);
+        if (len < 0) {
+            printf("ERR:%s ends with a truncated record\n", file);
+            free(data);
+            fclose(fp);
+            return NULL;
+        }
+        if (p[0] == TSLOG_REC_DEF)
+            tslog_read_def(log, payload, len);
+    }
+    free(data);
+    return fp;
+}
+
+/**
+ *  @brief Parses a query time
+ *
+ *  @param arg      Seconds since the epoch, YYYY-MM-DDTHH:MM:SS local
+ *                  time, or -seconds before the end of the log
+ *  @param end_ms   Time of the last sample in ms
+ *  @param ms       Returns the time in ms
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+tslog_parse_time(char *arg, u64 end_ms, u64 * ms)
+{
+    struct tm tm;
+    char *end;
+    double secs;
+
+    memset(&tm, 0, sizeof(tm));
+    end = strptime(arg, "%Y-%m-%dT%H:%M:%S", &tm);
+    if (end && !*end) {
+        tm.tm_isdst = -1;
+        *ms = (u64) mktime(&tm) * 1000;
+        return UAP_SUCCESS;
+    }
+    secs = strtod(arg, &end);
+    if (end == arg || *end)
+        return UAP_FAILURE;
+    if (arg[0] != '-')
+        *ms = secs * 1000;
+    else if (end_ms + secs * 1000 > 0)
+        *ms = end_ms + secs * 1000;
+    else
+        *ms = 0;
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Formats a time in ms as local time
+ *
+ *  @param ms       Milliseconds since the epoch
+ *  @param buf      Output buffer of 32 bytes
+ *  @return         buf
+ */
+static char *
+tslog_format_time(u64 ms, char *buf)
+{
+    time_t t = ms / 1000;
+    struct tm tm;
+
+    localtime_r(&t, &tm);
+    strftime(buf, 32, "%Y-%m-%d %H:%M:%S", &tm);
+    return buf;
+}
+
+/**
+ *  @brief Compares two doubles for qsort
+ *
+ *  @param a        First value
+ *  @param b        Second value
+ *  @return         <0, 0 or >0
+ */
+static int
+tslog_cmp(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ *  @brief Adds the value of a series to the query window
+ *
+ *  @param s        Series
+ *  @param agg      Values of the series
+ *  @param ms       Time of the sample in ms
+ *  @param in_range Non zero when the sample is in the queried range
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+tslog_agg_add(tslog_series * s, tslog_agg * agg, u64 ms, int in_range)
+{
+    double v, *nv;
+
+    if (!agg->selected)
+        return UAP_SUCCESS;
+    if (TSLOG_KIND_COUNTER(s->kind)) {
+        /* A rate needs the previous value, which may be out of range */
+        v = -1;
+        if (agg->prev_ms && ms > agg->prev_ms)
+            v = (s->value - agg->prev) * 1000.0 / (ms - agg->prev_ms);
+        agg->prev = s->value;
+        agg->prev_ms = ms;
+        if (v < 0)
+            return UAP_SUCCESS;
+    } else {
+        v = (int) s->value;
+    }
+    if (!in_range)
+        return UAP_SUCCESS;
+    if (agg->num == agg->cap) {
+        nv = (double *) realloc(agg->v, (agg->cap * 2 + 64) * sizeof(double));
+        if (!nv)
+            return UAP_FAILURE;
+        agg->v = nv;
+        agg->cap = agg->cap * 2 + 64;
+    }
+    agg->v[agg->num++] = v;
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Prints the aggregates of one query window and empties it
+ *
+ *  @param log      Log state
+ *  @param agg      Values of each series
+ *  @param start_ms Start of the window in ms
+ *  @param end_ms   End of the window in ms
+ *  @return         N/A
+ */
+static void
+tslog_print_window(tslog * log, tslog_agg * agg, u64 start_ms, u64 end_ms)
+{
+    char name[TSLOG_NAME_LEN], from[32], to[32];
+    double sum, *v;
+    int id, i, n, header = 0;
+
+    for (id = 0; id < log->num; id++) {
+        n = agg[id].num;
+        if (!n)
+            continue;
+        if (!header++) {
+            printf("\n%s - %s\n", tslog_format_time(start_ms, from),
+                   tslog_format_time(end_ms, to));
+            printf("%-40s %6s %10s %10s %10s %10s %10s\n", "Series",
+                   "Count", "Min", "Avg", "P50", "P95", "Max");
+        }
+        v = agg[id].v;
+        qsort(v, n, sizeof(double), tslog_cmp);
+        for (i = 0, sum = 0; i < n; i++)
+            sum += v[i];
+        tslog_series_name(&log->series[id], name);
+        if (TSLOG_KIND_COUNTER(log->series[id].kind))
+            strncat(name, "/s", TSLOG_NAME_LEN - strlen(name) - 1);
+        /* Nearest rank percentiles */
+        printf("%-40s %6d %10.2f %10.2f %10.2f %10.2f %10.2f\n", name, n,
+               v[0], sum / n, v[(n + 1) / 2 - 1], v[(n * 95 + 99) / 100 - 1],
+               v[n - 1]);
+        agg[id].num = 0;
+    }
+}
+
+/**
+ *  @brief Show usage information for the tslog_record command
+ *
+ *  $return         N/A
+ */
+static void
+print_tslog_record_usage(void)
+{
+    printf("\nUsage : tslog_record <LOG_FILE> [--interval <ms>] "
+           "[--count <n>]\n"
+           "                     [--keyframe <n>] [--max-size <bytes>]\n"
+           "                     [--sources <stats,sta,coex>]\n");
+    printf("\nAppends a sample of the AP counters to LOG_FILE every "
+           "interval (default %d ms)\n", TSLOG_DEFAULT_INTERVAL);
+    printf("until count samples were taken or Ctrl-C.  Samples are "
+           "delta coded, with a\n"
+           "full KEY sample every keyframe samples (default %d).  "
+           "Past max-size bytes\n"
+           "the log is renamed to LOG_FILE.1 and a new one started.\n",
+           TSLOG_DEFAULT_KEYFRAME);
+    printf("\nSources (default all):\n"
+           "    stats   802.11 counters, as with snmp_get\n"
+           "    sta     station count and the RSSI of each station\n"
+           "    coex    BT coex statistics\n");
+    return;
+}
+
+/**
+ *  @brief Show usage information for the tslog_query command
+ *
+ *  $return         N/A
+ */
+static void
+print_tslog_query_usage(void)
+{
+    printf("\nUsage : tslog_query <LOG_FILE> [--from <time>] [--to <time>]\n"
+           "                    [--window <seconds>] "
+           "[--series <prefix,...>]\n");
+    printf("\nPrints count, min, avg, median, 95th percentile and max of "
+           "each series over\n"
+           "every window of the range (default one window).  Counters "
+           "are shown as\n"
+           "rates per second.  A time is seconds since the epoch, "
+           "YYYY-MM-DDTHH:MM:SS,\n"
+           "or -seconds before the last sample.\n");
+    return;
+}
+
+/****************************************************************************
+        Global functions
+****************************************************************************/
+/**
+ *  @brief Records the AP counters into a log file
+ *
+ *  Usage: "tslog_record <LOG_FILE> [--interval <ms>] [--count <n>]
+ *          [--keyframe <n>] [--max-size <bytes>] [--sources <list>]"
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param argc     Number of arguments
+ *  @param argv     Pointer to the arguments
+ *  @return         N/A
+ */
+void
+apcmd_tslog_record(uap_dev * dev, int argc, char *argv[])
+{
+    static tslog log;
+    static tslog_sample sample;
+    struct sigaction sa, old_sa;
+    struct timespec next;
+    char rotated[256];
+    char *tok, *file;
+    long interval_ms = TSLOG_DEFAULT_INTERVAL, count = 0;
+    long keyframe = TSLOG_DEFAULT_KEYFRAME, max_size = 0;
+    long size, w, n, since_key = 0, bytes = 0;
+    int opt, sources = 0, dropped = 0;
+    FILE *fp;
+
+    while ((opt = getopt_long(argc, argv, "hi:c:k:m:s:", tslog_options,
+                              NULL)) != -1) {
+        switch (opt) {
+        case 'i':
+            interval_ms = atol(optarg);
+            break;
+        case 'c':
+            count = atol(optarg);
+            break;
+        case 'k':
+            keyframe = atol(optarg);
+            break;
+        case 'm':
+            max_size = atol(optarg);
+            break;
+        case 's':
+            for (tok = strtok(optarg, ","); tok; tok = strtok(NULL, ",")) {
+                if (!strcmp(tok, "stats")) {
+                    sources |= TSLOG_SRC_STATS;
+                } else if (!strcmp(tok, "sta")) {
+                    sources |= TSLOG_SRC_STA;
+                } else if (!strcmp(tok, "coex")) {
+                    sources |= TSLOG_SRC_COEX;
+                } else {
+                    printf("ERR:Unknown source %s\n", tok);
+                    print_tslog_record_usage();
+                    return;
+                }
+            }
+            break;
+        default:
+            print_tslog_record_usage();
+            return;
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (argc != 1) {
+        printf("ERR:Incorrect number of arguments.\n");
+        print_tslog_record_usage();
+        return;
+    }
+    if (interval_ms <= 0 || count < 0 || keyframe <= 0 || max_size < 0) {
+        printf("ERR:Invalid interval, count, keyframe or max-size.\n");
+        return;
+    }
+    if (uapd_allowed("tslog_record") != UAP_SUCCESS)
+        return;
+    if (!sources)
+        sources = TSLOG_SRC_STATS | TSLOG_SRC_STA | TSLOG_SRC_COEX;
+    file = argv[0];
+    fp = tslog_open_append(file, &log, &size);
+    if (!fp)
+        return;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = tslog_sigint;
+    sigemptyset(&sa.sa_mask);
+    tslog_stop = 0;
+    sigaction(SIGINT, &sa, &old_sa);
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (n = 0; !count || n < count; n++) {
+        if (n) {
+            next.tv_sec += interval_ms / 1000;
+            next.tv_nsec += (interval_ms % 1000) * 1000000;
+            if (next.tv_nsec >= 1000000000) {
+                next.tv_sec++;
+                next.tv_nsec -= 1000000000;
+            }
+            while (!tslog_stop &&
+                   clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next,
+                                   NULL) == EINTR) ;
+        }
+        if (tslog_stop)
+            break;
+        /* A file opens with a KEY, a reader knows nothing before it */
+        w = tslog_sample_write(dev, &log, fp, sources, !since_key, &sample);
+        if (w < 0) {
+            printf("ERR:Cannot write %s: %s\n", file, strerror(errno));
+            break;
+        }
+        since_key = (since_key + 1) % keyframe;
+        if (sample.dropped && !dropped++)
+            printf("WARN:More than %d series, new ones are dropped\n",
+                   TSLOG_MAX_SERIES);
+        size += w;
+        bytes += w;
+        if (max_size && size >= max_size) {
+            fclose(fp);
+            fp = NULL;
+            snprintf(rotated, sizeof(rotated), "%s.1", file);
+            if (rename(file, rotated)) {
+                printf("ERR:Cannot rename %s: %s\n", file, strerror(errno));
+                break;
+            }
+            fp = tslog_open_append(file, &log, &size);
+            if (!fp)
+                break;
+            since_key = 0;
+        }
+    }
+    sigaction(SIGINT, &old_sa, NULL);
+    if (fp)
+        fclose(fp);
+    printf("Recorded %ld samples, %ld bytes (%.1f bytes/sample)\n", n,
+           bytes, n ? (double) bytes / n : 0.0);
+    return;
+}
+
+/**
+ *  @brief Queries a counter log
+ *
+ *  Usage: "tslog_query <LOG_FILE> [--from <time>] [--to <time>]
+ *          [--window <seconds>] [--series <prefix,...>]"
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param argc     Number of arguments
+ *  @param argv     Pointer to the arguments
+ *  @return         N/A
+ */
+void
+apcmd_tslog_query(uap_dev * dev, int argc, char *argv[])
+{
+    static tslog log;
+    static tslog_agg agg[TSLOG_MAX_SERIES];
+    char *prefixes[TSLOG_MAX_PREFIXES];
+    char name[TSLOG_NAME_LEN];
+    char *from_arg = NULL, *to_arg = NULL, *series_arg = NULL, *tok;
+    u8 *data, *end, *p, *payload, *start = NULL;
+    u64 v, ms, first_ms = 0, last_ms = 0, from_ms, to_ms;
+    u64 window_ms = 0, win_start, win_end;
+    long len, rec_len, records = 0, samples = 0, decoded = 0;
+    int opt, i, id, num_prefixes = 0, in_range, ret = UAP_SUCCESS;
+
+    while ((opt = getopt_long(argc, argv, "hF:T:w:S:", tslog_options,
+                              NULL)) != -1) {
+        switch (opt) {
+        case 'F':
+            from_arg = optarg;
+            break;
+        case 'T':
+            to_arg = optarg;
+            break;
+        case 'w':
+            window_ms = atof(optarg) * 1000;
+            break;
+        case 'S':
+            series_arg = optarg;
+            break;
+        default:
+            print_tslog_query_usage();
+            return;
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (argc != 1) {
+        printf("ERR:Incorrect number of arguments.\n");
+        print_tslog_query_usage();
+        return;
+    }
+    for (tok = series_arg ? strtok(series_arg, ",") : NULL;
+         tok && num_prefixes < TSLOG_MAX_PREFIXES; tok = strtok(NULL, ","))
+        prefixes[num_prefixes++] = tok;
+    data = tslog_load(argv[0], &len);
+    if (!data)
+        return;
+    end = data + len;
+
+    /* Pass 1: record headers, DEFs and sample times only */
+    memset(&log, 0, sizeof(log));
+    for (p = data + TSLOG_HDR_LEN; p < end; p = payload + rec_len) {
+        rec_len = tslog_next_rec(p, end, &payload);
+        if (rec_len < 0) {
+            printf("WARN:Ignoring a truncated record at offset %ld\n",
+                   (long) (p - data));
+            end = p;
+            break;
+        }
+        records++;
+        if (p[0] == TSLOG_REC_DEF) {
+            tslog_read_def(&log, payload, rec_len);
+        } else if (p[0] == TSLOG_REC_KEY && rec_len >= 8) {
+            last_ms = tslog_key_ms(payload);
+            if (!start)
+                first_ms = last_ms;
+            start = p;
+            samples++;
+        } else if (p[0] == TSLOG_REC_DELTA && start &&
+                   get_varint(payload, payload + rec_len, &v)) {
+            last_ms += v;
+            samples++;
+        }
+    }
+    if (!start) {
+        printf("Log has no samples\n");
+        free(data);
+        return;
+    }
+    from_ms = first_ms;
+    to_ms = last_ms;
+    if ((from_arg && tslog_parse_time(from_arg, last_ms, &from_ms) !=
+         UAP_SUCCESS) ||
+        (to_arg && tslog_parse_time(to_arg, last_ms, &to_ms) != UAP_SUCCESS)) {
+        printf("ERR:Invalid time.\n");
+        free(data);
+        return;
+    }
+    for (id = 0; id < log.num; id++) {
+        memset(&agg[id], 0, sizeof(tslog_agg));
+        tslog_series_name(&log.series[id], name);
+        agg[id].selected = !num_prefixes;
+        for (i = 0; i < num_prefixes; i++) {
+            if (!strncmp(name, prefixes[i], strlen(prefixes[i])))
+                agg[id].selected = 1;
+        }
+    }
+
+    /* Start at the last KEY at or before the range, skipping the rest */
+    start = NULL;
+    for (p = data + TSLOG_HDR_LEN; p < end; p = payload + rec_len) {
+        rec_len = tslog_next_rec(p, end, &payload);
+        if (p[0] != TSLOG_REC_KEY || rec_len < 8)
+            continue;
+        if (start && tslog_key_ms(payload) > from_ms)
+            break;
+        start = p;
+    }
+
+    /* Pass 2: decode samples from that KEY to the end of the range */
+    win_start = from_ms;
+    win_end = window_ms ? from_ms + window_ms : to_ms + 1;
+    for (p = start; p < end && ret == UAP_SUCCESS; p = payload + rec_len) {
+        rec_len = tslog_next_rec(p, end, &payload);
+        if (p[0] != TSLOG_REC_KEY && p[0] != TSLOG_REC_DELTA)
+            continue;
+        if (tslog_read_sample(&log, p[0], payload, rec_len) != UAP_SUCCESS) {
+            printf("ERR:Corrupted record at offset %ld\n",
+                   (long) (p - data));
+            break;
+        }
+        ms = log.last_ms;
+        if (ms > to_ms)
+            break;
+        decoded++;
+        in_range = ms >= from_ms;
+        while (in_range && ms >= win_end) {
+            tslog_print_window(&log, agg, win_start, win_end);
+            win_start = win_end;
+            win_end += window_ms;
+        }
+        for (id = 0; id < log.num && ret == UAP_SUCCESS; id++) {
+            if (log.series[id].present)
+                ret = tslog_agg_add(&log.series[id], &agg[id], ms, in_range);
+        }
+        if (ret != UAP_SUCCESS)
+            printf("ERR:Cannot allocate memory!\n");
+    }
+    tslog_print_window(&log, agg, win_start, window_ms ? win_end : to_ms);
+    printf("\n%ld records, %ld samples, %ld decoded, %d series\n", records,
+           samples, decoded, log.num);
+    for (id = 0; id < log.num; id++)
+        free(agg[id].v);
+    free(data);
+    return;
+}
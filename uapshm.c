@@ -0,0 +1,413 @@
+/** @file  uapshm.c
+ *
+ *  @brief This file contains the shared-memory ring of libuaputl: one
+ *  publisher writes station and counter records, any number of local
+ *  readers use them in place.
+ *
+ * Copyright (C) 2008-2009, Marvell International Ltd.
+ *
+ * This software file (the "File") is distributed by Marvell International
+ * Ltd. under the terms of the GNU General Public License Version 2, June 1991
+ * (the "License").  You may use, redistribute and/or modify this File in
+ * accordance with the terms and conditions of the License, a copy of which
+ * is available along with the File in the gpl.txt file or by writing to
+ * the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307 or on the worldwide web at http://www.gnu.org/licenses/gpl.txt.
+ *
+ * THE FILE IS DISTRIBUTED AS-IS, WITHOUT WARRANTY OF ANY KIND, AND THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE
+ * ARE EXPRESSLY DISCLAIMED.  The License provides additional details about
+ * this warranty disclaimer.
+ *
+ */
+/****************************************************************************
+Change log:
+    10/17/26: Initial creation
+****************************************************************************/
+
+/****************************************************************************
+        Header files
+****************************************************************************/
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "uaplib.h"
+
+/****************************************************************************
+        Definitions
+****************************************************************************/
+/*
+ * The segment holds a header followed by a ring of uap_shm_rec slots.
+ * Record n (from 1) goes to slot n % slots.  Each slot is a seqlock:
+ * the publisher sets its seq to 2n - 1, writes the record, then sets
+ * seq to 2n and the header head to n.  A reader of record n checks that
+ * seq is 2n before and after using the record; any other value means
+ * the slot was being written or already holds a newer record.
+ */
+
+/** Segment magic */
+#define SHM_MAGIC               0x55415053
+/** Segment layout version */
+#define SHM_VERSION             1
+/** Header size, the slots start on their own cache line */
+#define SHM_HDR_SIZE            64
+
+/** Segment header */
+typedef struct _shm_hdr
+{
+    /** SHM_MAGIC, written last */
+    unsigned int magic;
+    /** SHM_VERSION */
+    unsigned int version;
+    /** Number of slots */
+    unsigned int slots;
+    /** sizeof(uap_shm_rec) */
+    unsigned int rec_size;
+    /** Last record published, 0 for none */
+    unsigned long long head;
+    /** Publisher pid, 0 once it stopped */
+    int pid;
+    /** Publishing interval in ms */
+    int interval_ms;
+} shm_hdr;
+
+/** Handle of a mapped segment */
+struct _uap_shm
+{
+    /** Segment header */
+    shm_hdr *hdr;
+    /** First slot */
+    uap_shm_rec *ring;
+    /** Mapped length */
+    size_t len;
+    /** Non zero for the publisher */
+    int writer;
+};
+
+/****************************************************************************
+        Local functions
+****************************************************************************/
+/**
+ *  @brief Returns the slot of a record
+ *
+ *  @param shm      Segment handle
+ *  @param n        Record number
+ *  @return         Slot
+ */
+static uap_shm_rec *
+shm_slot(uap_shm * shm, unsigned long long n)
+{
+    return &shm->ring[n % shm->hdr->slots];
+}
+
+/**
+ *  @brief Retires the segment a new publisher replaces
+ *
+ *  Readers still mapping the old segment see its publisher pid drop
+ *  to 0 once the name is reused. A segment of another layout is
+ *  replaced as is.
+ *
+ *  @param name     Segment name, as for shm_open()
+ *  @return         UAP_OK, or UAP_ERR_BUSY if its publisher is running
+ */
+static int
+shm_retire(const char *name)
+{
+    shm_hdr *hdr;
+    struct stat st;
+    int fd, pid, ret = UAP_OK;
+
+    fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0)
+        return UAP_OK;
+    if (fstat(fd, &st) < 0 || st.st_size < SHM_HDR_SIZE) {
+        close(fd);
+        return UAP_OK;
+    }
+    hdr = mmap(NULL, SHM_HDR_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+               0);
+    close(fd);
+    if (hdr == MAP_FAILED)
+        return UAP_OK;
+    if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) == SHM_MAGIC) {
+        pid = __atomic_load_n(&hdr->pid, __ATOMIC_ACQUIRE);
+        if (pid > 0 && (kill(pid, 0) == 0 || errno == EPERM))
+            ret = UAP_ERR_BUSY;
+        else
+            __atomic_store_n(&hdr->pid, 0, __ATOMIC_RELEASE);
+    }
+    munmap(hdr, SHM_HDR_SIZE);
+    return ret;
+}
+
+/****************************************************************************
+        Global functions
+****************************************************************************/
+/**
+ *  @brief Creates a segment for publishing
+ *
+ *  A segment of the same name is replaced unless its publisher is still
+ *  running; readers still mapping it see its publisher pid drop to 0.
+ *
+ *  @param shm          Returns the handle
+ *  @param name         Segment name, as for shm_open()
+ *  @param slots        Number of records kept
+ *  @param interval_ms  Publishing interval, for readers
+ *  @return             UAP_OK, UAP_ERR_BUSY if another publisher is
+ *                      running, or another UAP_ERR_ code
+ */
+int
+uap_shm_create(uap_shm ** shm, const char *name, int slots,
+               int interval_ms)
+{
+    uap_shm *s;
+    int fd, ret;
+
+    if (!shm || !name || slots < 2)
+        return UAP_ERR_INVAL;
+    ret = shm_retire(name);
+    if (ret != UAP_OK)
+        return ret;
+    s = calloc(1, sizeof(uap_shm));
+    if (!s)
+        return UAP_ERR_NOMEM;
+    s->len = SHM_HDR_SIZE + (size_t) slots * sizeof(uap_shm_rec);
+    s->writer = 1;
+    shm_unlink(name);
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0 || ftruncate(fd, s->len) < 0) {
+        if (fd >= 0) {
+            close(fd);
+            shm_unlink(name);
+        }
+        free(s);
+        return UAP_ERR_NODEV;
+    }
+    s->hdr = mmap(NULL, s->len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (s->hdr == MAP_FAILED) {
+        shm_unlink(name);
+        free(s);
+        return UAP_ERR_NOMEM;
+    }
+    s->ring = (uap_shm_rec *) ((char *) s->hdr + SHM_HDR_SIZE);
+    /* ftruncate() zeroed the segment, every slot is empty */
+    s->hdr->version = SHM_VERSION;
+    s->hdr->slots = slots;
+    s->hdr->rec_size = sizeof(uap_shm_rec);
+    s->hdr->pid = getpid();
+    s->hdr->interval_ms = interval_ms;
+    __atomic_store_n(&s->hdr->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+    *shm = s;
+    return UAP_OK;
+}
+
+/**
+ *  @brief Publishes one record
+ *
+ *  @param shm      Segment handle from uap_shm_create()
+ *  @param stats    802.11 counters
+ *  @param sta      Stations
+ *  @param count    Number of stations, at most UAP_SHM_MAX_STA are kept
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+int
+uap_shm_publish(uap_shm * shm, const uap_stats_info * stats,
+                const uap_sta_info * sta, int count)
+{
+    struct timespec ts;
+    uap_shm_rec *rec;
+    unsigned long long n;
+
+    if (!shm || !shm->writer || !stats || count < 0 || (count && !sta))
+        return UAP_ERR_INVAL;
+    n = shm->hdr->head + 1;
+    rec = shm_slot(shm, n);
+    __atomic_store_n(&rec->seq, 2 * n - 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    clock_gettime(CLOCK_REALTIME, &ts);
+    rec->time_ns = (unsigned long long) ts.tv_sec * 1000000000 + ts.tv_nsec;
+    rec->stats = *stats;
+    rec->sta_total = count;
+    if (count > UAP_SHM_MAX_STA)
+        count = UAP_SHM_MAX_STA;
+    rec->sta_count = count;
+    memcpy(rec->sta, sta, count * sizeof(uap_sta_info));
+    __atomic_store_n(&rec->seq, 2 * n, __ATOMIC_RELEASE);
+    __atomic_store_n(&shm->hdr->head, n, __ATOMIC_RELEASE);
+    return UAP_OK;
+}
+
+/**
+ *  @brief Maps a segment for reading
+ *
+ *  @param shm      Returns the handle
+ *  @param name     Segment name, as for shm_open()
+ *  @return         UAP_OK or a UAP_ERR_ code
+ */
+int
+uap_shm_open(uap_shm ** shm, const char *name)
+{
+    struct stat st;
+    uap_shm *s;
+    int fd;
+
+    if (!shm || !name)
+        return UAP_ERR_INVAL;
+    s = calloc(1, sizeof(uap_shm));
+    if (!s)
+        return UAP_ERR_NOMEM;
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0 || fstat(fd, &st) < 0 || st.st_size < SHM_HDR_SIZE) {
+        if (fd >= 0)
+            close(fd);
+        free(s);
+        return UAP_ERR_NODEV;
+    }
+    s->len = st.st_size;
+    s->hdr = mmap(NULL, s->len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (s->hdr == MAP_FAILED) {
+        free(s);
+        return UAP_ERR_NOMEM;
+    }
+    s->ring = (uap_shm_rec *) ((char *) s->hdr + SHM_HDR_SIZE);
+    if (__atomic_load_n(&s->hdr->magic, __ATOMIC_ACQUIRE) != SHM_MAGIC ||
+        s->hdr->version != SHM_VERSION ||
+        s->hdr->rec_size != sizeof(uap_shm_rec) || s->hdr->slots < 2 ||
+        s->len < SHM_HDR_SIZE +
+        (size_t) s->hdr->slots * sizeof(uap_shm_rec)) {
+        munmap(s->hdr, s->len);
+        free(s);
+        return UAP_ERR_PROTO;
+    }
+    *shm = s;
+    return UAP_OK;
+}
+
+/**
+ *  @brief Unmaps a segment
+ *
+ *  The publisher marks the segment stopped; the segment itself stays
+ *  until replaced, so readers keep the last records.
+ *
+ *  @param shm      Segment handle
+ *  @return         N/A
+ */
+void
+uap_shm_close(uap_shm * shm)
+{
+    if (!shm)
+        return;
+    if (shm->writer)
+        __atomic_store_n(&shm->hdr->pid, 0, __ATOMIC_RELEASE);
+    munmap(shm->hdr, shm->len);
+    free(shm);
+}
+
+/**
+ *  @brief Returns the number of the last record published
+ *
+ *  @param shm      Segment handle
+ *  @return         Record number, 0 before the first record
+ */
+unsigned long long
+uap_shm_head(uap_shm * shm)
+{
+    return __atomic_load_n(&shm->hdr->head, __ATOMIC_ACQUIRE);
+}
+
+/**
+ *  @brief Returns the number of records the ring keeps
+ *
+ *  @param shm      Segment handle
+ *  @return         Number of slots
+ */
+int
+uap_shm_slots(uap_shm * shm)
+{
+    return shm->hdr->slots;
+}
+
+/**
+ *  @brief Returns the publisher state
+ *
+ *  @param shm          Segment handle
+ *  @param interval_ms  Returns the publishing interval, may be NULL
+ *  @return             Publisher pid, 0 once it stopped
+ */
+int
+uap_shm_publisher(uap_shm * shm, int *interval_ms)
+{
+    if (interval_ms)
+        *interval_ms = shm->hdr->interval_ms;
+    return __atomic_load_n(&shm->hdr->pid, __ATOMIC_ACQUIRE);
+}
+
+/**
+ *  @brief Returns a record in place, without copying it
+ *
+ *  The record may be overwritten while it is used: call
+ *  uap_shm_valid() once done, and discard what was read if it fails.
+ *
+ *  @param shm      Segment handle
+ *  @param n        Record number
+ *  @return         Record, NULL if record n is not in the ring
+ */
+const uap_shm_rec *
+uap_shm_peek(uap_shm * shm, unsigned long long n)
+{
+    uap_shm_rec *rec;
+
+    if (!n)
+        return NULL;
+    rec = shm_slot(shm, n);
+    if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != 2 * n)
+        return NULL;
+    return rec;
+}
+
+/**
+ *  @brief Checks that a record from uap_shm_peek() was not overwritten
+ *
+ *  @param shm      Segment handle
+ *  @param rec      Record
+ *  @param n        Record number
+ *  @return         Non zero if everything read from rec is record n
+ */
+int
+uap_shm_valid(uap_shm * shm, const uap_shm_rec * rec, unsigned long long n)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&rec->seq, __ATOMIC_RELAXED) == 2 * n;
+}
+
+/**
+ *  @brief Copies a record
+ *
+ *  @param shm      Segment handle
+ *  @param n        Record number
+ *  @param rec      Returns the record
+ *  @return         UAP_OK, or UAP_ERR_INVAL if record n is not in the
+ *                  ring (not yet published or overwritten)
+ */
+int
+uap_shm_read(uap_shm * shm, unsigned long long n, uap_shm_rec * rec)
+{
+    const uap_shm_rec *slot;
+
+    slot = uap_shm_peek(shm, n);
+    if (!slot)
+        return UAP_ERR_INVAL;
+    memcpy(rec, slot, sizeof(uap_shm_rec));
+    if (!uap_shm_valid(shm, slot, n))
+        return UAP_ERR_INVAL;
+    return UAP_OK;
+}
@@ -0,0 +1,1088 @@
+/** @file  uapsim.c
+ *
+ *  @brief This file contains a simulated uAP firmware, used as a
+ *  transport backend when no uAP card or driver is available.
+ *
+ * Copyright (C) 2008-2009, Marvell International Ltd.
+ *
+ * This software file (the "File") is distributed by Marvell International
+ * Ltd. under the terms of the GNU General Public License Version 2, June 1991
+ * (the "License").  You may use, redistribute and/or modify this File in
+ * accordance with the terms and conditions of the License, a copy of which
+ * is available along with the File in the gpl.txt file or by writing to
+ * the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307 or on the worldwide web at http://www.gnu.org/licenses/gpl.txt.
+ *
+ * THE FILE IS DISTRIBUTED AS-IS, WITHOUT WARRANTY OF ANY KIND, AND THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE
+ * ARE EXPRESSLY DISCLAIMED.  The License provides additional details about
+ * this warranty disclaimer.
+ *
+ */
+/****************************************************************************
+Change log:
+    10/17/26: Initial creation
+****************************************************************************/
+
+/****************************************************************************
+        Header files
+****************************************************************************/
+#include <sys/types.h>
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <linux/if.h>
+#include "uaputl.h"
+
+/****************************************************************************
+        Definitions
+****************************************************************************/
+/** Size of a simulated TLV store */
+#define SIM_STORE_SIZE          MRVDRV_SIZE_OF_CMD_BUFFER
+/** Maximum number of simulated stations */
+#define SIM_MAX_STA             256
+/** Default number of associated stations */
+#define SIM_DEFAULT_STA         4
+/** Number of simulated memory/register words */
+#define SIM_MAX_WORDS           64
+/** Number of SNMP MIB objects */
+#define SIM_MAX_OID             32
+/** Result code for commands the simulator rejects */
+#define SIM_RESULT_ERROR        1
+/** Seconds between simulated station joins/leaves */
+#define SIM_CHURN_PERIOD        15
+
+/** Simulated TLV store, TLVs kept in firmware (little endian) format */
+typedef struct _sim_store
+{
+    /** TLV data */
+    u8 data[SIM_STORE_SIZE];
+    /** Used length */
+    u16 len;
+} sim_store;
+
+/** Simulated station */
+typedef struct _sim_sta
+{
+    /** MAC address */
+    u8 mac[ETH_ALEN];
+    /** Power mfg status */
+    u8 power;
+    /** RSSI in dBm */
+    s8 rssi;
+    /** Associated flag */
+    u8 assoc;
+} sim_sta;
+
+/** Simulated memory or register word */
+typedef struct _sim_word
+{
+    /** Address, register offset or'ed with the command */
+    u32 addr;
+    /** Value */
+    u32 value;
+} sim_word;
+
+/** Simulated firmware state */
+typedef struct _uap_sim
+{
+    /** System configuration TLVs */
+    sim_store cfg;
+    /** BT coex TLVs */
+    sim_store coex;
+    /** 802.11d domain TLV */
+    sim_store domain;
+    /** cfg_data blob */
+    sim_store cfg_data;
+    /** BSS started flag */
+    int bss_started;
+    /** Stations */
+    sim_sta sta[SIM_MAX_STA];
+    /** Number of station slots in use */
+    int sta_num;
+    /** SNMP MIB objects */
+    u32 mib[SIM_MAX_OID];
+    /** Memory words */
+    sim_word mem[SIM_MAX_WORDS];
+    /** Register words */
+    sim_word reg[SIM_MAX_WORDS];
+    /** Next word to recycle */
+    int mem_next, reg_next;
+    /** sys_debug settings */
+    u32 debug_gmode, debug_evtmask;
+    /** Power mode */
+    ps_mgmt pm;
+    /** PRNG state */
+    u32 seed;
+    /** Simulated time of the last update, in milliseconds */
+    u32 last_ms;
+    /** Time left until the next station churn, in milliseconds */
+    u32 churn_ms;
+    /** Simulated firmware response time, in microseconds */
+    u32 latency_us;
+    /** Percentage of host commands answered with EBUSY */
+    u32 busy_pct;
+    /** Random state of the EBUSY answers */
+    unsigned int busy_seed;
+    /** Answer with SeqNum 0, as a firmware that does not echo it */
+    int no_seq;
+    /** Serializes the simulated firmware, requests wait in parallel */
+    pthread_mutex_t lock;
+} uap_sim;
+
+/** Frame counters advanced with simulated traffic, per second */
+static struct
+{
+    /** OID */
+    u16 oid;
+    /** Increment per second */
+    u32 rate;
+} sim_traffic[] = {
+    {0x0e, 1},                  /* dot11CCMPDecryptErrors */
+    {0x12, 4},                  /* dot11FailedCount */
+    {0x13, 60},                 /* dot11RetryCount */
+    {0x14, 20},                 /* dot11MultipleRetryCount */
+    {0x15, 3},                  /* dot11FrameDuplicateCount */
+    {0x16, 40},                 /* dot11RTSSuccessCount */
+    {0x17, 2},                  /* dot11RTSFailureCount */
+    {0x18, 8},                  /* dot11ACKFailureCount */
+    {0x19, 800},                /* dot11ReceivedFragmentCount */
+    {0x1a, 30},                 /* dot11MulticastReceivedFrameCount */
+    {0x1b, 12},                 /* dot11FCSErrorCount */
+    {0x1c, 900},                /* dot11TransmittedFrameCount */
+    {0x1f, 25},                 /* dot11MulticastTransmittedFrameCount */
+};
+
+/****************************************************************************
+        Local functions
+****************************************************************************/
+/**
+ *  @brief Returns the next pseudo random number
+ *
+ *  @param sim      A pointer to uap_sim structure
+ *  @return         Random number
+ */
+static u32
+sim_rand(uap_sim * sim)
+{
+    sim->seed = sim->seed * 1103515245 + 12345;
+    return (sim->seed >> 16) & 0x7fff;
+}
+
+/**
+ *  @brief Returns the monotonic time in milliseconds
+ *
+ *  @return         Milliseconds
+ */
+static u32
+sim_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ *  @brief Checks whether a TLV is stored once per key byte
+ *
+ *  @param tag      TLV tag
+ *  @return         1 if keyed, 0 otherwise
+ */
+static int
+sim_tlv_keyed(u16 tag)
+{
+    return (tag == MRVL_WEP_KEY_TLV_ID) || (tag == MRVL_ANTENNA_CTL_TLV_ID);
+}
+
+/**
+ *  @brief Finds a TLV in a store
+ *
+ *  @param store    A pointer to sim_store structure
+ *  @param from     Offset to start from
+ *  @param tag      TLV tag
+ *  @param key      Key byte for keyed TLVs, -1 to match any
+ *  @return         Offset of the TLV or -1
+ */
+static int
+sim_store_find(sim_store * store, int from, u16 tag, int key)
+{
+    TLVBUF_HEADER *tlv;
+    int off = from;
+
+    while (off + sizeof(TLVBUF_HEADER) <= store->len) {
+        tlv = (TLVBUF_HEADER *) (store->data + off);
+        if ((uap_le16_to_cpu(tlv->Type) == tag) &&
+            ((key < 0) || (uap_le16_to_cpu(tlv->Len) && tlv->Data[0] == key)))
+            return off;
+        off += sizeof(TLVBUF_HEADER) + uap_le16_to_cpu(tlv->Len);
+    }
+    return -1;
+}
+
+/**
+ *  @brief Stores a TLV, replacing the previous value
+ *
+ *  @param store    A pointer to sim_store structure
+ *  @param tlv      TLV in firmware format
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+sim_store_set(sim_store * store, TLVBUF_HEADER * tlv)
+{
+    u16 tag = uap_le16_to_cpu(tlv->Type);
+    u16 tlv_len = sizeof(TLVBUF_HEADER) + uap_le16_to_cpu(tlv->Len);
+    int key = -1;
+    int off, old_len;
+
+    if (sim_tlv_keyed(tag) && uap_le16_to_cpu(tlv->Len))
+        key = tlv->Data[0];
+    off = sim_store_find(store, 0, tag, key);
+    if (off >= 0) {
+        old_len = sizeof(TLVBUF_HEADER) +
+            uap_le16_to_cpu(((TLVBUF_HEADER *) (store->data + off))->Len);
+        memmove(store->data + off, store->data + off + old_len,
+                store->len - off - old_len);
+        store->len -= old_len;
+    }
+    if (store->len + tlv_len > SIM_STORE_SIZE)
+        return UAP_FAILURE;
+    memcpy(store->data + store->len, tlv, tlv_len);
+    store->len += tlv_len;
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Stores a TLV given in host format
+ *
+ *  @param store    A pointer to sim_store structure
+ *  @param tag      TLV tag
+ *  @param data     TLV value
+ *  @param len      TLV value length
+ *  @return         N/A
+ */
+static void
+sim_store_put(sim_store * store, u16 tag, void *data, u16 len)
+{
+    u8 buf[sizeof(TLVBUF_HEADER) + MAX_IE_BUFFER_LEN];
+    TLVBUF_HEADER *tlv = (TLVBUF_HEADER *) buf;
+
+    tlv->Type = uap_cpu_to_le16(tag);
+    tlv->Len = uap_cpu_to_le16(len);
+    memcpy(tlv->Data, data, len);
+    sim_store_set(store, tlv);
+}
+
+/**
+ *  @brief Writes the TLVs of a store matching a request into a response
+ *
+ *  @param store    A pointer to sim_store structure
+ *  @param req      Requested TLV
+ *  @param out      Output buffer
+ *  @param room     Space left in the output buffer
+ *  @return         Number of bytes written, -1 if out of space
+ */
+static int
+sim_store_get(sim_store * store, TLVBUF_HEADER * req, u8 * out, int room)
+{
+    u16 tag = uap_le16_to_cpu(req->Type);
+    int key = -1;
+    int off, tlv_len, written = 0;
+
+    if (sim_tlv_keyed(tag) && uap_le16_to_cpu(req->Len))
+        key = req->Data[0];
+    for (off = sim_store_find(store, 0, tag, key); off >= 0;
+         off = sim_store_find(store, off + tlv_len, tag, key)) {
+        tlv_len = sizeof(TLVBUF_HEADER) +
+            uap_le16_to_cpu(((TLVBUF_HEADER *) (store->data + off))->Len);
+        if (written + tlv_len > room)
+            return -1;
+        memcpy(out + written, store->data + off, tlv_len);
+        written += tlv_len;
+    }
+    if (!written) {
+        /* Not configured: echo the request */
+        tlv_len = sizeof(TLVBUF_HEADER) + uap_le16_to_cpu(req->Len);
+        if (tlv_len > room)
+            return -1;
+        memmove(out, req, tlv_len);
+        written = tlv_len;
+    }
+    return written;
+}
+
+/**
+ *  @brief Handles a GET/SET on a TLV store
+ *
+ *  A GET without TLVs returns the whole store.
+ *
+ *  @param store    A pointer to sim_store structure
+ *  @param buf      Command buffer
+ *  @param hdr_len  Length of the command header preceding the TLVs
+ *  @param action   ACTION_GET or ACTION_SET
+ *  @param len      Request length in, response length out
+ *  @param cap      Size of the command buffer
+ *  @return         CMD_SUCCESS or SIM_RESULT_ERROR
+ */
+static s16
+sim_store_cmd(sim_store * store, u8 * buf, u16 hdr_len, u16 action,
+              u16 * len, u16 cap)
+{
+    u8 req[MRVDRV_SIZE_OF_CMD_BUFFER];
+    TLVBUF_HEADER *tlv;
+    int req_len, off = 0, out = hdr_len, n;
+
+    req_len = *len - hdr_len;
+    if (req_len < 0 || req_len > sizeof(req))
+        return SIM_RESULT_ERROR;
+    memcpy(req, buf + hdr_len, req_len);
+
+    if (action == ACTION_SET) {
+        while (off + sizeof(TLVBUF_HEADER) <= req_len) {
+            tlv = (TLVBUF_HEADER *) (req + off);
+            if (sim_store_set(store, tlv) != UAP_SUCCESS)
+                return SIM_RESULT_ERROR;
+            off += sizeof(TLVBUF_HEADER) + uap_le16_to_cpu(tlv->Len);
+        }
+        return CMD_SUCCESS;
+    }
+    if (req_len < sizeof(TLVBUF_HEADER)) {
+        if (hdr_len + store->len > cap)
+            return SIM_RESULT_ERROR;
+        memcpy(buf + hdr_len, store->data, store->len);
+        *len = hdr_len + store->len;
+        return CMD_SUCCESS;
+    }
+    while (off + sizeof(TLVBUF_HEADER) <= req_len) {
+        tlv = (TLVBUF_HEADER *) (req + off);
+        n = sim_store_get(store, tlv, buf + out, cap - out);
+        if (n < 0)
+            return SIM_RESULT_ERROR;
+        out += n;
+        off += sizeof(TLVBUF_HEADER) + uap_le16_to_cpu(tlv->Len);
+    }
+    *len = out;
+    return CMD_SUCCESS;
+}
+
+/**
+ *  @brief Loads the default system configuration
+ *
+ *  @param sim      A pointer to uap_sim structure
+ *  @return         N/A
+ */
+static void
+sim_default_config(uap_sim * sim)
+{
+    u8 mac[ETH_ALEN] = { 0x00, 0x50, 0x43, 0x20, 0x00, 0x01 };
+    u8 rates[] = { 0x82, 0x84, 0x8b, 0x96, 0x0c, 0x12,
+        0x18, 0x24, 0x30, 0x48, 0x60, 0x6c
+    };
+    u8 chan_cfg[2] = { 0, 6 };
+    u8 antenna[2] = { 0, 0 };
+    u8 cipher[2] = { CIPHER_NONE, CIPHER_NONE };
+    u8 filter[2] = { 0, 0 };
+    CHANNEL_LIST chan_list[11];
+    char *ssid = "Marvell Micro AP";
+    u16 val16;
+    u32 val32;
+    u8 val8;
+    int i;
+    tlvbuf_coex_common_cfg coex_common;
+    tlvbuf_coex_sco_cfg coex_sco;
+    tlvbuf_coex_acl_cfg coex_acl;
+    tlvbuf_coex_stats coex_stats;
+
+    memset(&sim->cfg, 0, sizeof(sim_store));
+    sim_store_put(&sim->cfg, MRVL_AP_MAC_ADDRESS_TLV_ID, mac, ETH_ALEN);
+    sim_store_put(&sim->cfg, MRVL_SSID_TLV_ID, ssid, strlen(ssid));
+    val16 = uap_cpu_to_le16(100);
+    sim_store_put(&sim->cfg, MRVL_BEACON_PERIOD_TLV_ID, &val16, sizeof(u16));
+    val8 = 1;
+    sim_store_put(&sim->cfg, MRVL_DTIM_PERIOD_TLV_ID, &val8, sizeof(u8));
+    sim_store_put(&sim->cfg, MRVL_CHANNELCONFIG_TLV_ID, chan_cfg, 2);
+    memset(chan_list, 0, sizeof(chan_list));
+    for (i = 0; i < 11; i++)
+        chan_list[i].ChanNumber = i + 1;
+    sim_store_put(&sim->cfg, MRVL_CHANNELLIST_TLV_ID, chan_list,
+                  sizeof(chan_list));
+    sim_store_put(&sim->cfg, MRVL_RATES_TLV_ID, rates, sizeof(rates));
+    val8 = 13;
+    sim_store_put(&sim->cfg, MRVL_TX_POWER_TLV_ID, &val8, sizeof(u8));
+    val8 = 1;
+    sim_store_put(&sim->cfg, MRVL_BCAST_SSID_CTL_TLV_ID, &val8, sizeof(u8));
+    val8 = 0;
+    sim_store_put(&sim->cfg, MRVL_PREAMBLE_CTL_TLV_ID, &val8, sizeof(u8));
+    sim_store_put(&sim->cfg, MRVL_ANTENNA_CTL_TLV_ID, antenna, 2);
+    antenna[0] = 1;
+    sim_store_put(&sim->cfg, MRVL_ANTENNA_CTL_TLV_ID, antenna, 2);
+    val16 = uap_cpu_to_le16(MAX_RTS_THRESHOLD);
+    sim_store_put(&sim->cfg, MRVL_RTS_THRESHOLD_TLV_ID, &val16, sizeof(u16));
+    val16 = uap_cpu_to_le16(MAX_FRAG_THRESHOLD);
+    sim_store_put(&sim->cfg, MRVL_FRAG_THRESHOLD_TLV_ID, &val16, sizeof(u16));
+    val8 = 0;
+    sim_store_put(&sim->cfg, MRVL_RADIO_CTL_TLV_ID, &val8, sizeof(u8));
+    val8 = 0;
+    sim_store_put(&sim->cfg, MRVL_RSN_REPLAY_PROT_TLV_ID, &val8, sizeof(u8));
+    val16 = 0;
+    sim_store_put(&sim->cfg, MRVL_TX_DATA_RATE_TLV_ID, &val16, sizeof(u16));
+    sim_store_put(&sim->cfg, MRVL_MCBC_DATA_RATE_TLV_ID, &val16, sizeof(u16));
+    val8 = 1;
+    sim_store_put(&sim->cfg, MRVL_PKT_FWD_CTL_TLV_ID, &val8, sizeof(u8));
+    val32 = uap_cpu_to_le32(1800);
+    sim_store_put(&sim->cfg, MRVL_STA_AGEOUT_TIMER_TLV_ID, &val32,
+                  sizeof(u32));
+    val8 = 0;
+    sim_store_put(&sim->cfg, MRVL_AUTH_TLV_ID, &val8, sizeof(u8));
+    val16 = uap_cpu_to_le16(PROTOCOL_NO_SECURITY);
+    sim_store_put(&sim->cfg, MRVL_PROTOCOL_TLV_ID, &val16, sizeof(u16));
+    val16 = uap_cpu_to_le16(KEY_MGMT_NONE);
+    sim_store_put(&sim->cfg, MRVL_AKMP_TLV_ID, &val16, sizeof(u16));
+    sim_store_put(&sim->cfg, MRVL_CIPHER_TLV_ID, cipher, 2);
+    val32 = uap_cpu_to_le32(MAX_GRP_TIMER);
+    sim_store_put(&sim->cfg, MRVL_GRP_REKEY_TIME_TLV_ID, &val32, sizeof(u32));
+    val16 = uap_cpu_to_le16(sim->sta_num > 8 ? sim->sta_num : 8);
+    sim_store_put(&sim->cfg, MRVL_MAX_STA_CNT_TLV_ID, &val16, sizeof(u16));
+    val8 = 7;
+    sim_store_put(&sim->cfg, MRVL_RETRY_LIMIT_TLV_ID, &val8, sizeof(u8));
+    sim_store_put(&sim->cfg, MRVL_STA_MAC_ADDR_FILTER_TLV_ID, filter, 2);
+
+    /* BT coex */
+    memset(&sim->coex, 0, sizeof(sim_store));
+    memset(&coex_common, 0, sizeof(coex_common));
+    coex_common.Tag = uap_cpu_to_le16(MRVL_BT_COEX_COMMON_CFG_TLV_ID);
+    coex_common.Length = uap_cpu_to_le16(sizeof(coex_common) -
+                                         sizeof(TLVBUF_HEADER));
+    sim_store_set(&sim->coex, (TLVBUF_HEADER *) & coex_common);
+    memset(&coex_sco, 0, sizeof(coex_sco));
+    coex_sco.Tag = uap_cpu_to_le16(MRVL_BT_COEX_SCO_CFG_TLV_ID);
+    coex_sco.Length = uap_cpu_to_le16(sizeof(coex_sco) -
+                                      sizeof(TLVBUF_HEADER));
+    sim_store_set(&sim->coex, (TLVBUF_HEADER *) & coex_sco);
+    memset(&coex_acl, 0, sizeof(coex_acl));
+    coex_acl.Tag = uap_cpu_to_le16(MRVL_BT_COEX_ACL_CFG_TLV_ID);
+    coex_acl.Length = uap_cpu_to_le16(sizeof(coex_acl) -
+                                      sizeof(TLVBUF_HEADER));
+    sim_store_set(&sim->coex, (TLVBUF_HEADER *) & coex_acl);
+    memset(&coex_stats, 0, sizeof(coex_stats));
+    coex_stats.Tag = uap_cpu_to_le16(MRVL_BT_COEX_STATS_TLV_ID);
+    coex_stats.Length = uap_cpu_to_le16(sizeof(coex_stats) -
+                                        sizeof(TLVBUF_HEADER));
+    sim_store_set(&sim->coex, (TLVBUF_HEADER *) & coex_stats);
+
+    memset(&sim->domain, 0, sizeof(sim_store));
+    sim->bss_started = 0;
+}
+
+/**
+ *  @brief Fills a station slot with a new station
+ *
+ *  @param sim      A pointer to uap_sim structure
+ *  @param i        Station index
+ *  @return         N/A
+ */
+static void
+sim_sta_join(uap_sim * sim, int i)
+{
+    sim_sta *sta = &sim->sta[i];
+    u32 id = sim_rand(sim);
+
+    sta->mac[0] = 0x00;
+    sta->mac[1] = 0x1a;
+    sta->mac[2] = 0x2b;
+    sta->mac[3] = (u8) i;
+    sta->mac[4] = (u8) (id >> 8);
+    sta->mac[5] = (u8) id;
+    sta->power = 0;
+    sta->rssi = -40 - (s8) (sim_rand(sim) % 40);
+    sta->assoc = 1;
+}
+
+/**
+ *  @brief Advances the simulated traffic to the current time
+ *
+ *  Counters grow with elapsed time, RSSI drifts, stations change
+ *  power state and leave/join every SIM_CHURN_PERIOD seconds.
+ *
+ *  @param sim      A pointer to uap_sim structure
+ *  @return         N/A
+ */
+static void
+sim_update(uap_sim * sim)
+{
+    u32 now = sim_now_ms();
+    u32 dt = now - sim->last_ms;
+    int i, off;
+    tlvbuf_coex_stats *stats;
+    sim_sta *sta;
+
+    if (!dt)
+        return;
+    sim->last_ms = now;
+    for (i = 0; i < sizeof(sim_traffic) / sizeof(sim_traffic[0]); i++) {
+        sim->mib[sim_traffic[i].oid] += (sim_traffic[i].rate * dt +
+                                         sim_rand(sim) % 1000) / 1000;
+    }
+    off = sim_store_find(&sim->coex, 0, MRVL_BT_COEX_STATS_TLV_ID, -1);
+    if (off >= 0) {
+        stats = (tlvbuf_coex_stats *) (sim->coex.data + off);
+        stats->null_queued =
+            uap_cpu_to_le32(uap_le32_to_cpu(stats->null_queued) + dt / 100);
+        stats->cf_end_queued =
+            uap_cpu_to_le32(uap_le32_to_cpu(stats->cf_end_queued) + dt / 200);
+    }
+    for (i = 0; i < sim->sta_num; i++) {
+        sta = &sim->sta[i];
+        if (!sta->assoc)
+            continue;
+        sta->rssi += (s8) (sim_rand(sim) % 5) - 2;
+        if (sta->rssi > -20)
+            sta->rssi = -20;
+        if (sta->rssi < -95)
+            sta->rssi = -95;
+        if (sim_rand(sim) % 8 == 0)
+            sta->power = !sta->power;
+    }
+    if (dt >= sim->churn_ms) {
+        sim->churn_ms = SIM_CHURN_PERIOD * 1000;
+        if (sim->sta_num) {
+            i = sim_rand(sim) % sim->sta_num;
+            if (sim->sta[i].assoc)
+                sim->sta[i].assoc = 0;
+            else
+                sim_sta_join(sim, i);
+        }
+    } else {
+        sim->churn_ms -= dt;
+    }
+}
+
+/**
+ *  @brief Handles HostCmd_SNMP_MIB
+ *
+ *  @param sim      A pointer to uap_sim structure
+ *  @param buf      Command buffer
+ *  @param len      Request length in, response length out
+ *  @return         CMD_SUCCESS or SIM_RESULT_ERROR
+ */
+static s16
+sim_snmp_mib(uap_sim * sim, u8 * buf, u16 * len)
+{
+    APCMDBUF_SNMP_MIB *cmd = (APCMDBUF_SNMP_MIB *) buf;
+    u16 action = uap_le16_to_cpu(cmd->Action);
+    int off = sizeof(APCMDBUF_SNMP_MIB);
+    TLVBUF_HEADER *tlv;
+    u16 oid, oid_len;
+    u32 val;
+    int i;
+
+    while (off + sizeof(TLVBUF_HEADER) <= *len) {
+        tlv = (TLVBUF_HEADER *) (buf + off);
+        oid = uap_le16_to_cpu(tlv->Type);
+        oid_len = uap_le16_to_cpu(tlv->Len);
+        if (oid >= SIM_MAX_OID || oid_len > 4)
+            return SIM_RESULT_ERROR;
+        if (action == ACTION_SET) {
+            for (val = 0, i = oid_len - 1; i >= 0; i--)
+                val = (val << 8) | tlv->Data[i];
+            sim->mib[oid] = val;
+        } else {
+            for (val = sim->mib[oid], i = 0; i < oid_len; i++, val >>= 8)
+                tlv->Data[i] = (u8) val;
+        }
+        off += sizeof(TLVBUF_HEADER) + oid_len;
+    }
+    return CMD_SUCCESS;
+}
+
+/**
+ *  @brief Handles APCMD_STA_LIST
+ *
+ *  @param sim      A pointer to uap_sim structure
+ *  @param buf      Command buffer
+ *  @param len      Request length in, response length out
+ *  @param cap      Size of the command buffer
+ *  @return         CMD_SUCCESS
+ */
+static s16
+sim_sta_list(uap_sim * sim, u8 * buf, u16 * len, u16 cap)
+{
+    APCMDBUF_STA_LIST_RESPONSE *resp = (APCMDBUF_STA_LIST_RESPONSE *) buf;
+    TLVBUF_STA_INFO *tlv;
+    int i, count = 0, assoc = 0;
+
+    for (i = 0; i < sim->sta_num; i++) {
+        if (!sim->sta[i].assoc)
+            continue;
+        /* Stations that do not fit are still counted in StaCount */
+        if (sizeof(APCMDBUF_STA_LIST_RESPONSE) +
+            (++assoc) * sizeof(TLVBUF_STA_INFO) > cap)
+            continue;
+        tlv = &resp->StaList[count++];
+        tlv->Tag = uap_cpu_to_le16(MRVL_STA_INFO_TLV_ID);
+        tlv->Length = uap_cpu_to_le16(sizeof(TLVBUF_STA_INFO) -
+                                      sizeof(TLVBUF_HEADER));
+        memcpy(tlv->MacAddress, sim->sta[i].mac, ETH_ALEN);
+        tlv->PowerMfgStatus = sim->sta[i].power;
+        tlv->Rssi = sim->sta[i].rssi;
+    }
+    resp->StaCount = uap_cpu_to_le16(assoc);
+    *len = sizeof(APCMDBUF_STA_LIST_RESPONSE) + count * sizeof(TLVBUF_STA_INFO);
+    return CMD_SUCCESS;
+}
+
+/**
+ *  @brief Handles APCMD_STA_DEAUTH
+ *
+ *  @param sim      A pointer to uap_sim structure
+ *  @param buf      Command buffer
+ *  @return         CMD_SUCCESS or SIM_RESULT_ERROR
+ */
+static s16
+sim_sta_deauth(uap_sim * sim, u8 * buf)
+{
+    APCMDBUF_STA_DEAUTH *cmd = (APCMDBUF_STA_DEAUTH *) buf;
+    int i;
+
+    for (i = 0; i < sim->sta_num; i++) {
+        if (sim->sta[i].assoc &&
+            !memcmp(sim->sta[i].mac, cmd->StaMacAddress, ETH_ALEN)) {
+            sim->sta[i].assoc = 0;
+            return CMD_SUCCESS;
+        }
+    }
+    return SIM_RESULT_ERROR;
+}
+
+/**
+ *  @brief Reads or writes a simulated memory/register word
+ *
+ *  @param words    Word table
+ *  @param next     Next slot to recycle
+ *  @param addr     Address
+ *  @param action   ACTION_GET or ACTION_SET
+ *  @param value    Value to write, or read value
+ *  @return         N/A
+ */
+static void
+sim_word_access(sim_word * words, int *next, u32 addr, u16 action,
+                u32 * value)
+{
+    int i;
+
+    for (i = 0; i < SIM_MAX_WORDS; i++) {
+        if (words[i].addr == addr)
+            break;
+    }
+    if (action == ACTION_SET) {
+        if (i == SIM_MAX_WORDS) {
+            i = *next;
+            *next = (*next + 1) % SIM_MAX_WORDS;
+        }
+        words[i].addr = addr;
+        words[i].value = *value;
+    } else {
+        *value = (i < SIM_MAX_WORDS) ? words[i].value : (addr ^ 0x5a5a5a5a);
+    }
+}
+
+/**
+ *  @brief Handles HostCmd_CMD_SYS_DEBUG
+ *
+ *  @param sim      A pointer to uap_sim structure
+ *  @param buf      Command buffer
+ *  @param len      Request length in, response length out
+ *  @param cap      Size of the command buffer
+ *  @return         CMD_SUCCESS or SIM_RESULT_ERROR
+ */
+static s16
+sim_sys_debug(uap_sim * sim, u8 * buf, u16 * len, u16 cap)
+{
+    APCMDBUF_SYS_DEBUG *cmd = (APCMDBUF_SYS_DEBUG *) buf;
+    u16 action = uap_le16_to_cpu(cmd->Action);
+    CHANNEL_SCAN_ENTRY_T *entry;
+    int i;
+
+    switch (uap_le32_to_cpu(cmd->subcmd)) {
+    case DEBUG_SUBCOMMAND_GMODE:
+        if (action == ACTION_SET)
+            sim->debug_gmode = cmd->debugConfig.globalDebugMode;
+        cmd->debugConfig.globalDebugMode = sim->debug_gmode;
+        break;
+    case DEBUG_SUBCOMMAND_MAJOREVTMASK:
+        if (action == ACTION_SET)
+            sim->debug_evtmask =
+                uap_le32_to_cpu(cmd->debugConfig.debugMajorIdMask);
+        cmd->debugConfig.debugMajorIdMask = uap_cpu_to_le32(sim->debug_evtmask);
+        break;
+    case DEBUG_SUBCOMMAND_CHANNEL_SCAN:
+        cmd->debugConfig.cs_entry.numChannels = 0;
+        for (i = 0; i < 11; i++) {
+            if (sizeof(APCMDBUF_SYS_DEBUG) + (i + 1) *
+                sizeof(CHANNEL_SCAN_ENTRY_T) > cap)
+                break;
+            entry = &cmd->debugConfig.cs_entry.cst[i];
+            entry->chan_num = i + 1;
+            entry->num_of_aps = sim_rand(sim) % 6;
+            entry->CCA_count = uap_cpu_to_le32(sim_rand(sim) % 2000);
+            entry->duration = uap_cpu_to_le32(100);
+            entry->channel_weight = uap_cpu_to_le32(sim_rand(sim) % 100);
+            cmd->debugConfig.cs_entry.numChannels++;
+        }
+        *len = sizeof(APCMDBUF_SYS_DEBUG) +
+            cmd->debugConfig.cs_entry.numChannels *
+            sizeof(CHANNEL_SCAN_ENTRY_T);
+        return CMD_SUCCESS;
+    default:
+        return SIM_RESULT_ERROR;
+    }
+    *len = sizeof(APCMDBUF_SYS_DEBUG);
+    return CMD_SUCCESS;
+}
+
+/**
+ *  @brief Handles HostCmd_CMD_CFG_DATA
+ *
+ *  @param sim      A pointer to uap_sim structure
+ *  @param buf      Command buffer
+ *  @param len      Request length in, response length out
+ *  @param cap      Size of the command buffer
+ *  @return         CMD_SUCCESS or SIM_RESULT_ERROR
+ */
+static s16
+sim_cfg_data(uap_sim * sim, u8 * buf, u16 * len, u16 cap)
+{
+    APCMDBUF_CFG_DATA *cmd = (APCMDBUF_CFG_DATA *) buf;
+    u16 data_len = uap_le16_to_cpu(cmd->data_len);
+
+    if (uap_le16_to_cpu(cmd->action) == ACTION_SET) {
+        if (data_len > MAX_CFG_DATA_SIZE)
+            return SIM_RESULT_ERROR;
+        memcpy(sim->cfg_data.data, cmd->data, data_len);
+        sim->cfg_data.len = data_len;
+        return CMD_SUCCESS;
+    }
+    if (sizeof(APCMDBUF_CFG_DATA) + sim->cfg_data.len > cap)
+        return SIM_RESULT_ERROR;
+    memcpy(cmd->data, sim->cfg_data.data, sim->cfg_data.len);
+    cmd->data_len = uap_cpu_to_le16(sim->cfg_data.len);
+    *len = sizeof(APCMDBUF_CFG_DATA) + sim->cfg_data.len;
+    return CMD_SUCCESS;
+}
+
+/**
+ *  @brief Handles HostCmd_CMD_802_11D_DOMAIN_INFO
+ *
+ *  @param sim      A pointer to uap_sim structure
+ *  @param buf      Command buffer
+ *  @param len      Request length in, response length out
+ *  @param cap      Size of the command buffer
+ *  @return         CMD_SUCCESS or SIM_RESULT_ERROR
+ */
+static s16
+sim_cfg_80211d(uap_sim * sim, u8 * buf, u16 * len, u16 cap)
+{
+    APCMDBUF_CFG_80211D *cmd = (APCMDBUF_CFG_80211D *) buf;
+    u16 hdr_len = sizeof(APCMDBUF_CFG_80211D) - sizeof(domain_param_t);
+    u16 dom_len;
+
+    if (uap_le16_to_cpu(cmd->Action) == ACTION_SET) {
+        dom_len = *len - hdr_len;
+        if (dom_len > SIM_STORE_SIZE)
+            return SIM_RESULT_ERROR;
+        memcpy(sim->domain.data, &cmd->Domain, dom_len);
+        sim->domain.len = dom_len;
+        return CMD_SUCCESS;
+    }
+    if (!sim->domain.len) {
+        memset(&cmd->Domain, 0, sizeof(domain_param_t));
+        *len = sizeof(APCMDBUF_CFG_80211D);
+        return CMD_SUCCESS;
+    }
+    if (hdr_len + sim->domain.len > cap)
+        return SIM_RESULT_ERROR;
+    memcpy(&cmd->Domain, sim->domain.data, sim->domain.len);
+    *len = hdr_len + sim->domain.len;
+    return CMD_SUCCESS;
+}
+
+/**
+ *  @brief Opens the simulated firmware
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param arg      "<stations>[:<latency_us>[:<busy_pct>[:noseq]]]", or
+ *                  NULL
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+sim_open(uap_dev * dev, char *arg)
+{
+    uap_sim *sim;
+    char *p;
+    int i;
+
+    sim = (uap_sim *) malloc(sizeof(uap_sim));
+    if (!sim) {
+        uap_dev_error(dev, UAP_ERR_NOMEM,
+                      "Cannot allocate simulated firmware!");
+        return UAP_FAILURE;
+    }
+    memset(sim, 0, sizeof(uap_sim));
+    sim->sta_num = arg ? atoi(arg) : SIM_DEFAULT_STA;
+    if (arg && (p = strchr(arg, ':'))) {
+        sim->latency_us = strtoul(p + 1, NULL, 10);
+        if ((p = strchr(p + 1, ':')))
+            sim->busy_pct = strtoul(p + 1, NULL, 10);
+        if (p && (p = strchr(p + 1, ':'))) {
+            if (strcmp(p + 1, "noseq")) {
+                uap_dev_error(dev, UAP_ERR_INVAL,
+                              "Unknown simulator option %s", p + 1);
+                free(sim);
+                return UAP_FAILURE;
+            }
+            sim->no_seq = 1;
+        }
+    }
+    if (sim->sta_num < 0 || sim->sta_num > SIM_MAX_STA) {
+        uap_dev_error(dev, UAP_ERR_INVAL,
+                      "Simulated station count must be 0..%d", SIM_MAX_STA);
+        free(sim);
+        return UAP_FAILURE;
+    }
+    sim->seed = 1;
+    for (i = 0; dev->name[i]; i++)
+        sim->seed = sim->seed * 31 + dev->name[i];
+    sim->busy_seed = sim->seed;
+    sim_default_config(sim);
+    for (i = 0; i < sim->sta_num; i++)
+        sim_sta_join(sim, i);
+    sim->mib[OID_80211D_ENABLE] = 0;
+    sim->last_ms = sim_now_ms();
+    sim->churn_ms = SIM_CHURN_PERIOD * 1000;
+    pthread_mutex_init(&sim->lock, NULL);
+    dev->priv = sim;
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Runs a host command against the simulated firmware, with
+ *  sim->lock held
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param buf      Command buffer, overwritten with the response
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+sim_exec(uap_dev * dev, u8 * buf)
+{
+    uap_sim *sim = (uap_sim *) dev->priv;
+    APCMDBUF *header = (APCMDBUF *) buf;
+    u16 cap = *(u32 *) buf + BUF_HEADER_SIZE;
+    u16 cmd_code = uap_le16_to_cpu(header->CmdCode);
+    u16 len = uap_le16_to_cpu(header->Size) + BUF_HEADER_SIZE;
+    s16 result = CMD_SUCCESS;
+    u32 value;
+
+    if (len < sizeof(APCMDBUF) || len > cap) {
+        errno = EINVAL;
+        uap_dev_error(dev, UAP_ERR_PROTO, "Malformed command for simulated %s",
+                      dev->name);
+        return UAP_FAILURE;
+    }
+    sim_update(sim);
+
+    switch (cmd_code) {
+    case APCMD_SYS_INFO:
+        {
+            APCMDBUF_SYS_INFO_RESPONSE *resp =
+                (APCMDBUF_SYS_INFO_RESPONSE *) buf;
+            if (cap < sizeof(APCMDBUF_SYS_INFO_RESPONSE)) {
+                result = SIM_RESULT_ERROR;
+                break;
+            }
+            memset(resp->SysInfo, 0, sizeof(resp->SysInfo));
+            snprintf((char *) resp->SysInfo, sizeof(resp->SysInfo),
+                     "uAP simulated firmware (%s)", dev->name);
+            len = sizeof(APCMDBUF_SYS_INFO_RESPONSE);
+        }
+        break;
+    case APCMD_SYS_RESET:
+        sim_default_config(sim);
+        break;
+    case APCMD_SYS_CONFIGURE:
+        result = sim_store_cmd(&sim->cfg, buf, sizeof(APCMDBUF_SYS_CONFIGURE),
+                               uap_le16_to_cpu(((APCMDBUF_SYS_CONFIGURE *)
+                                                buf)->Action), &len, cap);
+        break;
+    case APCMD_BSS_START:
+        sim->bss_started = 1;
+        break;
+    case APCMD_BSS_STOP:
+        sim->bss_started = 0;
+        break;
+    case APCMD_STA_LIST:
+        result = sim_sta_list(sim, buf, &len, cap);
+        break;
+    case APCMD_STA_DEAUTH:
+        result = sim_sta_deauth(sim, buf);
+        break;
+    case HostCmd_SNMP_MIB:
+        result = sim_snmp_mib(sim, buf, &len);
+        break;
+    case HostCmd_CMD_MAC_REG_ACCESS:
+    case HostCmd_CMD_BBP_REG_ACCESS:
+    case HostCmd_CMD_RF_REG_ACCESS:
+        {
+            APCMDBUF_REG_RDWR *cmd = (APCMDBUF_REG_RDWR *) buf;
+            value = uap_le32_to_cpu(cmd->Value);
+            sim_word_access(sim->reg, &sim->reg_next,
+                            (cmd_code << 16) | uap_le16_to_cpu(cmd->Offset),
+                            uap_le16_to_cpu(cmd->Action), &value);
+            cmd->Value = uap_cpu_to_le32(value);
+        }
+        break;
+    case HostCmd_CMD_MEM_ACCESS:
+        {
+            APCMDBUF_MEM_ACCESS *cmd = (APCMDBUF_MEM_ACCESS *) buf;
+            value = uap_le32_to_cpu(cmd->Value);
+            sim_word_access(sim->mem, &sim->mem_next,
+                            uap_le32_to_cpu(cmd->Address),
+                            uap_le16_to_cpu(cmd->Action), &value);
+            cmd->Value = uap_cpu_to_le32(value);
+        }
+        break;
+    case HostCmd_EEPROM_ACCESS:
+        {
+            APCMDBUF_EEPROM_ACCESS *cmd = (APCMDBUF_EEPROM_ACCESS *) buf;
+            u16 offset = uap_le16_to_cpu(cmd->Offset);
+            u16 count = uap_le16_to_cpu(cmd->ByteCount);
+            int i;
+            if (sizeof(APCMDBUF_EEPROM_ACCESS) - 1 + count > cap) {
+                result = SIM_RESULT_ERROR;
+                break;
+            }
+            for (i = 0; i < count; i++)
+                cmd->Value[i] = (u8) (offset + i);
+            len = sizeof(APCMDBUF_EEPROM_ACCESS) - 1 + count;
+        }
+        break;
+    case HostCmd_CMD_802_11D_DOMAIN_INFO:
+        result = sim_cfg_80211d(sim, buf, &len, cap);
+        break;
+    case HostCmd_CMD_CFG_DATA:
+        result = sim_cfg_data(sim, buf, &len, cap);
+        break;
+    case APCMD_SYS_DEBUG:
+        result = sim_sys_debug(sim, buf, &len, cap);
+        break;
+    case HostCmd_ROBUST_COEX:
+        result = sim_store_cmd(&sim->coex, buf, sizeof(apcmdbuf_coex_config),
+                               uap_le16_to_cpu(((apcmdbuf_coex_config *)
+                                                buf)->action), &len, cap);
+        break;
+    default:
+        result = SIM_RESULT_ERROR;
+        break;
+    }
+
+    header->CmdCode = uap_cpu_to_le16(cmd_code | APCMD_RESP_CHECK);
+    header->Result = uap_cpu_to_le16(result);
+    header->Size = uap_cpu_to_le16(len - BUF_HEADER_SIZE);
+    if (sim->no_seq)
+        header->SeqNum = 0;
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Runs a host command against the simulated firmware
+ *
+ *  The response time is spent outside the firmware lock, so requests
+ *  of several threads are in flight together as with a real device.
+ *  A signal during the response time fails the command with EINTR, and
+ *  busy_pct percent of the commands fail with EBUSY.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param buf      Command buffer, overwritten with the response
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+sim_cmd(uap_dev * dev, u8 * buf)
+{
+    uap_sim *sim = (uap_sim *) dev->priv;
+    int ret, busy;
+
+    if (sim->latency_us && usleep(sim->latency_us) < 0) {
+        uap_dev_error(dev, UAP_ERR_IO, "Simulated %s interrupted", dev->name);
+        errno = EINTR;
+        return UAP_FAILURE;
+    }
+    pthread_mutex_lock(&sim->lock);
+    busy = sim->busy_pct && (rand_r(&sim->busy_seed) % 100 < sim->busy_pct);
+    ret = busy ? UAP_FAILURE : sim_exec(dev, buf);
+    pthread_mutex_unlock(&sim->lock);
+    if (busy) {
+        uap_dev_error(dev, UAP_ERR_IO, "Simulated %s busy", dev->name);
+        errno = EBUSY;
+    }
+    return ret;
+}
+
+/**
+ *  @brief Sets/gets the simulated power mode
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param pm       A pointer to ps_mgmt structure
+ *  @return         UAP_SUCCESS
+ */
+static int
+sim_power_mode(uap_dev * dev, ps_mgmt * pm)
+{
+    uap_sim *sim = (uap_sim *) dev->priv;
+
+    pthread_mutex_lock(&sim->lock);
+    if (pm->flags & PS_FLAG_PS_MODE)
+        sim->pm.ps_mode = pm->ps_mode;
+    if (pm->flags & PS_FLAG_SLEEP_PARAM)
+        sim->pm.sleep_param = pm->sleep_param;
+    if (pm->flags & PS_FLAG_INACT_SLEEP_PARAM)
+        sim->pm.inact_param = pm->inact_param;
+    *pm = sim->pm;
+    pm->flags = PS_FLAG_PS_MODE;
+    if (pm->ps_mode == PS_MODE_PERIODIC_DTIM)
+        pm->flags |= PS_FLAG_SLEEP_PARAM;
+    if (pm->ps_mode == PS_MODE_INACTIVITY)
+        pm->flags |= PS_FLAG_INACT_SLEEP_PARAM;
+    pthread_mutex_unlock(&sim->lock);
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Releases the simulated firmware
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @return         N/A
+ */
+static void
+sim_close(uap_dev * dev)
+{
+    uap_sim *sim = (uap_sim *) dev->priv;
+
+    pthread_mutex_destroy(&sim->lock);
+    free(sim);
+}
+
+/****************************************************************************
+        Global variables
+****************************************************************************/
+/** Simulated firmware backend */
+uap_transport uap_sim_transport = {
+    "sim",
+    sim_open,
+    sim_cmd,
+    sim_power_mode,
+    sim_close,
+    1
+};
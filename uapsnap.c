@@ -0,0 +1,477 @@
+/** @file  uapsnap.c
+ *
+ *  @brief This file contains the snapshot command: the system
+ *  information, stations, counters, power mode and BT coex state
+ *  captured together and printed as one record.
+ *
+ * Copyright (C) 2008-2009, Marvell International Ltd.
+ *
+ * This software file (the "File") is distributed by Marvell International
+ * Ltd. under the terms of the GNU General Public License Version 2, June 1991
+ * (the "License").  You may use, redistribute and/or modify this File in
+ * accordance with the terms and conditions of the License, a copy of which
+ * is available along with the File in the gpl.txt file or by writing to
+ * the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307 or on the worldwide web at http://www.gnu.org/licenses/gpl.txt.
+ *
+ * THE FILE IS DISTRIBUTED AS-IS, WITHOUT WARRANTY OF ANY KIND, AND THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE
+ * ARE EXPRESSLY DISCLAIMED.  The License provides additional details about
+ * this warranty disclaimer.
+ *
+ */
+/****************************************************************************
+Change log:
+    10/17/26: Initial creation
+****************************************************************************/
+
+/****************************************************************************
+        Header files
+****************************************************************************/
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <pthread.h>
+#include <linux/if.h>
+#include "uaputl.h"
+
+/****************************************************************************
+        Definitions
+****************************************************************************/
+/*
+ * Every source is one host command (one power mode request for
+ * powermode).  On a transport that takes concurrent requests the
+ * commands are all put in flight at once from one thread each.  Else,
+ * and while a trace is recorded, they are sent back to back in source
+ * order, so a recorded snapshot replays in the same order.  The
+ * record carries the time the first command was sent and the time the
+ * last response came back.
+ */
+
+/** Sources of a snapshot */
+#define SNAP_SYS_INFO           0
+#define SNAP_STA_LIST           1
+#define SNAP_STATS              2
+#define SNAP_POWER_MODE         3
+#define SNAP_COEX               4
+#define SNAP_SOURCES            5
+
+/** Snapshot record */
+typedef struct _uapsnap
+{
+    /** Handle the commands go through */
+    uap_dev *dev;
+    /** System information */
+    char sys_info[UAP_SYS_INFO_LEN];
+    /** Stations reported by the firmware */
+    int sta_count;
+    /** Stations */
+    uap_sta_info sta[UAP_MAX_STA];
+    /** 802.11 counters */
+    uap_stats_info stats;
+    /** Power mode */
+    ps_mgmt pm;
+    /** BT coex configuration bitmap */
+    unsigned int coex_bitmap;
+    /** BT coex statistics */
+    unsigned int coex[COEX_STATS];
+    /** UAP_SUCCESS or UAP_FAILURE per source */
+    int ret[SNAP_SOURCES];
+    /** Response time of each source */
+    u64 done_ns[SNAP_SOURCES];
+} uapsnap;
+
+/** One source of a snapshot, run on its own thread */
+typedef struct _uapsnap_job
+{
+    /** Snapshot filled in */
+    uapsnap *snap;
+    /** Source */
+    int source;
+    /** Thread */
+    pthread_t tid;
+} uapsnap_job;
+
+/** Options of the snapshot command */
+static struct option snapshot_options[] = {
+    {"help", 0, NULL, 'h'},
+    {NULL, 0, NULL, '\0'}
+};
+
+/** Names of the sources, as in the record */
+static const char *snap_names[SNAP_SOURCES] = {
+    "sys_info",
+    "sta_list",
+    "stats",
+    "powermode",
+    "coex",
+};
+
+/****************************************************************************
+        Local functions
+****************************************************************************/
+/**
+ *  @brief Gets the BT coex configuration bitmap and statistics in one
+ *  coex_config GET
+ *
+ *  @param snap     Snapshot
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+snap_get_coex(uapsnap * snap)
+{
+    apcmdbuf_coex_config *cmd_buf;
+    tlvbuf_coex_common_cfg *common;
+    tlvbuf_coex_stats *stats;
+    TLVBUF_HEADER *tlv;
+    u16 cmd_len = sizeof(apcmdbuf_coex_config) +
+        sizeof(tlvbuf_coex_common_cfg) + sizeof(tlvbuf_coex_stats);
+    u32 field;
+    u8 *buf, *p;
+    int i, left, len, found = 0, ret = UAP_FAILURE;
+
+    buf = uap_cmd_buf_alloc(snap->dev, cmd_len);
+    if (!buf)
+        return UAP_FAILURE;
+    cmd_buf = (apcmdbuf_coex_config *) buf;
+    common = (tlvbuf_coex_common_cfg *) cmd_buf->tlv_buffer;
+    common->Tag = MRVL_BT_COEX_COMMON_CFG_TLV_ID;
+    common->Length = sizeof(tlvbuf_coex_common_cfg) - sizeof(TLVBUF_HEADER);
+    endian_convert_tlv_header_out(common);
+    stats = (tlvbuf_coex_stats *) (cmd_buf->tlv_buffer +
+                                   sizeof(tlvbuf_coex_common_cfg));
+    stats->Tag = MRVL_BT_COEX_STATS_TLV_ID;
+    stats->Length = sizeof(tlvbuf_coex_stats) - sizeof(TLVBUF_HEADER);
+    endian_convert_tlv_header_out(stats);
+    cmd_buf->CmdCode = HostCmd_ROBUST_COEX;
+    cmd_buf->Size = cmd_len - BUF_HEADER_SIZE;
+    cmd_buf->SeqNum = 0;
+    cmd_buf->Result = 0;
+    cmd_buf->action = uap_cpu_to_le16(ACTION_GET);
+    if (uap_ioctl(snap->dev, buf, &cmd_len, cmd_len) != UAP_SUCCESS ||
+        cmd_buf->CmdCode != (HostCmd_ROBUST_COEX | APCMD_RESP_CHECK) ||
+        cmd_buf->Result != CMD_SUCCESS) {
+        uap_cmd_buf_free(snap->dev, buf);
+        return UAP_FAILURE;
+    }
+
+    /* The firmware may answer with the TLVs in any order */
+    p = cmd_buf->tlv_buffer;
+    left = cmd_buf->Size + BUF_HEADER_SIZE - sizeof(apcmdbuf_coex_config);
+    while (left >= (int) sizeof(TLVBUF_HEADER)) {
+        tlv = (TLVBUF_HEADER *) p;
+        len = sizeof(TLVBUF_HEADER) + uap_le16_to_cpu(tlv->Len);
+        if (len > left)
+            break;
+        switch (uap_le16_to_cpu(tlv->Type)) {
+        case MRVL_BT_COEX_COMMON_CFG_TLV_ID:
+            if (len < (int) sizeof(tlvbuf_coex_common_cfg))
+                break;
+            common = (tlvbuf_coex_common_cfg *) p;
+            snap->coex_bitmap = uap_le32_to_cpu(common->config_bitmap);
+            found |= 1;
+            break;
+        case MRVL_BT_COEX_STATS_TLV_ID:
+            if (len < (int) sizeof(tlvbuf_coex_stats))
+                break;
+            stats = (tlvbuf_coex_stats *) p;
+            /* The fields are packed, copy them out one by one */
+            for (i = 0; i < COEX_STATS; i++) {
+                memcpy(&field, (u8 *) & stats->null_not_sent +
+                       i * sizeof(u32), sizeof(u32));
+                snap->coex[i] = (unsigned int) uap_le32_to_cpu(field);
+            }
+            found |= 2;
+            break;
+        }
+        p += len;
+        left -= len;
+    }
+    if (found == 3)
+        ret = UAP_SUCCESS;
+    uap_cmd_buf_free(snap->dev, buf);
+    return ret;
+}
+
+/**
+ *  @brief Reads one source of a snapshot
+ *
+ *  @param snap     Snapshot
+ *  @param source   Source
+ *  @return         N/A
+ */
+static void
+snap_get(uapsnap * snap, int source)
+{
+    int ret = UAP_FAILURE;
+
+    switch (source) {
+    case SNAP_SYS_INFO:
+        if (uap_get_sys_info(snap->dev, snap->sys_info,
+                             sizeof(snap->sys_info)) == UAP_OK)
+            ret = UAP_SUCCESS;
+        break;
+    case SNAP_STA_LIST:
+        if (uap_get_sta_list(snap->dev, snap->sta, UAP_MAX_STA,
+                             &snap->sta_count) == UAP_OK)
+            ret = UAP_SUCCESS;
+        break;
+    case SNAP_STATS:
+        if (uap_get_stats(snap->dev, &snap->stats) == UAP_OK)
+            ret = UAP_SUCCESS;
+        break;
+    case SNAP_POWER_MODE:
+        /* A request without flags gets the current power mode */
+        memset(&snap->pm, 0, sizeof(ps_mgmt));
+        ret = uap_power_mode_ioctl(snap->dev, &snap->pm);
+        break;
+    case SNAP_COEX:
+        ret = snap_get_coex(snap);
+        break;
+    }
+    snap->ret[source] = ret;
+    snap->done_ns[source] = uap_time_ns();
+}
+
+/**
+ *  @brief Thread reading one source of a snapshot
+ *
+ *  @param arg      uapsnap_job of the source
+ *  @return         NULL
+ */
+static void *
+snap_thread(void *arg)
+{
+    uapsnap_job *job = (uapsnap_job *) arg;
+
+    snap_get(job->snap, job->source);
+    return NULL;
+}
+
+/**
+ *  @brief Reads every source of a snapshot
+ *
+ *  @param snap     Snapshot, with dev set
+ *  @return         N/A
+ */
+static void
+snap_take(uapsnap * snap)
+{
+    uapsnap_job job[SNAP_SOURCES];
+    int i, started = 0;
+
+    if (snap->dev->ops->concurrent && !snap->dev->trace) {
+        /* The calling thread reads the first source itself */
+        for (i = 1; i < SNAP_SOURCES; i++) {
+            job[i].snap = snap;
+            job[i].source = i;
+            if (pthread_create(&job[i].tid, NULL, snap_thread, &job[i]))
+                break;
+            started++;
+        }
+        snap_get(snap, 0);
+        for (i = 1; i <= started; i++)
+            pthread_join(job[i].tid, NULL);
+        /* Sources without a thread are read here */
+        for (i = started + 1; i < SNAP_SOURCES; i++)
+            snap_get(snap, i);
+        return;
+    }
+    for (i = 0; i < SNAP_SOURCES; i++)
+        snap_get(snap, i);
+}
+
+/**
+ *  @brief Prints a string as a JSON string
+ *
+ *  @param s        String
+ *  @return         N/A
+ */
+static void
+snap_print_string(const char *s)
+{
+    putchar('"');
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            printf("\\%c", *s);
+        else if ((unsigned char) *s < 0x20)
+            printf("\\u%04x", (unsigned char) *s);
+        else
+            putchar(*s);
+    }
+    putchar('"');
+}
+
+/**
+ *  @brief Prints a snapshot as one JSON object on one line
+ *
+ *  A source that could not be read is null and listed in "errors".
+ *
+ *  @param snap      Snapshot
+ *  @param time_ns   CLOCK_REALTIME when the first command was sent
+ *  @param start_ns  uap_time_ns() when the first command was sent
+ *  @return          N/A
+ */
+static void
+snap_print(uapsnap * snap, u64 time_ns, u64 start_ns)
+{
+    unsigned int value;
+    const char *name, *sep;
+    u64 end_ns = start_ns;
+    int i, count;
+
+    for (i = 0; i < SNAP_SOURCES; i++) {
+        if (snap->done_ns[i] > end_ns)
+            end_ns = snap->done_ns[i];
+    }
+    printf("{\"interface\":");
+    snap_print_string(snap->dev->name);
+    printf(",\"time\":%llu.%06llu,\"span_us\":%llu",
+           (unsigned long long) time_ns / 1000000000,
+           (unsigned long long) time_ns / 1000 % 1000000,
+           (unsigned long long) (end_ns - start_ns) / 1000);
+
+    printf(",\"sys_info\":");
+    if (snap->ret[SNAP_SYS_INFO] == UAP_SUCCESS)
+        snap_print_string(snap->sys_info);
+    else
+        printf("null");
+
+    printf(",\"stations\":");
+    if (snap->ret[SNAP_STA_LIST] == UAP_SUCCESS) {
+        count = MIN(snap->sta_count, UAP_MAX_STA);
+        printf("{\"count\":%d,\"list\":[", snap->sta_count);
+        for (i = 0; i < count; i++)
+            printf("%s{\"mac\":\"%02x:%02x:%02x:%02x:%02x:%02x\","
+                   "\"rssi\":%d,\"power_save\":%s}", i ? "," : "",
+                   snap->sta[i].mac[0], snap->sta[i].mac[1],
+                   snap->sta[i].mac[2], snap->sta[i].mac[3],
+                   snap->sta[i].mac[4], snap->sta[i].mac[5],
+                   snap->sta[i].rssi,
+                   snap->sta[i].power_save ? "true" : "false");
+        printf("]}");
+    } else {
+        printf("null");
+    }
+
+    printf(",\"stats\":");
+    if (snap->ret[SNAP_STATS] == UAP_SUCCESS) {
+        for (i = 0; (name = stats_field(&snap->stats, i, &value)); i++)
+            printf("%c\"%s\":%u", i ? ',' : '{', name, value);
+        printf("}");
+    } else {
+        printf("null");
+    }
+
+    printf(",\"powermode\":");
+    if (snap->ret[SNAP_POWER_MODE] == UAP_SUCCESS) {
+        printf("{\"mode\":");
+        snap_print_string(power_mode_name(snap->pm.ps_mode));
+        if (snap->pm.flags & PS_FLAG_SLEEP_PARAM)
+            printf(",\"ctrl_bitmap\":%d,\"min_sleep_us\":%d,"
+                   "\"max_sleep_us\":%d",
+                   (int) snap->pm.sleep_param.ctrl_bitmap,
+                   (int) snap->pm.sleep_param.min_sleep,
+                   (int) snap->pm.sleep_param.max_sleep);
+        if (snap->pm.flags & PS_FLAG_INACT_SLEEP_PARAM)
+            printf(",\"inactivity_to_us\":%d,\"min_awake_us\":%d,"
+                   "\"max_awake_us\":%d",
+                   (int) snap->pm.inact_param.inactivity_to,
+                   (int) snap->pm.inact_param.min_awake,
+                   (int) snap->pm.inact_param.max_awake);
+        printf("}");
+    } else {
+        printf("null");
+    }
+
+    printf(",\"coex\":");
+    if (snap->ret[SNAP_COEX] == UAP_SUCCESS) {
+        printf("{\"config_bitmap\":%u", snap->coex_bitmap);
+        for (i = 0; i < COEX_STATS; i++)
+            printf(",\"%s\":%u", coex_stats_name(i), snap->coex[i]);
+        printf("}");
+    } else {
+        printf("null");
+    }
+
+    printf(",\"errors\":[");
+    for (i = 0, sep = ""; i < SNAP_SOURCES; i++) {
+        if (snap->ret[i] != UAP_SUCCESS) {
+            printf("%s\"%s\"", sep, snap_names[i]);
+            sep = ",";
+        }
+    }
+    printf("]}\n");
+}
+
+/**
+ *  @brief Show usage information for the snapshot command
+ *
+ *  $return         N/A
+ */
+static void
+print_snapshot_usage(void)
+{
+    printf("\nUsage : snapshot\n");
+    printf("\nReads sys_info, sta_list, uap_stats, powermode and the BT\n"
+           "coex configuration and statistics together and prints them\n"
+           "as one JSON object on one line.  \"time\" is when the first\n"
+           "request was sent, \"span_us\" how long until the last\n"
+           "response; on the ioctl and sim transports the requests are\n"
+           "all in flight at once.  A source that could not be read is\n"
+           "null and listed in \"errors\".\n");
+}
+
+/****************************************************************************
+        Global functions
+****************************************************************************/
+/**
+ *  @brief Captures and prints a snapshot of the AP state
+ *
+ *  Usage: "snapshot"
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param argc     Number of arguments
+ *  @param argv     Pointer to the arguments
+ *  @return         N/A
+ */
+void
+apcmd_snapshot(uap_dev * dev, int argc, char *argv[])
+{
+    uapsnap *snap;
+    struct timespec now;
+    u64 time_ns, start_ns;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "+h", snapshot_options,
+                              NULL)) != -1) {
+        switch (opt) {
+        default:
+            print_snapshot_usage();
+            return;
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (argc) {
+        printf("ERR:Too many arguments.\n");
+        print_snapshot_usage();
+        return;
+    }
+
+    snap = (uapsnap *) calloc(1, sizeof(uapsnap));
+    if (!snap) {
+        printf("ERR:Cannot allocate memory!\n");
+        return;
+    }
+    snap->dev = dev;
+    clock_gettime(CLOCK_REALTIME, &now);
+    time_ns = (u64) now.tv_sec * 1000000000 + now.tv_nsec;
+    start_ns = uap_time_ns();
+    snap_take(snap);
+    snap_print(snap, time_ns, start_ns);
+    free(snap);
+}
@@ -0,0 +1,732 @@
+/** @file  uapsta.c
+ *
+ *  @brief This file contains the station table of the sta_list watch:
+ *  stations keyed by MAC address, diffed between polls, and the bulk and
+ *  policy modes of sta_deauth and the MAC filter diff built on it.
+ *
+ * Copyright (C) 2008-2009, Marvell International Ltd.
+ *
+ * This software file (the "File") is distributed by Marvell International
+ * Ltd. under the terms of the GNU General Public License Version 2, June 1991
+ * (the "License").  You may use, redistribute and/or modify this File in
+ * accordance with the terms and conditions of the License, a copy of which
+ * is available along with the File in the gpl.txt file or by writing to
+ * the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307 or on the worldwide web at http://www.gnu.org/licenses/gpl.txt.
+ *
+ * THE FILE IS DISTRIBUTED AS-IS, WITHOUT WARRANTY OF ANY KIND, AND THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE
+ * ARE EXPRESSLY DISCLAIMED.  The License provides additional details about
+ * this warranty disclaimer.
+ *
+ */
+/****************************************************************************
+Change log:
+    10/17/26: Initial creation
+****************************************************************************/
+
+/****************************************************************************
+        Header files
+****************************************************************************/
+#include <sys/types.h>
+#include <stdio.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <linux/if.h>
+#include "uaputl.h"
+
+/****************************************************************************
+        Definitions
+****************************************************************************/
+/*
+ * The table is open addressing with linear probing over a power of two
+ * number of slots, kept at most half full.  A station is found with
+ * one hash of its MAC address whatever the number of stations.  Every
+ * poll stamps the stations it reports with the poll number; those left
+ * with an older stamp have left and are removed by backward shifting,
+ * so no deleted markers build up in the probe sequences.
+ */
+
+/** Initial number of slots of the station table */
+#define STA_TABLE_MIN           32
+/** Most requests in flight of a bulk deauthentication */
+#define STA_DEAUTH_THREADS      8
+
+/** Station of the table */
+typedef struct _sta_entry
+{
+    /** Non zero for a used slot */
+    int used;
+    /** MAC address */
+    u8 mac[ETH_ALEN];
+    /** Poll that last reported the station */
+    long seen;
+    /** Non zero in power save */
+    int power_save;
+    /** RSSI of the last poll in dBm */
+    int rssi;
+    /** Lowest RSSI */
+    int rssi_min;
+    /** Highest RSSI */
+    int rssi_max;
+    /** RSSI moving average */
+    double rssi_ewma;
+    /** Number of polls that reported the station */
+    long samples;
+    /** Time of the join */
+    u64 joined_ns;
+    /** Consecutive polls with the RSSI below the policy threshold */
+    long low;
+} sta_entry;
+
+/** Station table */
+typedef struct _sta_table
+{
+    /** Slots, a power of two */
+    sta_entry *slot;
+    /** Number of slots */
+    int size;
+    /** Number of stations */
+    int count;
+} sta_table;
+
+/** State of a sta_list watch */
+typedef struct _sta_watch
+{
+    /** Stations */
+    sta_table table;
+    /** Current poll, from 1 */
+    long poll;
+    /** EWMA weight of the newest RSSI */
+    double alpha;
+    /** Start of the watch */
+    u64 start_ns;
+    /** Time of the current poll */
+    u64 now_ns;
+    /** Set when a station could not be added */
+    int nomem;
+    /** Non zero to print no JOIN, LEAVE or PS events */
+    int quiet;
+    /** RSSI threshold of the deauth policy in dBm, INT_MIN for none */
+    int rssi_below;
+} sta_watch;
+
+/** Bulk deauthentication shared by its threads */
+typedef struct _sta_deauth_job
+{
+    /** Device */
+    uap_dev *dev;
+    /** MAC addresses */
+    u8 (*mac)[ETH_ALEN];
+    /** Number of MAC addresses */
+    int n;
+    /** Reason code */
+    u16 reason;
+    /** Result of each MAC address */
+    int *ret;
+    /** Next MAC address to send, taken atomically */
+    int next;
+} sta_deauth_job;
+
+/** Set by SIGINT to end the watch */
+static volatile sig_atomic_t sta_watch_stop;
+
+/****************************************************************************
+        Local functions
+****************************************************************************/
+/**
+ *  @brief SIGINT handler of the sta_list watch
+ *
+ *  @param sig      Signal number
+ *  @return         N/A
+ */
+static void
+sta_watch_sigint(int sig)
+{
+    sta_watch_stop = 1;
+}
+
+/**
+ *  @brief Hashes a MAC address, FNV-1a
+ *
+ *  @param mac      MAC address
+ *  @return         Hash
+ */
+static unsigned int
+sta_hash(const u8 * mac)
+{
+    unsigned int h = 2166136261U;
+    int i;
+
+    for (i = 0; i < ETH_ALEN; i++)
+        h = (h ^ mac[i]) * 16777619U;
+    return h;
+}
+
+/**
+ *  @brief Finds the slot of a station, or the free slot it would take
+ *
+ *  @param t        Station table
+ *  @param mac      MAC address
+ *  @return         Slot
+ */
+static sta_entry *
+sta_find(sta_table * t, const u8 * mac)
+{
+    unsigned int i = sta_hash(mac) & (t->size - 1);
+
+    while (t->slot[i].used && memcmp(t->slot[i].mac, mac, ETH_ALEN))
+        i = (i + 1) & (t->size - 1);
+    return &t->slot[i];
+}
+
+/**
+ *  @brief Sets up an empty station table
+ *
+ *  @param t        Station table
+ *  @param size     Number of slots, a power of two
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+sta_table_init(sta_table * t, int size)
+{
+    t->slot = (sta_entry *) calloc(size, sizeof(sta_entry));
+    if (!t->slot)
+        return UAP_FAILURE;
+    t->size = size;
+    t->count = 0;
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Adds a station, doubling the table when half full
+ *
+ *  @param t        Station table
+ *  @param mac      MAC address, not in the table
+ *  @return         Slot of the station, NULL when out of memory
+ */
+static sta_entry *
+sta_add(sta_table * t, const u8 * mac)
+{
+    sta_table grown;
+    sta_entry *e;
+    int i;
+
+    if (2 * (t->count + 1) > t->size) {
+        if (sta_table_init(&grown, 2 * t->size) != UAP_SUCCESS)
+            return NULL;
+        for (i = 0; i < t->size; i++) {
+            if (t->slot[i].used)
+                *sta_find(&grown, t->slot[i].mac) = t->slot[i];
+        }
+        grown.count = t->count;
+        free(t->slot);
+        *t = grown;
+    }
+    e = sta_find(t, mac);
+    memset(e, 0, sizeof(sta_entry));
+    e->used = 1;
+    memcpy(e->mac, mac, ETH_ALEN);
+    t->count++;
+    return e;
+}
+
+/**
+ *  @brief Removes a station
+ *
+ *  The stations after it in its probe sequence move back into the
+ *  hole when that brings them closer to their home slot.
+ *
+ *  @param t        Station table
+ *  @param e        Slot of the station
+ *  @return         N/A
+ */
+static void
+sta_remove(sta_table * t, sta_entry * e)
+{
+    unsigned int mask = t->size - 1;
+    unsigned int hole = e - t->slot, i = hole, home;
+
+    for (;;) {
+        i = (i + 1) & mask;
+        if (!t->slot[i].used)
+            break;
+        home = sta_hash(t->slot[i].mac) & mask;
+        /* Move the entry unless its home lies cyclically in (hole, i] */
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            t->slot[hole] = t->slot[i];
+            hole = i;
+        }
+    }
+    t->slot[hole].used = 0;
+    t->count--;
+}
+
+/**
+ *  @brief Prints the time and MAC address that start an event line
+ *
+ *  @param w        Watch
+ *  @param event    Event name
+ *  @param e        Station
+ *  @return         N/A
+ */
+static void
+sta_event(sta_watch * w, char *event, sta_entry * e)
+{
+    printf("%9.3f %-6s ", (w->now_ns - w->start_ns) / 1e9, event);
+    print_mac(e->mac);
+}
+
+/**
+ *  @brief Prints the RSSI summary of a station
+ *
+ *  @param e        Station
+ *  @return         N/A
+ */
+static void
+sta_print_rssi(sta_entry * e)
+{
+    printf("rssi %d dBm, min %d max %d avg %.1f", e->rssi, e->rssi_min,
+           e->rssi_max, e->rssi_ewma);
+}
+
+/**
+ *  @brief Updates the table with one station of a poll, as the station
+ *  list is decoded, and prints its change
+ *
+ *  @param arg      sta_watch
+ *  @param sta      Station
+ *  @return         0 to go on, 1 when out of memory
+ */
+static int
+sta_watch_seen(void *arg, const uap_sta_info * sta)
+{
+    sta_watch *w = (sta_watch *) arg;
+    sta_entry *e;
+
+    e = sta_find(&w->table, sta->mac);
+    if (!e->used) {
+        e = sta_add(&w->table, sta->mac);
+        if (!e) {
+            w->nomem = 1;
+            return 1;
+        }
+        e->power_save = sta->power_save;
+        e->rssi = e->rssi_min = e->rssi_max = sta->rssi;
+        e->rssi_ewma = sta->rssi;
+        e->joined_ns = w->now_ns;
+        if (!w->quiet) {
+            sta_event(w, "JOIN", e);
+            printf(" rssi %d dBm, %s\n", e->rssi,
+                   e->power_save ? "power save" : "active");
+        }
+    } else if (e->power_save != sta->power_save) {
+        e->power_save = sta->power_save;
+        if (!w->quiet) {
+            sta_event(w, "PS", e);
+            printf(" %s, rssi %d dBm\n",
+                   e->power_save ? "power save" : "active", sta->rssi);
+        }
+    }
+    e->seen = w->poll;
+    e->samples++;
+    e->rssi = sta->rssi;
+    if (e->rssi < e->rssi_min)
+        e->rssi_min = e->rssi;
+    if (e->rssi > e->rssi_max)
+        e->rssi_max = e->rssi;
+    e->rssi_ewma += w->alpha * (e->rssi - e->rssi_ewma);
+    e->low = e->rssi < w->rssi_below ? e->low + 1 : 0;
+    return 0;
+}
+
+/**
+ *  @brief Removes the stations a poll did not report and prints them
+ *
+ *  @param w        Watch
+ *  @return         N/A
+ */
+static void
+sta_watch_sweep(sta_watch * w)
+{
+    sta_table *t = &w->table;
+    sta_entry *e;
+    int i;
+
+    /* A removal may move a later station into slot i, look again */
+    for (i = 0; i < t->size;) {
+        e = &t->slot[i];
+        if (e->used && e->seen != w->poll) {
+            if (!w->quiet) {
+                sta_event(w, "LEAVE", e);
+                printf(" after %.1f s, ", (w->now_ns - e->joined_ns) / 1e9);
+                sta_print_rssi(e);
+                printf("\n");
+            }
+            sta_remove(t, e);
+        } else {
+            i++;
+        }
+    }
+}
+
+/**
+ *  @brief Sends the deauthentications of a bulk job until none is left
+ *
+ *  @param arg      sta_deauth_job
+ *  @return         NULL
+ */
+static void *
+sta_deauth_worker(void *arg)
+{
+    sta_deauth_job *job = (sta_deauth_job *) arg;
+    int i;
+
+    while ((i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) <
+           job->n)
+        job->ret[i] = uap_sta_deauth(job->dev, job->mac[i], job->reason);
+    return NULL;
+}
+
+/**
+ *  @brief Sets up a watch and the SIGINT handler ending it
+ *
+ *  @param w        Watch
+ *  @param alpha    EWMA weight of the newest RSSI
+ *  @param old_sa   Returns the previous SIGINT action
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+sta_watch_start(sta_watch * w, double alpha, struct sigaction *old_sa)
+{
+    struct sigaction sa;
+
+    memset(w, 0, sizeof(sta_watch));
+    if (sta_table_init(&w->table, STA_TABLE_MIN) != UAP_SUCCESS) {
+        printf("ERR:Cannot allocate memory!\n");
+        return UAP_FAILURE;
+    }
+    w->alpha = alpha;
+    w->rssi_below = INT_MIN;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sta_watch_sigint;
+    sigemptyset(&sa.sa_mask);
+    sta_watch_stop = 0;
+    sigaction(SIGINT, &sa, old_sa);
+    w->start_ns = w->now_ns = uap_time_ns();
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Waits for the next poll of a watch and polls the station list
+ *
+ *  The first poll is not delayed.
+ *
+ *  @param dev          A pointer to uap_dev structure
+ *  @param w            Watch, w->poll is the poll to make
+ *  @param next         Schedule of the polls, CLOCK_MONOTONIC
+ *  @param interval_ms  Polling interval in ms
+ *  @return             UAP_SUCCESS, or UAP_FAILURE when interrupted or
+ *                      on an error, printed
+ */
+static int
+sta_watch_poll(uap_dev * dev, sta_watch * w, struct timespec *next,
+               long interval_ms)
+{
+    int ret, sta_count;
+
+    if (w->poll > 1) {
+        next->tv_sec += interval_ms / 1000;
+        next->tv_nsec += (interval_ms % 1000) * 1000000;
+        if (next->tv_nsec >= 1000000000) {
+            next->tv_sec++;
+            next->tv_nsec -= 1000000000;
+        }
+        while (!sta_watch_stop &&
+               clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, next,
+                               NULL) == EINTR) ;
+    }
+    if (sta_watch_stop)
+        return UAP_FAILURE;
+    w->now_ns = uap_time_ns();
+    ret = uap_sta_list_walk(dev, sta_watch_seen, w, &sta_count);
+    if (w->nomem) {
+        printf("ERR:Cannot allocate memory!\n");
+        return UAP_FAILURE;
+    }
+    if (ret == UAP_ERR_PROTO) {
+        printf("ERR:%s\n", uap_last_error(dev));
+        return UAP_FAILURE;
+    }
+    if (ret != UAP_OK) {
+        print_lib_error(ret, "Could not get STA list!");
+        return UAP_FAILURE;
+    }
+    sta_watch_sweep(w);
+    return UAP_SUCCESS;
+}
+
+/****************************************************************************
+        Global functions
+****************************************************************************/
+/**
+ *  @brief Polls the station list and prints joins, leaves and power
+ *  save changes
+ *
+ *  The stations of the first poll are printed as joins.  At the end
+ *  the stations still associated are printed with their RSSI range and
+ *  moving average.
+ *
+ *  @param dev         A pointer to uap_dev structure
+ *  @param interval_ms Polling interval in ms
+ *  @param count       Number of polls, 0 until interrupted
+ *  @param alpha       EWMA weight of the newest RSSI, 0 < alpha <= 1
+ *  @return            N/A
+ */
+void
+sta_list_watch(uap_dev * dev, long interval_ms, long count, double alpha)
+{
+    struct sigaction old_sa;
+    struct timespec next;
+    sta_watch w;
+    sta_entry *e;
+    int i;
+
+    if (sta_watch_start(&w, alpha, &old_sa) != UAP_SUCCESS)
+        return;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (w.poll = 1; !count || w.poll <= count; w.poll++) {
+        if (sta_watch_poll(dev, &w, &next, interval_ms) != UAP_SUCCESS)
+            break;
+        fflush(stdout);
+    }
+    sigaction(SIGINT, &old_sa, NULL);
+
+    printf("%d stations after %.3f s:\n", w.table.count,
+           (w.now_ns - w.start_ns) / 1e9);
+    for (i = 0; i < w.table.size; i++) {
+        e = &w.table.slot[i];
+        if (!e->used)
+            continue;
+        print_mac(e->mac);
+        printf(" %s, %ld polls, ", e->power_save ? "power save" : "active",
+               e->samples);
+        sta_print_rssi(e);
+        printf("\n");
+    }
+    free(w.table.slot);
+}
+
+/**
+ *  @brief Deauthenticates a list of stations back to back
+ *
+ *  The requests share the handle.  On a transport taking concurrent
+ *  requests up to STA_DEAUTH_THREADS are in flight at once; they are
+ *  sent one at a time while a trace is recorded, so that it replays.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param mac      MAC addresses
+ *  @param n        Number of MAC addresses
+ *  @param reason   Reason code
+ *  @param ret      Returns the UAP_OK or UAP_ERR_ code of each address
+ *  @return         Number of stations deauthenticated
+ */
+int
+sta_deauth_list(uap_dev * dev, u8 (*mac)[ETH_ALEN], int n, u16 reason,
+                int *ret)
+{
+    pthread_t tid[STA_DEAUTH_THREADS - 1];
+    sta_deauth_job job;
+    int i, threads = 0, done = 0;
+
+    job.dev = dev;
+    job.mac = mac;
+    job.n = n;
+    job.reason = reason;
+    job.ret = ret;
+    job.next = 0;
+    if (dev->ops->concurrent && !dev->trace) {
+        while (threads < STA_DEAUTH_THREADS - 1 && threads < n - 1 &&
+               !pthread_create(&tid[threads], NULL, sta_deauth_worker, &job))
+            threads++;
+    }
+    sta_deauth_worker(&job);
+    for (i = 0; i < threads; i++)
+        pthread_join(tid[i], NULL);
+    for (i = 0; i < n; i++) {
+        if (ret[i] == UAP_OK)
+            done++;
+    }
+    return done;
+}
+
+/**
+ *  @brief Polls the station list and deauthenticates the stations whose
+ *  RSSI stays below a threshold
+ *
+ *  A station is deauthenticated once its RSSI was below the threshold
+ *  for the given number of consecutive polls; the stations of one poll
+ *  go back to back through sta_deauth_list().  A station whose
+ *  deauthentication failed is tried again on the next poll.
+ *
+ *  @param dev          A pointer to uap_dev structure
+ *  @param rssi_below   RSSI threshold in dBm
+ *  @param samples      Number of consecutive polls below the threshold
+ *  @param interval_ms  Polling interval in ms
+ *  @param count        Number of polls, 0 until interrupted
+ *  @param reason       Reason code
+ *  @param dry_run      Non zero to print the stations without
+ *                      deauthenticating them
+ *  @return             N/A
+ */
+void
+sta_deauth_policy(uap_dev * dev, int rssi_below, long samples,
+                  long interval_ms, long count, u16 reason, int dry_run)
+{
+    struct sigaction old_sa;
+    struct timespec next;
+    sta_watch w;
+    sta_entry *e;
+    u8 (*mac)[ETH_ALEN] = NULL;
+    int *ret = NULL;
+    int i, n, size = 0, total = 0;
+
+    if (sta_watch_start(&w, STA_WATCH_ALPHA, &old_sa) != UAP_SUCCESS)
+        return;
+    w.quiet = 1;
+    w.rssi_below = rssi_below;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (w.poll = 1; !count || w.poll <= count; w.poll++) {
+        if (sta_watch_poll(dev, &w, &next, interval_ms) != UAP_SUCCESS)
+            break;
+        if (size < w.table.count) {
+            size = w.table.size;
+            free(mac);
+            free(ret);
+            mac = malloc(size * sizeof(*mac));
+            ret = malloc(size * sizeof(int));
+            if (!mac || !ret) {
+                printf("ERR:Cannot allocate memory!\n");
+                break;
+            }
+        }
+        for (i = n = 0; i < w.table.size; i++) {
+            e = &w.table.slot[i];
+            if (e->used && e->low >= samples)
+                memcpy(mac[n++], e->mac, ETH_ALEN);
+        }
+        if (!n)
+            continue;
+        if (dry_run)
+            total += n;
+        else
+            total += sta_deauth_list(dev, mac, n, reason, ret);
+        for (i = 0; i < n; i++) {
+            e = sta_find(&w.table, mac[i]);
+            sta_event(&w, "DEAUTH", e);
+            printf(" rssi %d dBm for %ld polls: ", e->rssi, e->low);
+            if (dry_run) {
+                /* The station stays, it matches again after samples */
+                printf("dry run\n");
+                e->low = 0;
+            } else if (ret[i] == UAP_OK) {
+                printf("ok\n");
+                sta_remove(&w.table, e);
+            } else {
+                print_lib_error(ret[i], "Deauthentication unsuccessful!");
+            }
+        }
+        fflush(stdout);
+    }
+    sigaction(SIGINT, &old_sa, NULL);
+
+    printf("%d stations %sdeauthenticated in %.3f s\n", total,
+           dry_run ? "to be " : "", (w.now_ns - w.start_ns) / 1e9);
+    free(mac);
+    free(ret);
+    free(w.table.slot);
+}
+
+/**
+ *  @brief Removes the repeated addresses of a MAC list
+ *
+ *  The first occurrence of each address is kept, in order.
+ *
+ *  @param macs     List
+ *  @return         UAP_SUCCESS, or UAP_FAILURE when out of memory
+ */
+int
+sta_mac_dedup(mac_list * macs)
+{
+    sta_table t;
+    int i, n = 0;
+
+    if (sta_table_init(&t, STA_TABLE_MIN) != UAP_SUCCESS)
+        return UAP_FAILURE;
+    for (i = 0; i < macs->n; i++) {
+        if (sta_find(&t, macs->mac[i])->used)
+            continue;
+        if (!sta_add(&t, macs->mac[i])) {
+            free(t.slot);
+            return UAP_FAILURE;
+        }
+        memmove(macs->mac[n++], macs->mac[i], ETH_ALEN);
+    }
+    macs->n = n;
+    free(t.slot);
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Prints the changes from a MAC filter table to a MAC list
+ *
+ *  Addresses only in the list are printed with '+', those only in the
+ *  table with '-'.
+ *
+ *  @param macs       List, without repeated addresses
+ *  @param cur        Addresses of the table, ETH_ALEN bytes each
+ *  @param cur_count  Number of addresses of the table
+ *  @return           Number of changes, -1 when out of memory
+ */
+int
+sta_mac_diff(mac_list * macs, u8 * cur, int cur_count)
+{
+    sta_table t;
+    sta_entry *e;
+    int i, changes = 0;
+
+    if (sta_table_init(&t, STA_TABLE_MIN) != UAP_SUCCESS)
+        return -1;
+    for (i = 0; i < macs->n; i++) {
+        if (!sta_add(&t, macs->mac[i])) {
+            free(t.slot);
+            return -1;
+        }
+    }
+    for (i = 0; i < cur_count; i++) {
+        e = sta_find(&t, cur + i * ETH_ALEN);
+        if (e->used) {
+            e->seen = 1;
+        } else {
+            printf("- ");
+            print_mac(cur + i * ETH_ALEN);
+            printf("\n");
+            changes++;
+        }
+    }
+    for (i = 0; i < macs->n; i++) {
+        if (!sta_find(&t, macs->mac[i])->seen) {
+            printf("+ ");
+            print_mac(macs->mac[i]);
+            printf("\n");
+            changes++;
+        }
+    }
+    free(t.slot);
+    return changes;
+}
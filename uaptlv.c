@@ -0,0 +1,164 @@
+/** @file  uaptlv.c
+ *
+ *  @brief This file contains the TLV builder of the sys_configure
+ *  commands: TLVs are appended in place in one command buffer.
+ *
+ * Copyright (C) 2008-2009, Marvell International Ltd.
+ *
+ * This software file (the "File") is distributed by Marvell International
+ * Ltd. under the terms of the GNU General Public License Version 2, June 1991
+ * (the "License").  You may use, redistribute and/or modify this File in
+ * accordance with the terms and conditions of the License, a copy of which
+ * is available along with the File in the gpl.txt file or by writing to
+ * the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307 or on the worldwide web at http://www.gnu.org/licenses/gpl.txt.
+ *
+ * THE FILE IS DISTRIBUTED AS-IS, WITHOUT WARRANTY OF ANY KIND, AND THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE
+ * ARE EXPRESSLY DISCLAIMED.  The License provides additional details about
+ * this warranty disclaimer.
+ *
+ */
+/****************************************************************************
+Change log:
+    10/17/26: Initial creation
+****************************************************************************/
+
+/****************************************************************************
+        Header files
+****************************************************************************/
+#include <sys/types.h>
+#include <stdio.h>
+#include <string.h>
+#include <linux/if.h>
+#include "uaputl.h"
+
+/****************************************************************************
+        Definitions
+****************************************************************************/
+/*
+ * The command is built in one pooled MRVDRV_SIZE_OF_CMD_BUFFER buffer:
+ * a TLV that would not fit is refused, so nothing is ever reallocated
+ * or written past the buffer.  TLV headers stay in CPU order while the
+ * command is built, for the callers to read back, and are converted to
+ * little endian when it is sent.  Errors are reported on the handle
+ * with uap_dev_error(), so the builder serves libuaputl as well as the
+ * commands of the tool.
+ */
+
+/****************************************************************************
+        Global functions
+****************************************************************************/
+/**
+ *  @brief Starts a sys_configure command
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param b        Builder
+ *  @param action   ACTION_GET or ACTION_SET
+ *  @return         UAP_SUCCESS or UAP_FAILURE, reported on the handle
+ */
+int
+tlv_build_start(uap_dev * dev, tlv_builder * b, u16 action)
+{
+    APCMDBUF_SYS_CONFIGURE *cmd_buf;
+
+    b->dev = dev;
+    b->len = sizeof(APCMDBUF_SYS_CONFIGURE);
+    b->count = 0;
+    b->buf = uap_cmd_buf_alloc(dev, b->len);
+    if (!b->buf) {
+        uap_dev_error(dev, UAP_ERR_NOMEM,
+                      "Cannot allocate buffer for command!");
+        return UAP_FAILURE;
+    }
+    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) b->buf;
+    cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
+    cmd_buf->Action = action;
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Appends a TLV to the command
+ *
+ *  The TLV is zeroed and its Length set to size less the header; the
+ *  caller may set another Length, the TLV still takes size bytes.
+ *
+ *  @param b        Builder
+ *  @param tag      TLV tag
+ *  @param size     TLV size with its header
+ *  @return         TLV, NULL if it does not fit, reported on the handle
+ */
+void *
+tlv_build_add(tlv_builder * b, u16 tag, u16 size)
+{
+    TLVBUF_HEADER *tlv;
+
+    if (size < sizeof(TLVBUF_HEADER) || b->count == TLV_BUILD_MAX ||
+        size > MRVDRV_SIZE_OF_CMD_BUFFER - b->len) {
+        uap_dev_error(b->dev, UAP_ERR_INVAL,
+                      "TLV 0x%04x does not fit in the command!", tag);
+        return NULL;
+    }
+    tlv = (TLVBUF_HEADER *) (b->buf + b->len);
+    memset(tlv, 0, size);
+    tlv->Type = tag;
+    tlv->Len = size - sizeof(TLVBUF_HEADER);
+    b->off[b->count++] = b->len;
+    b->len += size;
+    return tlv;
+}
+
+/**
+ *  @brief Shrinks the last TLV of the command
+ *
+ *  @param b        Builder
+ *  @param tlv      Last TLV from tlv_build_add()
+ *  @param size     New TLV size with its header, at most its size
+ *  @return         N/A
+ */
+void
+tlv_build_trim(tlv_builder * b, void *tlv, u16 size)
+{
+    b->len = (u8 *) tlv - b->buf + size;
+    ((TLVBUF_HEADER *) tlv)->Len = size - sizeof(TLVBUF_HEADER);
+}
+
+/**
+ *  @brief Sends the command
+ *
+ *  On return b->len is the size of the response; its TLV headers are
+ *  left as received, in little endian.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param b        Builder
+ *  @return         UAP_SUCCESS or UAP_FAILURE, as uap_ioctl()
+ */
+int
+tlv_build_send(uap_dev * dev, tlv_builder * b)
+{
+    TLVBUF_HEADER *tlv;
+    int i;
+
+    ((APCMDBUF_SYS_CONFIGURE *) b->buf)->Size = b->len;
+    for (i = 0; i < b->count; i++) {
+        tlv = (TLVBUF_HEADER *) (b->buf + b->off[i]);
+        tlv->Type = uap_cpu_to_le16(tlv->Type);
+        tlv->Len = uap_cpu_to_le16(tlv->Len);
+    }
+    b->count = 0;
+    return uap_ioctl(dev, b->buf, &b->len, MRVDRV_SIZE_OF_CMD_BUFFER);
+}
+
+/**
+ *  @brief Releases the command buffer
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param b        Builder, may be unstarted when b->buf is NULL
+ *  @return         N/A
+ */
+void
+tlv_build_free(uap_dev * dev, tlv_builder * b)
+{
+    uap_cmd_buf_free(dev, b->buf);
+    b->buf = NULL;
+}
@@ -0,0 +1,421 @@
+/** @file  uaptrace.c
+ *
+ *  @brief This file contains the host command trace: recording of the
+ *  traffic sent through a uAP device, trace decoding and the replay
+ *  transport.
+ *
+ * Copyright (C) 2008-2009, Marvell International Ltd.
+ *
+ * This software file (the "File") is distributed by Marvell International
+ * Ltd. under the terms of the GNU General Public License Version 2, June 1991
+ * (the "License").  You may use, redistribute and/or modify this File in
+ * accordance with the terms and conditions of the License, a copy of which
+ * is available along with the File in the gpl.txt file or by writing to
+ * the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307 or on the worldwide web at http://www.gnu.org/licenses/gpl.txt.
+ *
+ * THE FILE IS DISTRIBUTED AS-IS, WITHOUT WARRANTY OF ANY KIND, AND THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE
+ * ARE EXPRESSLY DISCLAIMED.  The License provides additional details about
+ * this warranty disclaimer.
+ *
+ */
+/****************************************************************************
+Change log:
+    10/17/26: Initial creation
+****************************************************************************/
+
+/****************************************************************************
+        Header files
+****************************************************************************/
+#include <sys/types.h>
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/if.h>
+#include "uaputl.h"
+
+/****************************************************************************
+        Definitions
+****************************************************************************/
+/** Trace file magic */
+#define UAP_TRACE_MAGIC         "UAPTRACE"
+/** Trace file magic length */
+#define UAP_TRACE_MAGIC_LEN     8
+/** Trace file format version */
+#define UAP_TRACE_VERSION       1
+/** Record header length, see uap_trace_record() */
+#define UAP_TRACE_REC_LEN       24
+
+/** Replay backend state */
+typedef struct _trace_replay
+{
+    /** Trace file contents */
+    u8 *data;
+    /** Trace file length */
+    long len;
+    /** Read offset */
+    long off;
+} trace_replay;
+
+/****************************************************************************
+        Local functions
+****************************************************************************/
+/**
+ *  @brief Stores a 16 bit little endian value
+ *
+ *  @param p        Destination
+ *  @param v        Value
+ *  @return         N/A
+ */
+static void
+put_le16(u8 * p, u16 v)
+{
+    p[0] = (u8) v;
+    p[1] = (u8) (v >> 8);
+}
+
+/**
+ *  @brief Stores a 32 bit little endian value
+ *
+ *  @param p        Destination
+ *  @param v        Value
+ *  @return         N/A
+ */
+static void
+put_le32(u8 * p, u32 v)
+{
+    put_le16(p, (u16) v);
+    put_le16(p + 2, (u16) (v >> 16));
+}
+
+/**
+ *  @brief Loads a 16 bit little endian value
+ *
+ *  @param p        Source
+ *  @return         Value
+ */
+static u16
+get_le16(u8 * p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+/**
+ *  @brief Loads a 32 bit little endian value
+ *
+ *  @param p        Source
+ *  @return         Value
+ */
+static u32
+get_le32(u8 * p)
+{
+    return get_le16(p) | ((u32) get_le16(p + 2) << 16);
+}
+
+/**
+ *  @brief Returns the next replay record of a type
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param type     Record type
+ *  @param rec      Decoded record
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+replay_next(uap_dev * dev, u8 type, trace_rec * rec)
+{
+    trace_replay *replay = (trace_replay *) dev->priv;
+    long next;
+
+    while ((next = uap_trace_decode(replay->data, replay->len, replay->off,
+                                rec)) > 0) {
+        replay->off = next;
+        if (rec->type == type)
+            return UAP_SUCCESS;
+    }
+    errno = ENODATA;
+    uap_dev_error(dev, UAP_ERR_IO, "Replay trace exhausted");
+    return UAP_FAILURE;
+}
+
+/**
+ *  @brief Opens the replay backend
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param arg      Trace file name
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+replay_open(uap_dev * dev, char *arg)
+{
+    trace_replay *replay;
+
+    if (!arg) {
+        uap_dev_error(dev, UAP_ERR_INVAL, "Usage: -t replay:<trace file>");
+        return UAP_FAILURE;
+    }
+    replay = (trace_replay *) malloc(sizeof(trace_replay));
+    if (!replay) {
+        uap_dev_error(dev, UAP_ERR_NOMEM, "Cannot allocate replay state!");
+        return UAP_FAILURE;
+    }
+    replay->data = uap_trace_load(dev, arg, &replay->len);
+    if (!replay->data) {
+        free(replay);
+        return UAP_FAILURE;
+    }
+    replay->off = UAP_TRACE_HDR_LEN;
+    dev->priv = replay;
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Answers a host command with the next recorded response
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param buf      Command buffer, overwritten with the response
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+replay_cmd(uap_dev * dev, u8 * buf)
+{
+    APCMDBUF *header = (APCMDBUF *) buf;
+    u16 cap = *(u32 *) buf + BUF_HEADER_SIZE;
+    u16 seq_num = header->SeqNum;
+    trace_rec rec;
+
+    if (replay_next(dev, UAP_TRACE_HOSTCMD, &rec) != UAP_SUCCESS)
+        return UAP_FAILURE;
+    if (rec.cmd_code != uap_le16_to_cpu(header->CmdCode)) {
+        errno = EPROTO;
+        uap_dev_error(dev, UAP_ERR_PROTO,
+                      "Replay mismatch: trace has command 0x%04x, got 0x%04x",
+                      rec.cmd_code, uap_le16_to_cpu(header->CmdCode));
+        return UAP_FAILURE;
+    }
+    if (rec.status != UAP_SUCCESS) {
+        errno = EIO;
+        uap_dev_error(dev, UAP_ERR_IO, "Recorded command 0x%04x failed",
+                      rec.cmd_code);
+        return UAP_FAILURE;
+    }
+    if (rec.resp_len > cap) {
+        errno = EMSGSIZE;
+        uap_dev_error(dev, UAP_ERR_PROTO,
+                      "Recorded response (%d) larger than buffer (%d)",
+                      rec.resp_len, cap);
+        return UAP_FAILURE;
+    }
+    memcpy(buf, rec.resp, rec.resp_len);
+    /* Traces are matched by order, answer with the live sequence number */
+    if (rec.resp_len >= sizeof(APCMDBUF))
+        header->SeqNum = seq_num;
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Answers a power mode request with the recorded one
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param pm       A pointer to ps_mgmt structure
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+replay_power_mode(uap_dev * dev, ps_mgmt * pm)
+{
+    trace_rec rec;
+
+    if (replay_next(dev, UAP_TRACE_POWER_MODE, &rec) != UAP_SUCCESS)
+        return UAP_FAILURE;
+    if (rec.status != UAP_SUCCESS || rec.resp_len != sizeof(ps_mgmt)) {
+        errno = EIO;
+        uap_dev_error(dev, UAP_ERR_IO, "Recorded power mode request failed");
+        return UAP_FAILURE;
+    }
+    memcpy(pm, rec.resp, sizeof(ps_mgmt));
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Releases the replay backend
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @return         N/A
+ */
+static void
+replay_close(uap_dev * dev)
+{
+    trace_replay *replay = (trace_replay *) dev->priv;
+
+    free(replay->data);
+    free(replay);
+}
+
+/****************************************************************************
+        Global functions
+****************************************************************************/
+/**
+ *  @brief Decodes the trace record at an offset
+ *
+ *  @param data     Trace contents
+ *  @param len      Trace length
+ *  @param off      Record offset
+ *  @param rec      Decoded record
+ *  @return         Offset of the next record, -1 if truncated
+ */
+long
+uap_trace_decode(u8 * data, long len, long off, trace_rec * rec)
+{
+    u8 *p = data + off;
+
+    if (off + UAP_TRACE_REC_LEN > len)
+        return -1;
+    rec->type = p[0];
+    rec->status = p[1];
+    rec->cmd_code = get_le16(p + 2);
+    rec->seq_num = get_le16(p + 4);
+    rec->req_len = get_le16(p + 6);
+    rec->resp_len = get_le16(p + 8);
+    rec->buf_size = get_le16(p + 10);
+    rec->start_ns = get_le32(p + 12) | ((u64) get_le32(p + 16) << 32);
+    rec->latency_ns = get_le32(p + 20);
+    off += UAP_TRACE_REC_LEN;
+    if (off + rec->req_len + rec->resp_len > len)
+        return -1;
+    rec->req = data + off;
+    rec->resp = rec->req + rec->req_len;
+    return off + rec->req_len + rec->resp_len;
+}
+
+/**
+ *  @brief Reads a whole trace file and checks its header
+ *
+ *  @param dev      A pointer to uap_dev structure, for errors
+ *  @param file     Trace file name
+ *  @param len      Length of the returned contents
+ *  @return         Trace contents or NULL
+ */
+u8 *
+uap_trace_load(uap_dev * dev, char *file, long *len)
+{
+    FILE *fp;
+    u8 *data = NULL;
+
+    fp = fopen(file, "r");
+    if (!fp) {
+        uap_dev_error(dev, UAP_ERR_NODEV, "Cannot open trace file %s", file);
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    *len = ftell(fp);
+    rewind(fp);
+    if (*len >= UAP_TRACE_HDR_LEN)
+        data = (u8 *) malloc(*len);
+    if (!data || fread(data, 1, *len, fp) != *len ||
+        memcmp(data, UAP_TRACE_MAGIC, UAP_TRACE_MAGIC_LEN) ||
+        get_le16(data + UAP_TRACE_MAGIC_LEN) != UAP_TRACE_VERSION) {
+        uap_dev_error(dev, UAP_ERR_INVAL, "%s is not a uaputl trace", file);
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+    return data;
+}
+
+/**
+ *  @brief Starts recording the traffic of a device
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param file     Trace file name
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+int
+uap_trace_open(uap_dev * dev, char *file)
+{
+    u8 hdr[UAP_TRACE_HDR_LEN];
+
+    dev->trace = fopen(file, "w");
+    if (!dev->trace) {
+        uap_dev_error(dev, UAP_ERR_NODEV, "Cannot create trace file %s", file);
+        return UAP_FAILURE;
+    }
+    memcpy(hdr, UAP_TRACE_MAGIC, UAP_TRACE_MAGIC_LEN);
+    put_le16(hdr + UAP_TRACE_MAGIC_LEN, UAP_TRACE_VERSION);
+    put_le16(hdr + UAP_TRACE_MAGIC_LEN + 2, 0);
+    fwrite(hdr, 1, sizeof(hdr), dev->trace);
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Stops recording the traffic of a device
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @return         N/A
+ */
+void
+uap_trace_close(uap_dev * dev)
+{
+    if (dev->trace) {
+        fclose(dev->trace);
+        dev->trace = NULL;
+    }
+}
+
+/**
+ *  @brief Appends one request/response exchange to the trace
+ *
+ *  Record layout, little endian: type(1) status(1) CmdCode(2) SeqNum(2)
+ *  request length(2) response length(2) buffer size(2) start time in
+ *  ns(8) latency in ns(4), then the request and the response bytes as
+ *  seen on the wire.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param type     UAP_TRACE_HOSTCMD or UAP_TRACE_POWER_MODE
+ *  @param status   Transport status
+ *  @param req      Request bytes
+ *  @param req_len  Request length
+ *  @param resp     Response bytes
+ *  @param resp_len Response length
+ *  @param buf_size Command buffer size
+ *  @param start_ns Monotonic time the request was sent
+ *  @param end_ns   Monotonic time the response was received
+ *  @return         N/A
+ */
+void
+uap_trace_record(uap_dev * dev, u8 type, int status, u8 * req, u16 req_len,
+                 u8 * resp, u16 resp_len, u16 buf_size, u64 start_ns,
+                 u64 end_ns)
+{
+    u8 hdr[UAP_TRACE_REC_LEN];
+    u64 latency = end_ns - start_ns;
+    APCMDBUF *header = (APCMDBUF *) req;
+
+    hdr[0] = type;
+    hdr[1] = (u8) status;
+    if (type == UAP_TRACE_HOSTCMD) {
+        put_le16(hdr + 2, uap_le16_to_cpu(header->CmdCode));
+        put_le16(hdr + 4, uap_le16_to_cpu(header->SeqNum));
+    } else {
+        put_le16(hdr + 2, 0);
+        put_le16(hdr + 4, 0);
+    }
+    put_le16(hdr + 6, req_len);
+    put_le16(hdr + 8, resp_len);
+    put_le16(hdr + 10, buf_size);
+    put_le32(hdr + 12, (u32) (start_ns & 0xffffffff));
+    put_le32(hdr + 16, (u32) (start_ns >> 32));
+    put_le32(hdr + 20, latency > 0xffffffffULL ? 0xffffffff : (u32) latency);
+    fwrite(hdr, 1, sizeof(hdr), dev->trace);
+    fwrite(req, 1, req_len, dev->trace);
+    fwrite(resp, 1, resp_len, dev->trace);
+}
+
+/** Trace replay backend */
+uap_transport uap_replay_transport = {
+    "replay",
+    replay_open,
+    replay_cmd,
+    replay_power_mode,
+    replay_close
+};
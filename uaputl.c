@@ -27,6 +27,8 @@ Change log:
 /****************************************************************************
         Header files
 ****************************************************************************/
+/** fopencookie() */
+#define _GNU_SOURCE
 #include <stdarg.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -41,7 +43,14 @@ Change log:
 #include <ctype.h>
 #include <linux/if.h>
 #include <sys/ioctl.h>
+#include <sys/wait.h>
 #include <errno.h>
+#include <glob.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <stddef.h>
 #include "uaputl.h"
 #include "uapcmd.h"
 
@@ -51,17 +60,159 @@ Change log:
 /** Default debug level */
 int debug_level = MSG_NONE;
 
-/** Enable or disable debug outputs */
-#define DEBUG   1
-
 /** Convert character to integer */
 #define CHAR2INT(x) (((x) >= 'A') ? ((x) - 'A' + 10) : ((x) - '0'))
 
+/** Maximum length of a batch script line */
+#define MAX_SCRIPT_LINE     1024
+/** Maximum number of arguments on a batch script line */
+#define MAX_SCRIPT_ARGS     64
+
+/** Set while a batch script is read from stdin */
+static int script_stdin;
+
+/** Per command latency summary */
+typedef struct _trace_summary
+{
+    /** Record type */
+    u8 type;
+    /** Command code */
+    u16 cmd_code;
+    /** Number of failures */
+    u32 errors;
+    /** Number of latency samples */
+    u32 count;
+    /** Latency samples, in ns */
+    u32 *lat;
+    /** Allocated samples */
+    u32 size;
+} trace_summary;
+
+/** Maximum number of command codes summarized */
+#define TRACE_MAX_CMDS          64
+
+/** Maximum number of interfaces a command is fanned out to */
+#define MAX_FANOUT_IFACES   64
+/** Directory listing the network interfaces */
+#define SYS_CLASS_NET       "/sys/class/net/"
+
+/** Options of a command, script or daemon run */
+typedef struct _run_opts
+{
+    /** Transport, NULL for the default */
+    char *transport;
+    /** Trace file to record to, or NULL */
+    char *record;
+    /** Script to run, or NULL */
+    char *script;
+    /** Daemon socket, or NULL */
+    char *socket_path;
+    /** Metrics listen address, or NULL */
+    char *metrics;
+    /** Metrics snapshot cache time in ms */
+    long metrics_cache_ms;
+    /** Print the host command latencies on exit */
+    int timing;
+    /** Deadlines as "<ms>" or "<command>=<ms>" */
+    char *timeouts[UAP_TIMEOUT_CMDS + 1];
+    /** Number of deadlines */
+    int timeout_num;
+    /** Retry policy as "<retries>[:<backoff_ms>]", or NULL */
+    char *retry;
+} run_opts;
+
+/** Worker process running a command on one interface */
+typedef struct _fanout_job
+{
+    /** Interface name */
+    char *name;
+    /** Worker pid */
+    pid_t pid;
+    /** Read end of the worker stdout, -1 when closed */
+    int fd;
+    /** Collected output */
+    FILE *out;
+    /** Output buffer */
+    char *buf;
+    /** Output length */
+    size_t len;
+    /** Exit status, -1 if the worker did not exit normally */
+    int status;
+    /** Monotonic start and end time, in ns */
+    u64 start_ns, end_ns;
+} fanout_job;
+
+/** Output of a command, passed on to stdout and scanned for errors */
+typedef struct _cmd_output
+{
+    /** Stream the output is passed on to */
+    FILE *out;
+    /** Start of the current line, leading blanks skipped */
+    char head[8];
+    /** Length of head, -1 once the line is classified */
+    int head_len;
+    /** Number of error lines */
+    int errors;
+} cmd_output;
+
+/** dot11 counters of uap_stats, in firmware order */
+static struct
+{
+    /** Counter name */
+    char *name;
+    /** Column heading of the rate in watch mode, NULL if not shown */
+    char *column;
+    /** Offset in uap_stats_info */
+    int offset;
+} stats_fields[] = {
+    {"dot11LocalTKIPMICFailures", NULL,
+     offsetof(uap_stats_info, tkip_mic_failures)},
+    {"dot11CCMPDecryptErrors", "Decrypt/s",
+     offsetof(uap_stats_info, ccmp_decrypt_errors)},
+    {"dot11WEPUndecryptableCount", NULL,
+     offsetof(uap_stats_info, wep_undecryptable)},
+    {"dot11WEPICVErrorCount", NULL, offsetof(uap_stats_info, wep_icv_errors)},
+    {"dot11DecryptFailureCount", NULL,
+     offsetof(uap_stats_info, decrypt_failures)},
+    {"dot11FailedCount", "Failed/s", offsetof(uap_stats_info, failed)},
+    {"dot11RetryCount", "Retry/s", offsetof(uap_stats_info, retry)},
+    {"dot11MultipleRetryCount", "MRetry/s",
+     offsetof(uap_stats_info, multiple_retry)},
+    {"dot11FrameDuplicateCount", NULL,
+     offsetof(uap_stats_info, frame_duplicate)},
+    {"dot11RTSSuccessCount", NULL, offsetof(uap_stats_info, rts_success)},
+    {"dot11RTSFailureCount", NULL, offsetof(uap_stats_info, rts_failure)},
+    {"dot11ACKFailureCount", "AckFail/s",
+     offsetof(uap_stats_info, ack_failure)},
+    {"dot11ReceivedFragmentCount", "RxFrag/s",
+     offsetof(uap_stats_info, rx_fragments)},
+    {"dot11MulticastReceivedFrameCount", NULL,
+     offsetof(uap_stats_info, rx_multicast_frames)},
+    {"dot11FCSErrorCount", "FCSErr/s", offsetof(uap_stats_info, fcs_errors)},
+    {"dot11TransmittedFrameCount", "TxFrame/s",
+     offsetof(uap_stats_info, tx_frames)},
+    {"dot11RSNATKIPCounterMeasuresInvoked", NULL,
+     offsetof(uap_stats_info, tkip_countermeasures)},
+    {"dot11RSNA4WayHandshakeFailures", NULL,
+     offsetof(uap_stats_info, rsna_4way_failures)},
+    {"dot11MulticastTransmittedFrameCount", NULL,
+     offsetof(uap_stats_info, tx_multicast_frames)},
+};
+
+/** Number of uap_stats counters */
+#define STATS_FIELDS    (sizeof(stats_fields) / sizeof(stats_fields[0]))
+
+/** Value of a uap_stats counter */
+#define STATS_FIELD(stats, i) \
+    (*(unsigned int *) ((u8 *) (stats) + stats_fields[i].offset))
+
 /****************************************************************************
         Global variables
 ****************************************************************************/
 /** Device name */
 static char dev_name[IFNAMSIZ + 1];
+/** Device handle, opened once in main() and passed to every command */
+static uap_dev *uap_device;
 /** option for cmd */
 struct option cmd_options[] = {
     {"help", 0, 0, 'h'},
@@ -292,35 +443,6 @@ a2hex(char *s)
     return val;
 }
 
-/** 
- *  @brief Dump hex data
- *
- *  @param prompt	A pointer prompt buffer
- *  @param p		A pointer to data buffer
- *  @param len		the len of data buffer
- *  @param delim	delim char
- *  @return            	None
- */
-void
-hexdump_data(char *prompt, void *p, int len, char delim)
-{
-    int i;
-    unsigned char *s = p;
-
-    if (prompt) {
-        printf("%s: len=%d\n", prompt, (int) len);
-    }
-    for (i = 0; i < len; i++) {
-        if (i != len - 1)
-            printf("%02x%c", *s++, delim);
-        else
-            printf("%02x\n", *s);
-        if ((i + 1) % 16 == 0)
-            printf("\n");
-    }
-    printf("\n");
-}
-
 #if DEBUG
 /** 
  * @brief           conditional printf
@@ -518,10 +640,33 @@ parse_domain_file(char *country, IEEEtypes_SubbandSet_t * sub_bands)
 
 }
 
+/**
+ *  @brief Prints the failure of a library command
+ *
+ *  Transport failures are already reported by the device handle.
+ *
+ *  @param err      UAP_ERR_ code
+ *  @param fw_msg   Message for a firmware failure
+ *  @return         N/A
+ */
+void
+print_lib_error(int err, char *fw_msg)
+{
+    if (err == UAP_ERR_FW)
+        printf("ERR:%s\n", fw_msg);
+    else if (err == UAP_ERR_PROTO)
+        printf("ERR:Corrupted response!\n");
+    else if (err == UAP_ERR_TIMEOUT)
+        printf("ERR:Command timed out!\n");
+    else
+        printf("ERR:Command sending failed!\n");
+}
+
 /** 
  *
  *  @brief Set/Get SNMP MIB
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param action 0-GET 1-SET
  *  @param oid    oid
  *  @param size   size of oid value
@@ -530,7 +675,7 @@ parse_domain_file(char *country, IEEEtypes_SubbandSet_t * sub_bands)
  *
  */
 int
-sg_snmp_mib(u16 action, u16 oid, u16 size, u8 * oid_buf)
+sg_snmp_mib(uap_dev * dev, u16 action, u16 oid, u16 size, u8 * oid_buf)
 {
     APCMDBUF_SNMP_MIB *cmd_buf = NULL;
     TLVBUF_HEADER *tlv = NULL;
@@ -541,12 +686,11 @@ sg_snmp_mib(u16 action, u16 oid, u16 size, u8 * oid_buf)
     int i;
 
     buf_len = sizeof(APCMDBUF_SNMP_MIB) + sizeof(TLVBUF_HEADER) + size;
-    buf = (u8 *) malloc(buf_len);
+    buf = uap_cmd_buf_alloc(dev, buf_len);
     if (!buf) {
         printf("ERR:Cannot allocate buffer from command!\n");
         return ret;
     }
-    bzero((char *) buf, buf_len);
 
     /* Locate Headers */
     cmd_buf = (APCMDBUF_SNMP_MIB *) buf;
@@ -564,7 +708,7 @@ sg_snmp_mib(u16 action, u16 oid, u16 size, u8 * oid_buf)
 
     cmd_buf->Action = uap_cpu_to_le16(action);
     cmd_len = buf_len;
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, buf_len);
+    ret = uap_ioctl(dev, (u8 *) cmd_buf, &cmd_len, buf_len);
     if (ret == UAP_SUCCESS) {
         if (cmd_buf->Result == CMD_SUCCESS) {
             if (!action) {
@@ -584,7 +728,7 @@ sg_snmp_mib(u16 action, u16 oid, u16 size, u8 * oid_buf)
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    free(buf);
+    uap_cmd_buf_free(dev, buf);
     return ret;
 }
 
@@ -593,19 +737,16 @@ sg_snmp_mib(u16 action, u16 oid, u16 size, u8 * oid_buf)
  *
  *  Usage: "sys_info"
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_info(int argc, char *argv[])
+apcmd_sys_info(uap_dev * dev, int argc, char *argv[])
 {
-    APCMDBUF_SYS_INFO_REQUEST *cmd_buf = NULL;
-    APCMDBUF_SYS_INFO_RESPONSE *response_buf = NULL;
-    u8 *buf = NULL;
-    u16 cmd_len;
-    u16 buf_len;
-    int ret = UAP_FAILURE;
+    char info[UAP_SYS_INFO_LEN];
+    int ret;
     int opt;
 
     while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
@@ -625,53 +766,11 @@ apcmd_sys_info(int argc, char *argv[])
         return;
     }
 
-    buf_len =
-        (sizeof(APCMDBUF_SYS_INFO_REQUEST) >=
-         sizeof(APCMDBUF_SYS_INFO_RESPONSE)) ? sizeof(APCMDBUF_SYS_INFO_REQUEST)
-        : sizeof(APCMDBUF_SYS_INFO_RESPONSE);
-
-    /* alloc buf for command */
-    buf = (u8 *) malloc(buf_len);
-
-    if (!buf) {
-        printf("ERR:Cannot allocate buffer from command!\n");
-        return;
-    }
-    bzero((char *) buf, buf_len);
-
-    /* Locate headers */
-    cmd_len = sizeof(APCMDBUF_SYS_INFO_REQUEST);
-    cmd_buf = (APCMDBUF_SYS_INFO_REQUEST *) buf;
-    response_buf = (APCMDBUF_SYS_INFO_RESPONSE *) buf;
-
-    /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_SYS_INFO;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-
-    /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, buf_len);
-
-    /* Process response */
-    if (ret == UAP_SUCCESS) {
-        /* Verify response */
-        if (response_buf->CmdCode != (APCMD_SYS_INFO | APCMD_RESP_CHECK)) {
-            printf("ERR:Corrupted response!\n");
-            free(buf);
-            return;
-        }
-        /* Print response */
-        if (response_buf->Result == CMD_SUCCESS) {
-            printf("System information = %s\n", response_buf->SysInfo);
-        } else {
-            printf("ERR:Could not retrieve system information!\n");
-        }
-    } else {
-        printf("ERR:Command sending failed!\n");
-    }
-
-    free(buf);
+    ret = uap_get_sys_info(dev, info, sizeof(info));
+    if (ret == UAP_OK)
+        printf("System information = %s\n", info);
+    else
+        print_lib_error(ret, "Could not retrieve system information!");
     return;
 }
 
@@ -704,34 +803,38 @@ print_power_mode_usage(void)
     return;
 }
 
+/** Names of the power modes, by ps_mode */
+static const char *power_mode_names[POWER_MODES] = {
+    "disabled",
+    "periodic_dtim",
+    "inactivity",
+};
+
+/**
+ *  @brief Returns the name of a power mode
+ *
+ *  @param mode     Power mode
+ *  @return         Name, "unknown" for an unknown mode
+ */
+const char *
+power_mode_name(int mode)
+{
+    return (mode >= 0 && mode < POWER_MODES) ? power_mode_names[mode] :
+        "unknown";
+}
+
 /** 
  *  @brief Set/get power mode 
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param pm      A pointer to ps_mgmt structure
  *  @return         N/A
  */
 void
-send_power_mode_ioctl(ps_mgmt * pm)
+send_power_mode_ioctl(uap_dev * dev, ps_mgmt * pm)
 {
-    struct ifreq ifr;
-    s32 sockfd;
-
-    /* Open socket */
-    if ((sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
-        printf("ERR:Cannot open socket\n");
+    if (uap_power_mode_ioctl(dev, pm) != UAP_SUCCESS)
         return;
-    }
-    /* Initialize the ifr structure */
-    memset(&ifr, 0, sizeof(ifr));
-    strncpy(ifr.ifr_ifrn.ifrn_name, dev_name, strlen(dev_name));
-    ifr.ifr_ifru.ifru_data = (void *) pm;
-    /* Perform ioctl */
-    errno = 0;
-    if (ioctl(sockfd, UAP_POWER_MODE, &ifr)) {
-        perror("");
-        printf("ERR:UAP_POWER_MODE is not supported by %s\n", dev_name);
-        return;
-    }
     switch (pm->ps_mode) {
     case 0:
         printf("power mode = Disabled\n");
@@ -755,8 +858,6 @@ send_power_mode_ioctl(ps_mgmt * pm)
         printf("\tmin_awake=%d us\n", (int) pm->inact_param.min_awake);
         printf("\tmax_awake=%d us\n", (int) pm->inact_param.max_awake);
     }
-    /* Close socket */
-    close(sockfd);
     return;
 }
 
@@ -770,12 +871,13 @@ send_power_mode_ioctl(ps_mgmt * pm)
  *                       1 - enable power mode
  *            		 2 - get current power mode                         
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_power_mode(int argc, char *argv[])
+apcmd_power_mode(uap_dev * dev, int argc, char *argv[])
 {
     int opt;
     ps_mgmt pm;
@@ -957,7 +1059,7 @@ apcmd_power_mode(int argc, char *argv[])
             }
         }
     }
-    send_power_mode_ioctl(&pm);
+    send_power_mode_ioctl(dev, &pm);
     return;
 }
 
@@ -978,12 +1080,13 @@ print_sys_reset_usage(void)
  *
  *  Usage: "sys_reset"
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_reset(int argc, char *argv[])
+apcmd_sys_reset(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_RESET *cmd_buf = NULL;
     u8 *buffer = NULL;
@@ -1012,19 +1115,18 @@ apcmd_sys_reset(int argc, char *argv[])
     memset(&pm, 0, sizeof(ps_mgmt));
     pm.flags = PS_FLAG_PS_MODE;
     pm.ps_mode = PS_MODE_DISABLE;
-    send_power_mode_ioctl(&pm);
+    send_power_mode_ioctl(dev, &pm);
 
     /* Initialize the command length */
     cmd_len = sizeof(APCMDBUF_SYS_RESET);
 
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
+    buffer = uap_cmd_buf_alloc(dev, cmd_len);
 
     if (!buffer) {
         printf("ERR:Cannot allocate buffer for command!\n");
         return;
     }
-    bzero((char *) buffer, cmd_len);
 
     /* Locate headers */
     cmd_buf = (APCMDBUF_SYS_RESET *) buffer;
@@ -1036,14 +1138,14 @@ apcmd_sys_reset(int argc, char *argv[])
     cmd_buf->Result = 0;
 
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = uap_ioctl(dev, (u8 *) cmd_buf, &cmd_len, cmd_len);
 
     /* Process response */
     if (ret == UAP_SUCCESS) {
         /* Verify response */
         if (cmd_buf->CmdCode != (APCMD_SYS_RESET | APCMD_RESP_CHECK)) {
             printf("ERR:Corrupted response!\n");
-            free(buffer);
+            uap_cmd_buf_free(dev, buffer);
             return;
         }
         /* Print response */
@@ -1056,7 +1158,7 @@ apcmd_sys_reset(int argc, char *argv[])
         printf("ERR:Command sending failed!\n");
     }
     if (buffer)
-        free(buffer);
+        uap_cmd_buf_free(dev, buffer);
     return;
 }
 
@@ -1077,17 +1179,15 @@ print_bss_start_usage(void)
  *
  *   Usage: "bss_start"
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_bss_start(int argc, char *argv[])
+apcmd_bss_start(uap_dev * dev, int argc, char *argv[])
 {
-    APCMDBUF_BSS_START *cmd_buf = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
-    int ret = UAP_FAILURE;
+    int ret;
     int opt;
 
     while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
@@ -1107,54 +1207,18 @@ apcmd_bss_start(int argc, char *argv[])
         return;
     }
 
-    /* Initialize the command length */
-    cmd_len = sizeof(APCMDBUF_BSS_START);
-
-    /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
-        return;
-    }
-    bzero((char *) buffer, cmd_len);
-
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_BSS_START *) buffer;
-
-    /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_BSS_START;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-
-    /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
-
-    /* Process response */
-    if (ret == UAP_SUCCESS) {
-        /* Verify response */
-        if (cmd_buf->CmdCode != (APCMD_BSS_START | APCMD_RESP_CHECK)) {
-            printf("ERR:Corrupted response!\n");
-            free(buffer);
-            return;
-        }
-
-        /* Print response */
-        if (cmd_buf->Result == CMD_SUCCESS) {
-            printf("BSS started!\n");
-        } else if (cmd_buf->Result == BSS_FAILURE_START_INVAL) {
-            printf("ERR:Could not start BSS! Invalid BSS parameters.\n");
-        } else if (cmd_buf->Result == BSS_FAILURE_START_REDUNDANT) {
-            printf("ERR:Could not start BSS! BSS already started.\n");
-        } else {
-            printf("ERR:Could not start BSS!\n");
-        }
+    ret = uap_bss_start(dev);
+    if (ret == UAP_OK) {
+        printf("BSS started!\n");
+    } else if (ret == UAP_ERR_FW &&
+               uap_last_result(dev) == BSS_FAILURE_START_INVAL) {
+        printf("ERR:Could not start BSS! Invalid BSS parameters.\n");
+    } else if (ret == UAP_ERR_FW &&
+               uap_last_result(dev) == BSS_FAILURE_START_REDUNDANT) {
+        printf("ERR:Could not start BSS! BSS already started.\n");
     } else {
-        printf("ERR:Command sending failed!\n");
+        print_lib_error(ret, "Could not start BSS!");
     }
-    if (buffer)
-        free(buffer);
     return;
 }
 
@@ -1175,17 +1239,15 @@ print_bss_stop_usage(void)
  *
  *   Usage: "bss_stop"
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_bss_stop(int argc, char *argv[])
+apcmd_bss_stop(uap_dev * dev, int argc, char *argv[])
 {
-    APCMDBUF_BSS_STOP *cmd_buf = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
-    int ret = UAP_FAILURE;
+    int ret;
     int opt;
 
     while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
@@ -1203,54 +1265,18 @@ apcmd_bss_stop(int argc, char *argv[])
         print_bss_stop_usage();
     }
 
-    /* Initialize the command length */
-    cmd_len = sizeof(APCMDBUF_BSS_STOP);
-
-    /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
-        return;
-    }
-    bzero((char *) buffer, cmd_len);
-
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_BSS_STOP *) buffer;
-
-    /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_BSS_STOP;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-
-    /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
-
-    /* Process response */
-    if (ret == UAP_SUCCESS) {
-        /* Verify response */
-        if (cmd_buf->CmdCode != (APCMD_BSS_STOP | APCMD_RESP_CHECK)) {
-            printf("ERR:Corrupted response!\n");
-            free(buffer);
-            return;
-        }
-
-        /* Print response */
-        if (cmd_buf->Result == CMD_SUCCESS) {
-            printf("BSS stopped!\n");
-        } else if (cmd_buf->Result == BSS_FAILURE_STOP_REDUNDANT) {
-            printf("ERR:Could not stop BSS! BSS already stopped.\n");
-        } else if (cmd_buf->Result == BSS_FAILURE_STOP_INVAL) {
-            printf("ERR:Could not stop BSS! No active BSS.\n");
-        } else {
-            printf("ERR:Could not stop BSS!\n");
-        }
+    ret = uap_bss_stop(dev);
+    if (ret == UAP_OK) {
+        printf("BSS stopped!\n");
+    } else if (ret == UAP_ERR_FW &&
+               uap_last_result(dev) == BSS_FAILURE_STOP_REDUNDANT) {
+        printf("ERR:Could not stop BSS! BSS already stopped.\n");
+    } else if (ret == UAP_ERR_FW &&
+               uap_last_result(dev) == BSS_FAILURE_STOP_INVAL) {
+        printf("ERR:Could not stop BSS! No active BSS.\n");
     } else {
-        printf("ERR:Command sending failed!\n");
+        print_lib_error(ret, "Could not stop BSS!");
     }
-    if (buffer)
-        free(buffer);
     return;
 }
 
@@ -1262,36 +1288,103 @@ apcmd_bss_stop(int argc, char *argv[])
 void
 print_sta_list_usage(void)
 {
-    printf("\nUsage : sta_list\n");
+    printf("\nUsage : sta_list [--watch <ms> [--count <N>] [--alpha <a>]]\n");
+    printf("\nWith --watch, the station list is polled every <ms> and only\n"
+           "the changes are printed: JOIN, LEAVE and PS (power save state)\n"
+           "lines, N polls or until interrupted.  The stations still\n"
+           "associated are then printed with their RSSI range and moving\n"
+           "average, weight <a> for the newest poll (default %.1f).\n",
+           STA_WATCH_ALPHA);
     return;
 }
 
+/** Progress of the sta_list printing */
+typedef struct _sta_list_out
+{
+    /** Number of stations, set by the firmware response */
+    int count;
+    /** Stations printed */
+    int n;
+} sta_list_out;
+
+/**
+ *  @brief Prints one station of the sta_list command as it is decoded
+ *
+ *  @param arg      sta_list_out
+ *  @param sta      Station
+ *  @return         0 to go on
+ */
+static int
+sta_list_print(void *arg, const uap_sta_info * sta)
+{
+    sta_list_out *out = (sta_list_out *) arg;
+
+    if (!out->n)
+        printf("Number of STA = %d\n\n", out->count);
+    printf("STA %d information:\n", ++out->n);
+    printf("=====================\n");
+    printf("MAC Address: ");
+    print_mac((u8 *) sta->mac);
+    printf("\nPower mfg status: %s\n",
+           sta->power_save ? "power save" : "active");
+    printf("Rssi : %d dBm\n\n", sta->rssi);
+    return 0;
+}
+
+/** Options of the sta_list command */
+static struct option sta_list_options[] = {
+    {"help", 0, NULL, 'h'},
+    {"watch", 1, NULL, 'w'},
+    {"count", 1, NULL, 'c'},
+    {"alpha", 1, NULL, 'a'},
+    {NULL, 0, NULL, '\0'}
+};
+
 /** 
  *  @brief Creates a STA list request and sends to the driver
  *
- *   Usage: "sta_list"
+ *   Usage: "sta_list [--watch <ms> [--count <N>] [--alpha <a>]]"
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sta_list(int argc, char *argv[])
+apcmd_sta_list(uap_dev * dev, int argc, char *argv[])
 {
-    APCMDBUF_STA_LIST_REQUEST *cmd_buf = NULL;
-    APCMDBUF_STA_LIST_RESPONSE *response_buf = NULL;
-    u8 *buf = NULL;
-    u16 buf_len;
-    TLVBUF_STA_INFO *tlv = NULL;
-    u16 cmd_len;
-    u16 response_len;
-    int ret = UAP_FAILURE;
-    int i = 0;
+    long interval_ms = 0, polls = 0;
+    double alpha = STA_WATCH_ALPHA;
+    char *end;
+    sta_list_out out;
+    int ret;
     int opt;
-    int rssi = 0;
 
-    while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "+hw:c:a:", sta_list_options,
+                              NULL)) != -1) {
         switch (opt) {
+        case 'w':
+            interval_ms = strtol(optarg, &end, 10);
+            if (*end || interval_ms <= 0) {
+                printf("ERR:Invalid interval %s\n", optarg);
+                return;
+            }
+            break;
+        case 'c':
+            polls = strtol(optarg, &end, 10);
+            if (*end || polls <= 0) {
+                printf("ERR:Invalid count %s\n", optarg);
+                return;
+            }
+            break;
+        case 'a':
+            alpha = strtod(optarg, &end);
+            if (*end || alpha <= 0 || alpha > 1) {
+                printf("ERR:Invalid alpha %s, expected 0 < a <= 1\n",
+                       optarg);
+                return;
+            }
+            break;
         default:
             print_sta_list_usage();
             return;
@@ -1306,84 +1399,26 @@ apcmd_sta_list(int argc, char *argv[])
         print_sta_list_usage();
         return;
     }
-    response_len =
-        sizeof(APCMDBUF_STA_LIST_RESPONSE) +
-        (MAX_NUM_CLIENTS * sizeof(TLVBUF_STA_INFO));
-    if (response_len > sizeof(APCMDBUF_STA_LIST_REQUEST))
-        buf_len = response_len;
-    else
-        buf_len = sizeof(APCMDBUF_STA_LIST_REQUEST);
-
-    /* Initialize the command length */
-    cmd_len = sizeof(APCMDBUF_STA_LIST_REQUEST);
-
-    /* Initialize the command buffer */
-    buf = (u8 *) malloc(buf_len);
-
-    if (!buf) {
-        printf("ERR:Cannot allocate buffer from command!\n");
+    if (interval_ms) {
+        if (uapd_allowed("sta_list --watch") != UAP_SUCCESS)
+            return;
+        sta_list_watch(dev, interval_ms, polls, alpha);
         return;
     }
-    bzero((char *) buf, buf_len);
-
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_STA_LIST_REQUEST *) buf;
-    response_buf = (APCMDBUF_STA_LIST_RESPONSE *) buf;
-
-    /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_STA_LIST;
-    cmd_buf->Size = cmd_len;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-
-    /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, buf_len);
-    response_buf->StaCount = uap_le16_to_cpu(response_buf->StaCount);
-
-    /* Process response */
-    if (ret == UAP_SUCCESS) {
-        /* Verify response */
-        if (response_buf->CmdCode != (APCMD_STA_LIST | APCMD_RESP_CHECK)) {
-            printf("ERR:Corrupted response!\n");
-            free(buf);
-            return;
-        }
-
-        /* Print response */
-        if (response_buf->Result == CMD_SUCCESS) {
-            printf("Number of STA = %d\n\n", response_buf->StaCount);
-            for (i = 0; i < response_buf->StaCount; i++) {
-                tlv = (TLVBUF_STA_INFO *) (&response_buf->StaList[i]);
-                endian_convert_tlv_header_in(tlv);
-                if (tlv) {
-                    if (tlv->Tag != MRVL_STA_INFO_TLV_ID) {
-                        printf("STA %d information corrupted.\n", i + 1);
-                        continue;
-                    }
-                    printf("STA %d information:\n", i + 1);
-                    printf("=====================\n");
-                    printf("MAC Address: ");
-                    print_mac(tlv->MacAddress);
-                    printf("\nPower mfg status: %s\n",
-                           (tlv->PowerMfgStatus ==
-                            0) ? "active" : "power save");
-                                        /** On some platform, s8 is same as unsigned char*/
-                    rssi = (int) tlv->Rssi;
-                    if (rssi > 0x7f)
-                        rssi = -(256 - rssi);
-                    printf("Rssi : %d dBm\n\n", rssi);
-                } else {
-                    printf("ERR:Unable to find information for STA %d\n\n",
-                           i + 1);
-                }
-            }
-        } else {
-            printf("ERR:Could not get STA list!\n");
-        }
-    } else {
-        printf("ERR:Command sending failed!\n");
+    if (polls) {
+        printf("ERR:--count needs --watch.\n");
+        print_sta_list_usage();
+        return;
     }
-    free(buf);
+
+    memset(&out, 0, sizeof(out));
+    ret = uap_sta_list_walk(dev, sta_list_print, &out, &out.count);
+    if (ret == UAP_OK && !out.n)
+        printf("Number of STA = %d\n\n", out.count);
+    if (ret == UAP_ERR_PROTO)
+        printf("ERR:%s\n", uap_last_error(dev));
+    else if (ret != UAP_OK)
+        print_lib_error(ret, "Could not get STA list!");
     return;
 }
 
@@ -1396,29 +1431,110 @@ void
 print_sta_deauth_usage(void)
 {
     printf("\nUsage : sta_deauth <STA_MAC_ADDRESS> [REASON_CODE]\n");
+    printf("        sta_deauth [--reason <code>] [--file <path>] "
+           "[STA_MAC_ADDRESS...]\n");
+    printf("        sta_deauth --rssi-below <dBm> [--samples <N>] "
+           "[--interval <ms>]\n"
+           "                   [--count <polls>] [--reason <code>] "
+           "[--dry-run]\n");
+    printf("\nSeveral MAC addresses, from the arguments and from a file of\n"
+           "one address per line ('-' for stdin, '#' starts a comment),\n"
+           "are deauthenticated back to back with a result for each.\n"
+           "With --rssi-below, the station list is polled every <ms>\n"
+           "(default %d) and the stations whose RSSI is below <dBm> for\n"
+           "N consecutive polls (default %d) are deauthenticated, <polls>\n"
+           "polls or until interrupted.\n", STA_DEAUTH_INTERVAL_MS,
+           STA_DEAUTH_SAMPLES);
     return;
 }
 
+/** Options of the sta_deauth command */
+static struct option sta_deauth_options[] = {
+    {"help", 0, NULL, 'h'},
+    {"reason", 1, NULL, 'r'},
+    {"file", 1, NULL, 'f'},
+    {"rssi-below", 1, NULL, 'b'},
+    {"samples", 1, NULL, 'n'},
+    {"interval", 1, NULL, 'i'},
+    {"count", 1, NULL, 'c'},
+    {"dry-run", 0, NULL, 'd'},
+    {NULL, 0, NULL, '\0'}
+};
+
 /** 
- *  @brief Creates a STA deauth request and sends to the driver
+ *  @brief Creates STA deauth requests and sends them to the driver
  *
- *   Usage: "sta_deauth <STA_MAC_ADDRESS>"
+ *   Usage: "sta_deauth <STA_MAC_ADDRESS> [REASON_CODE]"
+ *          "sta_deauth [--reason <code>] [--file <path>] [MAC...]"
+ *          "sta_deauth --rssi-below <dBm> [--samples <N>] ..."
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sta_deauth(int argc, char *argv[])
+apcmd_sta_deauth(uap_dev * dev, int argc, char *argv[])
 {
-    APCMDBUF_STA_DEAUTH *cmd_buf = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len;
+    mac_list macs;
+    u8 mac[ETH_ALEN];
+    u16 reason = 0;
+    long rssi_below = 0, samples = STA_DEAUTH_SAMPLES;
+    long interval_ms = STA_DEAUTH_INTERVAL_MS, polls = 0;
+    int policy = 0, dry_run = 0;
+    char *file = NULL, *end;
+    int *result;
+    u64 start_ns;
+    int i, ok;
     int ret = UAP_FAILURE;
     int opt;
 
-    while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "+hr:f:b:n:i:c:d",
+                              sta_deauth_options, NULL)) != -1) {
         switch (opt) {
+        case 'r':
+            if (IS_HEX_OR_DIGIT(optarg) == UAP_FAILURE) {
+                printf("ERR: Invalid input for reason code\n");
+                print_sta_deauth_usage();
+                return;
+            }
+            reason = (u16) A2HEXDECIMAL(optarg);
+            break;
+        case 'f':
+            file = optarg;
+            break;
+        case 'b':
+            rssi_below = strtol(optarg, &end, 10);
+            if (*end || !*optarg) {
+                printf("ERR:Invalid RSSI %s\n", optarg);
+                return;
+            }
+            policy = 1;
+            break;
+        case 'n':
+            samples = strtol(optarg, &end, 10);
+            if (*end || samples <= 0) {
+                printf("ERR:Invalid number of samples %s\n", optarg);
+                return;
+            }
+            break;
+        case 'i':
+            interval_ms = strtol(optarg, &end, 10);
+            if (*end || interval_ms <= 0) {
+                printf("ERR:Invalid interval %s\n", optarg);
+                return;
+            }
+            break;
+        case 'c':
+            polls = strtol(optarg, &end, 10);
+            if (*end || polls <= 0) {
+                printf("ERR:Invalid count %s\n", optarg);
+                return;
+            }
+            break;
+        case 'd':
+            dry_run = 1;
+            break;
         default:
             print_sta_deauth_usage();
             return;
@@ -1427,76 +1543,155 @@ apcmd_sta_deauth(int argc, char *argv[])
     argc -= optind;
     argv += optind;
 
-    /* Check arguments */
-    if (argc != 1 && argc != 2) {
-        printf("ERR:wrong arguments! Must provide STA_MAC_ADDRESS.\n");
-        printf("\t\t with optional REASON_CODE.\n");
-        print_sta_deauth_usage();
+    if (policy) {
+        if (argc || file) {
+            printf("ERR:--rssi-below takes no MAC address.\n");
+            print_sta_deauth_usage();
+            return;
+        }
+        if (uapd_allowed("sta_deauth --rssi-below") != UAP_SUCCESS)
+            return;
+        sta_deauth_policy(dev, rssi_below, samples, interval_ms, polls,
+                          reason, dry_run);
+        return;
+    }
+    if (dry_run || polls) {
+        printf("ERR:--dry-run and --count need --rssi-below.\n");
+        print_sta_deauth_usage();
         return;
     }
 
-    /* Check Reason Code */
-    if (argc == 2) {
+    /* Check Reason Code, a second argument that is no MAC address */
+    if (argc == 2 && !file && mac2raw(argv[1], mac) == UAP_FAILURE) {
         if (IS_HEX_OR_DIGIT(argv[1]) == UAP_FAILURE) {
             printf("ERR: Invalid input for reason code\n");
             print_sta_deauth_usage();
             return;
         }
+        reason = (u16) A2HEXDECIMAL(argv[1]);
+        argc = 1;
     }
 
-    /* Initialize the command length */
-    cmd_len = sizeof(APCMDBUF_STA_DEAUTH);
-
-    /* Initialize the command buffer */
-    buffer = (u8 *) malloc(cmd_len);
-    if (!buffer) {
-        printf("ERR:Cannot allocate buffer for command!\n");
+    if (argc == 1 && !file) {
+        if ((ret = mac2raw(argv[0], mac)) != UAP_SUCCESS) {
+            printf("ERR: %s Address\n", ret == UAP_FAILURE ? "Invalid MAC" :
+                   ret == UAP_RET_MAC_BROADCAST ? "Broadcast" : "Multicast");
+            return;
+        }
+        ret = uap_sta_deauth(dev, mac, reason);
+        if (ret == UAP_OK)
+            printf("Deauthentication successful!\n");
+        else
+            print_lib_error(ret, "Deauthentication unsuccessful!");
         return;
     }
-    bzero((char *) buffer, cmd_len);
 
-    /* Locate headers */
-    cmd_buf = (APCMDBUF_STA_DEAUTH *) buffer;
-
-    /* Fill the command buffer */
-    cmd_buf->CmdCode = APCMD_STA_DEAUTH;
-    cmd_buf->Size = cmd_len - BUF_HEADER_SIZE;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->Result = 0;
-    if ((ret = mac2raw(argv[0], cmd_buf->StaMacAddress)) != UAP_SUCCESS) {
-        printf("ERR: %s Address\n", ret == UAP_FAILURE ? "Invalid MAC" :
-               ret == UAP_RET_MAC_BROADCAST ? "Broadcast" : "Multicast");
-        free(buffer);
-        return;
+    memset(&macs, 0, sizeof(macs));
+    for (i = 0; i < argc; i++) {
+        if (mac_list_add(&macs, argv[i]) != UAP_SUCCESS)
+            goto done;
+    }
+    if (file && mac_list_read(&macs, file) != UAP_SUCCESS)
+        goto done;
+    if (!macs.n) {
+        printf("ERR:wrong arguments! Must provide STA_MAC_ADDRESS.\n");
+        printf("\t\t with optional REASON_CODE.\n");
+        print_sta_deauth_usage();
+        goto done;
+    }
+    result = (int *) malloc(macs.n * sizeof(int));
+    if (!result) {
+        printf("ERR:Cannot allocate memory!\n");
+        goto done;
     }
-    if (argc == 2) {
-        cmd_buf->ReasonCode = uap_cpu_to_le16((u16) A2HEXDECIMAL(argv[1]));
+    start_ns = uap_time_ns();
+    ok = sta_deauth_list(dev, macs.mac, macs.n, reason, result);
+    for (i = 0; i < macs.n; i++) {
+        print_mac(macs.mac[i]);
+        if (result[i] == UAP_OK) {
+            printf(" Deauthentication successful!\n");
+        } else {
+            printf(" ");
+            print_lib_error(result[i], "Deauthentication unsuccessful!");
+        }
     }
+    printf("Deauthenticated %d of %d stations in %.3f ms\n", ok, macs.n,
+           (uap_time_ns() - start_ns) / 1e6);
+    free(result);
+  done:
+    free(macs.mac);
+    return;
+}
 
-    /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+/** Names of the BT coex statistics, in tlvbuf_coex_stats order */
+static const char *coex_stats_names[COEX_STATS] = {
+    "null_not_sent",
+    "null_queued",
+    "null_not_queued",
+    "cf_end_queued",
+    "cf_end_not_queued",
+    "null_alloc_fail",
+    "cf_end_alloc_fail",
+};
 
-    /* Process response */
-    if (ret == UAP_SUCCESS) {
-        /* Verify response */
-        if (cmd_buf->CmdCode != (APCMD_STA_DEAUTH | APCMD_RESP_CHECK)) {
-            printf("ERR:Corrupted response!\n");
-            free(buffer);
-            return;
-        }
+/**
+ *  @brief Returns the name of a BT coex statistic
+ *
+ *  @param i        Statistic index
+ *  @return         Name, NULL past the last statistic
+ */
+const char *
+coex_stats_name(int i)
+{
+    return (i >= 0 && i < COEX_STATS) ? coex_stats_names[i] : NULL;
+}
 
-        /* Print response */
-        if (cmd_buf->Result == CMD_SUCCESS) {
-            printf("Deauthentication successful!\n");
-        } else {
-            printf("ERR:Deauthentication unsuccessful!\n");
+/**
+ *  @brief Gets the BT coex statistics
+ *
+ *  Sends a coex_config GET carrying only the statistics TLV.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param stats    Returns COEX_STATS values
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+int
+coex_stats_get(uap_dev * dev, unsigned int *stats)
+{
+    apcmdbuf_coex_config *cmd_buf;
+    tlvbuf_coex_stats *tlv;
+    u16 cmd_len = sizeof(apcmdbuf_coex_config) + sizeof(tlvbuf_coex_stats);
+    u32 field;
+    u8 *buf;
+    int i, ret = UAP_FAILURE;
+
+    buf = uap_cmd_buf_alloc(dev, cmd_len);
+    if (!buf)
+        return UAP_FAILURE;
+    cmd_buf = (apcmdbuf_coex_config *) buf;
+    tlv = (tlvbuf_coex_stats *) cmd_buf->tlv_buffer;
+    tlv->Tag = MRVL_BT_COEX_STATS_TLV_ID;
+    tlv->Length = sizeof(tlvbuf_coex_stats) - sizeof(TLVBUF_HEADER);
+    endian_convert_tlv_header_out(tlv);
+    cmd_buf->CmdCode = HostCmd_ROBUST_COEX;
+    cmd_buf->Size = cmd_len - BUF_HEADER_SIZE;
+    cmd_buf->SeqNum = 0;
+    cmd_buf->Result = 0;
+    cmd_buf->action = uap_cpu_to_le16(ACTION_GET);
+    if (uap_ioctl(dev, buf, &cmd_len, cmd_len) == UAP_SUCCESS &&
+        cmd_buf->CmdCode == (HostCmd_ROBUST_COEX | APCMD_RESP_CHECK) &&
+        cmd_buf->Result == CMD_SUCCESS &&
+        uap_le16_to_cpu(tlv->Tag) == MRVL_BT_COEX_STATS_TLV_ID) {
+        /* The fields are packed, copy them out one by one */
+        for (i = 0; i < COEX_STATS; i++) {
+            memcpy(&field, (u8 *) & tlv->null_not_sent + i * sizeof(u32),
+                   sizeof(u32));
+            stats[i] = (unsigned int) uap_le32_to_cpu(field);
         }
-    } else {
-        printf("ERR:Command sending failed!\n");
+        ret = UAP_SUCCESS;
     }
-    if (buffer)
-        free(buffer);
-    return;
+    uap_cmd_buf_free(dev, buf);
+    return ret;
 }
 
 /**
@@ -1518,12 +1713,13 @@ print_coex_config_usage(void)
  *
  *  Usage: "Usage : coex_config [CONFIG_FILE]"
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         UAP_SUCCESS or UAP_FAILURE
  */
 void
-apcmd_coex_config(int argc, char *argv[])
+apcmd_coex_config(uap_dev * dev, int argc, char *argv[])
 {
     apcmdbuf_coex_config *cmd_buf = NULL;
     tlvbuf_coex_common_cfg *coex_common_tlv;
@@ -1553,7 +1749,7 @@ apcmd_coex_config(int argc, char *argv[])
     }
     if (argc == 1) {
         /* Read profile and send command to firmware */
-        apcmd_coex_config_profile(argc, argv);
+        apcmd_coex_config_profile(dev, argc, argv);
         return;
     }
 
@@ -1562,12 +1758,11 @@ apcmd_coex_config(int argc, char *argv[])
         + sizeof(tlvbuf_coex_sco_cfg) + sizeof(tlvbuf_coex_acl_cfg)
         + sizeof(tlvbuf_coex_stats);
     /* alloc buf for command */
-    buf = (u8 *) malloc(cmd_len);
+    buf = uap_cmd_buf_alloc(dev, cmd_len);
     if (!buf) {
         printf("ERR:Cannot allocate buffer from command!\n");
         return;
     }
-    bzero((char *) buf, cmd_len);
 
     cmd_buf = (apcmdbuf_coex_config *) buf;
 
@@ -1606,14 +1801,14 @@ apcmd_coex_config(int argc, char *argv[])
     cmd_buf->action = uap_cpu_to_le16(ACTION_GET);
 
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = uap_ioctl(dev, (u8 *) cmd_buf, &cmd_len, cmd_len);
 
     /* Process response */
     if (ret == UAP_SUCCESS) {
         /* Verify response */
         if (cmd_buf->CmdCode != (HostCmd_ROBUST_COEX | APCMD_RESP_CHECK)) {
             printf("ERR:Corrupted response!\n");
-            free(buf);
+            uap_cmd_buf_free(dev, buf);
             return;
         }
         /* Print response */
@@ -1628,7 +1823,7 @@ apcmd_coex_config(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    free(buf);
+    uap_cmd_buf_free(dev, buf);
     return;
 }
 
@@ -1856,12 +2051,13 @@ config_get_line(char *s, int size, FILE * stream, int *line, char **_pos)
 /** 
  *  @brief Read the profile and sends to the driver
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         UAP_SUCCESS or UAP_FAILURE
  */
 void
-apcmd_coex_config_profile(int argc, char *argv[])
+apcmd_coex_config_profile(uap_dev * dev, int argc, char *argv[])
 {
     FILE *config_file = NULL;
     char *line = NULL;
@@ -1901,12 +2097,11 @@ apcmd_coex_config_profile(int argc, char *argv[])
     cmd_len = sizeof(apcmdbuf_coex_config) + sizeof(tlvbuf_coex_common_cfg)
         + sizeof(tlvbuf_coex_sco_cfg) + sizeof(tlvbuf_coex_acl_cfg);
     /* alloc buf for command */
-    buf = (u8 *) malloc(cmd_len);
+    buf = uap_cmd_buf_alloc(dev, cmd_len);
     if (!buf) {
         printf("ERR:Cannot allocate buffer from command!\n");
         goto done;
     }
-    bzero((char *) buf, cmd_len);
 
     cmd_buf = (apcmdbuf_coex_config *) buf;
 
@@ -2042,7 +2237,7 @@ apcmd_coex_config_profile(int argc, char *argv[])
         }
     }
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
+    ret = uap_ioctl(dev, (u8 *) cmd_buf, &cmd_len, cmd_len);
 
     /* Process response */
     if (ret == UAP_SUCCESS) {
@@ -2063,7 +2258,7 @@ apcmd_coex_config_profile(int argc, char *argv[])
   done:
     fclose(config_file);
     if (buf)
-        free(buf);
+        uap_cmd_buf_free(dev, buf);
     if (line)
         free(line);
 }
@@ -2071,12 +2266,13 @@ apcmd_coex_config_profile(int argc, char *argv[])
 /** 
  *  @brief Read the profile and sends to the driver
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         UAP_SUCCESS or UAP_FAILURE
  */
 void
-apcmd_sys_config_profile(int argc, char *argv[])
+apcmd_sys_config_profile(uap_dev * dev, int argc, char *argv[])
 {
     FILE *config_file = NULL;
     char *line = NULL;
@@ -2088,10 +2284,7 @@ apcmd_sys_config_profile(int argc, char *argv[])
     int is_ap_config = 0;
     int is_custom_ie_config = 0;
     int is_ap_mac_filter = 0;
-    APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
-    u8 *buffer = NULL;
-    u16 cmd_len = 0;
-    u16 tlv_len = 0;
+    tlv_builder b;
     u16 ie_len = 0;
     u16 ie_buf_len = 0;
     u16 mask_ie_index = 0;
@@ -2114,6 +2307,7 @@ apcmd_sys_config_profile(int argc, char *argv[])
     u8 state_80211d;
     int flag_80211d = 0;
 
+    b.buf = NULL;
     memset(rate, 0, MAX_RATES);
     /* Check if file exists */
     config_file = fopen(argv[0], "r");
@@ -2146,7 +2340,8 @@ apcmd_sys_config_profile(int argc, char *argv[])
                 is_ap_config = 0;
                 if (tx_data_rate != -1) {
                     if ((!rate[0]) && (tx_data_rate) &&
-                        (is_tx_rate_valid((u8) tx_data_rate) != UAP_SUCCESS)) {
+                        (is_tx_rate_valid(dev, (u8) tx_data_rate) !=
+                         UAP_SUCCESS)) {
                         printf("ERR: Invalid Tx Data Rate \n");
                         goto done;
                     }
@@ -2165,25 +2360,18 @@ apcmd_sys_config_profile(int argc, char *argv[])
 
                     /* Append a new TLV */
                     TLVBUF_TX_DATA_RATE *tlv = NULL;
-                    tlv_len = sizeof(TLVBUF_TX_DATA_RATE);
-                    buffer = realloc(buffer, cmd_len + tlv_len);
-                    if (!buffer) {
-                        printf("ERR:Cannot append tx data rate TLV!\n");
+                    tlv = tlv_build_add(&b, MRVL_TX_DATA_RATE_TLV_ID,
+                                        sizeof(TLVBUF_TX_DATA_RATE));
+                    if (!tlv)
                         goto done;
-                    }
-                    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-                    tlv = (TLVBUF_TX_DATA_RATE *) (buffer + cmd_len);
-                    cmd_len += tlv_len;
                     /* Set TLV fields */
-                    tlv->Tag = MRVL_TX_DATA_RATE_TLV_ID;
                     tlv->Length = 2;
                     tlv->TxDataRate = tx_data_rate;
-                    endian_convert_tlv_header_out(tlv);
                     tlv->TxDataRate = uap_cpu_to_le16(tlv->TxDataRate);
                 }
                 if (mcbc_data_rate != -1) {
                     if ((!rate[0]) && (mcbc_data_rate) &&
-                        (is_mcbc_rate_valid((u8) mcbc_data_rate) !=
+                        (is_mcbc_rate_valid(dev, (u8) mcbc_data_rate) !=
                          UAP_SUCCESS)) {
                         printf("ERR: Invalid Tx Data Rate \n");
                         goto done;
@@ -2206,20 +2394,13 @@ apcmd_sys_config_profile(int argc, char *argv[])
 
                     /* Append a new TLV */
                     TLVBUF_MCBC_DATA_RATE *tlv = NULL;
-                    tlv_len = sizeof(TLVBUF_MCBC_DATA_RATE);
-                    buffer = realloc(buffer, cmd_len + tlv_len);
-                    if (!buffer) {
-                        printf("ERR:Cannot append tx data rate TLV!\n");
+                    tlv = tlv_build_add(&b, MRVL_MCBC_DATA_RATE_TLV_ID,
+                                        sizeof(TLVBUF_MCBC_DATA_RATE));
+                    if (!tlv)
                         goto done;
-                    }
-                    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-                    tlv = (TLVBUF_MCBC_DATA_RATE *) (buffer + cmd_len);
-                    cmd_len += tlv_len;
                     /* Set TLV fields */
-                    tlv->Tag = MRVL_MCBC_DATA_RATE_TLV_ID;
                     tlv->Length = 2;
                     tlv->MCBCdatarate = mcbc_data_rate;
-                    endian_convert_tlv_header_out(tlv);
                     tlv->MCBCdatarate = uap_cpu_to_le16(tlv->MCBCdatarate);
                 }
 
@@ -2232,31 +2413,18 @@ apcmd_sys_config_profile(int argc, char *argv[])
                     }
                     TLVBUF_CIPHER *tlv = NULL;
                     /* Append a new TLV */
-                    tlv_len = sizeof(TLVBUF_CIPHER);
-                    buffer = realloc(buffer, cmd_len + tlv_len);
-                    if (!buffer) {
-                        printf("ERR:Cannot append cipher TLV!\n");
+                    tlv = tlv_build_add(&b, MRVL_CIPHER_TLV_ID,
+                                        sizeof(TLVBUF_CIPHER));
+                    if (!tlv)
                         goto done;
-                    }
-                    cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-                    tlv = (TLVBUF_CIPHER *) (buffer + cmd_len);
-                    bzero((char *) tlv, tlv_len);
-                    cmd_len += tlv_len;
                     /* Set TLV fields */
-                    tlv->Tag = MRVL_CIPHER_TLV_ID;
                     tlv->Length = 2;
                     tlv->PairwiseCipher = pairwisecipher;
                     tlv->GroupCipher = groupcipher;
-                    endian_convert_tlv_header_out(tlv);
                 }
-                cmd_buf->Size = cmd_len;
                 /* Send collective command */
-                uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
-                cmd_len = 0;
-                if (buffer) {
-                    free(buffer);
-                    buffer = NULL;
-                }
+                tlv_build_send(dev, &b);
+                tlv_build_free(dev, &b);
                 continue;
             }
         }
@@ -2264,22 +2432,9 @@ apcmd_sys_config_profile(int argc, char *argv[])
         /* Check for beginning of AP configurations */
         if (strcmp(args[0], "ap_config") == 0) {
             is_ap_config = 1;
-            cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE);
-            if (buffer) {
-                free(buffer);
-                buffer = NULL;
-            }
-            buffer = (u8 *) malloc(cmd_len);
-            if (!buffer) {
-                printf("ERR:Cannot allocate memory!\n");
+            tlv_build_free(dev, &b);
+            if (tlv_build_start(dev, &b, ACTION_SET) != UAP_SUCCESS)
                 goto done;
-            }
-            cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-            cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-            cmd_buf->Size = cmd_len;
-            cmd_buf->SeqNum = 0;
-            cmd_buf->Result = 0;
-            cmd_buf->Action = ACTION_SET;
             continue;
         }
 
@@ -2298,17 +2453,11 @@ apcmd_sys_config_profile(int argc, char *argv[])
                          (filter_tlv->FilterMode == 1) ? "'Allow'" : "'Block'");
                     goto done;
                 }
-                filter_tlv->Length = (filter_tlv->Count * ETH_ALEN) + 2;
-                cmd_len -=
-                    (MAX_MAC_ONESHOT_FILTER - filter_mac_count) * ETH_ALEN;
-                cmd_buf->Size = cmd_len;
-                endian_convert_tlv_header_out(filter_tlv);
-                uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
-                cmd_len = 0;
-                if (buffer) {
-                    free(buffer);
-                    buffer = NULL;
-                }
+                tlv_build_trim(&b, filter_tlv,
+                               sizeof(TLVBUF_STA_MAC_ADDR_FILTER) +
+                               filter_mac_count * ETH_ALEN);
+                tlv_build_send(dev, &b);
+                tlv_build_free(dev, &b);
                 continue;
             }
         }
@@ -2322,19 +2471,10 @@ apcmd_sys_config_profile(int argc, char *argv[])
                     goto done;
                 }
                 is_custom_ie_config = 0;
-                custom_ie_tlv_head->Length = custom_ie_tlv_len;
-                cmd_len -=
-                    (MAX_IE_BUFFER_LEN * MAX_CUSTOM_IE_COUNT) -
-                    custom_ie_tlv_len;
-                cmd_len -= sizeof(custom_ie) * MAX_CUSTOM_IE_COUNT;
-                cmd_buf->Size = cmd_len;
-                endian_convert_tlv_header_out(custom_ie_tlv_head);
-                uap_ioctl((u8 *) cmd_buf, &cmd_len, cmd_len);
-                cmd_len = 0;
-                if (buffer) {
-                    free(buffer);
-                    buffer = NULL;
-                }
+                tlv_build_trim(&b, custom_ie_tlv_head,
+                               sizeof(tlvbuf_custom_ie) + custom_ie_tlv_len);
+                tlv_build_send(dev, &b);
+                tlv_build_free(dev, &b);
                 continue;
             }
         }
@@ -2351,7 +2491,7 @@ apcmd_sys_config_profile(int argc, char *argv[])
                 goto done;
             }
             if (sg_snmp_mib
-                (ACTION_SET, OID_80211D_ENABLE, sizeof(state_80211d),
+                (dev, ACTION_SET, OID_80211D_ENABLE, sizeof(state_80211d),
                  &state_80211d)
                 == UAP_FAILURE) {
                 goto done;
@@ -2415,7 +2555,7 @@ apcmd_sys_config_profile(int argc, char *argv[])
                    no_of_sub_band * sizeof(IEEEtypes_SubbandSet_t));
 
             /* Send the command */
-            uap_ioctl((u8 *) cmd_buf, &cmdlen, buf_len);
+            uap_ioctl(dev, (u8 *) cmd_buf, &cmdlen, buf_len);
             if (buf)
                 free(buf);
         }
@@ -2423,31 +2563,15 @@ apcmd_sys_config_profile(int argc, char *argv[])
         /* Check for beginning of AP MAC address filter configurations */
         if (strcmp(args[0], "ap_mac_filter") == 0) {
             is_ap_mac_filter = 1;
-            cmd_len =
-                sizeof(APCMDBUF_SYS_CONFIGURE) +
-                sizeof(TLVBUF_STA_MAC_ADDR_FILTER) +
-                (MAX_MAC_ONESHOT_FILTER * ETH_ALEN);
-            if (buffer) {
-                free(buffer);
-                buffer = NULL;
-            }
-            buffer = (u8 *) malloc(cmd_len);
-            if (!buffer) {
-                printf("ERR:Cannot allocate memory!\n");
+            tlv_build_free(dev, &b);
+            if (tlv_build_start(dev, &b, ACTION_SET) != UAP_SUCCESS)
+                goto done;
+            /* Room for the largest table, trimmed at the end */
+            filter_tlv = tlv_build_add(&b, MRVL_STA_MAC_ADDR_FILTER_TLV_ID,
+                                       sizeof(TLVBUF_STA_MAC_ADDR_FILTER) +
+                                       (MAX_MAC_ONESHOT_FILTER * ETH_ALEN));
+            if (!filter_tlv)
                 goto done;
-            }
-            cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-            cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-            cmd_buf->Size = cmd_len;
-            cmd_buf->SeqNum = 0;
-            cmd_buf->Result = 0;
-            cmd_buf->Action = ACTION_SET;
-            filter_tlv =
-                (TLVBUF_STA_MAC_ADDR_FILTER *) (buffer +
-                                                sizeof(APCMDBUF_SYS_CONFIGURE));
-            filter_tlv->Tag = MRVL_STA_MAC_ADDR_FILTER_TLV_ID;
-            filter_tlv->Length = 2;
-            filter_tlv->Count = 0;
             filter_mac_count = 0;
             continue;
         }
@@ -2455,29 +2579,19 @@ apcmd_sys_config_profile(int argc, char *argv[])
         /* Check for beginning of custom IE configurations */
         if (strcmp(args[0], "custom_ie_config") == 0) {
             is_custom_ie_config = 1;
-            cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE) + sizeof(tlvbuf_custom_ie)
-                +
-                ((MAX_IE_BUFFER_LEN + sizeof(custom_ie)) * MAX_CUSTOM_IE_COUNT);
-            if (buffer) {
-                free(buffer);
-                buffer = NULL;
-            }
-            buffer = (u8 *) malloc(cmd_len);
-            if (!buffer) {
-                printf("ERR:Cannot allocate memory!\n");
+            tlv_build_free(dev, &b);
+            if (tlv_build_start(dev, &b, ACTION_SET) != UAP_SUCCESS)
+                goto done;
+            /* Room for the largest IE list, trimmed at the end */
+            custom_ie_tlv = tlv_build_add(&b, MRVL_MGMT_IE_LIST_TLV_ID,
+                                          sizeof(tlvbuf_custom_ie) +
+                                          ((MAX_IE_BUFFER_LEN +
+                                            sizeof(custom_ie)) *
+                                           MAX_CUSTOM_IE_COUNT));
+            if (!custom_ie_tlv)
                 goto done;
-            }
-            cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-            cmd_buf->CmdCode = APCMD_SYS_CONFIGURE;
-            cmd_buf->Size = cmd_len;
-            cmd_buf->SeqNum = 0;
-            cmd_buf->Result = 0;
-            cmd_buf->Action = ACTION_SET;
-            custom_ie_tlv =
-                (tlvbuf_custom_ie *) (buffer + sizeof(APCMDBUF_SYS_CONFIGURE));
             custom_ie_ptr = (custom_ie *) (custom_ie_tlv->ie_data);
             custom_ie_tlv_head = custom_ie_tlv;
-            custom_ie_tlv_head->Tag = MRVL_MGMT_IE_LIST_TLV_ID;
             continue;
         }
 
@@ -2525,6 +2639,11 @@ apcmd_sys_config_profile(int argc, char *argv[])
                 printf("ERR:Illegal MgmtSubtypeMask %s.\n", args[1]);
                 goto done;
             }
+            if (custom_mask_count == MAX_CUSTOM_IE_COUNT) {
+                printf("ERR:Custom IE list can not have more than %d IEs\n",
+                       MAX_CUSTOM_IE_COUNT);
+                goto done;
+            }
             mask_ie_index = (u16) atoi(args[0] + strlen("MgmtSubtypeMask_"));
             if (mask_ie_index > 3) {
                 printf("ERR:Incorrect index %d.\n", mask_ie_index);
@@ -2542,6 +2661,11 @@ apcmd_sys_config_profile(int argc, char *argv[])
                 printf("ERR:Only hex digits are allowed\n");
                 goto done;
             }
+            if (custom_buf_count == MAX_CUSTOM_IE_COUNT) {
+                printf("ERR:Custom IE list can not have more than %d IEs\n",
+                       MAX_CUSTOM_IE_COUNT);
+                goto done;
+            }
             ie_buf_len = strlen(args[1]);
             if (!strncasecmp("0x", args[1], 2)) {
                 ie_len = (ie_buf_len - 2 + 1) / 2;
@@ -2570,6 +2694,9 @@ apcmd_sys_config_profile(int argc, char *argv[])
             custom_buf_count++;
             continue;
         }
+        /* The remaining parameters are TLVs of the ap_config section */
+        if (!is_ap_config)
+            continue;
         if (strcmp(args[0], "SSID") == 0) {
             if (arg_num == 1) {
                 printf("ERR:SSID field is blank!\n");
@@ -2589,20 +2716,13 @@ apcmd_sys_config_profile(int argc, char *argv[])
                     goto done;
                 }
                 /* Append a new TLV */
-                tlv_len = sizeof(TLVBUF_SSID) + strlen(args[1]);
-                buffer = realloc(buffer, cmd_len + tlv_len);
-                if (!buffer) {
-                    printf("ERR:Cannot realloc SSID TLV!\n");
+                tlv = tlv_build_add(&b, MRVL_SSID_TLV_ID,
+                                    sizeof(TLVBUF_SSID) + strlen(args[1]));
+                if (!tlv)
                     goto done;
-                }
-                cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-                tlv = (TLVBUF_SSID *) (buffer + cmd_len);
-                cmd_len += tlv_len;
                 /* Set TLV fields */
-                tlv->Tag = MRVL_SSID_TLV_ID;
                 tlv->Length = strlen(args[1]);
                 memcpy(tlv->Ssid, args[1], tlv->Length);
-                endian_convert_tlv_header_out(tlv);
             }
         }
         if (strcmp(args[0], "BeaconPeriod") == 0) {
@@ -2612,20 +2732,13 @@ apcmd_sys_config_profile(int argc, char *argv[])
             }
             TLVBUF_BEACON_PERIOD *tlv = NULL;
             /* Append a new TLV */
-            tlv_len = sizeof(TLVBUF_BEACON_PERIOD);
-            buffer = realloc(buffer, cmd_len + tlv_len);
-            if (!buffer) {
-                printf("ERR:Cannot realloc beacon period TLV!\n");
+            tlv = tlv_build_add(&b, MRVL_BEACON_PERIOD_TLV_ID,
+                                sizeof(TLVBUF_BEACON_PERIOD));
+            if (!tlv)
                 goto done;
-            }
-            cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-            tlv = (TLVBUF_BEACON_PERIOD *) (buffer + cmd_len);
-            cmd_len += tlv_len;
             /* Set TLV fields */
-            tlv->Tag = MRVL_BEACON_PERIOD_TLV_ID;
             tlv->Length = 2;
             tlv->BeaconPeriod_ms = (u16) atoi(args[1]);
-            endian_convert_tlv_header_out(tlv);
             tlv->BeaconPeriod_ms = uap_cpu_to_le16(tlv->BeaconPeriod_ms);
         }
         if (strcmp(args[0], "ChanList") == 0) {
@@ -2637,19 +2750,12 @@ apcmd_sys_config_profile(int argc, char *argv[])
             TLVBUF_CHANNEL_LIST *tlv = NULL;
             CHANNEL_LIST *pChanList = NULL;
             /* Append a new TLV */
-            tlv_len =
-                sizeof(TLVBUF_CHANNEL_LIST) +
-                ((arg_num - 1) * sizeof(CHANNEL_LIST));
-            buffer = realloc(buffer, cmd_len + tlv_len);
-            if (!buffer) {
-                printf("ERR:Cannot append channel list TLV!\n");
+            tlv = tlv_build_add(&b, MRVL_CHANNELLIST_TLV_ID,
+                                sizeof(TLVBUF_CHANNEL_LIST) +
+                                ((arg_num - 1) * sizeof(CHANNEL_LIST)));
+            if (!tlv)
                 goto done;
-            }
-            cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-            tlv = (TLVBUF_CHANNEL_LIST *) (buffer + cmd_len);
-            cmd_len += tlv_len;
             /* Set TLV fields */
-            tlv->Tag = MRVL_CHANNELLIST_TLV_ID;
             tlv->Length = sizeof(CHANNEL_LIST) * (arg_num - 1);
             pChanList = (CHANNEL_LIST *) tlv->ChanList;
             for (i = 0; i < (arg_num - 1); i++) {
@@ -2657,7 +2763,6 @@ apcmd_sys_config_profile(int argc, char *argv[])
                 pChanList->BandConfigType = 0;
                 pChanList++;
             }
-            endian_convert_tlv_header_out(tlv);
         }
         if (strcmp(args[0], "Channel") == 0) {
             if (is_input_valid(CHANNEL, arg_num - 1, args + 1) != UAP_SUCCESS) {
@@ -2665,40 +2770,26 @@ apcmd_sys_config_profile(int argc, char *argv[])
             }
             TLVBUF_CHANNEL_CONFIG *tlv = NULL;
             /* Append a new TLV */
-            tlv_len = sizeof(TLVBUF_CHANNEL_CONFIG);
-            buffer = realloc(buffer, cmd_len + tlv_len);
-            if (!buffer) {
-                printf("ERR:Cannot append channel TLV!\n");
+            tlv = tlv_build_add(&b, MRVL_CHANNELCONFIG_TLV_ID,
+                                sizeof(TLVBUF_CHANNEL_CONFIG));
+            if (!tlv)
                 goto done;
-            }
-            cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-            tlv = (TLVBUF_CHANNEL_CONFIG *) (buffer + cmd_len);
-            cmd_len += tlv_len;
             /* Set TLV fields */
-            tlv->Tag = MRVL_CHANNELCONFIG_TLV_ID;
             tlv->Length = 2;
             tlv->ChanNumber = (u8) atoi(args[1]);
             if ((arg_num - 1) == 2)
                 tlv->BandConfigType = atoi(args[2]) ? BAND_CONFIG_ACS_MODE : 0;
             else
                 tlv->BandConfigType = 0;
-            endian_convert_tlv_header_out(tlv);
         }
         if (strcmp(args[0], "AP_MAC") == 0) {
             int ret;
             TLVBUF_AP_MAC_ADDRESS *tlv = NULL;
             /* Append a new TLV */
-            tlv_len = sizeof(TLVBUF_AP_MAC_ADDRESS);
-            buffer = realloc(buffer, cmd_len + tlv_len);
-            if (!buffer) {
-                printf("ERR:Cannot append channel TLV!\n");
+            tlv = tlv_build_add(&b, MRVL_AP_MAC_ADDRESS_TLV_ID,
+                                sizeof(TLVBUF_AP_MAC_ADDRESS));
+            if (!tlv)
                 goto done;
-            }
-            cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-            tlv = (TLVBUF_AP_MAC_ADDRESS *) (buffer + cmd_len);
-            cmd_len += tlv_len;
-            cmd_buf->Action = ACTION_SET;
-            tlv->Tag = MRVL_AP_MAC_ADDRESS_TLV_ID;
             tlv->Length = ETH_ALEN;
             if ((ret = mac2raw(args[1], tlv->ApMacAddr)) != UAP_SUCCESS) {
                 printf("ERR: %s Address \n",
@@ -2706,7 +2797,6 @@ apcmd_sys_config_profile(int argc, char *argv[])
                        UAP_RET_MAC_BROADCAST ? "Broadcast" : "Multicast");
                 goto done;
             }
-            endian_convert_tlv_header_out(tlv);
         }
 
         if (strcmp(args[0], "RxAntenna") == 0) {
@@ -2717,21 +2807,13 @@ apcmd_sys_config_profile(int argc, char *argv[])
             }
             TLVBUF_ANTENNA_CTL *tlv = NULL;
             /* Append a new TLV */
-            tlv_len = sizeof(TLVBUF_ANTENNA_CTL);
-            buffer = realloc(buffer, cmd_len + tlv_len);
-            if (!buffer) {
-                printf("ERR:Cannot append channel TLV!\n");
+            tlv = tlv_build_add(&b, MRVL_ANTENNA_CTL_TLV_ID,
+                                sizeof(TLVBUF_ANTENNA_CTL));
+            if (!tlv)
                 goto done;
-            }
-            cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-            tlv = (TLVBUF_ANTENNA_CTL *) (buffer + cmd_len);
-            cmd_len += tlv_len;
-            cmd_buf->Action = ACTION_SET;
-            tlv->Tag = MRVL_ANTENNA_CTL_TLV_ID;
             tlv->Length = 2;
             tlv->WhichAntenna = 0;
             tlv->AntennaMode = atoi(args[1]);
-            endian_convert_tlv_header_out(tlv);
         }
 
         if (strcmp(args[0], "TxAntenna") == 0) {
@@ -2742,21 +2824,13 @@ apcmd_sys_config_profile(int argc, char *argv[])
             }
             TLVBUF_ANTENNA_CTL *tlv = NULL;
             /* Append a new TLV */
-            tlv_len = sizeof(TLVBUF_ANTENNA_CTL);
-            buffer = realloc(buffer, cmd_len + tlv_len);
-            if (!buffer) {
-                printf("ERR:Cannot append channel TLV!\n");
+            tlv = tlv_build_add(&b, MRVL_ANTENNA_CTL_TLV_ID,
+                                sizeof(TLVBUF_ANTENNA_CTL));
+            if (!tlv)
                 goto done;
-            }
-            cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-            tlv = (TLVBUF_ANTENNA_CTL *) (buffer + cmd_len);
-            cmd_len += tlv_len;
-            cmd_buf->Action = ACTION_SET;
-            tlv->Tag = MRVL_ANTENNA_CTL_TLV_ID;
             tlv->Length = 2;
             tlv->WhichAntenna = 1;
             tlv->AntennaMode = atoi(args[1]);
-            endian_convert_tlv_header_out(tlv);
         }
         if (strcmp(args[0], "Rate") == 0) {
             if (is_input_valid(RATE, arg_num - 1, args + 1) != UAP_SUCCESS) {
@@ -2765,23 +2839,16 @@ apcmd_sys_config_profile(int argc, char *argv[])
             }
             TLVBUF_RATES *tlv = NULL;
             /* Append a new TLV */
-            tlv_len = sizeof(TLVBUF_RATES) + arg_num - 1;
-            buffer = realloc(buffer, cmd_len + tlv_len);
-            if (!buffer) {
-                printf("ERR:Cannot append rates TLV!\n");
+            tlv = tlv_build_add(&b, MRVL_RATES_TLV_ID,
+                                sizeof(TLVBUF_RATES) + arg_num - 1);
+            if (!tlv)
                 goto done;
-            }
-            cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-            tlv = (TLVBUF_RATES *) (buffer + cmd_len);
-            cmd_len += tlv_len;
             /* Set TLV fields */
-            tlv->Tag = MRVL_RATES_TLV_ID;
             tlv->Length = arg_num - 1;
             for (i = 0; i < tlv->Length; i++) {
                 rate[i] = tlv->OperationalRates[i] =
                     (u8) A2HEXDECIMAL(args[i + 1]);
             }
-            endian_convert_tlv_header_out(tlv);
         }
         if (strcmp(args[0], "TxPowerLevel") == 0) {
             if (is_input_valid(TXPOWER, arg_num - 1, args + 1) != UAP_SUCCESS) {
@@ -2790,20 +2857,13 @@ apcmd_sys_config_profile(int argc, char *argv[])
             } else {
                 TLVBUF_TX_POWER *tlv = NULL;
                 /* Append a new TLV */
-                tlv_len = sizeof(TLVBUF_TX_POWER);
-                buffer = realloc(buffer, cmd_len + tlv_len);
-                if (!buffer) {
-                    printf("ERR:Cannot append tx power level TLV!\n");
+                tlv = tlv_build_add(&b, MRVL_TX_POWER_TLV_ID,
+                                    sizeof(TLVBUF_TX_POWER));
+                if (!tlv)
                     goto done;
-                }
-                cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-                tlv = (TLVBUF_TX_POWER *) (buffer + cmd_len);
-                cmd_len += tlv_len;
                 /* Set TLV fields */
-                tlv->Tag = MRVL_TX_POWER_TLV_ID;
                 tlv->Length = 1;
                 tlv->TxPower_dBm = (u8) atoi(args[1]);
-                endian_convert_tlv_header_out(tlv);
             }
         }
         if (strcmp(args[0], "BroadcastSSID") == 0) {
@@ -2813,20 +2873,13 @@ apcmd_sys_config_profile(int argc, char *argv[])
             }
             TLVBUF_BCAST_SSID_CTL *tlv = NULL;
             /* Append a new TLV */
-            tlv_len = sizeof(TLVBUF_BCAST_SSID_CTL);
-            buffer = realloc(buffer, cmd_len + tlv_len);
-            if (!buffer) {
-                printf("ERR:Cannot append SSID broadcast control TLV!\n");
+            tlv = tlv_build_add(&b, MRVL_BCAST_SSID_CTL_TLV_ID,
+                                sizeof(TLVBUF_BCAST_SSID_CTL));
+            if (!tlv)
                 goto done;
-            }
-            cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-            tlv = (TLVBUF_BCAST_SSID_CTL *) (buffer + cmd_len);
-            cmd_len += tlv_len;
             /* Set TLV fields */
-            tlv->Tag = MRVL_BCAST_SSID_CTL_TLV_ID;
             tlv->Length = 1;
             tlv->BcastSsidCtl = (u8) atoi(args[1]);
-            endian_convert_tlv_header_out(tlv);
         }
         if (strcmp(args[0], "RTSThreshold") == 0) {
             if (is_input_valid(RTSTHRESH, arg_num - 1, args + 1) != UAP_SUCCESS) {
@@ -2834,20 +2887,13 @@ apcmd_sys_config_profile(int argc, char *argv[])
             }
             TLVBUF_RTS_THRESHOLD *tlv = NULL;
             /* Append a new TLV */
-            tlv_len = sizeof(TLVBUF_RTS_THRESHOLD);
-            buffer = realloc(buffer, cmd_len + tlv_len);
-            if (!buffer) {
-                printf("ERR:Cannot append RTS threshold TLV!\n");
+            tlv = tlv_build_add(&b, MRVL_RTS_THRESHOLD_TLV_ID,
+                                sizeof(TLVBUF_RTS_THRESHOLD));
+            if (!tlv)
                 goto done;
-            }
-            cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-            tlv = (TLVBUF_RTS_THRESHOLD *) (buffer + cmd_len);
-            cmd_len += tlv_len;
             /* Set TLV fields */
-            tlv->Tag = MRVL_RTS_THRESHOLD_TLV_ID;
             tlv->Length = 2;
             tlv->RtsThreshold = (u16) atoi(args[1]);
-            endian_convert_tlv_header_out(tlv);
             tlv->RtsThreshold = uap_cpu_to_le16(tlv->RtsThreshold);
         }
         if (strcmp(args[0], "FragThreshold") == 0) {
@@ -2857,20 +2903,13 @@ apcmd_sys_config_profile(int argc, char *argv[])
             }
             TLVBUF_FRAG_THRESHOLD *tlv = NULL;
             /* Append a new TLV */
-            tlv_len = sizeof(TLVBUF_FRAG_THRESHOLD);
-            buffer = realloc(buffer, cmd_len + tlv_len);
-            if (!buffer) {
-                printf("ERR:Cannot append Fragmentation threshold TLV!\n");
+            tlv = tlv_build_add(&b, MRVL_FRAG_THRESHOLD_TLV_ID,
+                                sizeof(TLVBUF_FRAG_THRESHOLD));
+            if (!tlv)
                 goto done;
-            }
-            cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-            tlv = (TLVBUF_FRAG_THRESHOLD *) (buffer + cmd_len);
-            cmd_len += tlv_len;
             /* Set TLV fields */
-            tlv->Tag = MRVL_FRAG_THRESHOLD_TLV_ID;
             tlv->Length = 2;
             tlv->FragThreshold = (u16) atoi(args[1]);
-            endian_convert_tlv_header_out(tlv);
             tlv->FragThreshold = uap_cpu_to_le16(tlv->FragThreshold);
         }
         if (strcmp(args[0], "DTIMPeriod") == 0) {
@@ -2880,20 +2919,13 @@ apcmd_sys_config_profile(int argc, char *argv[])
             }
             TLVBUF_DTIM_PERIOD *tlv = NULL;
             /* Append a new TLV */
-            tlv_len = sizeof(TLVBUF_DTIM_PERIOD);
-            buffer = realloc(buffer, cmd_len + tlv_len);
-            if (!buffer) {
-                printf("ERR:Cannot append DTIM period TLV!\n");
+            tlv = tlv_build_add(&b, MRVL_DTIM_PERIOD_TLV_ID,
+                                sizeof(TLVBUF_DTIM_PERIOD));
+            if (!tlv)
                 goto done;
-            }
-            cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-            tlv = (TLVBUF_DTIM_PERIOD *) (buffer + cmd_len);
-            cmd_len += tlv_len;
             /* Set TLV fields */
-            tlv->Tag = MRVL_DTIM_PERIOD_TLV_ID;
             tlv->Length = 1;
             tlv->DtimPeriod = (u8) atoi(args[1]);
-            endian_convert_tlv_header_out(tlv);
         }
         if (strcmp(args[0], "RadioControl") == 0) {
             if (is_input_valid(RADIOCONTROL, arg_num - 1, args + 1) !=
@@ -2902,20 +2934,13 @@ apcmd_sys_config_profile(int argc, char *argv[])
             }
             TLVBUF_RADIO_CTL *tlv = NULL;
             /* Append a new TLV */
-            tlv_len = sizeof(TLVBUF_RADIO_CTL);
-            buffer = realloc(buffer, cmd_len + tlv_len);
-            if (!buffer) {
-                printf("ERR:Cannot append radio control TLV!\n");
+            tlv = tlv_build_add(&b, MRVL_RADIO_CTL_TLV_ID,
+                                sizeof(TLVBUF_RADIO_CTL));
+            if (!tlv)
                 goto done;
-            }
-            cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-            tlv = (TLVBUF_RADIO_CTL *) (buffer + cmd_len);
-            cmd_len += tlv_len;
             /* Set TLV fields */
-            tlv->Tag = MRVL_RADIO_CTL_TLV_ID;
             tlv->Length = 1;
             tlv->RadioCtl = (u8) atoi(args[1]);
-            endian_convert_tlv_header_out(tlv);
         }
         if (strcmp(args[0], "RSNReplayProtection") == 0) {
             if (is_input_valid(RSNREPLAYPROT, arg_num - 1, args + 1) !=
@@ -2924,20 +2949,13 @@ apcmd_sys_config_profile(int argc, char *argv[])
             }
             tlvbuf_rsn_replay_prot *tlv = NULL;
             /* Append a new TLV */
-            tlv_len = sizeof(tlvbuf_rsn_replay_prot);
-            buffer = realloc(buffer, cmd_len + tlv_len);
-            if (!buffer) {
-                printf("ERR:Cannot append RSN replay protection TLV!\n");
+            tlv = tlv_build_add(&b, MRVL_RSN_REPLAY_PROT_TLV_ID,
+                                sizeof(tlvbuf_rsn_replay_prot));
+            if (!tlv)
                 goto done;
-            }
-            cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-            tlv = (tlvbuf_rsn_replay_prot *) (buffer + cmd_len);
-            cmd_len += tlv_len;
             /* Set TLV fields */
-            tlv->Tag = MRVL_RSN_REPLAY_PROT_TLV_ID;
             tlv->Length = 1;
             tlv->rsn_replay_prot = (u8) atoi(args[1]);
-            endian_convert_tlv_header_out(tlv);
         }
         if (strcmp(args[0], "TxDataRate") == 0) {
             if (is_input_valid(TXDATARATE, arg_num - 1, args + 1) !=
@@ -2959,20 +2977,13 @@ apcmd_sys_config_profile(int argc, char *argv[])
             }
             TLVBUF_PKT_FWD_CTL *tlv = NULL;
             /* Append a new TLV */
-            tlv_len = sizeof(TLVBUF_PKT_FWD_CTL);
-            buffer = realloc(buffer, cmd_len + tlv_len);
-            if (!buffer) {
-                printf("ERR:Cannot append packet forwarding control TLV!\n");
+            tlv = tlv_build_add(&b, MRVL_PKT_FWD_CTL_TLV_ID,
+                                sizeof(TLVBUF_PKT_FWD_CTL));
+            if (!tlv)
                 goto done;
-            }
-            cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-            tlv = (TLVBUF_PKT_FWD_CTL *) (buffer + cmd_len);
-            cmd_len += tlv_len;
             /* Set TLV fields */
-            tlv->Tag = MRVL_PKT_FWD_CTL_TLV_ID;
             tlv->Length = 1;
             tlv->PktFwdCtl = (u8) atoi(args[1]);
-            endian_convert_tlv_header_out(tlv);
         }
         if (strcmp(args[0], "StaAgeoutTimer") == 0) {
             if (is_input_valid(STAAGEOUTTIMER, arg_num - 1, args + 1) !=
@@ -2981,20 +2992,13 @@ apcmd_sys_config_profile(int argc, char *argv[])
             }
             TLVBUF_STA_AGEOUT_TIMER *tlv = NULL;
             /* Append a new TLV */
-            tlv_len = sizeof(TLVBUF_STA_AGEOUT_TIMER);
-            buffer = realloc(buffer, cmd_len + tlv_len);
-            if (!buffer) {
-                printf("ERR:Cannot append STA ageout timer TLV!\n");
+            tlv = tlv_build_add(&b, MRVL_STA_AGEOUT_TIMER_TLV_ID,
+                                sizeof(TLVBUF_STA_AGEOUT_TIMER));
+            if (!tlv)
                 goto done;
-            }
-            cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-            tlv = (TLVBUF_STA_AGEOUT_TIMER *) (buffer + cmd_len);
-            cmd_len += tlv_len;
             /* Set TLV fields */
-            tlv->Tag = MRVL_STA_AGEOUT_TIMER_TLV_ID;
             tlv->Length = 4;
             tlv->StaAgeoutTimer_ms = (u32) atoi(args[1]);
-            endian_convert_tlv_header_out(tlv);
             tlv->StaAgeoutTimer_ms = uap_cpu_to_le32(tlv->StaAgeoutTimer_ms);
         }
         if (strcmp(args[0], "AuthMode") == 0) {
@@ -3008,20 +3012,12 @@ apcmd_sys_config_profile(int argc, char *argv[])
                 goto done;
             }
             /* Append a new TLV */
-            tlv_len = sizeof(TLVBUF_AUTH_MODE);
-            buffer = realloc(buffer, cmd_len + tlv_len);
-            if (!buffer) {
-                printf("ERR:Cannot append auth mode TLV!\n");
+            tlv = tlv_build_add(&b, MRVL_AUTH_TLV_ID, sizeof(TLVBUF_AUTH_MODE));
+            if (!tlv)
                 goto done;
-            }
-            cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-            tlv = (TLVBUF_AUTH_MODE *) (buffer + cmd_len);
-            cmd_len += tlv_len;
             /* Set TLV fields */
-            tlv->Tag = MRVL_AUTH_TLV_ID;
             tlv->Length = 1;
             tlv->AuthMode = (u8) atoi(args[1]);
-            endian_convert_tlv_header_out(tlv);
         }
         if (strcmp(args[0], "KeyIndex") == 0) {
             if (arg_num == 1) {
@@ -3069,17 +3065,11 @@ apcmd_sys_config_profile(int argc, char *argv[])
                     key_len = strlen(args[1]) / 2;
                 }
                 /* Append a new TLV */
-                tlv_len = sizeof(TLVBUF_WEP_KEY) + key_len;
-                buffer = realloc(buffer, cmd_len + tlv_len);
-                if (!buffer) {
-                    printf("ERR:Cannot append WEP key configurations TLV!\n");
+                tlv = tlv_build_add(&b, MRVL_WEP_KEY_TLV_ID,
+                                    sizeof(TLVBUF_WEP_KEY) + key_len);
+                if (!tlv)
                     goto done;
-                }
-                cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-                tlv = (TLVBUF_WEP_KEY *) (buffer + cmd_len);
-                cmd_len += tlv_len;
                 /* Set TLV fields */
-                tlv->Tag = MRVL_WEP_KEY_TLV_ID;
                 tlv->Length = key_len + 2;
                 if (strcmp(args[0], "Key_0") == 0) {
                     tlv->KeyIndex = 0;
@@ -3100,7 +3090,6 @@ apcmd_sys_config_profile(int argc, char *argv[])
                 } else {
                     string2raw(args[1], tlv->Key);
                 }
-                endian_convert_tlv_header_out(tlv);
             }
         }
         if (strcmp(args[0], "PSK") == 0) {
@@ -3115,7 +3104,6 @@ apcmd_sys_config_profile(int argc, char *argv[])
                 if (args[1][strlen(args[1]) - 1] == '"') {
                     args[1][strlen(args[1]) - 1] = '\0';
                 }
-                tlv_len = sizeof(TLVBUF_WPA_PASSPHRASE) + strlen(args[1]);
                 if (strlen(args[1]) > MAX_WPA_PASSPHRASE_LENGTH) {
                     printf("ERR:PSK too long.\n");
                     goto done;
@@ -3132,19 +3120,14 @@ apcmd_sys_config_profile(int argc, char *argv[])
                     }
                 }
                 /* Append a new TLV */
-                buffer = realloc(buffer, cmd_len + tlv_len);
-                if (!buffer) {
-                    printf("ERR:Cannot append WPA passphrase TLV!\n");
+                tlv = tlv_build_add(&b, MRVL_WPA_PASSPHRASE_TLV_ID,
+                                    sizeof(TLVBUF_WPA_PASSPHRASE) +
+                                    strlen(args[1]));
+                if (!tlv)
                     goto done;
-                }
-                cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-                tlv = (TLVBUF_WPA_PASSPHRASE *) (buffer + cmd_len);
-                cmd_len += tlv_len;
                 /* Set TLV fields */
-                tlv->Tag = MRVL_WPA_PASSPHRASE_TLV_ID;
                 tlv->Length = strlen(args[1]);
                 memcpy(tlv->Passphrase, args[1], tlv->Length);
-                endian_convert_tlv_header_out(tlv);
             }
         }
         if (strcmp(args[0], "Protocol") == 0) {
@@ -3153,38 +3136,23 @@ apcmd_sys_config_profile(int argc, char *argv[])
             }
             TLVBUF_PROTOCOL *tlv = NULL;
             /* Append a new TLV */
-            tlv_len = sizeof(TLVBUF_PROTOCOL);
-            buffer = realloc(buffer, cmd_len + tlv_len);
-            if (!buffer) {
-                printf("ERR:Cannot append protocol TLV!\n");
+            tlv = tlv_build_add(&b, MRVL_PROTOCOL_TLV_ID,
+                                sizeof(TLVBUF_PROTOCOL));
+            if (!tlv)
                 goto done;
-            }
-            cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-            tlv = (TLVBUF_PROTOCOL *) (buffer + cmd_len);
-            cmd_len += tlv_len;
             /* Set TLV fields */
-            tlv->Tag = MRVL_PROTOCOL_TLV_ID;
             tlv->Length = 2;
             tlv->Protocol = (u16) atoi(args[1]);
-            endian_convert_tlv_header_out(tlv);
             tlv->Protocol = uap_cpu_to_le16(tlv->Protocol);
             if (atoi(args[1]) & (PROTOCOL_WPA | PROTOCOL_WPA2)) {
                 TLVBUF_AKMP *tlv = NULL;
                 /* Append a new TLV */
-                tlv_len = sizeof(TLVBUF_AKMP);
-                buffer = realloc(buffer, cmd_len + tlv_len);
-                if (!buffer) {
-                    printf("ERR:Cannot append AKMP TLV!\n");
+                tlv = tlv_build_add(&b, MRVL_AKMP_TLV_ID, sizeof(TLVBUF_AKMP));
+                if (!tlv)
                     goto done;
-                }
-                cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-                tlv = (TLVBUF_AKMP *) (buffer + cmd_len);
-                cmd_len += tlv_len;
                 /* Set TLV fields */
-                tlv->Tag = MRVL_AKMP_TLV_ID;
                 tlv->Length = 2;
                 tlv->KeyMgmt = KEY_MGMT_PSK;
-                endian_convert_tlv_header_out(tlv);
                 tlv->KeyMgmt = uap_cpu_to_le16(tlv->KeyMgmt);
             }
         }
@@ -3232,20 +3200,13 @@ apcmd_sys_config_profile(int argc, char *argv[])
             TLVBUF_GROUP_REKEY_TIMER *tlv = NULL;
 
             /* Append a new TLV */
-            tlv_len = sizeof(TLVBUF_GROUP_REKEY_TIMER);
-            buffer = realloc(buffer, cmd_len + tlv_len);
-            if (!buffer) {
-                printf("ERR:Cannot append protocol TLV!\n");
+            tlv = tlv_build_add(&b, MRVL_GRP_REKEY_TIME_TLV_ID,
+                                sizeof(TLVBUF_GROUP_REKEY_TIMER));
+            if (!tlv)
                 goto done;
-            }
-            cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-            tlv = (TLVBUF_GROUP_REKEY_TIMER *) (buffer + cmd_len);
-            cmd_len += tlv_len;
             /* Set TLV fields */
-            tlv->Tag = MRVL_GRP_REKEY_TIME_TLV_ID;
             tlv->Length = 4;
             tlv->GroupRekeyTime_sec = (u32) atoi(args[1]);
-            endian_convert_tlv_header_out(tlv);
             tlv->GroupRekeyTime_sec = uap_cpu_to_le32(tlv->GroupRekeyTime_sec);
         }
         if (strcmp(args[0], "MaxStaNum") == 0) {
@@ -3255,20 +3216,13 @@ apcmd_sys_config_profile(int argc, char *argv[])
             TLVBUF_MAX_STA_NUM *tlv = NULL;
 
             /* Append a new TLV */
-            tlv_len = sizeof(TLVBUF_MAX_STA_NUM);
-            buffer = realloc(buffer, cmd_len + tlv_len);
-            if (!buffer) {
-                printf("ERR:Cannot realloc max station number TLV!\n");
+            tlv = tlv_build_add(&b, MRVL_MAX_STA_CNT_TLV_ID,
+                                sizeof(TLVBUF_MAX_STA_NUM));
+            if (!tlv)
                 goto done;
-            }
-            cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-            tlv = (TLVBUF_MAX_STA_NUM *) (buffer + cmd_len);
-            cmd_len += tlv_len;
             /* Set TLV fields */
-            tlv->Tag = MRVL_MAX_STA_CNT_TLV_ID;
             tlv->Length = 2;
             tlv->Max_sta_num = (u16) atoi(args[1]);
-            endian_convert_tlv_header_out(tlv);
             tlv->Max_sta_num = uap_cpu_to_le16(tlv->Max_sta_num);
         }
         if (strcmp(args[0], "Retrylimit") == 0) {
@@ -3279,31 +3233,21 @@ apcmd_sys_config_profile(int argc, char *argv[])
             TLVBUF_RETRY_LIMIT *tlv = NULL;
 
             /* Append a new TLV */
-            tlv_len = sizeof(TLVBUF_RETRY_LIMIT);
-            buffer = realloc(buffer, cmd_len + tlv_len);
-            if (!buffer) {
-                printf("ERR:Cannot realloc retry limit TLV!\n");
+            tlv = tlv_build_add(&b, MRVL_RETRY_LIMIT_TLV_ID,
+                                sizeof(TLVBUF_RETRY_LIMIT));
+            if (!tlv)
                 goto done;
-            }
-            cmd_buf = (APCMDBUF_SYS_CONFIGURE *) buffer;
-            tlv = (TLVBUF_RETRY_LIMIT *) (buffer + cmd_len);
-            cmd_len += tlv_len;
             /* Set TLV fields */
-            tlv->Tag = MRVL_RETRY_LIMIT_TLV_ID;
             tlv->Length = 1;
             tlv->retry_limit = (u8) atoi(args[1]);
-            endian_convert_tlv_header_out(tlv);
         }
 #if DEBUG
-        if (cmd_len != 0) {
-            hexdump("Command Buffer", (void *) cmd_buf, cmd_len, ' ');
-        }
+        hexdump("Command Buffer", (void *) b.buf, b.len, ' ');
 #endif
     }
   done:
     fclose(config_file);
-    if (buffer)
-        free(buffer);
+    tlv_build_free(dev, &b);
     if (line)
         free(line);
 }
@@ -3320,6 +3264,12 @@ print_apcmd_cfg_80211d_usage(void)
     return;
 }
 
+/** Default EWMA weight of uap_stats --kpi */
+#define STATS_KPI_ALPHA         0.3
+
+/** KPI defaults, for the usage */
+static uap_kpi stats_kpi_defaults;
+
 /**
  *  @brief Show usage information for the uap_stats command
  *
@@ -3328,60 +3278,254 @@ print_apcmd_cfg_80211d_usage(void)
 void
 print_apcmd_uap_stats(void)
 {
-    printf("Usage: uap_stats \n");
+    int i;
+
+    printf("Usage: uap_stats [--interval <ms> [--count <N>]\n"
+           "                 [--kpi [--alpha <a>] [--alert <kpi>=<ratio>]]]"
+           "\n");
+    printf("\nWith --interval, the counters are polled every <ms> and one\n"
+           "line of per second rates is printed per sample, N samples or\n"
+           "until interrupted, followed by the totals of the run.\n"
+           "\nWith --kpi, the line has the KPI ratios in percent instead,\n"
+           "smoothed with weight <a> for the newest sample (default %.1f).\n"
+           "An ALERT line is printed when a smoothed ratio goes above its\n"
+           "threshold, a CLEAR line when it drops back, 0 disables an\n"
+           "alert.  KPIs and default thresholds:\n", STATS_KPI_ALPHA);
+    uap_kpi_init(&stats_kpi_defaults, 1);
+    for (i = 0; i < UAP_KPIS; i++)
+        printf("    %-14s %.2f\n", uap_kpi_name(i),
+               stats_kpi_defaults.threshold[i]);
     return;
 }
 
+/** Options of the uap_stats command */
+static struct option uap_stats_options[] = {
+    {"help", 0, NULL, 'h'},
+    {"interval", 1, NULL, 'i'},
+    {"count", 1, NULL, 'c'},
+    {"kpi", 0, NULL, 'k'},
+    {"alpha", 1, NULL, 'a'},
+    {"alert", 1, NULL, 'A'},
+    {NULL, 0, NULL, '\0'}
+};
+
+/** Set by SIGINT to end a uap_stats watch */
+static volatile sig_atomic_t stats_stop;
+
+/**
+ *  @brief SIGINT handler of the uap_stats watch
+ *
+ *  @param sig      Signal number
+ *  @return         N/A
+ */
+static void
+stats_sigint(int sig)
+{
+    stats_stop = 1;
+}
+
 /**
- *  SNMP MIB OIDs Table
+ *  @brief Returns one uap_stats counter
+ *
+ *  @param stats    Counters
+ *  @param i        Counter index
+ *  @param value    Returns the counter value
+ *  @return         Counter name, NULL past the last counter
  */
-static oids_table snmp_oids[] = {
-    {0x0b, 4, "dot11LocalTKIPMICFailures"},
-    {0x0c, 4, "dot11CCMPDecryptErrors"},
-    {0x0d, 4, "dot11WEPUndecryptableCount"},
-    {0x0e, 4, "dot11WEPICVErrorCount"},
-    {0x0f, 4, "dot11DecryptFailureCount"},
-    {0x12, 4, "dot11FailedCount"},
-    {0x13, 4, "dot11RetryCount"},
-    {0x14, 4, "dot11MultipleRetryCount"},
-    {0x15, 4, "dot11FrameDuplicateCount"},
-    {0x16, 4, "dot11RTSSuccessCount"},
-    {0x17, 4, "dot11RTSFailureCount"},
-    {0x18, 4, "dot11ACKFailureCount"},
-    {0x19, 4, "dot11ReceivedFragmentCount"},
-    {0x1a, 4, "dot11MulticastReceivedFrameCount"},
-    {0x1b, 4, "dot11FCSErrorCount"},
-    {0x1c, 4, "dot11TransmittedFrameCount"},
-    {0x1d, 4, "dot11RSNATKIPCounterMeasuresInvoked"},
-    {0x1e, 4, "dot11RSNA4WayHandshakeFailures"},
-    {0x1f, 4, "dot11MulticastTransmittedFrameCount"}
-};
+const char *
+stats_field(uap_stats_info * stats, int i, unsigned int *value)
+{
+    if (i < 0 || i >= STATS_FIELDS)
+        return NULL;
+    *value = STATS_FIELD(stats, i);
+    return stats_fields[i].name;
+}
+
+/**
+ *  @brief Polls the uap_stats counters and prints their rates
+ *
+ *  Samples are taken on a fixed schedule and rates use the measured
+ *  time between samples.  The firmware counters are 32 bits wide, the
+ *  deltas are taken modulo 2^32 and summed in 64 bit totals, so a
+ *  counter wrapping between two samples is counted correctly.
+ *
+ *  @param dev         A pointer to uap_dev structure
+ *  @param interval_ms Sampling interval in ms
+ *  @param count       Number of samples, 0 until interrupted
+ *  @param kpi         KPI state to print KPIs instead of rates, or NULL
+ *  @return            N/A
+ */
+static void
+uap_stats_watch(uap_dev * dev, long interval_ms, long count, uap_kpi * kpi)
+{
+    uap_stats_info prev, cur, delta;
+    u64 total[STATS_FIELDS];
+    u64 start_ns, prev_ns, now_ns;
+    struct sigaction sa, old_sa;
+    struct timespec next;
+    double secs;
+    long n;
+    int i, ret, changed;
+
+    ret = uap_get_stats(dev, &prev);
+    if (ret != UAP_OK) {
+        print_lib_error(ret, "Command Response incorrect!");
+        return;
+    }
+    start_ns = prev_ns = uap_time_ns();
+    memset(total, 0, sizeof(total));
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = stats_sigint;
+    sigemptyset(&sa.sa_mask);
+    stats_stop = 0;
+    sigaction(SIGINT, &sa, &old_sa);
+
+    printf("%9s", "Time(s)");
+    for (i = 0; i < (kpi ? UAP_KPIS : STATS_FIELDS); i++) {
+        if (kpi)
+            printf(" %13s%%", uap_kpi_name(i));
+        else if (stats_fields[i].column)
+            printf(" %10s", stats_fields[i].column);
+    }
+    printf("\n");
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (n = 0; !count || n < count; n++) {
+        next.tv_sec += interval_ms / 1000;
+        next.tv_nsec += (interval_ms % 1000) * 1000000;
+        if (next.tv_nsec >= 1000000000) {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000;
+        }
+        while (!stats_stop &&
+               clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next,
+                               NULL) == EINTR) ;
+        if (stats_stop)
+            break;
+        ret = uap_get_stats(dev, &cur);
+        if (ret != UAP_OK) {
+            print_lib_error(ret, "Command Response incorrect!");
+            break;
+        }
+        now_ns = uap_time_ns();
+        secs = (now_ns - prev_ns) / 1e9;
+        uap_stats_delta(&delta, &prev, &cur);
+        printf("%9.3f", (now_ns - start_ns) / 1e9);
+        for (i = 0; i < STATS_FIELDS; i++) {
+            total[i] += STATS_FIELD(&delta, i);
+            if (!kpi && stats_fields[i].column)
+                printf(" %10.1f", STATS_FIELD(&delta, i) / secs);
+        }
+        if (kpi) {
+            changed = uap_kpi_update(kpi, &delta);
+            for (i = 0; i < UAP_KPIS; i++) {
+                if (kpi->ewma[i] < 0)
+                    printf(" %14s", "-");
+                else
+                    printf(" %14.2f", kpi->ewma[i] * 100);
+            }
+            printf("\n");
+            for (i = 0; i < UAP_KPIS; i++) {
+                if (changed & (1 << i))
+                    printf("%s:%s %.2f%% %s %.2f%%\n",
+                           kpi->alert[i] ? "ALERT" : "CLEAR",
+                           uap_kpi_name(i), kpi->ewma[i] * 100,
+                           kpi->alert[i] ? "above" : "back to",
+                           kpi->threshold[i] * 100);
+            }
+        } else {
+            printf("\n");
+        }
+        fflush(stdout);
+        prev = cur;
+        prev_ns = now_ns;
+    }
+    sigaction(SIGINT, &old_sa, NULL);
+
+    secs = (prev_ns - start_ns) / 1e9;
+    printf("Totals over %ld samples, %.3f s:\n", n, secs);
+    for (i = 0; i < STATS_FIELDS; i++) {
+        if (total[i])
+            printf("%s: %llu (%.1f/s)\n", stats_fields[i].name,
+                   (unsigned long long) total[i], total[i] / secs);
+    }
+    for (i = 0; kpi && i < UAP_KPIS; i++) {
+        if (kpi->ewma[i] >= 0)
+            printf("%s: %.2f%% smoothed, %u alerts\n", uap_kpi_name(i),
+                   kpi->ewma[i] * 100, kpi->alerts[i]);
+    }
+}
 
 /** 
  *  @brief Get uAP stats
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  
  *  @return         NA
  */
 void
-apcmd_uap_stats(int argc, char *argv[])
+apcmd_uap_stats(uap_dev * dev, int argc, char *argv[])
 {
-    u8 no_of_oids = sizeof(snmp_oids) / sizeof(snmp_oids[0]);
-    u16 i, j;
-    int size;
-    APCMDBUF_SNMP_MIB *cmd_buf = NULL;
-    u8 *buf = NULL;
-    TLVBUF_HEADER *tlv = NULL;
-    u16 cmd_len = 0;
-    u16 buf_len = 0;
-    u8 ret;
+    uap_stats_info stats;
+    uap_kpi kpi;
+    long interval_ms = 0, count = 0;
+    int use_kpi = 0;
+    double alpha = STATS_KPI_ALPHA, threshold;
+    char *end, *eq;
     int opt;
-    u16 oid_size;
+    int ret;
+    int i;
 
-    while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
+    uap_kpi_init(&kpi, alpha);
+    while ((opt = getopt_long(argc, argv, "+hi:c:ka:A:", uap_stats_options,
+                              NULL)) != -1) {
         switch (opt) {
+        case 'i':
+            interval_ms = strtol(optarg, &end, 10);
+            if (*end || interval_ms <= 0) {
+                printf("ERR:Invalid interval %s\n", optarg);
+                return;
+            }
+            break;
+        case 'c':
+            count = strtol(optarg, &end, 10);
+            if (*end || count <= 0) {
+                printf("ERR:Invalid count %s\n", optarg);
+                return;
+            }
+            break;
+        case 'k':
+            use_kpi = 1;
+            break;
+        case 'a':
+            alpha = strtod(optarg, &end);
+            if (*end || alpha <= 0 || alpha > 1) {
+                printf("ERR:Invalid alpha %s, expected 0 < a <= 1\n",
+                       optarg);
+                return;
+            }
+            kpi.alpha = alpha;
+            break;
+        case 'A':
+            eq = strchr(optarg, '=');
+            for (i = 0; eq && i < UAP_KPIS; i++) {
+                if (strlen(uap_kpi_name(i)) == eq - optarg &&
+                    !strncmp(uap_kpi_name(i), optarg, eq - optarg))
+                    break;
+            }
+            if (!eq || i == UAP_KPIS) {
+                printf("ERR:Expected <kpi>=<ratio>, got %s\n", optarg);
+                return;
+            }
+            threshold = strtod(eq + 1, &end);
+            if (end == eq + 1 || *end || threshold < 0) {
+                printf("ERR:Invalid threshold %s\n", eq + 1);
+                return;
+            }
+            kpi.threshold[i] = threshold;
+            break;
         default:
             print_apcmd_uap_stats();
             return;
@@ -3390,116 +3534,327 @@ apcmd_uap_stats(int argc, char *argv[])
 
     argc -= optind;
     argv += optind;
-    if (argc) {
+    if (argc || ((count || use_kpi) && !interval_ms)) {
         printf("Error: Invalid Input\n");
         print_apcmd_uap_stats();
         return;
     }
 
-    /**  Command Header */
-    buf_len += sizeof(APCMDBUF_SNMP_MIB);
-
-    for (i = 0; i < no_of_oids; i++) {
-        /** 
-         * size of Oid + Oid_value + Oid_size 
-         */
-        buf_len += snmp_oids[i].len + sizeof(TLVBUF_HEADER);
+    if (interval_ms) {
+        if (uapd_allowed("uap_stats --interval") != UAP_SUCCESS)
+            return;
+        uap_stats_watch(dev, interval_ms, count, use_kpi ? &kpi : NULL);
+        return;
     }
-    buf = (u8 *) malloc(buf_len);
-    if (!buf) {
-        printf("ERR:Cannot allocate buffer from command!\n");
+    ret = uap_get_stats(dev, &stats);
+    if (ret != UAP_OK) {
+        print_lib_error(ret, "Command Response incorrect!");
         return;
     }
-    bzero((char *) buf, buf_len);
+    for (i = 0; i < STATS_FIELDS; i++)
+        printf("%s: %u\n", stats_fields[i].name, STATS_FIELD(&stats, i));
+}
 
-    /* Locate Headers */
-    cmd_buf = (APCMDBUF_SNMP_MIB *) buf;
-    cmd_buf->Size = buf_len - BUF_HEADER_SIZE;
-    cmd_buf->Result = 0;
-    cmd_buf->SeqNum = 0;
-    cmd_buf->CmdCode = HostCmd_SNMP_MIB;
-    cmd_buf->Action = uap_cpu_to_le16(ACTION_GET);
-
-    tlv = (TLVBUF_HEADER *) ((u8 *) cmd_buf + sizeof(APCMDBUF_SNMP_MIB));
-    /* Add oid, oid_size and oid_value for each OID */
-    for (i = 0; i < no_of_oids; i++) {
-        /** Copy Index as Oid */
-        tlv->Type = uap_cpu_to_le16(snmp_oids[i].type);
-        /** Copy its size */
-        tlv->Len = uap_cpu_to_le16(snmp_oids[i].len);
-        /** Next TLV */
-        tlv = (TLVBUF_HEADER *) & (tlv->Data[snmp_oids[i].len]);
-    }
-    cmd_len = buf_len;
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, buf_len);
-    if (ret == UAP_SUCCESS) {
-        if (cmd_buf->Result == CMD_SUCCESS) {
-            tlv =
-                (TLVBUF_HEADER *) ((u8 *) cmd_buf + sizeof(APCMDBUF_SNMP_MIB));
-
-            size =
-                cmd_buf->Size - (sizeof(APCMDBUF_SNMP_MIB) - BUF_HEADER_SIZE);
-
-            while (size >= sizeof(TLVBUF_HEADER)) {
-                tlv->Type = uap_le16_to_cpu(tlv->Type);
-                for (i = 0; i < no_of_oids; i++) {
-                    if (snmp_oids[i].type == tlv->Type) {
-                        printf("%s: ", snmp_oids[i].name);
-                        break;
-                    }
-                }
-                oid_size = uap_le16_to_cpu(tlv->Len);
-                switch (oid_size) {
-                case 1:
-                    printf("%d", (unsigned int) tlv->Data[0]);
-                    break;
-                case 2:
-                    printf("%d",
-                           (unsigned int) uap_le16_to_cpu(*(u16 *) tlv->Data));
-                    break;
-                case 4:
-                    printf("%ld",
-                           (unsigned long) uap_le32_to_cpu(*(u32 *) tlv->Data));
-                    break;
-                default:
-                    for (j = 0; j < oid_size; j++) {
-                        printf("%d ", (u8) tlv->Data[i]);
-                    }
-                    break;
-                }
-                /** Next TLV */
-                tlv = (TLVBUF_HEADER *) & (tlv->Data[oid_size]);
-                size -= (sizeof(TLVBUF_HEADER) + oid_size);
-                size = (size > 0) ? size : 0;
-                printf("\n");
-            }
+/** Default number of records of a shm_publish ring */
+#define SHM_DEFAULT_SLOTS       64
+/** Default shm_publish interval in ms */
+#define SHM_DEFAULT_INTERVAL    1000
 
-        } else {
-            printf("ERR:Command Response incorrect!\n");
-        }
-    } else {
-        printf("ERR:Command sending failed!\n");
-    }
-    free(buf);
+/**
+ *  @brief Show usage information for the shm_publish command
+ *
+ *  $return         N/A
+ */
+void
+print_apcmd_shm_publish(void)
+{
+    printf("Usage: shm_publish [--interval <ms>] [--count <N>]"
+           " [--slots <n>] [name]\n");
+    printf("\nPolls the station list and the 802.11 counters every <ms>\n"
+           "(default %d) and publishes them as timestamped records in the\n"
+           "shared-memory ring <name> (default /uaputl.<interface>), N\n"
+           "records or until interrupted.  The ring keeps the last <n>\n"
+           "records (default %d), any number of local readers read them\n"
+           "with uap_shm_open() without sending requests.  A ring of the\n"
+           "same name is replaced unless its publisher is still running.\n",
+           SHM_DEFAULT_INTERVAL, SHM_DEFAULT_SLOTS);
 }
 
+/** Options of the shm_publish command */
+static struct option shm_publish_options[] = {
+    {"help", 0, NULL, 'h'},
+    {"interval", 1, NULL, 'i'},
+    {"count", 1, NULL, 'c'},
+    {"slots", 1, NULL, 's'},
+    {NULL, 0, NULL, '\0'}
+};
+
 /**
- *  @brief parser for sys_cfg_80211d input 
+ *  @brief Publishes the stations and counters to a shared-memory ring
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
- *  @param output   stores indexes for "state, country"
- *                  arguments
  *
  *  @return         NA
- *
  */
 void
-parse_input_80211d(int argc, char **argv, int output[2][2])
+apcmd_shm_publish(uap_dev * dev, int argc, char *argv[])
 {
-    int i, j, k = 0;
-    char *keywords[2] = { "state", "country" };
-
+    uap_sta_info sta[UAP_SHM_MAX_STA];
+    uap_stats_info stats;
+    struct sigaction sa, old_sa;
+    struct timespec next;
+    char name[IFNAMSIZ + 16];
+    uap_shm *shm;
+    long interval_ms = SHM_DEFAULT_INTERVAL, count = 0, slots, n;
+    char *end;
+    int opt, ret, sta_count;
+
+    slots = SHM_DEFAULT_SLOTS;
+    while ((opt = getopt_long(argc, argv, "+hi:c:s:", shm_publish_options,
+                              NULL)) != -1) {
+        switch (opt) {
+        case 'i':
+            interval_ms = strtol(optarg, &end, 10);
+            if (*end || interval_ms <= 0) {
+                printf("ERR:Invalid interval %s\n", optarg);
+                return;
+            }
+            break;
+        case 'c':
+            count = strtol(optarg, &end, 10);
+            if (*end || count <= 0) {
+                printf("ERR:Invalid count %s\n", optarg);
+                return;
+            }
+            break;
+        case 's':
+            slots = strtol(optarg, &end, 10);
+            if (*end || slots < 2 || slots > 65536) {
+                printf("ERR:Invalid slots %s, expected 2 to 65536\n",
+                       optarg);
+                return;
+            }
+            break;
+        default:
+            print_apcmd_shm_publish();
+            return;
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (argc > 1 || (argc && argv[0][0] != '/')) {
+        printf("Error: Invalid Input\n");
+        print_apcmd_shm_publish();
+        return;
+    }
+    if (uapd_allowed("shm_publish") != UAP_SUCCESS)
+        return;
+    if (argc)
+        snprintf(name, sizeof(name), "%s", argv[0]);
+    else
+        snprintf(name, sizeof(name), "/uaputl.%s", dev_name);
+
+    ret = uap_shm_create(&shm, name, slots, interval_ms);
+    if (ret != UAP_OK) {
+        printf("ERR:Cannot create %s: %s\n", name, uap_strerror(ret));
+        return;
+    }
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = stats_sigint;
+    sigemptyset(&sa.sa_mask);
+    stats_stop = 0;
+    sigaction(SIGINT, &sa, &old_sa);
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (n = 0; !stats_stop && (!count || n < count); n++) {
+        if (n) {
+            next.tv_sec += interval_ms / 1000;
+            next.tv_nsec += (interval_ms % 1000) * 1000000;
+            if (next.tv_nsec >= 1000000000) {
+                next.tv_sec++;
+                next.tv_nsec -= 1000000000;
+            }
+            while (!stats_stop &&
+                   clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next,
+                                   NULL) == EINTR) ;
+            if (stats_stop)
+                break;
+        }
+        ret = uap_get_sta_list(dev, sta, UAP_SHM_MAX_STA, &sta_count);
+        if (ret == UAP_OK)
+            ret = uap_get_stats(dev, &stats);
+        if (ret != UAP_OK) {
+            print_lib_error(ret, "Command Response incorrect!");
+            break;
+        }
+        uap_shm_publish(shm, &stats, sta, sta_count);
+    }
+    sigaction(SIGINT, &old_sa, NULL);
+    uap_shm_close(shm);
+    printf("Published %ld records to %s\n", n, name);
+}
+
+/**
+ *  @brief Show usage information for the shm_read command
+ *
+ *  $return         N/A
+ */
+void
+print_apcmd_shm_read(void)
+{
+    printf("Usage: shm_read [--follow] [name]\n");
+    printf("\nPrints the newest record of the shared-memory ring <name>\n"
+           "(default /uaputl.<interface>) written by shm_publish.  With\n"
+           "--follow, prints every new record until interrupted.\n");
+}
+
+/** Options of the shm_read command */
+static struct option shm_read_options[] = {
+    {"help", 0, NULL, 'h'},
+    {"follow", 0, NULL, 'f'},
+    {NULL, 0, NULL, '\0'}
+};
+
+/**
+ *  @brief Prints one shared-memory ring record
+ *
+ *  @param n        Record number
+ *  @param rec      Record
+ *  @return         N/A
+ */
+static void
+shm_print_rec(unsigned long long n, uap_shm_rec * rec)
+{
+    unsigned int value;
+    const char *name;
+    time_t secs;
+    char when[32];
+    int i;
+
+    secs = rec->time_ns / 1000000000;
+    strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%S", localtime(&secs));
+    printf("Record %llu at %s.%03llu, %d stations\n", n, when,
+           rec->time_ns / 1000000 % 1000, rec->sta_total);
+    for (i = 0; i < rec->sta_count; i++)
+        printf("  %02x:%02x:%02x:%02x:%02x:%02x rssi %d dBm%s\n",
+               rec->sta[i].mac[0], rec->sta[i].mac[1], rec->sta[i].mac[2],
+               rec->sta[i].mac[3], rec->sta[i].mac[4], rec->sta[i].mac[5],
+               rec->sta[i].rssi, rec->sta[i].power_save ? ", power save" :
+               "");
+    for (i = 0; (name = stats_field(&rec->stats, i, &value)); i++)
+        printf("  %s: %u\n", name, value);
+}
+
+/**
+ *  @brief Reads records of a shared-memory ring
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param argc     Number of arguments
+ *  @param argv     Pointer to the arguments
+ *
+ *  @return         NA
+ */
+void
+apcmd_shm_read(uap_dev * dev, int argc, char *argv[])
+{
+    struct sigaction sa, old_sa;
+    struct timespec tick;
+    char name[IFNAMSIZ + 16];
+    uap_shm_rec rec;
+    uap_shm *shm;
+    unsigned long long n, head;
+    int opt, ret, follow = 0, interval_ms;
+
+    while ((opt = getopt_long(argc, argv, "+hf", shm_read_options,
+                              NULL)) != -1) {
+        switch (opt) {
+        case 'f':
+            follow = 1;
+            break;
+        default:
+            print_apcmd_shm_read();
+            return;
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (argc > 1 || (argc && argv[0][0] != '/')) {
+        printf("Error: Invalid Input\n");
+        print_apcmd_shm_read();
+        return;
+    }
+    if (follow && uapd_allowed("shm_read --follow") != UAP_SUCCESS)
+        return;
+    if (argc)
+        snprintf(name, sizeof(name), "%s", argv[0]);
+    else
+        snprintf(name, sizeof(name), "/uaputl.%s", dev_name);
+
+    ret = uap_shm_open(&shm, name);
+    if (ret != UAP_OK) {
+        printf("ERR:Cannot open %s: %s\n", name, uap_strerror(ret));
+        return;
+    }
+    if (!uap_shm_publisher(shm, &interval_ms))
+        printf("WARN:%s has no publisher\n", name);
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = stats_sigint;
+    sigemptyset(&sa.sa_mask);
+    stats_stop = 0;
+    sigaction(SIGINT, &sa, &old_sa);
+
+    /* Wait for new records at a tenth of the publishing interval */
+    tick.tv_sec = interval_ms / 10000;
+    tick.tv_nsec = interval_ms % 10000 * 100000;
+    n = uap_shm_head(shm);
+    if (!n && !follow)
+        printf("ERR:%s has no record yet\n", name);
+    while (n || follow) {
+        head = uap_shm_head(shm);
+        if (n && head - n >= uap_shm_slots(shm)) {
+            printf("WARN:Records %llu to %llu skipped\n", n, head - 1);
+            n = head;
+        }
+        for (; n && n <= head; n++) {
+            if (uap_shm_read(shm, n, &rec) == UAP_OK)
+                shm_print_rec(n, &rec);
+            else
+                printf("WARN:Record %llu overwritten\n", n);
+        }
+        fflush(stdout);
+        if (!follow || stats_stop)
+            break;
+        if (!n)
+            n = 1;
+        while (!stats_stop && uap_shm_head(shm) < n &&
+               uap_shm_publisher(shm, NULL))
+            nanosleep(&tick, NULL);
+        if (stats_stop || uap_shm_head(shm) < n)
+            break;
+    }
+    sigaction(SIGINT, &old_sa, NULL);
+    uap_shm_close(shm);
+}
+
+/**
+ *  @brief parser for sys_cfg_80211d input 
+ *
+ *  @param argc     Number of arguments
+ *  @param argv     Pointer to the arguments
+ *  @param output   stores indexes for "state, country"
+ *                  arguments
+ *
+ *  @return         NA
+ *
+ */
+void
+parse_input_80211d(int argc, char **argv, int output[2][2])
+{
+    int i, j, k = 0;
+    char *keywords[2] = { "state", "country" };
+
     for (i = 0; i < 2; i++)
         output[i][0] = -1;
 
@@ -3522,12 +3877,13 @@ parse_input_80211d(int argc, char **argv, int output[2][2])
  *  
  *  State 0 or 1
  *  
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_cfg_80211d(int argc, char *argv[])
+apcmd_cfg_80211d(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_CFG_80211D *cmd_buf = NULL;
     IEEEtypes_SubbandSet_t *subband = NULL;
@@ -3627,8 +3983,9 @@ apcmd_cfg_80211d(int argc, char *argv[])
         /**
          * Update MIB only and return
          */
-        if (sg_snmp_mib(ACTION_SET, OID_80211D_ENABLE, sizeof(state), &state) ==
-            UAP_SUCCESS) {
+        if (sg_snmp_mib
+            (dev, ACTION_SET, OID_80211D_ENABLE, sizeof(state),
+             &state) == UAP_SUCCESS) {
             printf("802.11d %sd \n", state ? "enable" : "disable");
         }
         return;
@@ -3642,12 +3999,11 @@ apcmd_cfg_80211d(int argc, char *argv[])
         buf_len += MAX_SUB_BANDS * sizeof(IEEEtypes_SubbandSet_t);
     }
 
-    buf = (u8 *) malloc(buf_len);
+    buf = uap_cmd_buf_alloc(dev, buf_len);
     if (!buf) {
         printf("ERR:Cannot allocate buffer from command!\n");
         return;
     }
-    bzero((char *) buf, buf_len);
     /* Locate headers */
     cmd_buf = (APCMDBUF_CFG_80211D *) buf;
     cmd_len = argc ? buf_len :
@@ -3678,14 +4034,14 @@ apcmd_cfg_80211d(int argc, char *argv[])
     }
 
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, buf_len);
+    ret = uap_ioctl(dev, (u8 *) cmd_buf, &cmd_len, buf_len);
     if (ret == UAP_SUCCESS) {
         if (cmd_buf->Result == CMD_SUCCESS) {
             if (argc) {
                 printf("Set executed successfully\n");
                 if (sflag) {
                     if (sg_snmp_mib
-                        (ACTION_SET, OID_80211D_ENABLE, sizeof(state),
+                        (dev, ACTION_SET, OID_80211D_ENABLE, sizeof(state),
                          &state) == UAP_SUCCESS) {
                         printf("802.11d %sd \n", state ? "enable" : "disable");
                     }
@@ -3693,8 +4049,8 @@ apcmd_cfg_80211d(int argc, char *argv[])
             } else {
                 j = uap_le16_to_cpu(cmd_buf->Domain.Length);
                 if (sg_snmp_mib
-                    (ACTION_GET, OID_80211D_ENABLE, sizeof(state), &state)
-                    == UAP_SUCCESS) {
+                    (dev, ACTION_GET, OID_80211D_ENABLE, sizeof(state),
+                     &state) == UAP_SUCCESS) {
                     printf("State = %sd\n", state ? "enable" : "disable");
                 }
 
@@ -3727,7 +4083,7 @@ apcmd_cfg_80211d(int argc, char *argv[])
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    free(buf);
+    uap_cmd_buf_free(dev, buf);
     return;
 }
 
@@ -3736,12 +4092,13 @@ apcmd_cfg_80211d(int argc, char *argv[])
  *
  *  Usage: "Usage : sys_config [CONFIG_FILE]"
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         UAP_SUCCESS or UAP_FAILURE
  */
 void
-apcmd_sys_config(int argc, char *argv[])
+apcmd_sys_config(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_CONFIGURE *cmd_buf = NULL;
     u8 *buf = NULL;
@@ -3770,7 +4127,7 @@ apcmd_sys_config(int argc, char *argv[])
     }
     if (argc == 1) {
         /* Read profile and send command to firmware */
-        apcmd_sys_config_profile(argc, argv);
+        apcmd_sys_config_profile(dev, argc, argv);
         return;
     }
 
@@ -3778,13 +4135,12 @@ apcmd_sys_config(int argc, char *argv[])
     buf_len = MRVDRV_SIZE_OF_CMD_BUFFER;
 
     /* alloc buf for command */
-    buf = (u8 *) malloc(buf_len);
+    buf = uap_cmd_buf_alloc(dev, sizeof(APCMDBUF_SYS_CONFIGURE));
 
     if (!buf) {
         printf("ERR:Cannot allocate buffer from command!\n");
         return;
     }
-    bzero((char *) buf, buf_len);
 
     /* Locate headers */
     cmd_len = sizeof(APCMDBUF_SYS_CONFIGURE);
@@ -3797,14 +4153,14 @@ apcmd_sys_config(int argc, char *argv[])
     cmd_buf->Result = 0;
 
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, buf_len);
+    ret = uap_ioctl(dev, (u8 *) cmd_buf, &cmd_len, buf_len);
 
     /* Process response */
     if (ret == UAP_SUCCESS) {
         /* Verify response */
         if (cmd_buf->CmdCode != (APCMD_SYS_CONFIGURE | APCMD_RESP_CHECK)) {
             printf("ERR:Corrupted response!\n");
-            free(buf);
+            uap_cmd_buf_free(dev, buf);
             return;
         }
         /* Print response */
@@ -3814,28 +4170,29 @@ apcmd_sys_config(int argc, char *argv[])
                       cmd_buf->Size - sizeof(APCMDBUF_SYS_CONFIGURE) +
                       BUF_HEADER_SIZE);
             printf("\n802.11D setting:\n");
-            apcmd_cfg_80211d(1, argv_dummy);
+            apcmd_cfg_80211d(dev, 1, argv_dummy);
         } else {
             printf("ERR:Could not retrieve system configure\n");
         }
     } else {
         printf("ERR:Command sending failed!\n");
     }
-    free(buf);
+    uap_cmd_buf_free(dev, buf);
     memset(&pm, 0, sizeof(ps_mgmt));
-    send_power_mode_ioctl(&pm);
+    send_power_mode_ioctl(dev, &pm);
     return;
 }
 
 /** 
  *  @brief Send read/write command along with register details to the driver
+ *  @param dev      A pointer to uap_dev structure
  *  @param reg      reg type
  *  @param offset   pointer to register offset string
  *  @param strvalue pointer to value string
  *  @return         UAP_SUCCESS or UAP_FAILURE
  */
 int
-apcmd_regrdwr_process(int reg, s8 * offset, s8 * strvalue)
+apcmd_regrdwr_process(uap_dev * dev, int reg, s8 * offset, s8 * strvalue)
 {
     APCMDBUF_REG_RDWR *cmd_buf = NULL;
     u8 *buf = NULL;
@@ -3847,13 +4204,12 @@ apcmd_regrdwr_process(int reg, s8 * offset, s8 * strvalue)
     buf_len = sizeof(APCMDBUF_REG_RDWR);
 
     /* alloc buf for command */
-    buf = (u8 *) malloc(buf_len);
+    buf = uap_cmd_buf_alloc(dev, buf_len);
 
     if (!buf) {
         printf("ERR:Cannot allocate buffer from command!\n");
         return UAP_FAILURE;
     }
-    bzero((char *) buf, buf_len);
 
     /* Locate headers */
     cmd_len = sizeof(APCMDBUF_REG_RDWR);
@@ -3879,7 +4235,7 @@ apcmd_regrdwr_process(int reg, s8 * offset, s8 * strvalue)
         break;
     default:
         printf("Invalid register set specified.\n");
-        free(buf);
+        uap_cmd_buf_free(dev, buf);
         return UAP_FAILURE;
     }
     if (strvalue) {
@@ -3896,7 +4252,7 @@ apcmd_regrdwr_process(int reg, s8 * offset, s8 * strvalue)
     }
 
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, buf_len);
+    ret = uap_ioctl(dev, (u8 *) cmd_buf, &cmd_len, buf_len);
 
     /* Process response */
     if (ret == UAP_SUCCESS) {
@@ -3907,16 +4263,16 @@ apcmd_regrdwr_process(int reg, s8 * offset, s8 * strvalue)
                    uap_le32_to_cpu(cmd_buf->Value));
         } else {
             printf("ERR:Command sending failed!\n");
-            free(buf);
+            uap_cmd_buf_free(dev, buf);
             return UAP_FAILURE;
         }
     } else {
         printf("ERR:Command sending failed!\n");
-        free(buf);
+        uap_cmd_buf_free(dev, buf);
         return UAP_FAILURE;
     }
 
-    free(buf);
+    uap_cmd_buf_free(dev, buf);
     return UAP_SUCCESS;
 }
 
@@ -3925,12 +4281,13 @@ apcmd_regrdwr_process(int reg, s8 * offset, s8 * strvalue)
  *
  *  Usage: "Usage : rdeeprom <offset> <byteCount>"
  *
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_read_eeprom(int argc, char *argv[])
+apcmd_read_eeprom(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_EEPROM_ACCESS *cmd_buf = NULL;
     u8 *buf = NULL;
@@ -3958,12 +4315,11 @@ apcmd_read_eeprom(int argc, char *argv[])
     byteCount = A2HEXDECIMAL(argv[1]);
 
     buf_len = sizeof(APCMDBUF_EEPROM_ACCESS) + MAX_EEPROM_LEN;
-    buf = (u8 *) malloc(buf_len);
+    buf = uap_cmd_buf_alloc(dev, buf_len);
     if (!buf) {
         printf("ERR:Cannot allocate buffer from command!\n");
         return;
     }
-    bzero((char *) buf, buf_len);
 
     /* Locate headers */
     cmd_buf = (APCMDBUF_EEPROM_ACCESS *) buf;
@@ -3979,7 +4335,7 @@ apcmd_read_eeprom(int argc, char *argv[])
     cmd_buf->ByteCount = uap_cpu_to_le16(byteCount);
 
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, buf_len);
+    ret = uap_ioctl(dev, (u8 *) cmd_buf, &cmd_len, buf_len);
 
     /* Process response */
     if (ret == UAP_SUCCESS) {
@@ -3995,7 +4351,7 @@ apcmd_read_eeprom(int argc, char *argv[])
         printf("ERR:Command sending failed!\n");
     }
 
-    free(buf);
+    uap_cmd_buf_free(dev, buf);
     return;
 }
 
@@ -4019,12 +4375,13 @@ print_regrdwr_usage(void)
 
 /** 
  *  @brief Provides interface to perform read/write operations on regsiters
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_regrdwr(int argc, char *argv[])
+apcmd_regrdwr(uap_dev * dev, int argc, char *argv[])
 {
     int opt;
     s32 reg;
@@ -4051,7 +4408,7 @@ apcmd_regrdwr(int argc, char *argv[])
         return;
     }
     reg = atoi(argv[0]);
-    apcmd_regrdwr_process(reg, argv[1], argc > 2 ? argv[2] : NULL);
+    apcmd_regrdwr_process(dev, reg, argv[1], argc > 2 ? argv[2] : NULL);
     return;
 }
 
@@ -4073,12 +4430,13 @@ print_memaccess_usage(void)
 
 /** 
  *  @brief Provides interface to perform read/write memory location
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_memaccess(int argc, char *argv[])
+apcmd_memaccess(uap_dev * dev, int argc, char *argv[])
 {
     int opt;
     APCMDBUF_MEM_ACCESS *cmd_buf = NULL;
@@ -4113,13 +4471,12 @@ apcmd_memaccess(int argc, char *argv[])
     buf_len = sizeof(APCMDBUF_MEM_ACCESS);
 
     /* alloc buf for command */
-    buf = (u8 *) malloc(buf_len);
+    buf = uap_cmd_buf_alloc(dev, buf_len);
 
     if (!buf) {
         printf("ERR:Cannot allocate buffer from command!\n");
         return;
     }
-    bzero((char *) buf, buf_len);
     /* Locate headers */
     cmd_len = sizeof(APCMDBUF_MEM_ACCESS);
     cmd_buf = (APCMDBUF_MEM_ACCESS *) buf;
@@ -4145,7 +4502,7 @@ apcmd_memaccess(int argc, char *argv[])
     }
 
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, buf_len);
+    ret = uap_ioctl(dev, (u8 *) cmd_buf, &cmd_len, buf_len);
 
     /* Process response */
     if (ret == UAP_SUCCESS) {
@@ -4156,15 +4513,15 @@ apcmd_memaccess(int argc, char *argv[])
                    uap_le32_to_cpu(cmd_buf->Value));
         } else {
             printf("ERR:Command sending failed!\n");
-            free(buf);
+            uap_cmd_buf_free(dev, buf);
             return;
         }
     } else {
         printf("ERR:Command sending failed!\n");
-        free(buf);
+        uap_cmd_buf_free(dev, buf);
         return;
     }
-    free(buf);
+    uap_cmd_buf_free(dev, buf);
     return;
 }
 
@@ -4189,12 +4546,13 @@ print_sys_debug_usage(void)
 
 /** 
  *  @brief Creates a sys_debug request and sends to the driver
+ *  @param dev      A pointer to uap_dev structure
  *  @param argc     Number of arguments
  *  @param argv     Pointer to the arguments
  *  @return         N/A
  */
 void
-apcmd_sys_debug(int argc, char *argv[])
+apcmd_sys_debug(uap_dev * dev, int argc, char *argv[])
 {
     APCMDBUF_SYS_DEBUG *cmd_buf = NULL;
     u8 *buffer = NULL;
@@ -4238,12 +4596,11 @@ apcmd_sys_debug(int argc, char *argv[])
     }
 
     /* Initialize the command buffer */
-    buffer = (u8 *) malloc(buf_len);
+    buffer = uap_cmd_buf_alloc(dev, buf_len);
     if (!buffer) {
         printf("ERR:Cannot allocate buffer for command!\n");
         return;
     }
-    bzero((char *) buffer, buf_len);
 
     /* Locate headers */
     cmd_buf = (APCMDBUF_SYS_DEBUG *) buffer;
@@ -4276,14 +4633,14 @@ apcmd_sys_debug(int argc, char *argv[])
     cmd_buf->subcmd = uap_cpu_to_le32(cmd_buf->subcmd);
 
     /* Send the command */
-    ret = uap_ioctl((u8 *) cmd_buf, &cmd_len, buf_len);
+    ret = uap_ioctl(dev, (u8 *) cmd_buf, &cmd_len, buf_len);
 
     /* Process response */
     if (ret == UAP_SUCCESS) {
         /* Verify response */
         if (cmd_buf->CmdCode != (APCMD_SYS_DEBUG | APCMD_RESP_CHECK)) {
             printf("ERR:Corrupted response! CmdCode=%x\n", cmd_buf->CmdCode);
-            free(buffer);
+            uap_cmd_buf_free(dev, buffer);
             return;
         }
         /* Print response */
@@ -4296,7 +4653,7 @@ apcmd_sys_debug(int argc, char *argv[])
                     printf
                         ("ERR: Invalid command response size, cmd_buf->Size = %x\n",
                          cmd_buf->Size);
-                    free(buffer);
+                    uap_cmd_buf_free(dev, buffer);
                     return;
                 }
                 for (i = 0; i < cmd_buf->debugConfig.cs_entry.numChannels; i++) {
@@ -4343,7 +4700,7 @@ apcmd_sys_debug(int argc, char *argv[])
         printf("ERR:Command sending failed!\n");
     }
     if (buffer)
-        free(buffer);
+        uap_cmd_buf_free(dev, buffer);
     return;
 }
 
@@ -4353,7 +4710,7 @@ typedef struct
     /** command name */
     char *cmd;
     /** command function pointer */
-    void (*func) (int argc, char *argv[]);
+    void (*func) (uap_dev * dev, int argc, char *argv[]);
     /**command usuage */
     char *help;
 } command_table;
@@ -4416,6 +4773,12 @@ static command_table ap_command[] = {
     {"sys_cfg_custom_ie", apcmd_sys_cfg_custom_ie,
      "\tSet/get custom IE configuration"},
     {"sta_filter_table", apcmd_sta_filter_table, "Set/get uAP mac filter"},
+    {"sys_cfg_get", apcmd_sys_cfg_get,
+     "\tGet several sys_cfg parameters with one command"},
+    {"sys_cfg_begin", apcmd_sys_cfg_begin, "\tStart a sys_cfg batch"},
+    {"sys_cfg_commit", apcmd_sys_cfg_commit,
+     "\tSend the sys_cfg batch in as few commands as fit"},
+    {"sys_cfg_abort", apcmd_sys_cfg_abort, "\tDiscard the sys_cfg batch"},
     {"regrdwr", apcmd_regrdwr, "\t\tRead/Write register command"},
     {"memaccess", apcmd_memaccess, "\tRead/Write to a memory address command"},
     {"rdeeprom", apcmd_read_eeprom, "\tRead EEPROM "},
@@ -4424,8 +4787,17 @@ static command_table ap_command[] = {
     {"sys_debug", apcmd_sys_debug, "\tSet/Get debug parameter"},
     {"sys_cfg_80211d", apcmd_cfg_80211d, "\tSet/Get 802.11D info"},
     {"uap_stats", apcmd_uap_stats, "\tGet uAP stats"},
+    {"snmp_get", apcmd_snmp_get, "\tGet SNMP MIB OIDs in a batch"},
+    {"snmp_set", apcmd_snmp_set, "\tSet SNMP MIB OIDs in a batch"},
+    {"shm_publish", apcmd_shm_publish, "\tPublish AP counters to /dev/shm"},
+    {"shm_read", apcmd_shm_read, "\tRead a shared-memory counter ring"},
+    {"tslog_record", apcmd_tslog_record, "\tRecord AP counters to a log file"},
+    {"tslog_query", apcmd_tslog_query, "\tQuery a counter log file"},
     {"powermode", apcmd_power_mode, "\tSet/get uAP power mode"},
+    {"snapshot", apcmd_snapshot, "\tCapture all AP state in one record"},
     {"coex_config", apcmd_coex_config, "\tSet/get uAP BT coex configuration"},
+    {"trace_stats", apcmd_trace_stats, "\tSummarize a host command trace"},
+    {"timing", apcmd_timing, "\t\tShow/reset host command latencies"},
     {NULL, NULL, 0}
 };
 
@@ -4440,11 +4812,39 @@ print_tool_usage(void)
     int i;
     printf("uaputl.exe - uAP utility ver %s\n", UAP_VERSION);
     printf("Usage:\n"
-           "\tuaputl.exe [options] <command> [command parameters]\n");
+           "\tuaputl.exe [options] <command> [command parameters]\n"
+           "\tuaputl.exe [options] -f <script>\n"
+           "\tuaputl.exe [options] -D <socket>\n"
+           "\tuaputl.exe [options] -M <[host:]port|unix:path>\n");
     printf("Options:\n"
            "\t--help\tDisplay help\n"
            "\t-v\tDisplay version\n"
-           "\t-i <interface>\n" "\t-d <debug_level=0|1|2>\n");
+           "\t-i <interface[,interface...]> Interfaces or patterns such as\n"
+           "\t             uap*, several are served in parallel\n"
+           "\t-j <jobs>    Maximum number of interfaces served at a time\n"
+           "\t-d <debug_level=0|1|2>\n"
+           "\t-t <transport=ioctl|replay:<trace>|\n"
+           "\t     sim[:stations[:latency_us[:busy_pct[:noseq]]]]>\n"
+           "\t             noseq: responses do not echo SeqNum\n"
+           "\t-r <trace> Record host commands to a trace file\n"
+           "\t-f <script|-> Run the commands of a script (or stdin)\n"
+           "\t-D <socket> Serve the commands on a UNIX socket\n"
+           "\t-M, --metrics <[host:]port|unix:path> Serve the statistics\n"
+           "\t             in OpenMetrics format over HTTP, host defaults\n"
+           "\t             to %s\n"
+           "\t-C, --metrics-cache <ms> Time one firmware snapshot serves\n"
+           "\t             the scrapes, default %d\n"
+           "\t-T, --timing Print host command latencies on exit (always\n"
+           "\t             done with -f and -D)\n"
+           "\t-w, --timeout <[command=]ms> Deadline of a host command, of\n"
+           "\t             every command when no name or code is given\n"
+           "\t-R, --retry <retries[:backoff_ms[:timeouts]]> Retries of\n"
+           "\t             EBUSY and EAGAIN, default %d:%d. Commands past\n"
+           "\t             their deadline are only retried with\n"
+           "\t             \":timeouts\", as they may have reached the\n"
+           "\t             firmware and run twice\n",
+           UAPEXP_DEFAULT_HOST, UAPEXP_DEFAULT_CACHE_MS,
+           UAP_DEFAULT_RETRIES, UAP_DEFAULT_BACKOFF_MS);
     printf("Commands:\n");
     for (i = 0; ap_command[i].cmd; i++)
         printf("\t%-4s\t\t%s\n", ap_command[i].cmd, ap_command[i].help);
@@ -4462,9 +4862,417 @@ static struct option ap_options[] = {
     {"interface", 1, NULL, 'i'},
     {"debug", 1, NULL, 'd'},
     {"version", 0, NULL, 'v'},
+    {"transport", 1, NULL, 't'},
+    {"record", 1, NULL, 'r'},
+    {"file", 1, NULL, 'f'},
+    {"daemon", 1, NULL, 'D'},
+    {"timing", 0, NULL, 'T'},
+    {"jobs", 1, NULL, 'j'},
+    {"timeout", 1, NULL, 'w'},
+    {"retry", 1, NULL, 'R'},
+    {"metrics", 1, NULL, 'M'},
+    {"metrics-cache", 1, NULL, 'C'},
     {NULL, 0, NULL, '\0'}
 };
 
+/**
+ *  @brief qsort callback for latencies
+ *
+ *  @param a        First latency
+ *  @param b        Second latency
+ *  @return         <0, 0 or >0
+ */
+static int
+lat_cmp(const void *a, const void *b)
+{
+    u32 x = *(u32 *) a, y = *(u32 *) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ *  @brief Prints usage information of trace_stats
+ *
+ *  @return         N/A
+ */
+static void
+print_trace_stats_usage(void)
+{
+    printf("\nUsage : trace_stats <TRACE_FILE>\n");
+    printf("\nPrints per command latency percentiles of a trace recorded");
+    printf("\nwith 'uaputl -r <TRACE_FILE> ...'.\n");
+}
+
+/**
+ *  @brief Summarizes per command latency percentiles of a trace
+ *
+ *  Usage: "trace_stats <TRACE_FILE>"
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param argc     Number of arguments
+ *  @param argv     Pointer to the arguments
+ *  @return         N/A
+ */
+void
+apcmd_trace_stats(uap_dev * dev, int argc, char *argv[])
+{
+    trace_summary sum[TRACE_MAX_CMDS];
+    trace_summary *s;
+    trace_rec rec;
+    u8 *data;
+    long len, off;
+    int opt, i, n = 0, records = 0;
+    u64 first_ns = 0, last_ns = 0;
+    char code[8];
+    char *name;
+
+    while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
+        switch (opt) {
+        default:
+            print_trace_stats_usage();
+            return;
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (argc != 1) {
+        printf("ERR:Incorrect number of arguments.\n");
+        print_trace_stats_usage();
+        return;
+    }
+    data = uap_trace_load(dev, argv[0], &len);
+    if (!data)
+        return;
+
+    memset(sum, 0, sizeof(sum));
+    for (off = UAP_TRACE_HDR_LEN; off < len;) {
+        off = uap_trace_decode(data, len, off, &rec);
+        if (off < 0) {
+            printf("WARN:Trace truncated after %d records\n", records);
+            break;
+        }
+        if (!records++)
+            first_ns = rec.start_ns;
+        last_ns = rec.start_ns + rec.latency_ns;
+        for (i = 0; i < n; i++) {
+            if (sum[i].type == rec.type && sum[i].cmd_code == rec.cmd_code)
+                break;
+        }
+        if (i == n) {
+            if (n == TRACE_MAX_CMDS)
+                continue;
+            sum[n].type = rec.type;
+            sum[n].cmd_code = rec.cmd_code;
+            n++;
+        }
+        s = &sum[i];
+        if (rec.status != UAP_SUCCESS) {
+            s->errors++;
+            continue;
+        }
+        if (s->count == s->size) {
+            s->size = s->size ? s->size * 2 : 64;
+            s->lat = (u32 *) realloc(s->lat, s->size * sizeof(u32));
+            if (!s->lat) {
+                printf("ERR:Cannot allocate latency samples!\n");
+                goto done;
+            }
+        }
+        s->lat[s->count++] = rec.latency_ns;
+    }
+
+    printf("%d records, %.3f ms\n", records,
+           records ? (last_ns - first_ns) / 1e6 : 0.0);
+    printf("%-20s %7s %6s %9s %9s %9s %9s %9s\n", "Command", "Count",
+           "Errors", "Min(us)", "P50(us)", "P90(us)", "P99(us)", "Max(us)");
+    for (i = 0; i < n; i++) {
+        s = &sum[i];
+        name = (s->type == UAP_TRACE_POWER_MODE) ? "POWER_MODE" :
+            uap_cmd_name(s->cmd_code);
+        if (!name) {
+            snprintf(code, sizeof(code), "0x%04x", s->cmd_code);
+            name = code;
+        }
+        printf("%-20s %7lu %6lu", name, s->count, s->errors);
+        if (s->count) {
+            qsort(s->lat, s->count, sizeof(u32), lat_cmp);
+            /* Nearest rank percentiles */
+            printf(" %9.1f %9.1f %9.1f %9.1f %9.1f", s->lat[0] / 1e3,
+                   s->lat[(s->count * 50 + 99) / 100 - 1] / 1e3,
+                   s->lat[(s->count * 90 + 99) / 100 - 1] / 1e3,
+                   s->lat[(s->count * 99 + 99) / 100 - 1] / 1e3,
+                   s->lat[s->count - 1] / 1e3);
+        }
+        printf("\n");
+    }
+  done:
+    for (i = 0; i < n; i++)
+        free(sum[i].lat);
+    free(data);
+}
+
+/**
+ *  @brief Prints usage information of timing
+ *
+ *  @return         N/A
+ */
+static void
+print_timing_usage(void)
+{
+    printf("\nUsage : timing [reset]\n");
+    printf("\nPrints the round trip latency of each host command sent so far");
+    printf("\nin this batch or daemon, or clears it with 'reset'.\n");
+}
+
+/**
+ *  @brief Prints or clears the host command latencies of the handle
+ *
+ *  Usage: "timing [reset]"
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param argc     Number of arguments
+ *  @param argv     Pointer to the arguments
+ *  @return         N/A
+ */
+void
+apcmd_timing(uap_dev * dev, int argc, char *argv[])
+{
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "+", cmd_options, NULL)) != -1) {
+        switch (opt) {
+        default:
+            print_timing_usage();
+            return;
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (argc > 1 || (argc == 1 && strcmp(argv[0], "reset"))) {
+        printf("ERR:Invalid arguments.\n");
+        print_timing_usage();
+        return;
+    }
+    if (argc)
+        uap_timing_reset(dev);
+    else
+        uap_timing_print(dev);
+}
+
+/**
+ *  @brief Splits a command line into arguments
+ *
+ *  Arguments are separated by blanks and may be quoted with ' or ".
+ *  Text after '#' is a comment.
+ *
+ *  @param line     Command line, modified in place
+ *  @param args     Argument pointers
+ *  @param max_args Size of args
+ *  @return         Number of arguments, -1 if there are too many
+ */
+int
+split_command_line(char *line, char *args[], int max_args)
+{
+    char *src = line, *dst = line;
+    char quote;
+    int argc = 0;
+
+    while (*src) {
+        while (isspace(*src))
+            src++;
+        if (!*src || *src == '#')
+            break;
+        if (argc == max_args)
+            return -1;
+        args[argc++] = dst;
+        quote = 0;
+        while (*src && (quote || !isspace(*src))) {
+            if (!quote && (*src == '"' || *src == '\'')) {
+                quote = *src++;
+                continue;
+            }
+            if (quote && *src == quote) {
+                quote = 0;
+                src++;
+                continue;
+            }
+            *dst++ = *src++;
+        }
+        if (*src)
+            src++;
+        *dst++ = '\0';
+    }
+    return argc;
+}
+
+/**
+ *  @brief Looks up a command in the ap_command table
+ *
+ *  @param cmd      Command name
+ *  @return         Index in ap_command, or -1 if not found
+ */
+static int
+find_command(char *cmd)
+{
+    int i;
+
+    for (i = 0; ap_command[i].cmd; i++) {
+        if (!strcmp(ap_command[i].cmd, cmd))
+            return i;
+    }
+    return -1;
+}
+
+/**
+ *  @brief Passes command output on, counting the error lines
+ *
+ *  A line is an error when it starts with "ERR" or "Error:", the way
+ *  the command handlers report invalid arguments and failed requests.
+ *
+ *  @param cookie   A pointer to cmd_output structure
+ *  @param buf      Output bytes
+ *  @param size     Number of bytes
+ *  @return         Number of bytes written
+ */
+static ssize_t
+cmd_output_write(void *cookie, const char *buf, size_t size)
+{
+    cmd_output *co = (cmd_output *) cookie;
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        if (buf[i] == '\n') {
+            co->head_len = 0;
+            continue;
+        }
+        if (co->head_len < 0 ||
+            (!co->head_len && (buf[i] == ' ' || buf[i] == '\t')))
+            continue;
+        co->head[co->head_len++] = buf[i];
+        if ((co->head_len == 3 && !memcmp(co->head, "ERR", 3)) ||
+            (co->head_len == 6 && !memcmp(co->head, "Error:", 6))) {
+            co->errors++;
+            co->head_len = -1;
+        } else if (co->head_len == 6) {
+            co->head_len = -1;
+        }
+    }
+    return fwrite(buf, 1, size, co->out);
+}
+
+/**
+ *  @brief Runs one command of the ap_command table
+ *
+ *  The command output goes to stdout through a stream counting the
+ *  error messages, as handlers report invalid input only by printing.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param argc     Number of arguments
+ *  @param argv     Pointer to the arguments, argv[0] is the command
+ *  @return         UAP_SUCCESS, or UAP_FAILURE if the command is unknown,
+ *                  printed an error or a request sent by it failed
+ */
+int
+uap_run_command(uap_dev * dev, int argc, char *argv[])
+{
+    cookie_io_functions_t funcs = { NULL, cmd_output_write, NULL, NULL };
+    u32 errors = dev->err_count + dev->fw_err_count;
+    int i = find_command(argv[0]);
+    cmd_output co;
+    FILE *out, *scan;
+
+    if (i < 0) {
+        printf("ERR: %s is not supported\n", argv[0]);
+        return UAP_FAILURE;
+    }
+    memset(&co, 0, sizeof(co));
+    co.out = stdout;
+    out = stdout;
+    scan = fopencookie(&co, "w", funcs);
+    if (scan) {
+        /* Watch modes print as they go */
+        setvbuf(scan, NULL, _IOLBF, 0);
+        fflush(out);
+        stdout = scan;
+    }
+    optind = 0;
+    ap_command[i].func(dev, argc, argv);
+    if (scan) {
+        fclose(scan);
+        stdout = out;
+    }
+    if (co.errors || dev->err_count + dev->fw_err_count != errors)
+        return UAP_FAILURE;
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Runs the commands of a script over one device handle
+ *
+ *  Each non empty line is a command with its parameters, as given on
+ *  the uaputl command line. A status line is printed per command and a
+ *  timing summary at the end.
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param file     Script file name, "-" for stdin
+ *  @return         UAP_SUCCESS if every command succeeded, else UAP_FAILURE
+ */
+static int
+run_script(uap_dev * dev, char *file)
+{
+    FILE *fp;
+    char line[MAX_SCRIPT_LINE];
+    char *args[MAX_SCRIPT_ARGS];
+    char *name;
+    int li = 0, cmds = 0, failed = 0, argc, ret;
+    u32 host_cmds = dev->cmd_count;
+    u64 start_ns, cmd_ns, total_ns;
+
+    if (strcmp(file, "-")) {
+        fp = fopen(file, "r");
+        if (!fp) {
+            printf("ERR:Cannot open script %s\n", file);
+            return UAP_FAILURE;
+        }
+    } else {
+        fp = stdin;
+    }
+
+    script_stdin = (fp == stdin);
+    start_ns = uap_time_ns();
+    while (fgets(line, sizeof(line), fp)) {
+        li++;
+        argc = split_command_line(line, args, MAX_SCRIPT_ARGS);
+        if (!argc)
+            continue;
+        cmds++;
+        if (argc < 0) {
+            printf("line %d: ERR:Too many arguments\n", li);
+            failed++;
+            continue;
+        }
+        name = args[0];
+        cmd_ns = uap_time_ns();
+        ret = uap_run_command(dev, argc, args);
+        cmd_ns = uap_time_ns() - cmd_ns;
+        if (ret != UAP_SUCCESS)
+            failed++;
+        printf("line %d: %s %s, %.3f ms\n", li, name,
+               (ret == UAP_SUCCESS) ? "OK" : "FAILED", cmd_ns / 1e6);
+        if (fp == stdin)
+            fflush(stdout);
+    }
+    total_ns = uap_time_ns() - start_ns;
+    script_stdin = 0;
+    if (fp != stdin)
+        fclose(fp);
+
+    printf("Batch: %d commands, %d failed, %lu host commands, "
+           "%.3f ms total, %.3f ms/command\n", cmds, failed,
+           dev->cmd_count - host_cmds, total_ns / 1e6,
+           cmds ? total_ns / 1e6 / cmds : 0.0);
+    return failed ? UAP_FAILURE : UAP_SUCCESS;
+}
+
 /**
  *    @brief isdigit for String.
  *   
@@ -4897,6 +5705,99 @@ mac2raw(char *mac, u8 * raw)
     return UAP_SUCCESS;
 }
 
+/**
+ *  @brief Checks a MAC address and adds it to a list
+ *
+ *  The address is six pairs of hex digits in either case, separated
+ *  by ':' or '-'.
+ *
+ *  @param macs     List
+ *  @param str      MAC address string
+ *  @return         UAP_SUCCESS or UAP_FAILURE, printed
+ */
+int
+mac_list_add(mac_list * macs, char *str)
+{
+    char norm[2 * ETH_ALEN + ETH_ALEN];
+    u8 (*mac)[ETH_ALEN];
+    int ret, i;
+
+    if (macs->n == macs->size) {
+        mac = realloc(macs->mac, 2 * (macs->size + 8) * ETH_ALEN);
+        if (!mac) {
+            printf("ERR:Cannot allocate memory!\n");
+            return UAP_FAILURE;
+        }
+        macs->mac = mac;
+        macs->size = 2 * (macs->size + 8);
+    }
+    ret = UAP_FAILURE;
+    if (strlen(str) == sizeof(norm) - 1) {
+        for (i = 0; str[i]; i++) {
+            norm[i] = str[i] == '-' ? ':' : str[i];
+            if (i % 3 == 2 ? norm[i] != ':' : !isxdigit((u8) norm[i]))
+                break;
+        }
+        norm[i] = '\0';
+        if (!str[i])
+            ret = mac2raw(norm, macs->mac[macs->n]);
+    }
+    if (ret != UAP_SUCCESS) {
+        printf("ERR: %s Address %s\n", ret == UAP_FAILURE ? "Invalid MAC" :
+               ret == UAP_RET_MAC_BROADCAST ? "Broadcast" : "Multicast",
+               str);
+        return UAP_FAILURE;
+    }
+    macs->n++;
+    return UAP_SUCCESS;
+}
+
+/**
+ *  @brief Reads MAC addresses into a list, one per line
+ *
+ *  Blank lines and what follows a '#' are skipped.
+ *
+ *  @param macs     List
+ *  @param path     File, "-" for stdin, unless stdin carries the script
+ *                  or belongs to the daemon
+ *  @return         UAP_SUCCESS or UAP_FAILURE, printed
+ */
+int
+mac_list_read(mac_list * macs, char *path)
+{
+    char line[256], *p, *end;
+    FILE *fp;
+    int ret = UAP_SUCCESS;
+
+    if (!strcmp(path, "-")) {
+        if (script_stdin) {
+            printf("ERR:Cannot read MAC addresses from stdin, "
+                   "the script is read from it\n");
+            return UAP_FAILURE;
+        }
+        if (uapd_allowed("--file -") != UAP_SUCCESS)
+            return UAP_FAILURE;
+    }
+    fp = strcmp(path, "-") ? fopen(path, "r") : stdin;
+    if (!fp) {
+        printf("ERR:Cannot open %s: %s\n", path, strerror(errno));
+        return UAP_FAILURE;
+    }
+    while (ret == UAP_SUCCESS && fgets(line, sizeof(line), fp)) {
+        if ((p = strchr(line, '#')))
+            *p = '\0';
+        for (p = line; isspace((unsigned char) *p); p++) ;
+        for (end = p + strlen(p); end > p && isspace((unsigned char) end[-1]);
+             end--) ;
+        *end = '\0';
+        if (*p)
+            ret = mac_list_add(macs, p);
+    }
+    if (fp != stdin)
+        fclose(fp);
+    return ret;
+}
+
 /** 
  *  @brief Converts a string to hex value
  *
@@ -5403,102 +6304,336 @@ print_tlv(u8 * buf, u16 len)
 }
 
 /** 
- *  @brief Performs the ioctl operation to send the command to
- *  the driver.
+ *  @brief check cipher is valid or not
  *
- *  @param cmd        	 Pointer to the command buffer
- *  @param size          Pointer to the command size. This value is
- *                       overwritten by the function with the size of the
- *                       received response.
- *  @param buf_size 	 Size of the allocated command buffer
- *  @return              UAP_SUCCESS or UAP_FAILURE
+ *  @param pairwisecipher    pairwise cipher
+ *  @param groupcipher       group cipher
+ *  @return         UAP_SUCCESS or UAP_FAILURE
  */
 int
-uap_ioctl(u8 * cmd, u16 * size, u16 buf_size)
+is_cipher_valid(int pairwisecipher, int groupcipher)
 {
-    struct ifreq ifr;
-    APCMDBUF *header = NULL;
-    s32 sockfd;
+    if ((pairwisecipher == CIPHER_NONE) && (groupcipher == CIPHER_NONE))
+        return UAP_SUCCESS;
+    if ((pairwisecipher == CIPHER_TKIP) && (groupcipher == CIPHER_TKIP))
+        return UAP_SUCCESS;
+    if ((pairwisecipher == CIPHER_AES_CCMP) && (groupcipher == CIPHER_AES_CCMP))
+        return UAP_SUCCESS;
+    if ((pairwisecipher == CIPHER_BITMAP) && (groupcipher == CIPHER_TKIP))
+        return UAP_SUCCESS;
+    return UAP_FAILURE;
+}
 
-    if (buf_size < *size) {
-        printf("buf_size should not less than cmd buffer size\n");
-        return UAP_FAILURE;
+/**
+ *  @brief Expands the -i argument into interface names
+ *
+ *  The argument is a comma separated list of names and shell patterns.
+ *  Patterns are matched against /sys/class/net, in sorted order.
+ *
+ *  @param spec     -i argument, modified in place
+ *  @param names    Interface names
+ *  @param max      Size of names
+ *  @return         Number of interfaces, -1 on error
+ */
+static int
+expand_interfaces(char *spec, char names[][IFNAMSIZ + 1], int max)
+{
+    char path[sizeof(SYS_CLASS_NET) + IFNAMSIZ + 1];
+    char *tok, *save = NULL;
+    glob_t gl;
+    int n = 0, i, ret;
+
+    for (tok = strtok_r(spec, ",", &save); tok;
+         tok = strtok_r(NULL, ",", &save)) {
+        if (strlen(tok) >= IFNAMSIZ) {
+            printf("ERR:Interface name %s is too long\n", tok);
+            return -1;
+        }
+        if (!strpbrk(tok, "*?[")) {
+            if (n == max)
+                goto too_many;
+            strcpy(names[n++], tok);
+            continue;
+        }
+        snprintf(path, sizeof(path), SYS_CLASS_NET "%s", tok);
+        ret = glob(path, 0, NULL, &gl);
+        if (ret == GLOB_NOMATCH) {
+            printf("ERR:No interface matches %s\n", tok);
+            return -1;
+        }
+        if (ret) {
+            printf("ERR:Cannot list interfaces\n");
+            return -1;
+        }
+        for (i = 0; i < gl.gl_pathc; i++) {
+            if (n == max) {
+                globfree(&gl);
+                goto too_many;
+            }
+            snprintf(names[n++], IFNAMSIZ + 1, "%s",
+                     gl.gl_pathv[i] + strlen(SYS_CLASS_NET));
+        }
+        globfree(&gl);
     }
+    return n;
+  too_many:
+    printf("ERR:More than %d interfaces\n", max);
+    return -1;
+}
 
-    /* Open socket */
-    if ((sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
-        printf("ERR:Cannot open socket\n");
-        return UAP_FAILURE;
+/**
+ *  @brief Applies the -w and -R options to a handle
+ *
+ *  @param dev      A pointer to uap_dev structure
+ *  @param opts     Options
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+apply_request_policy(uap_dev * dev, run_opts * opts)
+{
+    char *arg, *eq, *end;
+    long ms, backoff;
+    int i, code;
+
+    for (i = 0; i < opts->timeout_num; i++) {
+        arg = opts->timeouts[i];
+        code = 0;
+        eq = strchr(arg, '=');
+        if (eq) {
+            *eq = '\0';
+            code = uap_cmd_code(arg);
+            *eq = '=';
+            if (code < 0) {
+                printf("ERR:Unknown command in timeout %s\n", arg);
+                return UAP_FAILURE;
+            }
+            arg = eq + 1;
+        }
+        ms = strtol(arg, &end, 10);
+        if (end == arg || *end || ms < 0 || ms > INT_MAX) {
+            printf("ERR:Invalid timeout %s\n", opts->timeouts[i]);
+            return UAP_FAILURE;
+        }
+        if (uap_set_timeout(dev, code, ms) != UAP_OK)
+            return UAP_FAILURE;
     }
-    *(u32 *) cmd = buf_size - BUF_HEADER_SIZE;
+    if (opts->retry) {
+        ms = strtol(opts->retry, &end, 10);
+        backoff = UAP_DEFAULT_BACKOFF_MS;
+        if (*end == ':')
+            backoff = strtol(end + 1, &end, 10);
+        if (!strcmp(end, ":timeouts")) {
+            end += strlen(end);
+            uap_set_retry_timeouts(dev, 1);
+        }
+        if (end == opts->retry || *end || ms > INT_MAX) {
+            printf("ERR:Invalid retry policy %s\n", opts->retry);
+            return UAP_FAILURE;
+        }
+        if (uap_set_retry(dev, ms, backoff) != UAP_OK)
+            return UAP_FAILURE;
+    }
+    return UAP_SUCCESS;
+}
 
-    /* Initialize the ifr structure */
-    memset(&ifr, 0, sizeof(ifr));
-    strncpy(ifr.ifr_ifrn.ifrn_name, dev_name, strlen(dev_name));
-    ifr.ifr_ifru.ifru_data = (void *) cmd;
-    header = (APCMDBUF *) cmd;
-    header->Size = *size - BUF_HEADER_SIZE;
-    if (header->CmdCode == APCMD_SYS_CONFIGURE) {
-        APCMDBUF_SYS_CONFIGURE *sys_cfg;
-        sys_cfg = (APCMDBUF_SYS_CONFIGURE *) cmd;
-        sys_cfg->Action = uap_cpu_to_le16(sys_cfg->Action);
+/**
+ *  @brief Runs the command, script or daemon of main() on one interface
+ *
+ *  @param opts     Options
+ *  @param argc     Number of arguments
+ *  @param argv     Command and parameters
+ *  @return         Exit status
+ */
+static int
+run_interface(run_opts * opts, int argc, char *argv[])
+{
+    int ret, sets;
+
+    if (uap_open(&uap_device, dev_name, opts->transport, UAP_OPEN_VERBOSE) !=
+        UAP_OK)
+        return 1;
+    uap_device->debug = debug_level;
+    if (apply_request_policy(uap_device, opts) != UAP_SUCCESS) {
+        uap_close(uap_device);
+        return 1;
     }
-    endian_convert_request_header(header);
-#if DEBUG
-    /* Dump request buffer */
-    hexdump("Request buffer", (void *) cmd, *size, ' ');
-#endif
-    /* Perform ioctl */
-    errno = 0;
-    if (ioctl(sockfd, UAPHOSTCMD, &ifr)) {
-        perror("");
-        printf("ERR:UAPHOSTCMD is not supported by %s\n", dev_name);
-        close(sockfd);
-        return UAP_FAILURE;
+    if (opts->record &&
+        (uap_trace_open(uap_device, opts->record) != UAP_SUCCESS)) {
+        uap_close(uap_device);
+        return 1;
     }
-    endian_convert_response_header(header);
-    header->CmdCode &= HostCmd_CMD_ID_MASK;
-    header->CmdCode |= APCMD_RESP_CHECK;
-    *size = header->Size;
 
-    /* Validate response size */
-    if (*size > (buf_size - BUF_HEADER_SIZE)) {
-        printf
-            ("ERR:Response size (%d) greater than buffer size (%d)! Aborting!\n",
-             *size, buf_size);
-        close(sockfd);
-        return UAP_FAILURE;
+    /* process command */
+    if (opts->socket_path) {
+        ret = uapd_run(uap_device, opts->socket_path);
+    } else if (opts->metrics) {
+        ret = uapexp_run(uap_device, opts->metrics, opts->metrics_cache_ms);
+    } else if (opts->script) {
+        ret = run_script(uap_device, opts->script);
+    } else {
+        ret = uap_run_command(uap_device, argc, argv);
+        /* A known command reports its own errors, exit status as before */
+        if (ret != UAP_SUCCESS && find_command(argv[0]) >= 0)
+            ret = UAP_SUCCESS;
     }
-#if DEBUG
-    /* Dump respond buffer */
-    hexdump("Respond buffer", (void *) header, header->Size + BUF_HEADER_SIZE,
-            ' ');
-#endif
+    sets = uap_cfg_abort(uap_device);
+    if (sets >= 0)
+        printf("WARN:sys_cfg batch of %d settings not committed\n", sets);
+    uap_printf(MSG_DEBUG, "DBG:%s: %lu host commands, %lu power mode, "
+               "%lu errors, %lu retries, %lu timeouts, %lu unpooled buffers, "
+               "%lu most in flight\n", uap_device->name,
+               uap_device->cmd_count, uap_device->pm_count,
+               uap_device->err_count, uap_device->retry_count,
+               uap_device->timeout_count, uap_device->cmd_pool_misses,
+               uap_device->inflight_peak);
+    if (opts->timing || opts->script || opts->socket_path || opts->metrics)
+        uap_timing_print(uap_device);
+    uap_close(uap_device);
+    return (ret == UAP_SUCCESS) ? 0 : 1;
+}
 
-    /* Close socket */
-    close(sockfd);
+/**
+ *  @brief Starts the worker process of one interface
+ *
+ *  @param job      Job of the interface
+ *  @param opts     Options
+ *  @param argc     Number of arguments
+ *  @param argv     Command and parameters
+ *  @return         UAP_SUCCESS or UAP_FAILURE
+ */
+static int
+fanout_start(fanout_job * job, run_opts * opts, int argc, char *argv[])
+{
+    char record[PATH_MAX];
+    int fds[2], status;
+
+    if (pipe(fds) < 0) {
+        perror("pipe");
+        return UAP_FAILURE;
+    }
+    fflush(stdout);
+    job->start_ns = uap_time_ns();
+    job->pid = fork();
+    if (job->pid < 0) {
+        perror("fork");
+        close(fds[0]);
+        close(fds[1]);
+        return UAP_FAILURE;
+    }
+    if (!job->pid) {
+        close(fds[0]);
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[1]);
+        strcpy(dev_name, job->name);
+        if (opts->record) {
+            /* One trace per interface */
+            snprintf(record, sizeof(record), "%s.%s", opts->record,
+                     job->name);
+            opts->record = record;
+        }
+        status = run_interface(opts, argc, argv);
+        fflush(stdout);
+        _exit(status);
+    }
+    close(fds[1]);
+    job->fd = fds[0];
+    job->out = open_memstream(&job->buf, &job->len);
     return UAP_SUCCESS;
 }
 
-/** 
- *  @brief check cipher is valid or not
+/**
+ *  @brief Runs the command on several interfaces in parallel
  *
- *  @param pairwisecipher    pairwise cipher
- *  @param groupcipher       group cipher
- *  @return         UAP_SUCCESS or UAP_FAILURE
+ *  Every interface is served by its own worker process, since command
+ *  handlers share getopt state and print to stdout.  At most jobs
+ *  workers run at a time.  The output of each interface is collected
+ *  and printed in interface order once all of them are done.
+ *
+ *  @param names    Interface names
+ *  @param n        Number of interfaces
+ *  @param jobs     Maximum number of concurrent workers
+ *  @param opts     Options
+ *  @param argc     Number of arguments
+ *  @param argv     Command and parameters
+ *  @return         0 if the command succeeded everywhere, else 1
  */
-int
-is_cipher_valid(int pairwisecipher, int groupcipher)
+static int
+fanout_run(char names[][IFNAMSIZ + 1], int n, int jobs, run_opts * opts,
+           int argc, char *argv[])
 {
-    if ((pairwisecipher == CIPHER_NONE) && (groupcipher == CIPHER_NONE))
-        return UAP_SUCCESS;
-    if ((pairwisecipher == CIPHER_TKIP) && (groupcipher == CIPHER_TKIP))
-        return UAP_SUCCESS;
-    if ((pairwisecipher == CIPHER_AES_CCMP) && (groupcipher == CIPHER_AES_CCMP))
-        return UAP_SUCCESS;
-    if ((pairwisecipher == CIPHER_BITMAP) && (groupcipher == CIPHER_TKIP))
-        return UAP_SUCCESS;
-    return UAP_FAILURE;
+    fanout_job job[MAX_FANOUT_IFACES];
+    struct pollfd pfd[MAX_FANOUT_IFACES];
+    int idx[MAX_FANOUT_IFACES];
+    char data[4096];
+    int i, next = 0, running = 0, failed = 0, npfd, status;
+    ssize_t len;
+    u64 start_ns = uap_time_ns();
+
+    memset(job, 0, sizeof(job));
+    for (i = 0; i < n; i++) {
+        job[i].name = names[i];
+        job[i].fd = -1;
+        job[i].status = -1;
+    }
+    while (next < n || running) {
+        while (next < n && running < jobs) {
+            if (fanout_start(&job[next], opts, argc, argv) == UAP_SUCCESS)
+                running++;
+            next++;
+        }
+        npfd = 0;
+        for (i = 0; i < n; i++) {
+            if (job[i].fd < 0)
+                continue;
+            pfd[npfd].fd = job[i].fd;
+            pfd[npfd].events = POLLIN;
+            idx[npfd++] = i;
+        }
+        if (!npfd)
+            break;
+        if (poll(pfd, npfd, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            break;
+        }
+        for (i = 0; i < npfd; i++) {
+            if (!pfd[i].revents)
+                continue;
+            len = read(pfd[i].fd, data, sizeof(data));
+            if (len < 0 && errno == EINTR)
+                continue;
+            if (len > 0) {
+                if (job[idx[i]].out)
+                    fwrite(data, 1, len, job[idx[i]].out);
+                continue;
+            }
+            /* Worker done */
+            close(pfd[i].fd);
+            job[idx[i]].fd = -1;
+            if (waitpid(job[idx[i]].pid, &status, 0) == job[idx[i]].pid &&
+                WIFEXITED(status))
+                job[idx[i]].status = WEXITSTATUS(status);
+            job[idx[i]].end_ns = uap_time_ns();
+            running--;
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        if (job[i].out)
+            fclose(job[i].out);
+        if (job[i].status)
+            failed++;
+        printf("=== %s: %s, %.3f ms ===\n", job[i].name,
+               job[i].status ? "FAILED" : "OK",
+               (job[i].end_ns - job[i].start_ns) / 1e6);
+        if (job[i].len)
+            fwrite(job[i].buf, 1, job[i].len, stdout);
+        free(job[i].buf);
+    }
+    printf("Fan-out: %d interfaces, %d failed, %d parallel, %.3f ms total\n",
+           n, failed, jobs, (uap_time_ns() - start_ns) / 1e6);
+    return failed ? 1 : 0;
 }
 
 /** 
@@ -5511,19 +6646,23 @@ is_cipher_valid(int pairwisecipher, int groupcipher)
 int
 main(int argc, char *argv[])
 {
-    int opt, i;
+    char names[MAX_FANOUT_IFACES][IFNAMSIZ + 1];
+    char *ifaces = NULL;
+    run_opts opts;
+    int opt, n, modes, jobs = 0;
+
+    memset(&opts, 0, sizeof(opts));
+    opts.metrics_cache_ms = UAPEXP_DEFAULT_CACHE_MS;
     memset(dev_name, 0, sizeof(dev_name));
     strcpy(dev_name, DEFAULT_DEV_NAME);
 
     /* parse arguments */
-    while ((opt = getopt_long(argc, argv, "+hi:d:v", ap_options, NULL)) != -1) {
+    while ((opt =
+            getopt_long(argc, argv, "+hi:d:vt:r:f:D:Tj:w:R:M:C:", ap_options,
+                        NULL)) != -1) {
         switch (opt) {
         case 'i':
-            if (strlen(optarg) < IFNAMSIZ) {
-                memset(dev_name, 0, sizeof(dev_name));
-                strncpy(dev_name, optarg, strlen(optarg));
-            }
-            printf("dev_name:%s\n", dev_name);
+            ifaces = optarg;
             break;
         case 'v':
             printf("uaputl.exe - uAP utility ver %s\n", UAP_VERSION);
@@ -5532,6 +6671,44 @@ main(int argc, char *argv[])
             debug_level = strtoul(optarg, NULL, 10);
             uap_printf(MSG_DEBUG, "debug_level=%x\n", debug_level);
             break;
+        case 't':
+            opts.transport = optarg;
+            break;
+        case 'r':
+            opts.record = optarg;
+            break;
+        case 'f':
+            opts.script = optarg;
+            break;
+        case 'D':
+            opts.socket_path = optarg;
+            break;
+        case 'M':
+            opts.metrics = optarg;
+            break;
+        case 'C':
+            opts.metrics_cache_ms = atol(optarg);
+            if (opts.metrics_cache_ms < 0) {
+                printf("ERR:Invalid metrics cache time %s\n", optarg);
+                exit(1);
+            }
+            break;
+        case 'T':
+            opts.timing = 1;
+            break;
+        case 'j':
+            jobs = atoi(optarg);
+            break;
+        case 'w':
+            if (opts.timeout_num == UAP_TIMEOUT_CMDS + 1) {
+                printf("ERR:Too many timeouts\n");
+                exit(1);
+            }
+            opts.timeouts[opts.timeout_num++] = optarg;
+            break;
+        case 'R':
+            opts.retry = optarg;
+            break;
         case 'h':
         default:
             print_tool_usage();
@@ -5543,23 +6720,29 @@ main(int argc, char *argv[])
     argv += optind;
     optind = 0;
 
-    if (argc < 1) {
+    /* A command, a script, the daemon or the exporter */
+    modes = !!opts.script + !!opts.socket_path + !!opts.metrics;
+    if (modes ? (argc || modes > 1) : (argc < 1)) {
         print_tool_usage();
         exit(1);
     }
 
-    /* process command */
-    for (i = 0; ap_command[i].cmd; i++) {
-        if (strncmp(ap_command[i].cmd, argv[0], strlen(ap_command[i].cmd)))
-            continue;
-        if (strlen(ap_command[i].cmd) != strlen(argv[0]))
-            continue;
-        ap_command[i].func(argc, argv);
-        break;
-    }
-    if (!ap_command[i].cmd) {
-        printf("ERR: %s is not supported\n", argv[0]);
+    if (!ifaces)
+        return run_interface(&opts, argc, argv);
+    n = expand_interfaces(ifaces, names, MAX_FANOUT_IFACES);
+    if (n < 1)
+        exit(1);
+    if (n == 1) {
+        strcpy(dev_name, names[0]);
+        printf("dev_name:%s\n", dev_name);
+        return run_interface(&opts, argc, argv);
+    }
+    if (opts.socket_path || opts.metrics ||
+        (opts.script && !strcmp(opts.script, "-"))) {
+        printf("ERR:-D, -M and -f - take a single interface\n");
         exit(1);
     }
-    return 0;
+    if (jobs < 1 || jobs > n)
+        jobs = n;
+    return fanout_run(names, n, jobs, &opts, argc, argv);
 }
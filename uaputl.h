@@ -26,6 +26,9 @@ Change log:
 #ifndef _UAP_H
 #define _UAP_H
 
+#include <pthread.h>
+#include "uaplib.h"
+
 #if (BYTE_ORDER == LITTLE_ENDIAN)
 #undef BIG_ENDIAN
 #endif
@@ -282,6 +285,9 @@ typedef signed long s32;
 /** Unsigned long integer */
 typedef unsigned long u32;
 
+/** Unsigned long long integer */
+typedef unsigned long long u64;
+
 /** Valid Input Commands */
 typedef enum
 {
@@ -318,6 +324,9 @@ typedef enum
 enum
 { MSG_NONE, MSG_DEBUG, MSG_ALL };
 
+/** Enable or disable debug outputs */
+#define DEBUG   1
+
 /** oids_table */
 typedef struct
 {
@@ -897,6 +906,9 @@ typedef PACK_START struct _tlvbuf_coex_stats
     u32 reserved[8];
 } PACK_END tlvbuf_coex_stats;
 
+/** Number of statistics in tlvbuf_coex_stats */
+#define COEX_STATS      7
+
 /** APCMD buffer : BT Coex API extension */
 typedef PACK_START struct _apcmdbuf_coex_config
 {
@@ -1239,6 +1251,8 @@ typedef struct _inact_sleep_param
 #define PS_MODE_PERIODIC_DTIM                1
 /** Enable inactivity ps */
 #define PS_MODE_INACTIVITY                   2
+/** Number of power modes */
+#define POWER_MODES                          3
 
 /** sleep parameter */
 #define SLEEP_PARAMETER                     1
@@ -1265,10 +1279,335 @@ typedef struct _ps_mgmt
     inact_sleep_param inact_param;
 } ps_mgmt;
 
+/** uap_transport: backend carrying host commands to the firmware */
+typedef struct _uap_transport
+{
+    /** backend name, as given to uap_open() */
+    char *name;
+    /** set up the backend, arg is the text after "name:" or NULL */
+    int (*open) (struct _uap_dev * dev, char *arg);
+    /** exchange one host command, response written in place */
+    int (*cmd) (struct _uap_dev * dev, u8 * buf);
+    /** set/get power mode */
+    int (*power_mode) (struct _uap_dev * dev, ps_mgmt * pm);
+    /** release the backend */
+    void (*close) (struct _uap_dev * dev);
+    /** non zero if cmd and power_mode may be called from several threads
+     *  at once, else requests are passed to the backend one at a time */
+    int concurrent;
+} uap_transport;
+
+/** Size of the error message kept by a handle */
+#define UAP_ERRMSG_LEN          128
+
+/** Outcome of the last request of a thread on a handle */
+typedef struct _uap_err_state
+{
+    /** UAP_ERR_ code of the last failure */
+    int last_err;
+    /** message of the last failure */
+    char errmsg[UAP_ERRMSG_LEN];
+    /** firmware result of the last host command */
+    s16 fw_result;
+    /** set while a request may still be retried: failures are
+     *  recorded but not printed */
+    int quiet;
+} uap_err_state;
+
+/** Maximum number of commands with their own deadline */
+#define UAP_TIMEOUT_CMDS        16
+/** Default number of retries of a transient failure */
+#define UAP_DEFAULT_RETRIES     2
+/** Default wait before the first retry in ms */
+#define UAP_DEFAULT_BACKOFF_MS  10
+/** Longest wait between two retries in ms */
+#define UAP_BACKOFF_MAX_MS      1000
+/** Signal interrupting a request past its deadline */
+#define UAP_DEADLINE_SIGNAL     (SIGRTMIN + 1)
+
+/** Default host of the metrics exporter */
+#define UAPEXP_DEFAULT_HOST     "127.0.0.1"
+/** Default time one snapshot serves the metrics scrapes in ms */
+#define UAPEXP_DEFAULT_CACHE_MS 5000
+
+/** Default EWMA weight of the newest RSSI in the sta_list watch */
+#define STA_WATCH_ALPHA         0.3
+/** Default number of polls below the RSSI threshold before a deauth */
+#define STA_DEAUTH_SAMPLES      3
+/** Default polling interval of the deauth policy in ms */
+#define STA_DEAUTH_INTERVAL_MS  1000
+
+/** List of MAC addresses read from the arguments or a file */
+typedef struct _mac_list
+{
+    /** Addresses */
+    u8 (*mac)[ETH_ALEN];
+    /** Number of addresses */
+    int n;
+    /** Allocated addresses */
+    int size;
+} mac_list;
+
+/** Most TLVs of a command built with tlv_build_add() */
+#define TLV_BUILD_MAX           128
+
+/** sys_configure command built in place, see uaptlv.c */
+typedef struct _tlv_builder
+{
+    /** Handle the command is sent on and errors are reported on */
+    uap_dev *dev;
+    /** Command buffer from uap_cmd_buf_alloc() */
+    u8 *buf;
+    /** Length of the command, of the response once sent */
+    u16 len;
+    /** Number of TLVs */
+    int count;
+    /** Offset of each TLV */
+    u16 off[TLV_BUILD_MAX];
+} tlv_builder;
+
+/** Deadline of one command code */
+typedef struct _uap_cmd_timeout
+{
+    /** command code */
+    u16 cmd_code;
+    /** deadline of one attempt in ms */
+    u32 timeout_ms;
+} uap_cmd_timeout;
+
+/** Host command in flight: completion object matched by SeqNum */
+typedef struct _uap_req
+{
+    /** sequence number given to the request */
+    u16 seq_num;
+    /** command code of the request */
+    u16 cmd_code;
+    /** next request in flight */
+    struct _uap_req *next;
+} uap_req;
+
+/** uap_dev: control context of one uAP interface */
+struct _uap_dev
+{
+    /** interface name */
+    char name[IFNAMSIZ + 1];
+    /** UAP_OPEN_ flags */
+    int flags;
+    /** debug level, buffers are dumped at MSG_ALL */
+    int debug;
+    /** protects the counters, histograms, trace, sys_cfg batch and
+        requests in flight */
+    pthread_mutex_t lock;
+    /** per thread uap_err_state */
+    pthread_key_t err_key;
+    /** thread that opened the handle */
+    pthread_t owner;
+    /** uap_err_state of the owner and of threads without their own */
+    uap_err_state err;
+    /** passes requests one at a time to non concurrent backends */
+    pthread_mutex_t xfer_lock;
+    /** sequence number of the last host command */
+    u16 seq_num;
+    /** host commands in flight */
+    uap_req *inflight;
+    /** number of host commands in flight */
+    u32 inflight_num;
+    /** largest number of host commands in flight at once */
+    u32 inflight_peak;
+    /** transport backend */
+    uap_transport *ops;
+    /** backend private data */
+    void *priv;
+    /** control socket, opened once for the life of the handle */
+    int sockfd;
+    /** ioctl request, interface name filled in at open time */
+    struct ifreq ifr;
+    /** number of host commands sent */
+    u32 cmd_count;
+    /** number of power mode requests sent */
+    u32 pm_count;
+    /** number of requests failed by the transport */
+    u32 err_count;
+    /** number of responses carrying a failure result */
+    u32 fw_err_count;
+    /** deadline of one attempt in ms, 0 for none */
+    u32 timeout_ms;
+    /** commands with their own deadline */
+    uap_cmd_timeout cmd_timeouts[UAP_TIMEOUT_CMDS];
+    /** number of commands with their own deadline */
+    u32 timeout_cmds;
+    /** number of retries of a transient failure */
+    u32 retries;
+    /** wait before the first retry in ms, doubled for each next one */
+    u32 backoff_ms;
+    /** retry attempts past their deadline too, off by default */
+    int retry_timeouts;
+    /** number of attempts retried */
+    u32 retry_count;
+    /** number of attempts past their deadline */
+    u32 timeout_count;
+    /** trace file, when recording */
+    FILE *trace;
+    /** sys_cfg SET TLVs held back while a batch is open, else NULL */
+    u8 *cfg_batch;
+    /** length of the held back TLVs */
+    u16 cfg_len;
+    /** number of SET requests held back in the open batch */
+    u32 cfg_sets;
+    /** number of commands the open batch was sent in */
+    u32 cfg_cmds;
+    /** per command latency histograms, allocated on first use */
+    struct _uap_timing *timing;
+    /** number of histograms in use */
+    u32 timing_cmds;
+    /** command buffer pool, UAP_CMD_POOL_SIZE buffers in one block */
+    u8 *cmd_pool;
+    /** bit n set when pool buffer n is free */
+    u32 cmd_pool_free;
+    /** number of buffers allocated because the pool was empty */
+    u32 cmd_pool_misses;
+};
+
+/** Number of pooled command buffers per handle, deep enough for the
+ *  commands that query another setting while holding their buffer */
+#define UAP_CMD_POOL_SIZE       4
+/** Alignment of pooled command buffers */
+#define UAP_CMD_POOL_ALIGN      64
+
+/** Room for TLVs in a batched sys_cfg command */
+#define UAP_CFG_BATCH_ROOM \
+    (MRVDRV_SIZE_OF_CMD_BUFFER - sizeof(APCMDBUF_SYS_CONFIGURE))
+
+/** Decoded trace record */
+typedef struct _trace_rec
+{
+    /** UAP_TRACE_HOSTCMD or UAP_TRACE_POWER_MODE */
+    u8 type;
+    /** Transport status, UAP_SUCCESS or UAP_FAILURE */
+    u8 status;
+    /** Command code of the request */
+    u16 cmd_code;
+    /** Sequence number of the request */
+    u16 seq_num;
+    /** Request length */
+    u16 req_len;
+    /** Response length */
+    u16 resp_len;
+    /** Command buffer size */
+    u16 buf_size;
+    /** Monotonic time the request was sent, in ns */
+    u64 start_ns;
+    /** Round trip latency in ns */
+    u32 latency_ns;
+    /** Request bytes */
+    u8 *req;
+    /** Response bytes */
+    u8 *resp;
+} trace_rec;
+
+/** Trace file header length: magic, version, reserved */
+#define UAP_TRACE_HDR_LEN       12
+
+/** Trace record type: host command */
+#define UAP_TRACE_HOSTCMD       1
+/** Trace record type: power mode ioctl */
+#define UAP_TRACE_POWER_MODE    2
+
+/** Latency histogram sub-buckets per power of two, as a shift */
+#define UAP_TIMING_SUB_BITS     3
+/** Latencies from 2^UAP_TIMING_MAX_BITS ns (~9 minutes) share a bucket */
+#define UAP_TIMING_MAX_BITS     39
+/** Number of latency histogram buckets */
+#define UAP_TIMING_BUCKETS \
+    ((UAP_TIMING_MAX_BITS - UAP_TIMING_SUB_BITS + 2) << UAP_TIMING_SUB_BITS)
+/** Maximum number of command codes timed */
+#define UAP_TIMING_CMDS         32
+
+/** Round trip latency histogram of one command code */
+typedef struct _uap_timing
+{
+    /** UAP_TRACE_HOSTCMD or UAP_TRACE_POWER_MODE */
+    u8 type;
+    /** Command code */
+    u16 cmd_code;
+    /** Number of requests the transport failed */
+    u32 errors;
+    /** Number of attempts retried */
+    u32 retries;
+    /** Number of attempts past their deadline */
+    u32 timeouts;
+    /** Number of timed requests */
+    u32 count;
+    /** Shortest latency in ns */
+    u64 min_ns;
+    /** Longest latency in ns */
+    u64 max_ns;
+    /** Sum of latencies in ns */
+    u64 total_ns;
+    /** Log-linear histogram, each bucket 1/8 of a power of two wide */
+    u32 hist[UAP_TIMING_BUCKETS];
+} uap_timing;
+
+/** Simulated firmware backend, uapsim.c */
+extern uap_transport uap_sim_transport;
+/** Trace replay backend, uaptrace.c */
+extern uap_transport uap_replay_transport;
+
 /** Function Prototype Declaration */
 int mac2raw(char *mac, u8 * raw);
+int mac_list_add(mac_list * macs, char *str);
+int mac_list_read(mac_list * macs, char *path);
 void print_mac(u8 * raw);
-int uap_ioctl(u8 * cmd, u16 * size, u16 buf_size);
+int uap_dev_error(uap_dev * dev, int err, char *fmt, ...);
+uap_err_state *uap_dev_err_state(uap_dev * dev);
+void print_lib_error(int err, char *fw_msg);
+int uap_ioctl(uap_dev * dev, u8 * cmd, u16 * size, u16 buf_size);
+int uap_power_mode_ioctl(uap_dev * dev, ps_mgmt * pm);
+u64 uap_time_ns(void);
+char *uap_cmd_name(u16 cmd_code);
+int uap_cmd_code(char *name);
+void uap_timing_print(uap_dev * dev);
+u8 *uap_cmd_buf_alloc(uap_dev * dev, int clear_len);
+void uap_cmd_buf_free(uap_dev * dev, u8 * buf);
+void uap_timing_reset(uap_dev * dev);
+int uap_trace_open(uap_dev * dev, char *file);
+void uap_trace_close(uap_dev * dev);
+u8 *uap_trace_load(uap_dev * dev, char *file, long *len);
+long uap_trace_decode(u8 * data, long len, long off, trace_rec * rec);
+void uap_trace_record(uap_dev * dev, u8 type, int status, u8 * req,
+                      u16 req_len, u8 * resp, u16 resp_len, u16 buf_size,
+                      u64 start_ns, u64 end_ns);
+void apcmd_trace_stats(uap_dev * dev, int argc, char *argv[]);
+void apcmd_shm_publish(uap_dev * dev, int argc, char *argv[]);
+void apcmd_shm_read(uap_dev * dev, int argc, char *argv[]);
+void apcmd_tslog_record(uap_dev * dev, int argc, char *argv[]);
+void apcmd_tslog_query(uap_dev * dev, int argc, char *argv[]);
+const char *stats_field(uap_stats_info * stats, int i, unsigned int *value);
+const char *coex_stats_name(int i);
+int coex_stats_get(uap_dev * dev, unsigned int *stats);
+const char *power_mode_name(int mode);
+void apcmd_snapshot(uap_dev * dev, int argc, char *argv[]);
+void sta_list_watch(uap_dev * dev, long interval_ms, long count,
+                    double alpha);
+int sta_deauth_list(uap_dev * dev, u8 (*mac)[ETH_ALEN], int n, u16 reason,
+                    int *ret);
+void sta_deauth_policy(uap_dev * dev, int rssi_below, long samples,
+                       long interval_ms, long count, u16 reason,
+                       int dry_run);
+int sta_mac_dedup(mac_list * macs);
+int sta_mac_diff(mac_list * macs, u8 * cur, int cur_count);
+int tlv_build_start(uap_dev * dev, tlv_builder * b, u16 action);
+void *tlv_build_add(tlv_builder * b, u16 tag, u16 size);
+void tlv_build_trim(tlv_builder * b, void *tlv, u16 size);
+int tlv_build_send(uap_dev * dev, tlv_builder * b);
+void tlv_build_free(uap_dev * dev, tlv_builder * b);
+void apcmd_timing(uap_dev * dev, int argc, char *argv[]);
+int uap_run_command(uap_dev * dev, int argc, char *argv[]);
+int split_command_line(char *line, char *args[], int max_args);
+int uapd_run(uap_dev * dev, char *path);
+int uapd_listen(char *path);
+int uapd_allowed(char *what);
+int uapexp_run(uap_dev * dev, char *addr, long cache_ms);
 void print_auth(TLVBUF_AUTH_MODE * tlv);
 void print_tlv(u8 * buf, u16 len);
 void print_cipher(TLVBUF_CIPHER * tlv);
@@ -1281,9 +1620,13 @@ unsigned int a2hex(char *s);
 int fparse_for_hex(FILE * fp, u8 * dst);
 int is_input_valid(valid_inputs cmd, int argc, char *argv[]);
 int is_cipher_valid(int pairwisecipher, int groupcipher);
-int get_sys_cfg_rates(u8 * rates);
-int is_tx_rate_valid(u8 rate);
-int is_mcbc_rate_valid(u8 rate);
+int get_sys_cfg_rates(uap_dev * dev, u8 * rates);
+int is_tx_rate_valid(uap_dev * dev, u8 rate);
+int is_mcbc_rate_valid(uap_dev * dev, u8 rate);
 void hexdump_data(char *prompt, void *p, int len, char delim);
+#if DEBUG
+void uap_printf(int level, char *fmt, ...);
+void hexdump(char *prompt, void *p, int len, char delim);
+#endif
 unsigned char hexc2bin(char chr);
 #endif /* _UAP_H */